@@ -0,0 +1,94 @@
+// advisor.h
+
+#pragma once
+
+#include "tokenizer.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Static performance review of a linked program. Finds constructs that are
+// slow in this interpreter and estimates what they cost:
+//   rem-in-loop     REM lines executed on every iteration
+//   memory-scalar   m[k] with a constant k used as a variable in a loop
+//   if-chain        long runs of IF x = k THEN on one variable
+//   loop-invariant  arithmetic on values the loop never changes
+//   print-in-loop   PRINT to stdout (flushed per line) in a tight loop
+// Loops are WHILE/WEND, DO/LOOP and backward GOTO/THEN. A finding's weight
+// is how often its line ran, from a profile when one is given (see
+// SUBARUU::Options::profile) and otherwise SUBARUU_ADVISOR_ITERATIONS per
+// enclosing loop; findings are ranked by cost times weight.
+class Advisor {
+    public:
+        // Executions per BASIC line number
+        using Profile = std::unordered_map<int, std::uint64_t>;
+        struct Finding {
+            int line; // BASIC line number
+            std::string kind;
+            std::string message;
+            double cost;   // estimated units per execution
+            double weight; // executions, measured or estimated
+            bool measured;
+        };
+
+        Advisor(std::string_view name,
+                std::string text,
+                const Profile* profile = nullptr);
+
+        // Ranked by impact, highest first
+        [[nodiscard]] const std::vector<Finding>& findings() const noexcept {
+            return findings_;
+        }
+        // One finding per line, e.g.
+        //   "  line 40: PRINT in a 2-line loop ... [print-in-loop, 20 x ~100]"
+        [[nodiscard]] std::string report() const;
+
+        // "line executions" per line; '#' lines are comments
+        static Profile load_profile(std::string_view path); // Can throw
+        static void save_profile(std::string_view path,
+                                 const Profile& profile); // Can throw
+
+    private:
+        using TokenType = Tokenizer::TokenType;
+        struct Token {
+            TokenType type;
+            long long number; // NUMBER tokens that fit, else -1
+            char letter;      // LETTER tokens, lower case
+        };
+        // Tokens between two EOLs
+        struct Statement {
+            int line;
+            std::size_t begin;
+            std::size_t end;
+        };
+        // Statements first..last, repeated
+        struct Loop {
+            std::size_t first;
+            std::size_t last;
+        };
+
+        void lex(std::string_view name, std::string text);
+        void find_loops();
+        void check_statement(std::size_t index);
+        void check_if_chains();
+        void check_invariants(std::size_t index, const Loop& loop);
+        // Letters assigned by LET or INPUT within a loop
+        std::unordered_set<char> assigned(const Loop& loop) const;
+        const Loop* innermost(std::size_t index) const;
+        void add(std::size_t index,
+                 const char* kind,
+                 std::string message,
+                 double cost);
+
+        const Profile* profile_;
+        std::vector<Token> tokens_;
+        std::vector<Statement> statements_;
+        std::unordered_map<long long, std::size_t> line_starts_;
+        std::vector<Loop> loops_;
+        std::vector<Finding> findings_;
+};
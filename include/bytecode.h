@@ -0,0 +1,100 @@
+// bytecode.h
+
+#pragma once
+
+#include "tokenizer.h"
+
+#include <boost/multiprecision/cpp_int.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Compact in-memory form of a program: one opcode byte per token (its
+// TokenType) followed by its operand, if any. Numbers are LEB128 varints,
+// inline when below 2^63 and otherwise an index into a pool of cpp_int
+// literals; string literals are an index into a pool of unique texts; a
+// variable operand is its letter. Whitespace and comment text are dropped,
+// so a program usually encodes to less than its source.
+//
+// Tokenizer decodes it on the fly (see Tokenizer(std::shared_ptr<const
+// Bytecode>)); token offsets are then byte offsets into the code.
+class Bytecode {
+    public:
+        using TokenType = Tokenizer::TokenType;
+        using value_t = boost::multiprecision::cpp_int;
+
+        // Encodes the tokens of `tokenizer` from its current position on
+        static std::shared_ptr<const Bytecode> compile(Tokenizer& tokenizer);
+        // One program of the parts in order, each starting on a new line
+        static std::shared_ptr<const Bytecode> link(
+          const std::vector<std::shared_ptr<const Bytecode>>& parts);
+
+        // Decodes the token at pos into type and (for tokens with an
+        // operand) data; returns the position of the next token
+        std::size_t decode(std::size_t pos,
+                           TokenType& type,
+                           Tokenizer::TokenData& data) const {
+            type = static_cast<TokenType>(code_[pos++]);
+            switch (type) {
+                case TokenType::NUMBER: {
+                    const auto tag = read_varint(pos);
+                    if (tag & 1)
+                        data = numbers_[tag >> 1];
+                    else
+                        data = value_t(tag >> 1);
+                    break;
+                }
+                case TokenType::STRING:
+                    // A view: the pool lives as long as the code
+                    data = std::string_view(strings_[read_varint(pos)]);
+                    break;
+                case TokenType::LETTER:
+                case TokenType::STRING_VAR:
+                    data = static_cast<char>(code_[pos++]);
+                    break;
+                default:
+                    break;
+            }
+            return pos;
+        }
+
+        // End of the code, i.e. the offset of EOF
+        [[nodiscard]] std::size_t end() const noexcept { return code_.size(); }
+        // Bytes held: code plus pooled literals
+        [[nodiscard]] std::size_t size() const noexcept;
+        // History::hash over the code and its pools: programs that differ
+        // only in whitespace or comment text have the same fingerprint
+        [[nodiscard]] std::uint64_t fingerprint() const;
+        // The fingerprint compile(tokenizer) would have, without keeping
+        // the code; the tokenizer is left at EOF
+        static std::uint64_t fingerprint(Tokenizer& tokenizer);
+
+    private:
+        using Pool = std::unordered_map<std::string, std::uint64_t>;
+        // Encodes the tokenizer's tokens after the code so far, up to EOF
+        // or until the code holds `limit` bytes
+        void append(Tokenizer& tokenizer,
+                    Pool& pooled,
+                    std::size_t limit = SIZE_MAX);
+        std::uint64_t hash_pools(std::uint64_t h) const;
+        void emit(TokenType type) {
+            code_.push_back(static_cast<std::uint8_t>(type));
+        }
+        void write_varint(std::uint64_t value);
+        std::uint64_t read_varint(std::size_t& pos) const {
+            std::uint64_t value = 0;
+            for (int shift = 0;; shift += 7) {
+                const auto byte = code_[pos++];
+                value |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+                if (!(byte & 0x80))
+                    return value;
+            }
+        }
+
+        std::vector<std::uint8_t> code_;
+        std::vector<value_t> numbers_;
+        std::vector<std::string> strings_;
+};
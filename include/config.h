@@ -3,14 +3,73 @@
 #pragma once
 
 #include <cstddef>
+#include <cstdint>
 
 // SUBARUU file extension.
 constexpr char SUBARUU_EXTENSION_LITERAL[] = "subaru";
 
 // Max length of string/number literals.
-constexpr std::size_t SUBARUU_STRING_LITERAL = 50;
+constexpr std::size_t SUBARUU_STRING_LITERAL = 4096;
 constexpr std::size_t SUBARUU_NUMBER_LITERAL = 10000;
 
+// String values: bytes stored inline before spilling to a rope, and the
+// size up to which adjacent rope leaves are coalesced on concatenation
+constexpr std::size_t SUBARUU_STRING_INLINE = 22;
+constexpr std::size_t SUBARUU_ROPE_LEAF = 512;
+
 // Interpreter constants
 constexpr std::size_t SUBARUU_MAX_VARIABLES = 26;
 constexpr bool SUBARUU_TERMINATE_ON_DIV_ZERO = false;
+// A LET whose inputs did not change reuses its last value once they span
+// this many 64-bit limbs, below which recomputing is as cheap
+constexpr std::size_t SUBARUU_MEMO_LIMBS = 4;
+
+// Output channels (OPEN ... FOR OUTPUT AS #n)
+constexpr std::size_t SUBARUU_MAX_CHANNELS = 255;
+constexpr std::size_t SUBARUU_CHANNEL_BUFFER = std::size_t(1) << 20;
+constexpr bool SUBARUU_CHANNEL_ASYNC_FLUSH = true;
+// zlib level for ".gz" channels and -output: fastest, to keep up with disk
+constexpr int SUBARUU_GZIP_LEVEL = 1;
+
+// PRINT USING: widest field, and distinct format strings kept compiled
+constexpr std::size_t SUBARUU_FORMAT_WIDTH = 1000;
+constexpr std::size_t SUBARUU_FORMAT_CACHE = 256;
+
+// SORT: fewest keys per radix sort thread
+constexpr std::size_t SUBARUU_SORT_PARALLEL = std::size_t(1) << 17;
+
+// SET/GET tables: smallest capacity (a power of two) and the load factor
+// past which a table doubles
+constexpr std::size_t SUBARUU_TABLE_MIN = 16;
+constexpr double SUBARUU_TABLE_LOAD = 0.75;
+
+// Execution: PRINT output buffered before a program waits for the host
+constexpr std::size_t SUBARUU_EXECUTION_OUTPUT = std::size_t(1) << 16;
+
+// INPUT read buffer
+constexpr std::size_t SUBARUU_INPUT_BUFFER = std::size_t(1) << 20;
+
+// Run history: most recent runs per engine that an engine choice averages,
+// and that the history file keeps of each program on each engine
+constexpr std::size_t SUBARUU_HISTORY_WINDOW = 8;
+
+// Sweeps: runs per shard by default, times a shard is handed out (and a
+// local worker started again) before the sweep fails, the most points a
+// grid may have, and how often the coordinator checks on its workers
+constexpr std::size_t SUBARUU_SWEEP_SHARD = 16;
+constexpr std::size_t SUBARUU_SWEEP_ATTEMPTS = 3;
+constexpr std::size_t SUBARUU_SWEEP_MAX_RUNS = std::size_t(1) << 32;
+constexpr int SUBARUU_SWEEP_POLL_MS = 100;
+
+// Live metrics: statements between updates of the shared counters
+constexpr std::uint64_t SUBARUU_METRICS_BATCH = 4096;
+
+// Performance advisor (-lint-perf): iterations assumed per loop without a
+// profile, the longest loop (in statements) that counts as tight, and the
+// shortest IF x = k chain reported
+constexpr double SUBARUU_ADVISOR_ITERATIONS = 10;
+constexpr std::size_t SUBARUU_ADVISOR_TIGHT_LOOP = 4;
+constexpr std::size_t SUBARUU_ADVISOR_IF_CHAIN = 4;
+
+// RND stream used until the program calls RANDOMIZE
+constexpr std::uint64_t SUBARUU_DEFAULT_SEED = 0x5ab4a0ULL;
@@ -0,0 +1,154 @@
+// execution.h
+
+#pragma once
+
+#include "subaruu.h"
+
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <istream>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <string_view>
+#include <utility>
+
+// A program run as C++20 coroutines, for hosts that interleave many
+// executions on one event loop thread. `co_await exec.step(budget)` runs at
+// most `budget` statements (see SUBARUU::run_for) and then suspends the
+// awaiting coroutine:
+//   BUDGET  handed to the scheduler, which queues it to resume later
+//   INPUT   until feed() or close_input() supplies what INPUT reads
+//   OUTPUT  until take_output() drains the buffered PRINT output
+// and returns why the slice ended; FINISHED does not suspend. Without a
+// scheduler a slice that used its budget continues at once. PRINT output
+// is buffered here (up to SUBARUU_EXECUTION_OUTPUT bytes before the
+// program waits), INPUT reads what was fed.
+class Execution {
+    public:
+        using Pause = SUBARUU::Pause;
+        // Must queue the handle, not resume it inline
+        using Scheduler = std::function<void(std::coroutine_handle<>)>;
+
+        class Step {
+            public:
+                bool await_ready() const noexcept { return false; }
+                bool await_suspend(std::coroutine_handle<> waiter);
+                Pause await_resume() const noexcept { return pause_; }
+
+            private:
+                friend class Execution;
+                Step(Execution& exec, std::uint64_t budget)
+                  : exec_(exec)
+                  , budget_(budget) {}
+
+                Execution& exec_;
+                std::uint64_t budget_;
+                Pause pause_ = Pause::BUDGET;
+        };
+
+        // Coroutine returned by run(); starts suspended
+        class Task {
+            public:
+                struct promise_type {
+                    std::exception_ptr error;
+                    Task get_return_object() noexcept {
+                        return Task(Handle::from_promise(*this));
+                    }
+                    std::suspend_always initial_suspend() noexcept {
+                        return {};
+                    }
+                    std::suspend_always final_suspend() noexcept {
+                        return {};
+                    }
+                    void return_void() noexcept {}
+                    void unhandled_exception() noexcept {
+                        error = std::current_exception();
+                    }
+                };
+                using Handle = std::coroutine_handle<promise_type>;
+
+                Task(Task&& other) noexcept
+                  : handle_(std::exchange(other.handle_, nullptr)) {}
+                ~Task() {
+                    if (handle_)
+                        handle_.destroy();
+                }
+
+                // Runs until the task next suspends
+                void resume() { handle_.resume(); }
+                [[nodiscard]] bool done() const { return handle_.done(); }
+                // Rethrows the error that ended the task, if any
+                void result() const {
+                    if (handle_.promise().error)
+                        std::rethrow_exception(handle_.promise().error);
+                }
+
+            private:
+                explicit Task(Handle handle) noexcept
+                  : handle_(handle) {}
+                Task(const Task&) = delete;
+                Task& operator=(const Task&) = delete;
+
+                Handle handle_;
+        };
+
+        Execution(std::string_view source,
+                  SUBARUU::Options options,
+                  Scheduler scheduler = nullptr); // Can throw
+
+        [[nodiscard]] Step step(std::uint64_t budget) {
+            return Step(*this, budget);
+        }
+        // Steps of `budget` statements until the program finishes
+        Task run(std::uint64_t budget);
+
+        // Text for INPUT; a number counts as available once followed by
+        // whitespace or by close_input()
+        void feed(std::string_view text);
+        void close_input();
+        // Buffered PRINT output, removed from the buffer
+        std::string take_output();
+        [[nodiscard]] std::size_t pending_output() const noexcept {
+            return output_.size;
+        }
+
+        [[nodiscard]] SUBARUU& interpreter() noexcept { return subaruu_; }
+
+    private:
+        struct InputBuf : std::streambuf {
+            std::string data;
+            void append(std::string_view text);
+            int_type underflow() override;
+        };
+        struct OutputBuf : std::streambuf {
+            std::string data;
+            std::size_t size = 0; // data.size(), for the gate
+            int_type overflow(int_type ch) override;
+            std::streamsize xsputn(const char* s, std::streamsize n) override;
+        };
+
+        static SUBARUU::Options wire(SUBARUU::Options options,
+                                     std::istream& in,
+                                     std::ostream& out);
+        void wake(Pause reason);
+
+        Scheduler scheduler_;
+        InputBuf input_;
+        OutputBuf output_;
+        std::istream in_;
+        std::ostream out_;
+        std::size_t input_ready_ = 0;
+        bool in_number_ = false;
+        SUBARUU::Gate gate_;
+        SUBARUU subaruu_;
+        // The coroutine suspended on INPUT or OUTPUT
+        std::coroutine_handle<> waiter_;
+        Pause waiting_for_ = Pause::FINISHED;
+
+        Execution(const Execution&) = delete;
+        Execution& operator=(const Execution&) = delete;
+};
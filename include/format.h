@@ -0,0 +1,52 @@
+// format.h
+
+#pragma once
+
+#include "str.h"
+
+#include <boost/multiprecision/cpp_int.hpp>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Compiled format string of PRINT USING. Text is copied as is except for
+// fields, which take the next item:
+//   {[<|>|^][0][width]}
+// aligned left, right or centered in at least width characters ('0' pads
+// numbers with zeros after the sign); numbers default to the right, strings
+// to the left, and nothing is truncated. "{{" and "}}" are literal braces.
+class Format {
+    public:
+        using value_t = boost::multiprecision::cpp_int;
+
+        enum class Align { DEFAULT, LEFT, RIGHT, CENTER };
+        struct Field {
+            std::string prefix; // literal text before the field
+            Align align;
+            bool zero;
+            std::size_t width;
+        };
+
+        explicit Format(std::string_view text); // Can throw
+
+        [[nodiscard]] const std::vector<Field>& fields() const noexcept {
+            return fields_;
+        }
+        // Literal text after the last field
+        [[nodiscard]] const std::string& suffix() const noexcept {
+            return suffix_;
+        }
+
+        // Append an item formatted by field to out
+        static void write_number(std::string& out,
+                                 const Field& field,
+                                 const value_t& value);
+        static void write_string(std::string& out,
+                                 const Field& field,
+                                 const Str& value);
+
+    private:
+        std::vector<Field> fields_;
+        std::string suffix_;
+};
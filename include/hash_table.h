@@ -0,0 +1,71 @@
+// hash_table.h
+
+#pragma once
+
+#include <boost/multiprecision/cpp_int.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Associative array behind SET/GET/HAS/DEL, keyed by numbers or strings (5
+// and "5" are different keys). Open addressing with linear probing over an
+// array of hashes, so a lookup scans consecutive 8-byte words and reads an
+// entry only on a full hash match; erasing shifts the following entries
+// back rather than leaving tombstones. Numbers that fit in 64 bits and
+// strings are hashed and compared without allocating; larger numbers are
+// keyed by their decimal text.
+class HashTable {
+    public:
+        using value_t = boost::multiprecision::cpp_int;
+
+        struct Stats {
+            std::size_t size = 0;
+            std::size_t capacity = 0;
+            std::uint64_t lookups = 0;
+            std::uint64_t probes = 0; // slots examined by those lookups
+            std::size_t longest = 0;  // longest probe to a stored key
+        };
+
+        [[nodiscard]] const value_t* find(const value_t& key) const;
+        [[nodiscard]] const value_t* find(std::string_view key) const;
+        void set(const value_t& key, value_t value);
+        void set(std::string_view key, value_t value);
+        // false if the key was not present
+        bool erase(const value_t& key);
+        bool erase(std::string_view key);
+
+        [[nodiscard]] std::size_t size() const noexcept { return size_; }
+        [[nodiscard]] Stats stats() const;
+
+    private:
+        enum class Kind : std::uint8_t { NUMBER, BIG, STRING };
+        struct Key {
+            Kind kind;
+            std::int64_t number;   // NUMBER
+            std::string_view text; // BIG and STRING
+        };
+        struct Entry {
+            Kind kind = Kind::NUMBER;
+            std::int64_t number = 0;
+            std::string text;
+            value_t value;
+        };
+
+        // `big` holds the text of a number beyond 64 bits
+        static Key number_key(const value_t& key, std::string& big);
+        static std::uint64_t hash(const Key& key) noexcept;
+        static bool matches(const Entry& entry, const Key& key) noexcept;
+        // Slot holding key, or npos
+        std::size_t locate(const Key& key) const;
+        void insert(const Key& key, value_t value);
+        bool remove(const Key& key);
+        void grow();
+
+        std::vector<std::uint64_t> hashes_; // 0 marks an empty slot
+        std::vector<Entry> entries_;
+        std::size_t size_ = 0;
+        mutable std::uint64_t lookups_ = 0;
+        mutable std::uint64_t probes_ = 0;
+};
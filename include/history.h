@@ -0,0 +1,59 @@
+// history.h
+
+#pragma once
+
+#include "config.h"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Per-program run records kept in a text file, one run per line:
+//   <hash> <engine> <verified> <load_ms> <run_ms> <statements> <cells> <peak_kb>
+// Programs are keyed by a hash of their linked code. The records of earlier
+// runs pick the engine for the next run of the same program, compact
+// bytecode or source text, whichever was faster. The file is user-writable,
+// so `verified` is a record only and never skips verification.
+class History {
+    public:
+        struct Run {
+            std::uint64_t hash;
+            bool compact;
+            bool verified;
+            double load_ms;
+            double run_ms;
+            std::uint64_t statements;
+            std::uint64_t memory_cells;
+            long peak_kb;
+        };
+        struct Choice {
+            bool compact;
+            std::string reason;
+        };
+
+        // Reads the records in path; a missing file has none
+        explicit History(std::string path);
+
+        // FNV-1a over the text; pass a previous hash to continue it
+        static std::uint64_t hash(
+          std::string_view text,
+          std::uint64_t h = 0xcbf29ce484222325ULL) noexcept;
+
+        // Engine for the next run; `compact` is the default
+        [[nodiscard]] Choice choose(std::uint64_t hash, bool compact) const;
+        [[nodiscard]] std::vector<Run> runs(std::uint64_t hash) const;
+        // Appends a run to the file, compacting it now and then so that
+        // it keeps at most twice SUBARUU_HISTORY_WINDOW runs per program
+        // and engine
+        void record(const Run& run); // Can throw
+
+        [[nodiscard]] const std::string& path() const noexcept {
+            return path_;
+        }
+
+    private:
+        void prune();
+        std::string path_;
+        std::vector<Run> runs_;
+};
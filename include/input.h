@@ -0,0 +1,36 @@
+// input.h
+
+#pragma once
+
+#include "config.h"
+
+#include <boost/multiprecision/cpp_int.hpp>
+#include <cstddef>
+#include <istream>
+#include <vector>
+
+// Reads whitespace-separated integers from a stream through a large buffer.
+// Numbers of up to 18 digits are accumulated in 64 bits; longer digit runs
+// are assembled 18 digits at a time into a cpp_int.
+class InputReader {
+    public:
+        using value_t = boost::multiprecision::cpp_int;
+
+        explicit InputReader(std::istream& in,
+                             std::size_t capacity = SUBARUU_INPUT_BUFFER);
+
+        // Reads the next number; returns false at end of input.
+        bool next(value_t& value); // Can throw
+
+    private:
+        bool fill();
+        bool skip_space();
+
+        std::istream& in_;
+        std::vector<char> buffer_;
+        const char* pos_;
+        const char* end_;
+
+        InputReader(const InputReader&) = delete;
+        InputReader& operator=(const InputReader&) = delete;
+};
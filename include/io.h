@@ -2,53 +2,60 @@
 
 #pragma once
 #include <fstream>
+#include <memory>
 #include <string>
 #include <string_view>
 
 class IO {
     public:
-        using iterator = std::string::iterator;
+        // Content is shared between readers (see share()), so it is read-only
+        using iterator = std::string::const_iterator;
         using const_iterator = std::string::const_iterator;
 
         explicit IO(std::string_view filename); // Can throw
+        IO(std::string_view name, std::string content);
         ~IO() noexcept;
 
+        // A second reader over the same content, positioned at its start
+        [[nodiscard]] std::unique_ptr<IO> share() const;
+
         // Iterators
-        [[nodiscard]] iterator begin() noexcept { return content_.begin(); }
-        [[nodiscard]] iterator end() noexcept { return content_.end(); }
         [[nodiscard]] const_iterator begin() const noexcept {
-            return content_.begin();
+            return content_->begin();
         }
         [[nodiscard]] const_iterator end() const noexcept {
-            return content_.end();
+            return content_->end();
         }
 
         // Position
-        [[nodiscard]] iterator position() noexcept { return current_pos_; }
         [[nodiscard]] const_iterator position() const noexcept {
             return current_pos_;
         }
+        [[nodiscard]] std::size_t offset() const noexcept {
+            return static_cast<std::size_t>(current_pos_ -
+                                            content_->begin());
+        }
 
         // Char access
         [[nodiscard]] char current() const noexcept {
-            return current_pos_ != content_.end() ? *current_pos_ : '\0';
+            return current_pos_ != content_->end() ? *current_pos_ : '\0';
         }
         iterator next() noexcept {
-            if (current_pos_ != content_.end()) {
+            if (current_pos_ != content_->end()) {
                 ++current_pos_;
             }
             return current_pos_;
         }
         [[nodiscard]] bool eof() const noexcept {
-            return current_pos_ == content_.end();
+            return current_pos_ == content_->end();
         }
 
         // Lookahead 1 character (or '\0')
         [[nodiscard]] char peek() const noexcept {
             auto it = current_pos_;
-            if (it != content_.end()) {
+            if (it != content_->end()) {
                 ++it;
-                if (it != content_.end())
+                if (it != content_->end())
                     return *it;
             }
             return '\0';
@@ -75,9 +82,10 @@ class IO {
         }
 
     private:
+        IO(std::string_view name, std::shared_ptr<const std::string> content);
         void load_file();
         std::string filename_;
-        std::string content_;
+        std::shared_ptr<const std::string> content_;
         iterator current_pos_;
 
         IO(const IO&) = delete;
@@ -0,0 +1,102 @@
+// metrics.h
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <thread>
+
+// Live metrics of running interpreters (see SUBARUU::Options::metrics).
+// Interpreters add to the counters in batches of SUBARUU_METRICS_BATCH
+// statements with relaxed atomics; a sampler thread reads them every
+// interval and publishes them in the Prometheus text format, either by
+// atomically replacing a file or, for a "unix:PATH" target, to every client
+// that connects to the Unix socket at PATH.
+class Metrics {
+    public:
+        struct Counters {
+            std::atomic<std::uint64_t> statements{ 0 };
+            std::atomic<std::uint64_t> line{ 0 }; // last line started
+            std::atomic<std::uint64_t> jumps{ 0 };
+            std::atomic<std::uint64_t> memory_cells{ 0 };
+            std::atomic<std::uint64_t> bignums{ 0 }; // values past 64 bits
+            std::atomic<std::uint64_t> output_bytes{ 0 };
+        };
+
+        // Starts sampling; `program` labels every sample
+        Metrics(std::string target,
+                std::chrono::milliseconds interval,
+                std::string program); // Can throw
+        // Publishes a last sample and stops
+        ~Metrics();
+
+        [[nodiscard]] Counters& counters() noexcept { return counters_; }
+        // The latest sample
+        [[nodiscard]] std::string text() const;
+
+    private:
+        void sampler();
+        void sample();
+        void serve();
+
+        std::string target_;
+        std::string socket_path_;
+        std::chrono::milliseconds interval_;
+        std::string program_;
+        Counters counters_;
+        int listen_fd_ = -1;
+        std::uint64_t last_statements_ = 0;
+        std::uint64_t last_jumps_ = 0;
+        std::chrono::steady_clock::time_point last_time_;
+        std::string text_;
+        bool stop_ = false;
+        mutable std::mutex mutex_;
+        std::condition_variable cv_;
+        std::thread thread_;
+
+        Metrics(const Metrics&) = delete;
+        Metrics& operator=(const Metrics&) = delete;
+};
+
+// Output stream that forwards to another stream's buffer and counts the
+// bytes written; used for the output_bytes metric.
+class CountingStream : public std::ostream {
+    public:
+        explicit CountingStream(std::ostream& target)
+          : std::ostream(nullptr)
+          , buf_(target.rdbuf()) {
+            rdbuf(&buf_);
+        }
+
+        [[nodiscard]] std::uint64_t count() const noexcept {
+            return buf_.count;
+        }
+
+    private:
+        struct Buf : std::streambuf {
+            explicit Buf(std::streambuf* target)
+              : target(target) {}
+            int_type overflow(int_type ch) override {
+                if (traits_type::eq_int_type(ch, traits_type::eof()))
+                    return traits_type::not_eof(ch);
+                ++count;
+                return target->sputc(traits_type::to_char_type(ch));
+            }
+            std::streamsize xsputn(const char* s, std::streamsize n) override {
+                const auto written = target->sputn(s, n);
+                count += static_cast<std::uint64_t>(written);
+                return written;
+            }
+            int sync() override { return target->pubsync(); }
+
+            std::streambuf* target;
+            std::uint64_t count = 0;
+        };
+        Buf buf_;
+};
@@ -0,0 +1,56 @@
+// module.h
+
+#pragma once
+
+#include "bytecode.h"
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class Module {
+    public:
+        // A run of module code, optionally followed by a MERGE directive
+        // naming the module spliced in at that point. A compiled module
+        // keeps only `code`, a source module only `text`.
+        struct Segment {
+            std::shared_ptr<const Bytecode> code;
+            std::string text;
+            std::string merge;
+        };
+        enum class Form { COMPILED, SOURCE };
+
+        explicit Module(std::string_view path,
+                        Form form = Form::COMPILED); // Can throw
+
+        // Process-wide cache of compiled modules, keyed by canonical path;
+        // a module is re-read only when its file changes on disk.
+        static std::shared_ptr<const Module> load(std::string_view path);
+        static void clear_cache() noexcept;
+
+        // Links the compiled modules into one program; merged modules
+        // already in the cache are neither read nor lexed again. The root
+        // module itself is not cached.
+        static std::shared_ptr<const Bytecode> compile(
+          std::string_view path); // Can throw
+        // Expands MERGE directives into a single program text, reading
+        // every module from disk.
+        static std::string link(std::string_view path); // Can throw
+
+        [[nodiscard]] const std::string& path() const noexcept {
+            return path_;
+        }
+        [[nodiscard]] const std::vector<Segment>& segments() const noexcept {
+            return segments_;
+        }
+        [[nodiscard]] const std::vector<int>& line_numbers() const noexcept {
+            return line_numbers_;
+        }
+
+    private:
+        void parse(const IO& source, Form form);
+        std::string path_;
+        std::vector<Segment> segments_;
+        std::vector<int> line_numbers_;
+};
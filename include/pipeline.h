@@ -0,0 +1,75 @@
+// pipeline.h
+
+#pragma once
+
+#include "segment.h"
+#include "subaruu.h"
+
+#include <memory>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// A graph of programs run in one process, read from a manifest:
+//
+//   # comment
+//   stage NAME PROGRAM                      a program to run
+//   output NAME FIRST LAST                  m[FIRST..LAST] is its result
+//   input NAME FROM FIRST LAST [at DEST]    before NAME runs, copy FROM's
+//                                           m[FIRST..LAST] to m[DEST..]
+//   segment NAME FILE [cow]                 attach a segment file, read-only
+//                                           or copy-on-write (see Segment)
+//
+// Inputs must lie within an output of an earlier stage, so the graph is
+// acyclic. Every stage runs on its own thread once its inputs are done;
+// memory is handed over in-process and never written to disk, one cell
+// per cell FROM set, however wide the range. Each stage's
+// PRINT output is collected and written out in manifest order. A segment
+// file is mapped once and shared by every stage that attaches it.
+class Pipeline {
+    public:
+        using value_t = SUBARUU::value_t;
+        struct Range {
+            value_t first;
+            value_t last;
+        };
+        struct Input {
+            std::size_t from; // index of the upstream stage
+            Range range;
+            value_t at;
+        };
+        struct Attachment {
+            std::string file;
+            Segment::Access access;
+        };
+        struct Stage {
+            std::string name;
+            std::string program; // relative to the manifest's directory
+            std::vector<Range> outputs;
+            std::vector<Input> inputs;
+            std::vector<Attachment> segments;
+        };
+
+        explicit Pipeline(std::string_view path); // Can throw
+        Pipeline(std::string_view path, std::string_view text); // Can throw
+
+        // Runs every stage, writing their output to `out`; throws the
+        // first stage failure in manifest order once all stages stop
+        void run(std::ostream& out, const SUBARUU::Options& options);
+
+        // A cell of a finished stage's memory
+        [[nodiscard]] value_t peek(std::string_view stage,
+                                   const value_t& index) const; // Can throw
+        [[nodiscard]] const std::vector<Stage>& stages() const noexcept {
+            return stages_;
+        }
+
+    private:
+        void parse(std::string_view text);
+        std::size_t find(std::string_view name) const;
+
+        std::string path_;
+        std::vector<Stage> stages_;
+        std::vector<std::unique_ptr<SUBARUU>> results_;
+};
@@ -0,0 +1,333 @@
+// radix_trie.h
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <boost/multiprecision/cpp_int.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <memory>
+#include <utility>
+
+// Persistent sparse array indexed by integers. Indices that fit in 64 bits
+// are zigzag-encoded (so small negative indices stay shallow) and stored in
+// a 16-way radix trie whose leaves hold 16 cells and a presence mask.
+//
+// Copies share every node. A write copies only the nodes on its path that
+// are still shared, so copying a trie is O(1) and two copies diverge one
+// leaf at a time; nodes owned by a single trie are updated in place.
+// Indices beyond 64 bits live in a side map that is copied on write.
+//
+// A Cursor remembers the leaf found by the last lookup at one access site,
+// so the next lookup of a nearby index (in the same 16 cells) skips the
+// descent. Cursors are invalidated by any change to the trie's nodes and
+// by copying it, which bumps its epoch.
+template <typename V>
+class RadixTrie {
+    public:
+        using key_t = boost::multiprecision::cpp_int;
+
+        struct Cursor {
+            const std::shared_ptr<void>* leaf = nullptr; // its holder
+            std::uint64_t page = 0;  // index >> BITS of the leaf
+            std::uint64_t epoch = 0; // trie epoch it was found in
+            bool writable = false;   // leaf owned by this trie alone
+        };
+
+        RadixTrie()
+          : epoch_(next_epoch()) {}
+        RadixTrie(const RadixTrie& other)
+          : root_(other.root_)
+          , height_(other.height_)
+          , size_(other.size_)
+          , big_(other.big_)
+          , epoch_(next_epoch()) {
+            // The nodes are shared now, so the other's cursors may not
+            // write through them either
+            other.epoch_.store(next_epoch(), std::memory_order_relaxed);
+        }
+        RadixTrie& operator=(const RadixTrie& other) {
+            if (this != &other) {
+                root_ = other.root_;
+                height_ = other.height_;
+                size_ = other.size_;
+                big_ = other.big_;
+                epoch_.store(next_epoch(), std::memory_order_relaxed);
+                other.epoch_.store(next_epoch(), std::memory_order_relaxed);
+            }
+            return *this;
+        }
+
+        // The stored value, or nullptr if the cell was never written
+        [[nodiscard]] const V* find(const key_t& key) const {
+            std::uint64_t index;
+            if (small_key(key, index))
+                return find_small(index);
+            if (!big_)
+                return nullptr;
+            auto it = big_->find(key);
+            return it != big_->end() ? &it->second : nullptr;
+        }
+
+        // The stored value, or V() if the cell was never written
+        [[nodiscard]] const V& get(const key_t& key) const {
+            static const V empty{};
+            const V* value = find(key);
+            return value ? *value : empty;
+        }
+
+        void set(const key_t& key, V value) {
+            std::uint64_t index;
+            if (small_key(key, index)) {
+                slot(index) = std::move(value);
+                return;
+            }
+            if (!big_)
+                big_ = std::make_shared<BigMap>();
+            else if (big_.use_count() > 1)
+                big_ = std::make_shared<BigMap>(*big_);
+            if (big_->insert_or_assign(key, std::move(value)).second)
+                ++size_;
+        }
+
+        // find() and set() for an index in 64 bits other than INT64_MIN,
+        // through the cursor of the calling access site
+        [[nodiscard]] const V* find(std::int64_t key, Cursor& cursor) const {
+            const std::uint64_t index = zigzag(key);
+            if (!cached(cursor, index)) {
+                const std::shared_ptr<void>* leaf = find_leaf(index);
+                if (!leaf)
+                    return nullptr;
+                cursor = Cursor{ leaf, index >> BITS, epoch(), false };
+            }
+            const auto& leaf = *static_cast<const Leaf*>(cursor.leaf->get());
+            const auto cell = index & MASK;
+            return (leaf.present >> cell) & 1 ? &leaf.cells[cell] : nullptr;
+        }
+
+        void set(std::int64_t key, V value, Cursor& cursor) {
+            const std::uint64_t index = zigzag(key);
+            if (!cached(cursor, index) || !cursor.writable) {
+                std::shared_ptr<void>* holder = own_leaf(index);
+                cursor = Cursor{ holder, index >> BITS, epoch(), true };
+            }
+            store(*static_cast<Leaf*>(cursor.leaf->get()), index,
+                  std::move(value));
+        }
+
+        // Number of cells ever written
+        [[nodiscard]] std::size_t size() const noexcept { return size_; }
+
+        // Calls f(key, value) for every written cell with first <= key <=
+        // last, in no particular order. Only nodes overlapping the range
+        // are visited, so the cost follows the cells stored, not the width
+        // of the range.
+        template <typename F>
+        void for_each(const key_t& first, const key_t& last, F&& f) const {
+            if (last < first)
+                return;
+            if (root_) {
+                // Zigzag indices of the range's keys
+                const auto index_of = [](const key_t& key) {
+                    const key_t index =
+                      key < 0 ? key_t(-2 * key - 1) : key_t(2 * key);
+                    return index > std::numeric_limits<std::uint64_t>::max()
+                             ? std::numeric_limits<std::uint64_t>::max()
+                             : static_cast<std::uint64_t>(index);
+                };
+                std::uint64_t low = 0, high = 0;
+                if (first >= 0) {
+                    low = index_of(first);
+                    high = index_of(last);
+                } else if (last < 0) {
+                    low = index_of(last);
+                    high = index_of(first);
+                } else {
+                    high = std::max(index_of(first), index_of(last));
+                }
+                visit(root_, height_, 0, low, high, first, last, f);
+            }
+            if (big_) {
+                for (auto it = big_->lower_bound(first);
+                     it != big_->end() && it->first <= last; ++it)
+                    f(it->first, it->second);
+            }
+        }
+
+    private:
+        static constexpr int BITS = 4;
+        static constexpr int FANOUT = 1 << BITS;
+        static constexpr std::uint64_t MASK = FANOUT - 1;
+        static constexpr int MAX_HEIGHT = 64 / BITS - 1;
+
+        struct Leaf {
+            std::uint16_t present = 0;
+            std::array<V, FANOUT> cells{};
+        };
+        struct Branch {
+            std::array<std::shared_ptr<void>, FANOUT> children;
+        };
+        using BigMap = std::map<key_t, V>;
+
+        static std::uint64_t next_epoch() noexcept {
+            static std::atomic<std::uint64_t> epochs{ 0 };
+            return epochs.fetch_add(1, std::memory_order_relaxed) + 1;
+        }
+
+        std::uint64_t epoch() const noexcept {
+            return epoch_.load(std::memory_order_relaxed);
+        }
+
+        bool cached(const Cursor& cursor, std::uint64_t index) const noexcept {
+            return cursor.epoch == epoch() && cursor.page == (index >> BITS);
+        }
+
+        static std::uint64_t zigzag(std::int64_t key) noexcept {
+            return (static_cast<std::uint64_t>(key) << 1) ^
+                   static_cast<std::uint64_t>(key >> 63);
+        }
+
+        // Zigzag encoding of keys whose magnitude is below 2^63
+        static bool small_key(const key_t& key, std::uint64_t& index) {
+            if (key.backend().size() != 1)
+                return false;
+            const auto magnitude =
+              static_cast<std::uint64_t>(boost::multiprecision::abs(key));
+            if (magnitude >> 63)
+                return false;
+            index = key.sign() < 0 ? 2 * magnitude - 1 : 2 * magnitude;
+            return true;
+        }
+
+        // Visits the cells under node, whose indices start at base, with
+        // indices in [low, high] and keys in [first, last]
+        template <typename F>
+        static void visit(const std::shared_ptr<void>& node,
+                          int level,
+                          std::uint64_t base,
+                          std::uint64_t low,
+                          std::uint64_t high,
+                          const key_t& first,
+                          const key_t& last,
+                          F& f) {
+            if (level == 0) {
+                const auto& leaf = *static_cast<const Leaf*>(node.get());
+                key_t key = 0;
+                for (std::uint64_t cell = 0; cell < FANOUT; ++cell) {
+                    const std::uint64_t index = base + cell;
+                    if (!((leaf.present >> cell) & 1) || index < low ||
+                        index > high)
+                        continue;
+                    key = static_cast<std::int64_t>((index >> 1) ^
+                                                    (0 - (index & 1)));
+                    if (key >= first && key <= last)
+                        f(key, leaf.cells[cell]);
+                }
+                return;
+            }
+            const auto& branch = *static_cast<const Branch*>(node.get());
+            const std::uint64_t span = std::uint64_t(1) << (BITS * level);
+            for (std::uint64_t child = 0; child < FANOUT; ++child) {
+                const std::uint64_t start = base + child * span;
+                if (start > high)
+                    break;
+                if (branch.children[child] && start + (span - 1) >= low)
+                    visit(branch.children[child], level - 1, start, low,
+                          high, first, last, f);
+            }
+        }
+
+        bool fits(std::uint64_t index) const noexcept {
+            return height_ >= MAX_HEIGHT ||
+                   (index >> (BITS * (height_ + 1))) == 0;
+        }
+
+        // The holder of the leaf covering index, or nullptr if there is none
+        const std::shared_ptr<void>* find_leaf(std::uint64_t index) const {
+            if (!fits(index) || !root_)
+                return nullptr;
+            const std::shared_ptr<void>* node = &root_;
+            for (int level = height_; level > 0; --level) {
+                const auto& branch = *static_cast<const Branch*>(node->get());
+                node = &branch.children[(index >> (BITS * level)) & MASK];
+                if (!*node)
+                    return nullptr;
+            }
+            return node;
+        }
+
+        const V* find_small(std::uint64_t index) const {
+            const std::shared_ptr<void>* node = find_leaf(index);
+            if (!node)
+                return nullptr;
+            const auto& leaf = *static_cast<const Leaf*>(node->get());
+            const auto cell = index & MASK;
+            return (leaf.present >> cell) & 1 ? &leaf.cells[cell] : nullptr;
+        }
+
+        // Makes the node in `ptr` exclusively ours, creating or copying it;
+        // either moves the trie to a new epoch
+        template <typename Node>
+        Node& own(std::shared_ptr<void>& ptr) {
+            if (!ptr) {
+                ptr = std::make_shared<Node>();
+                epoch_.store(next_epoch(), std::memory_order_relaxed);
+            } else if (ptr.use_count() > 1) {
+                ptr = std::make_shared<Node>(*static_cast<const Node*>(
+                  ptr.get()));
+                epoch_.store(next_epoch(), std::memory_order_relaxed);
+            }
+            return *static_cast<Node*>(ptr.get());
+        }
+
+        V& slot(std::uint64_t index) {
+            auto& leaf = *static_cast<Leaf*>(own_leaf(index)->get());
+            const auto cell = index & MASK;
+            const auto bit = static_cast<std::uint16_t>(1u << cell);
+            if (!(leaf.present & bit)) {
+                leaf.present = static_cast<std::uint16_t>(leaf.present | bit);
+                ++size_;
+            }
+            return leaf.cells[cell];
+        }
+
+        void store(Leaf& leaf, std::uint64_t index, V value) {
+            const auto cell = index & MASK;
+            const auto bit = static_cast<std::uint16_t>(1u << cell);
+            if (!(leaf.present & bit)) {
+                leaf.present = static_cast<std::uint16_t>(leaf.present | bit);
+                ++size_;
+            }
+            leaf.cells[cell] = std::move(value);
+        }
+
+        // The holder of the leaf covering index, owned by this trie alone
+        std::shared_ptr<void>* own_leaf(std::uint64_t index) {
+            while (!fits(index)) {
+                if (root_) {
+                    auto branch = std::make_shared<Branch>();
+                    branch->children[0] = std::move(root_);
+                    root_ = std::move(branch);
+                }
+                ++height_;
+                epoch_.store(next_epoch(), std::memory_order_relaxed);
+            }
+            std::shared_ptr<void>* ptr = &root_;
+            for (int level = height_; level > 0; --level) {
+                auto& branch = own<Branch>(*ptr);
+                ptr = &branch.children[(index >> (BITS * level)) & MASK];
+            }
+            own<Leaf>(*ptr);
+            return ptr;
+        }
+
+        std::shared_ptr<void> root_;
+        int height_ = 0;
+        std::size_t size_ = 0;
+        std::shared_ptr<BigMap> big_;
+        mutable std::atomic<std::uint64_t> epoch_;
+};
@@ -0,0 +1,58 @@
+// random.h
+
+#pragma once
+
+#include "config.h"
+
+#include <array>
+#include <boost/multiprecision/cpp_int.hpp>
+#include <cstdint>
+#include <vector>
+
+// xoshiro256** (Blackman & Vigna) seeded through splitmix64. jump() advances
+// the state by 2^128 draws, so seed(s, k) selects the k-th of 2^128
+// non-overlapping substreams of seed s. Jumping is linear in the state, so
+// k jumps are taken as one product of precomputed powers of the jump.
+class Random {
+    public:
+        using value_t = boost::multiprecision::cpp_int;
+
+        explicit Random(std::uint64_t seed = SUBARUU_DEFAULT_SEED);
+
+        void seed(std::uint64_t seed, std::uint64_t stream = 0);
+        void jump() noexcept;
+        // `times` jumps in O(log times)
+        void jump(std::uint64_t times);
+
+        std::uint64_t next() noexcept { return step(s_); }
+
+        // Uniform in [0, bound); bound must be positive.
+        std::uint64_t below(std::uint64_t bound) noexcept;
+        value_t below(const value_t& bound);
+
+    private:
+        using State = std::array<std::uint64_t, 4>;
+        // A linear map of the state: the image of each of its 256 bits
+        using Map = std::array<State, 256>;
+
+        static std::uint64_t rotl(std::uint64_t x, int k) noexcept {
+            return (x << k) | (x >> (64 - k));
+        }
+        static std::uint64_t step(State& s) noexcept {
+            const std::uint64_t result = rotl(s[1] * 5, 7) * 9;
+            const std::uint64_t t = s[1] << 17;
+            s[2] ^= s[0];
+            s[3] ^= s[1];
+            s[1] ^= s[2];
+            s[0] ^= s[3];
+            s[2] ^= t;
+            s[3] = rotl(s[3], 45);
+            return result;
+        }
+        static State jumped(State s) noexcept;
+        static State apply(const Map& map, const State& s) noexcept;
+        // The jump raised to 2^k, for k = 0 .. 63
+        static const std::vector<Map>& powers();
+
+        State s_;
+};
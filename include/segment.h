@@ -0,0 +1,64 @@
+// segment.h
+
+#pragma once
+
+#include "radix_trie.h"
+
+#include <boost/multiprecision/cpp_int.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+
+class SUBARUU;
+
+// Immutable range of indexed memory, m[first..last], that any number of
+// interpreters can attach (see SUBARUU::attach) without copying it.
+//
+// A segment is captured from an interpreter, typically one that ran a setup
+// program, or mapped from a segment file. A file holds a header and one
+// native-endian 64-bit cell per index. It is mapped read-only and shared,
+// so processes that map the same file (e.g. under /dev/shm) share its pages.
+class Segment {
+    public:
+        using value_t = boost::multiprecision::cpp_int;
+        // What an interpreter does with writes into an attached segment
+        enum class Access {
+            READ_ONLY,    // runtime error
+            COPY_ON_WRITE // the interpreter keeps its own copy of the cell
+        };
+
+        // Snapshot of m[first..last] of an interpreter
+        static std::shared_ptr<const Segment> capture(const SUBARUU& from,
+                                                      const value_t& first,
+                                                      const value_t& last);
+        // Maps a segment file
+        static std::shared_ptr<const Segment> map(
+          std::string_view path); // Can throw
+        // Writes a segment file; every cell must fit in 64 bits
+        void save(std::string_view path) const; // Can throw
+
+        ~Segment();
+
+        [[nodiscard]] bool contains(const value_t& index) const {
+            return first_ <= index && index <= last_;
+        }
+        // The cell at index, which must be contained
+        [[nodiscard]] value_t get(const value_t& index) const;
+        [[nodiscard]] const value_t& first() const noexcept { return first_; }
+        [[nodiscard]] const value_t& last() const noexcept { return last_; }
+
+    private:
+        Segment(value_t first, value_t last);
+
+        value_t first_;
+        value_t last_;
+        RadixTrie<value_t> cells_; // captured segments
+        const unsigned char* mapped_ = nullptr; // mapped segments' cells
+        void* mapping_ = nullptr;
+        std::size_t mapping_size_ = 0;
+
+        Segment(const Segment&) = delete;
+        Segment& operator=(const Segment&) = delete;
+};
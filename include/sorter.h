@@ -0,0 +1,28 @@
+// sorter.h
+
+#pragma once
+
+#include <boost/multiprecision/cpp_int.hpp>
+#include <cstdint>
+#include <vector>
+
+// Sorting behind SORT. Ranges whose values all fit in 64 bits take a
+// stable LSD radix sort, one pass per byte (passes where every key shares
+// the byte are skipped); ranges of at least SUBARUU_SORT_PARALLEL keys per
+// thread count and scatter their passes on several threads. Anything
+// larger falls back to a stable comparison sort.
+class Sorter {
+    public:
+        using value_t = boost::multiprecision::cpp_int;
+        using Order = std::vector<std::uint32_t>;
+
+        // Sorts keys; order, when given, is permuted alongside them.
+        // threads = 0 uses the hardware concurrency.
+        static void radix(std::vector<std::int64_t>& keys,
+                          Order* order,
+                          bool descending,
+                          unsigned threads = 0);
+        // Positions of values in sorted order
+        static Order compare(const std::vector<value_t>& values,
+                             bool descending);
+};
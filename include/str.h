@@ -0,0 +1,62 @@
+// str.h
+
+#pragma once
+
+#include "config.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+// Immutable string value behind string variables. Strings of up to
+// SUBARUU_STRING_INLINE bytes are stored inside the object; longer ones are
+// ropes of shared leaves under AVL-balanced concatenation nodes, so copying
+// is O(1) and appending to a large string costs O(log n) rather than a copy.
+class Str {
+    public:
+        Str() noexcept = default;
+        Str(std::string_view text); // Implicit, e.g. from literals
+
+        static Str concat(const Str& left, const Str& right);
+
+        [[nodiscard]] std::size_t size() const noexcept;
+        [[nodiscard]] bool empty() const noexcept { return size() == 0; }
+        [[nodiscard]] bool is_inline() const noexcept { return !node_; }
+        // Height of the rope (0 for inline strings and single leaves)
+        [[nodiscard]] int depth() const noexcept;
+
+        // Byte at position i; i must be less than size()
+        [[nodiscard]] char at(std::size_t i) const noexcept;
+        // Up to count bytes starting at pos (clamped to the string)
+        [[nodiscard]] Str substr(std::size_t pos, std::size_t count) const;
+        [[nodiscard]] int compare(const Str& other) const;
+
+        [[nodiscard]] std::string str() const;
+        void append_to(std::string& out) const;
+        friend std::ostream& operator<<(std::ostream& out, const Str& s);
+
+    private:
+        struct Node;
+        using NodePtr = std::shared_ptr<const Node>;
+
+        explicit Str(NodePtr node) noexcept;
+        bool flat(std::string_view& view) const noexcept;
+        NodePtr to_node() const;
+
+        static NodePtr make_leaf(std::string text);
+        static NodePtr make_node(NodePtr left, NodePtr right);
+        static NodePtr balance(NodePtr left, NodePtr right);
+        static NodePtr join(NodePtr left, NodePtr right);
+        static NodePtr slice(const NodePtr& node,
+                             std::size_t pos,
+                             std::size_t count);
+        template <typename Visit>
+        static void for_each_leaf(const Node& node, Visit&& visit);
+
+        NodePtr node_;
+        std::uint8_t size_ = 0;
+        char inline_[SUBARUU_STRING_INLINE] = {};
+};
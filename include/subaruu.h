@@ -5,38 +5,206 @@
 #pragma once
 
 #include "config.h"
+#include "format.h"
+#include "hash_table.h"
+#include "history.h"
+#include "input.h"
+#include "metrics.h"
+#include "radix_trie.h"
+#include "random.h"
+#include "segment.h"
+#include "str.h"
 #include "tokenizer.h"
+#include "writer.h"
 
 #include <array>
 #include <boost/multiprecision/cpp_int.hpp>
 #include <cstdint>
-#include <map>
+#include <istream>
 #include <memory>
+#include <ostream>
 #include <string>
 #include <string_view>
 #include <unordered_map>
+#include <vector>
 
 class SUBARUU {
     public:
         using value_t = boost::multiprecision::cpp_int;
+        struct Options {
+            // Check the whole program at load (see Verifier); verified
+            // programs branch through pre-resolved jump sites unchecked
+            bool verify = true;
+            // Execute from the compact encoding (see Bytecode) rather than
+            // re-lexing the source text
+            bool compact = true;
+            // Past runs; when set, they choose `compact` (see History)
+            std::shared_ptr<const History> history = nullptr;
+            // Destination of PRINT without a channel; stdout when null
+            std::ostream* output = nullptr;
+            // Source of INPUT; stdin when null
+            std::istream* input = nullptr;
+            // Count executions per line (see line_hits())
+            bool profile = false;
+            // Live counters to publish to; none are kept when null
+            Metrics* metrics = nullptr;
+        };
+        struct Stats {
+            std::uint64_t source_hash = 0; // Bytecode::fingerprint of it
+            bool compact = false;          // engine used
+            bool verified = false;         // verified at load
+            std::string engine_reason;     // why this engine
+            double load_ms = 0;            // link, verify, compile, line map
+            double run_ms = 0;
+            std::uint64_t statements = 0;  // statements executed
+            std::size_t memory_cells = 0;  // indexed cells written
+            HashTable::Stats tables;       // all SET/GET tables together
+            std::uint64_t memo_lookups = 0; // LETs with a value to reuse
+            std::uint64_t memo_hits = 0;    // and that reused it
+        };
+        // Why run_for() returned
+        enum class Pause { FINISHED, BUDGET, INPUT, OUTPUT };
+        // Flow control for run_for(), owned by the caller
+        struct Gate {
+            // Numbers INPUT may read without waiting, decremented as they
+            // are read; null (or SIZE_MAX) reads without limit
+            std::size_t* input_ready = nullptr;
+            // Output written and not yet drained, and the most allowed
+            const std::size_t* output_pending = nullptr;
+            std::size_t output_limit = 0;
+        };
         explicit SUBARUU(std::string_view source);
+        SUBARUU(std::string_view source, const Options& options);
         ~SUBARUU() = default;
         void run();
+        // Runs until execution reaches the start of `line`; false if the
+        // program finished first. run() resumes from there.
+        bool run_until(int line);
+        // Runs at most `budget` statements, stopping early at a statement
+        // boundary before an INPUT that needs numbers the gate does not
+        // have yet (all of them for a range) or while output is over the
+        // gate's limit. Call again to continue (see Execution).
+        Pause run_for(std::uint64_t budget, const Gate& gate);
+        // Copy of the current execution state. Program text and load-time
+        // tables are shared and memory and SET tables are copied on write,
+        // so a clone is O(1) in program, memory and table size. The
+        // clone's RND continues on substream `stream` of this one's
+        // generator; it has no open channels and reads further INPUT from
+        // stdin.
+        std::unique_ptr<SUBARUU> clone(std::uint64_t stream = 0) const;
+        // Metrics of the program given to the constructor
+        Stats stats() const;
+        // Executions per line number, when Options::profile is set
+        const std::unordered_map<int, std::uint64_t>& line_hits() const {
+            return line_hits_;
+        }
         std::string get_token_string(Tokenizer::TokenType token) const;
         bool finished() const;
+        // Indexed memory access for embedders
+        value_t peek(const value_t& index) const;
+        void poke(const value_t& index, value_t value);
+        // Copies the cells of from's m[first..last] that read as anything
+        // but unset to m[at..]; costs one step per such cell
+        void copy_memory(const SUBARUU& from,
+                         const value_t& first,
+                         const value_t& last,
+                         const value_t& at);
+        // Numeric variables 'a' to 'z', for embedders
+        value_t variable(char name) const;
+        void set_variable(char name, value_t value);
+        // Makes the segment's cells readable through m[]; cells this
+        // interpreter wrote itself take precedence. Shared, never copied.
+        void attach(std::shared_ptr<const Segment> segment,
+                    Segment::Access access);
 #ifdef DEBUG_MODE
         void log_found_line_numbers(
           const std::unordered_map<int, bool>& found_lines);
         void log_available_lines(int target_line);
 #endif
     private:
+        SUBARUU(const SUBARUU& other, std::uint64_t stream);
         // Token processing
         void accept(Tokenizer::TokenType expectedToken);
-        // Expression parsing
+        // Expressions: each site is compiled once to postfix code, which is
+        // evaluated on an explicit operand stack
+        struct Postfix {
+            enum Code : std::uint8_t {
+                PUSH_INT,   // arg itself
+                PUSH_CONST, // constants[arg], for literals beyond size_t
+                PUSH_VAR,   // variables_[arg]
+                LOAD_MEM,   // top = m[top]
+                LOAD_SITE,  // m[] at sites_[arg]
+                NEG,
+                ADD,
+                SUB,
+                MUL,
+                DIV,
+                RND, // top = RND(top)
+                LEN, // LEN/ASC of the string expression at offset arg
+                ASC,
+                GET, // GET/HAS of the table and key at offset arg
+                HAS
+            };
+            struct Op {
+                Code code;
+                std::size_t arg;
+            };
+            std::vector<Op> ops;
+            std::vector<value_t> constants;
+            std::size_t end = 0; // offset of the token after the expression
+            bool seeks = false;  // evaluation moves the tokenizer (LEN...)
+            // LET memo: set for products of variables and constants, which
+            // read nothing else; their variables, and the last value with
+            // the clock_ tick it was computed at (see let_value)
+            bool pure = false;
+            std::vector<std::size_t> inputs;
+            bool memoized = false;
+            std::uint64_t stamp = 0;
+            value_t memo;
+        };
+        struct PendingOp {
+            Postfix::Code code;
+            int precedence;              // 0 for an open bracket
+            Tokenizer::TokenType closer; // the bracket's closing token
+            bool emits;                  // false for a plain '('
+        };
         value_t expression();
-        value_t term();
-        value_t factor();
+        void compile_expression(Postfix& code);
+        // Memory access sites whose index is a variable plus a constant
+        // (m[i], m[i + 1], m[100 + i], m[i - 1]) skip the generic
+        // expression and keep a cursor into memory, so a loop walking
+        // memory avoids most trie descents
+        struct IndexSite {
+            std::int64_t base; // the constant
+            std::size_t var;   // variables_ index
+            std::size_t end;   // offset of the closing ']'
+            RadixTrie<value_t>::Cursor cursor;
+        };
+        static constexpr std::size_t NO_SITE = static_cast<std::size_t>(-1);
+        std::size_t index_site(bool run_once);
+        bool match_index_site(IndexSite& site);
+        bool site_index(const IndexSite& site, std::int64_t& index) const;
+        value_t load_site(IndexSite& site);
+        void store_site(IndexSite& site, value_t value);
+        void skip_string_argument();
+        value_t evaluate(const Postfix& code);
+        value_t let_value();
+        // Every write to a variable stamps it with the next clock_ tick
+        void wrote(std::size_t var) { versions_[var] = ++clock_; }
         int relation();
+        // Conditions (IF, WHILE, LOOP): NOT > AND > OR, short-circuit
+        int condition();
+        int and_condition();
+        int not_condition();
+        void skip_operand(bool stop_at_and);
+        bool is_condition_group();
+        // String expressions
+        Str string_expression();
+        Str string_factor();
+        Str string_literal();
+        std::size_t string_count(const value_t& n, std::string_view fn);
+        bool is_string_start(Tokenizer::TokenType token) const;
+        void let_string_statement();
         // Statements
         void statement();
         void line_statement();
@@ -44,9 +212,49 @@ class SUBARUU {
         void if_statement();
         void goto_statement();
         void print_statement(bool newline = true);
+        void print_using(std::ostream& out);
+        void chain_statement();
+        void open_statement();
+        void close_statement();
+        void input_statement();
+        void randomize_statement();
+        void rnd_statement();
+        void sort_statement();
+        void set_statement();
+        void del_statement();
+        void while_statement();
+        void wend_statement();
+        void do_statement();
+        void loop_statement();
+        // Output channels
+        int channel_number();
+        void close_channels();
+        // Input
+        value_t input_value();
+        bool reserve_input();
+        void input_range(const value_t& lo, const value_t& hi);
+        // Indexed memory
+        value_t read_memory(const value_t& index) const;
+        void write_memory(const value_t& index, value_t value);
+        template <typename Source>
+        void fill_range(const value_t& lo, const value_t& hi, Source&& next);
+        void sort_range(const value_t& lo,
+                        const value_t& hi,
+                        bool descending,
+                        const value_t* values);
+        // Tables: parses "t, key" and calls visit(table, key), the table
+        // being the letter's slot in tables_ and the key a value_t or a
+        // std::string_view; writable() unshares a slot before SET/DEL
+        template <typename Visit>
+        decltype(auto) table_access(Visit&& visit);
+        static HashTable& writable(std::shared_ptr<HashTable>& table);
+        // Random numbers
+        value_t random_below(const value_t& bound);
         // Line helpers
+        std::unique_ptr<Tokenizer> load(const std::string& path);
         void build_line_map();
-        bool find_target_line(int line_number);
+        void jump_to_line(int line_number);
+        void jump_to_loop(std::size_t offset);
         // Aids
         bool is_valid_line_number(const value_t& num) const;
         bool is_line_number() const;
@@ -55,11 +263,92 @@ class SUBARUU {
         enum ErrorCode { E_ERROR = 1, E_WARNING };
         void dprintf(const std::string& message, int errorCode);
         value_t safe_divide(value_t numerator, value_t denominator);
+        // Live metrics
+        void attach_metrics();
+        void publish_metrics();
+        void count_jump() {
+            if (counters_)
+                ++metered_.jumps;
+        }
+        void count_bignum(const value_t& value) {
+            if (counters_ && value.backend().size() > 1)
+                ++metered_.bignums;
+        }
+        // Load-time tables, shared by clones
+        struct Program {
+            // literals interned at load, keyed by source offset
+            std::unordered_map<std::size_t, Str> literals;
+            // line number -> offset of its line-number token
+            std::unordered_map<int, std::size_t> line_offsets;
+            // GOTO/THEN token offset -> offset of the target line
+            std::unordered_map<std::size_t, std::size_t> jump_sites;
+            // WHILE <-> WEND and LOOP -> DO token offsets
+            std::unordered_map<std::size_t, std::size_t> loop_targets;
+        };
         // State
+        Options options_;
+        bool verified_;
+        Stats stats_;
+        std::unordered_map<int, std::uint64_t> line_hits_;
+        std::string source_;
         std::unique_ptr<Tokenizer> tokenizer_;
         std::array<value_t, SUBARUU_MAX_VARIABLES> variables_;
-        // indexed memory
-        std::map<value_t, value_t> memory_;
-        std::unordered_map<int, bool> line_positions_;
+        std::array<std::uint64_t, SUBARUU_MAX_VARIABLES> versions_{};
+        std::uint64_t clock_ = 0;
+        // indexed memory, over the attached segments
+        RadixTrie<value_t> memory_;
+        struct Attached {
+            std::shared_ptr<const Segment> segment;
+            Segment::Access access;
+        };
+        std::vector<Attached> segments_;
+        // string variables (a$) and indexed strings (a$[i])
+        std::array<Str, SUBARUU_MAX_VARIABLES> string_variables_;
+        RadixTrie<Str> string_memory_;
+        // tables of SET/GET/HAS/DEL, one per letter: null until first
+        // written, shared with clones and copied on their next write
+        std::array<std::shared_ptr<HashTable>, SUBARUU_MAX_VARIABLES> tables_;
+        std::shared_ptr<const Program> program_;
+        // Condition caches keyed by token offset: where a skipped operand
+        // ends, and whether a '(' opens a parenthesized condition
+        std::unordered_map<std::size_t, std::size_t> skip_targets_;
+        std::unordered_map<std::size_t, bool> condition_groups_;
+        // Compiled expressions by start offset, and their operand stack
+        std::unordered_map<std::size_t, Postfix> expressions_;
+        std::vector<value_t> operands_;
+        // Index sites by the offset of the token after their '[', or
+        // NO_SITE where the index is not of a site's form
+        std::vector<IndexSite> sites_;
+        std::unordered_map<std::size_t, std::size_t> site_ids_;
+        // Furthest expression start run so far; earlier ones are cached
+        std::size_t high_water_ = 0;
+        // compile_expression() scratch, and code for run-once expressions
+        std::vector<PendingOp> pending_;
+        Postfix scratch_;
+        std::unordered_map<int, std::unique_ptr<OutputFile>> channels_;
+        std::unique_ptr<InputReader> input_;
+        // run_for()'s gate while it runs, and whether INPUT stopped it
+        const Gate* gate_ = nullptr;
+        bool input_paused_ = false;
+        Random rng_;
         bool execution_finished_;
+        // Live metrics (Options::metrics): counts kept here, and the counts
+        // already added to the shared counters
+        struct Metered {
+            std::uint64_t statements = 0;
+            std::uint64_t jumps = 0;
+            std::uint64_t bignums = 0;
+            std::uint64_t output_bytes = 0;
+            std::uint64_t memory_cells = 0;
+        };
+        Metrics::Counters* counters_ = nullptr;
+        Metered metered_;
+        Metered published_;
+        // PRINT USING formats by text, and the line being formatted
+        std::unordered_map<std::string, Format> formats_;
+        std::string format_key_;
+        std::string format_line_;
+        // PRINT's destination without a channel
+        std::ostream* console_ = nullptr;
+        std::unique_ptr<CountingStream> console_counter_;
 };
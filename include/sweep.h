@@ -0,0 +1,148 @@
+// sweep.h
+
+#pragma once
+
+#include "subaruu.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// A parameter sweep: one program run once per point of a grid of variable
+// values, read from a manifest:
+//
+//   # comment
+//   program PROGRAM                  the program every run executes
+//   vary VAR V1 V2 ...               values seeded into variable VAR
+//   vary VAR FIRST TO LAST [STEP S]  or a range of them
+//   report ITEM ...                  per-run results: variables (`x`) or
+//                                    memory cells (`m[100]`)
+//   shard RUNS                       runs per shard (see Coordinator)
+//
+// The grid is the product of the vary lines, the last varying fastest;
+// run k is its k-th point. Variables are seeded before the program starts
+// and PRINT output of the runs is dropped: what a run found must be
+// reported. A run that fails is recorded with its error. The program is
+// loaded once per shard and each run is a clone() of it, so every run
+// starts with the same RND state; vary a seed and RANDOMIZE with it for
+// independent draws.
+class Sweep {
+    public:
+        using value_t = SUBARUU::value_t;
+        struct Axis {
+            char variable;
+            std::vector<value_t> values;
+        };
+        // A report item: a variable, or a memory cell when variable is 0
+        struct Item {
+            char variable;
+            value_t index;
+        };
+        struct Result {
+            std::size_t run = 0;
+            bool ok = false;
+            std::vector<value_t> values; // one per report item
+            std::string error;           // when not ok
+        };
+
+        explicit Sweep(std::string_view path); // Can throw
+        Sweep(std::string_view path, std::string_view text); // Can throw
+
+        // Number of runs
+        [[nodiscard]] std::size_t size() const noexcept { return size_; }
+        // Variable values of run `run`, one per axis
+        [[nodiscard]] std::vector<value_t> point(std::size_t run) const;
+        // Runs first .. first + count - 1 in this process, in order;
+        // throws if the program cannot be loaded
+        [[nodiscard]] std::vector<Result> run(
+          std::size_t first,
+          std::size_t count,
+          const SUBARUU::Options& options) const;
+        // Results in run order as a tab-separated table with a header
+        void table(std::ostream& out, const std::vector<Result>& results) const;
+
+        // Identifies the manifest and program, so a coordinator only
+        // accepts workers sweeping the same grid
+        [[nodiscard]] std::uint64_t fingerprint() const noexcept {
+            return fingerprint_;
+        }
+        [[nodiscard]] std::size_t shard_size() const noexcept {
+            return shard_size_;
+        }
+        [[nodiscard]] const std::vector<Axis>& axes() const noexcept {
+            return axes_;
+        }
+        [[nodiscard]] const std::vector<Item>& report() const noexcept {
+            return report_;
+        }
+
+        // One line of the worker protocol, and back
+        static std::string encode(const Result& result);
+        static Result decode(std::string_view line); // Can throw
+
+        // Worker: connects to a Coordinator at `endpoint` ("unix:PATH" or
+        // "HOST:PORT") and runs the shards it is given until it is told
+        // to finish. A program that cannot be loaded fails every run of
+        // the shard. Returns the number of runs done; those that failed
+        // are added to *failed when given.
+        std::size_t work(const std::string& endpoint,
+                         const SUBARUU::Options& options,
+                         std::size_t* failed = nullptr) const; // Can throw
+
+    private:
+        void parse(std::string_view text);
+        Result run_one(const SUBARUU& loaded, std::size_t run) const;
+
+        std::string path_;
+        std::string program_;
+        std::vector<Axis> axes_;
+        std::vector<Item> report_;
+        std::size_t size_ = 1;
+        std::size_t shard_size_;
+        std::uint64_t fingerprint_ = 0;
+};
+
+// Hands the runs of a sweep out in shards to worker processes (see
+// Sweep::work) connecting over TCP or a Unix socket, and merges their
+// results. Shards of a worker that disconnects before finishing them go
+// back to the queue, up to SUBARUU_SWEEP_ATTEMPTS times each. The
+// protocol is one text line per message:
+//   worker: HELLO FINGERPRINT
+//   coordinator: SHARD ID FIRST COUNT | FINISH | BYE REASON
+//   worker: RESULT ... (one per run, see Sweep::encode), then DONE ID
+class Coordinator {
+    public:
+        // Listens on "unix:PATH" or "HOST:PORT" (port 0 picks a free one)
+        Coordinator(const Sweep& sweep, const std::string& endpoint); // Can throw
+        ~Coordinator();
+
+        // Where workers connect, with the port actually bound
+        [[nodiscard]] const std::string& endpoint() const noexcept {
+            return endpoint_;
+        }
+        // Serves workers until every run has a result; results in run
+        // order. `supervise`, when given, is called every poll and returns
+        // how many workers may still connect; none, with none connected,
+        // fails the sweep. Throws if a shard failed SUBARUU_SWEEP_ATTEMPTS
+        // times or no worker is left.
+        std::vector<Sweep::Result> run(
+          const std::function<std::size_t()>& supervise = nullptr);
+        // Shards handed out again after a worker failed
+        [[nodiscard]] std::size_t retries() const noexcept {
+            return retries_;
+        }
+
+    private:
+        const Sweep& sweep_;
+        std::string endpoint_;
+        std::string socket_path_; // unlinked on destruction
+        int listen_fd_ = -1;
+        std::size_t retries_ = 0;
+
+        Coordinator(const Coordinator&) = delete;
+        Coordinator& operator=(const Coordinator&) = delete;
+};
@@ -12,16 +12,22 @@
 #include <variant>
 #include <vector>
 
+class Bytecode;
+
 class Tokenizer {
     public:
         // Constructor/Destructor
         explicit Tokenizer(std::string_view source);
+        explicit Tokenizer(std::unique_ptr<IO> io);
+        // Decodes a compiled program instead of lexing text
+        explicit Tokenizer(std::shared_ptr<const Bytecode> code);
         ~Tokenizer();
         enum class TokenType {
             ERROR = 1,
             EOF_TOKEN,
             NUMBER,
             LETTER,
+            STRING_VAR,
             STRING,
             EQUAL,
             LT,
@@ -40,24 +46,65 @@ class Tokenizer {
             PRINT,
             PRINT_DOLLAR,
             TAB,
+            USING,
             REM,
             GOTO,
+            MERGE,
+            CHAIN,
+            OPEN,
+            FOR,
+            OUTPUT,
+            AS,
+            CLOSE,
+            HASH,
+            INPUT,
+            TO,
+            RND,
+            RANDOMIZE,
+            LEN,
+            ASC,
+            MID_DOLLAR,
+            LEFT_DOLLAR,
+            RIGHT_DOLLAR,
+            CHR_DOLLAR,
+            STR_DOLLAR,
+            WHILE,
+            WEND,
+            DO,
+            LOOP,
+            UNTIL,
+            SORT,
+            DESC,
+            SET,
+            GET,
+            HAS,
+            DEL,
+            AND,
+            OR,
+            NOT,
             LEFT_PAREN,
             RIGHT_PAREN,
             LEFT_BRACKET,
             RIGHT_BRACKET,
             EOL
         };
+        // A string literal is a std::string when lexed from text and a view
+        // into the literal pool when decoded from Bytecode
         using TokenData = std::variant<std::monostate,
                                        std::string,
                                        boost::multiprecision::cpp_int,
-                                       char>;
+                                       char,
+                                       std::string_view>;
         // Token operations
         TokenType current_token() const { return current_token_; }
         void reset();
         void reset(TokenType to);
+        void seek(std::size_t offset);
+        // A tokenizer at the same token, sharing the source text
+        std::unique_ptr<Tokenizer> clone() const;
         bool finished() const;
         void next_token();
+        std::size_t offset() const { return token_offset_; }
         // Line detection
         bool is_line_number();
         char peek_char();
@@ -81,6 +128,9 @@ class Tokenizer {
         TokenType token_eol(int c);
         // Member variables
         std::unique_ptr<IO> io_;
+        std::shared_ptr<const Bytecode> code_; // set when decoding
+        std::size_t code_pos_ = 0;
         TokenType current_token_;
         TokenData token_data_;
+        std::size_t token_offset_ = 0;
 };
@@ -0,0 +1,108 @@
+// verifier.h
+
+#pragma once
+
+#include "tokenizer.h"
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+// Load-time checker for a linked program. Parses every statement, checks
+// bracket balance, loop pairing and that every GOTO/THEN target exists, and
+// collects all problems instead of stopping at the first one. The program
+// is read in one pass, a line at a time; only its line numbers and jump
+// targets are kept.
+class Verifier {
+    public:
+        struct Diagnostic {
+            int line; // BASIC line number, 0 before the first one
+            std::string message;
+        };
+
+        Verifier(std::string_view name, std::string text);
+        // Verifies the program from the tokenizer's position on, e.g. a
+        // compiled one (see Bytecode)
+        explicit Verifier(std::unique_ptr<Tokenizer> tokenizer);
+
+        [[nodiscard]] bool ok() const noexcept { return diagnostics_.empty(); }
+        [[nodiscard]] const std::vector<Diagnostic>& diagnostics()
+          const noexcept {
+            return diagnostics_;
+        }
+        // One problem per line, e.g. "  line 90: THEN target 95 not found"
+        [[nodiscard]] std::string report() const;
+
+    private:
+        using TokenType = Tokenizer::TokenType;
+        struct Token {
+            TokenType type;
+            int line;
+            long long number; // NUMBER tokens that fit, else -1
+        };
+        struct OpenLoop {
+            TokenType kind;
+            int line;
+        };
+        // A GOTO/THEN target, checked once every line number is known
+        struct Jump {
+            int line;
+            long long number;
+            const char* keyword;
+            std::size_t diagnostic; // where its diagnostic goes, if any
+        };
+
+        void next_line();
+        void check_jumps();
+        void verify();
+        bool balanced(std::size_t from) const;
+        void skip_to_eol();
+        void diagnose(int line, std::string message);
+
+        // Statements
+        void statement();
+        void end_of_statement();
+        void print_statement();
+        void input_statement();
+        void assignment();
+        void jump_target(const char* keyword);
+        void open_loop(TokenType kind);
+        void close_loop(TokenType opener);
+        // Expressions
+        void condition();
+        void and_condition();
+        void not_condition();
+        bool is_condition_group() const;
+        void relation();
+        void expression();
+        void term();
+        void factor();
+        void string_expression();
+        void string_factor();
+        void index();
+        void table_key(const char* keyword);
+
+        // Token access
+        [[nodiscard]] const Token& peek() const { return tokens_[pos_]; }
+        [[nodiscard]] bool at(TokenType type) const {
+            return peek().type == type;
+        }
+        void advance();
+        void expect(TokenType type, const char* what);
+        [[noreturn]] void fail(const std::string& message) const;
+        [[nodiscard]] std::string name(TokenType type) const;
+
+        std::unique_ptr<Tokenizer> tokenizer_;
+        // Tokens of the current line, ending in EOL or EOF
+        std::vector<Token> tokens_;
+        std::size_t pos_ = 0;
+        int line_ = 0;
+        bool at_line_start_ = true;
+        std::unordered_set<long long> lines_;
+        std::vector<Jump> jumps_;
+        std::vector<OpenLoop> loops_;
+        std::vector<Diagnostic> diagnostics_;
+};
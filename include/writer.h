@@ -0,0 +1,88 @@
+// writer.h
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// Stream buffer writing to a file through one large buffer. In async mode
+// full buffers are handed to a flusher thread (double buffering), so the
+// interpreter keeps running while the previous block is written. With
+// GZIP each block is deflated on its way to the file (on the flusher
+// thread in async mode) into a single gzip member; a sync() emits a
+// deflate sync point so everything written so far can be decompressed.
+// GZIP needs a build with zlib (SUBARUU_WITH_ZLIB).
+class BufferedWriter : public std::streambuf {
+    public:
+        enum class Compression { NONE, GZIP };
+
+        // GZIP for a path ending in ".gz", otherwise NONE
+        static Compression compression_for(std::string_view path) noexcept;
+        // The path "-" writes to stdout
+        BufferedWriter(std::string_view path,
+                       std::size_t capacity,
+                       bool async,
+                       Compression compression = Compression::NONE); // Can throw
+        ~BufferedWriter() override;
+
+        void close(); // Can throw
+        [[nodiscard]] std::string_view path() const noexcept {
+            return path_;
+        }
+        [[nodiscard]] bool is_open() const noexcept { return fd_ >= 0; }
+
+    protected:
+        int_type overflow(int_type ch) override;
+        int sync() override;
+
+    private:
+        struct Deflater;
+        // How emit() ends a block: not at all, at a sync point, or with
+        // the gzip trailer
+        enum class Flush { NONE, SYNC, FINISH };
+
+        void hand_off(bool wait);
+        int emit(const char* data, std::size_t size, Flush flush);
+        int write_all(const char* data, std::size_t size);
+        void flusher();
+
+        std::string path_;
+        int fd_;
+        bool async_;
+        std::unique_ptr<Deflater> deflater_; // null without compression
+        std::vector<char> active_;
+        std::vector<char> pending_;
+        std::size_t pending_size_;
+        bool stop_;
+        std::atomic<int> error_;
+        std::mutex mutex_;
+        std::condition_variable cv_;
+        std::thread thread_;
+
+        BufferedWriter(const BufferedWriter&) = delete;
+        BufferedWriter& operator=(const BufferedWriter&) = delete;
+};
+
+// Output stream over a BufferedWriter, used for OPEN ... AS #n channels
+// and for -output.
+class OutputFile : public std::ostream {
+    public:
+        OutputFile(std::string_view path,
+                   std::size_t capacity,
+                   bool async,
+                   BufferedWriter::Compression compression =
+                     BufferedWriter::Compression::NONE); // Can throw
+        void close() { buffer_.close(); }
+
+    private:
+        BufferedWriter buffer_;
+};
@@ -0,0 +1,446 @@
+// advisor.cc
+
+#include "../include/advisor.h"
+#include "../include/config.h"
+#include "../include/io.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+
+/******************************************************************************/
+
+namespace {
+
+using TokenType = Tokenizer::TokenType;
+
+bool is_line_label(long long number) {
+    return number >= 10 && number % 10 == 0;
+}
+
+bool is_additive(TokenType type) {
+    return type == TokenType::PLUS || type == TokenType::MINUS;
+}
+
+bool is_multiplicative(TokenType type) {
+    return type == TokenType::ASTERISK || type == TokenType::SLASH;
+}
+
+const char* operator_text(TokenType type) {
+    switch (type) {
+        case TokenType::PLUS:
+            return " + ";
+        case TokenType::MINUS:
+            return " - ";
+        case TokenType::ASTERISK:
+            return " * ";
+        default:
+            return " / ";
+    }
+}
+
+} // namespace
+
+/**
+ * Advisor Constructor
+ *
+ * Reviews a whole program; the result is available through findings() and
+ * report().
+ *
+ * @param name Name used for the program's IO
+ * @param text The linked program text
+ * @param profile Executions per line from a recorded run, or nullptr
+ */
+Advisor::Advisor(std::string_view name,
+                 std::string text,
+                 const Profile* profile)
+  : profile_(profile) {
+    lex(name, std::move(text));
+    find_loops();
+    for (std::size_t i = 0; i < statements_.size(); ++i)
+        check_statement(i);
+    check_if_chains();
+    std::stable_sort(findings_.begin(), findings_.end(),
+                     [](const Finding& a, const Finding& b) {
+                         return a.cost * a.weight > b.cost * b.weight;
+                     });
+}
+
+/**
+ * report
+ *
+ * @param void
+ * @return Every finding, one per line, highest impact first
+ */
+std::string Advisor::report() const {
+    std::ostringstream out;
+    for (const auto& f : findings_) {
+        out << "  line " << f.line << ": " << f.message << " [" << f.kind
+            << ", " << std::llround(f.cost) << " x "
+            << (f.measured ? "" : "~") << std::llround(f.weight) << "]\n";
+    }
+    return out.str();
+}
+
+/**
+ * load_profile
+ *
+ * @param path A file written by save_profile()
+ * @return Profile Executions per line
+ * @throws std::runtime_error if the file cannot be read
+ */
+Advisor::Profile Advisor::load_profile(std::string_view path) {
+    std::ifstream in{ std::string(path) };
+    if (!in)
+        throw std::runtime_error("Failed to read profile: " + std::string(path));
+    Profile profile;
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.empty() || line[0] == '#')
+            continue;
+        std::istringstream fields(line);
+        int number;
+        std::uint64_t hits;
+        if (fields >> number >> hits)
+            profile[number] += hits;
+    }
+    return profile;
+}
+
+/**
+ * save_profile
+ *
+ * @param path The file to write
+ * @param profile Executions per line
+ * @throws std::runtime_error if the file cannot be written
+ */
+void Advisor::save_profile(std::string_view path, const Profile& profile) {
+    std::ofstream out{ std::string(path) };
+    out << "# line executions\n";
+    for (const auto& [line, hits] :
+         std::map<int, std::uint64_t>(profile.begin(), profile.end()))
+        out << line << ' ' << hits << '\n';
+    if (!out)
+        throw std::runtime_error("Failed to write profile: " +
+                                 std::string(path));
+}
+
+/******************************************************************************/
+
+/**
+ * lex
+ *
+ * Tokenizes the program into statements, tagging each with its BASIC line
+ * number. Line numbers themselves and REM text are not part of a statement.
+ *
+ * @param name Name used for the program's IO
+ * @param text The linked program text
+ * @return void
+ */
+void Advisor::lex(std::string_view name, std::string text) {
+    Tokenizer tokenizer(std::make_unique<IO>(name, std::move(text)));
+    bool at_line_start = true;
+    int line = 0;
+    std::size_t begin = 0;
+    const auto end_statement = [&] {
+        if (tokens_.size() > begin)
+            statements_.push_back(Statement{ line, begin, tokens_.size() });
+        tokens_.push_back(Token{ TokenType::EOL, -1, 0 });
+        begin = tokens_.size();
+    };
+    while (!tokenizer.finished()) {
+        const auto type = tokenizer.current_token();
+        long long number = -1;
+        char letter = 0;
+        if (type == TokenType::NUMBER) {
+            const auto value = tokenizer.get_num();
+            if (value <= std::numeric_limits<long long>::max())
+                number = static_cast<long long>(value);
+        } else if (type == TokenType::LETTER) {
+            letter = static_cast<char>(std::tolower(static_cast<unsigned char>(
+              std::get<char>(tokenizer.get_token_data()))));
+        }
+        if (type == TokenType::EOL) {
+            end_statement();
+        } else if (at_line_start && is_line_label(number) &&
+                   number <= std::numeric_limits<int>::max()) {
+            line = static_cast<int>(number);
+            line_starts_.try_emplace(number, statements_.size());
+        } else {
+            tokens_.push_back(Token{ type, number, letter });
+        }
+        if (type == TokenType::REM) {
+            tokenizer.skip_to_eol();
+            end_statement();
+            at_line_start = true;
+            continue;
+        }
+        at_line_start = type == TokenType::EOL;
+        tokenizer.next_token();
+    }
+    end_statement();
+}
+
+/**
+ * find_loops
+ *
+ * Pairs WHILE/WEND and DO/LOOP, and treats every GOTO/THEN to the same or
+ * an earlier line as a loop back to that line. Unpaired keywords are left
+ * to the Verifier.
+ *
+ * @param void
+ * @return void
+ */
+void Advisor::find_loops() {
+    const auto add_loop = [this](std::size_t first, std::size_t last) {
+        for (const auto& loop : loops_)
+            if (loop.first == first && loop.last == last)
+                return;
+        loops_.push_back(Loop{ first, last });
+    };
+    std::vector<std::pair<TokenType, std::size_t>> open;
+    for (std::size_t i = 0; i < statements_.size(); ++i) {
+        const auto& statement = statements_[i];
+        const auto first = tokens_[statement.begin].type;
+        if (first == TokenType::WHILE || first == TokenType::DO) {
+            open.emplace_back(first, i);
+        } else if (first == TokenType::WEND || first == TokenType::LOOP) {
+            const auto opener =
+              first == TokenType::WEND ? TokenType::WHILE : TokenType::DO;
+            if (!open.empty() && open.back().first == opener) {
+                add_loop(open.back().second, i);
+                open.pop_back();
+            }
+        }
+        for (auto k = statement.begin; k + 1 < statement.end; ++k) {
+            const auto type = tokens_[k].type;
+            if (type != TokenType::GOTO && type != TokenType::THEN)
+                continue;
+            auto target = line_starts_.find(tokens_[k + 1].number);
+            if (target != line_starts_.end() && target->second <= i)
+                add_loop(target->second, i);
+        }
+    }
+}
+
+/**
+ * check_statement
+ *
+ * Looks for the in-loop patterns in one statement.
+ *
+ * @param index The statement
+ * @return void
+ */
+void Advisor::check_statement(std::size_t index) {
+    const Loop* loop = innermost(index);
+    if (!loop)
+        return;
+    const auto& statement = statements_[index];
+    const auto first = tokens_[statement.begin].type;
+    if (first == TokenType::REM) {
+        add(index, "rem-in-loop",
+            "REM inside a loop is executed on every iteration; move it "
+            "before the loop",
+            1);
+    }
+    if ((first == TokenType::PRINT || first == TokenType::PRINT_DOLLAR) &&
+        tokens_[statement.begin + 1].type != TokenType::HASH) {
+        const auto size = loop->last - loop->first + 1;
+        if (size <= SUBARUU_ADVISOR_TIGHT_LOOP) {
+            add(index, "print-in-loop",
+                "PRINT in a " + std::to_string(size) +
+                  "-statement loop flushes stdout on every iteration; "
+                  "buffer it through OPEN ... FOR OUTPUT AS #n",
+                20);
+        }
+    }
+    // LETTER [ [-] NUMBER ]
+    std::map<std::pair<char, long long>, int> cells;
+    for (auto k = statement.begin; k + 3 < statement.end; ++k) {
+        if (tokens_[k].type != TokenType::LETTER ||
+            tokens_[k + 1].type != TokenType::LEFT_BRACKET)
+            continue;
+        const bool negative = tokens_[k + 2].type == TokenType::MINUS;
+        const auto& number = tokens_[k + 2 + negative];
+        if (number.type == TokenType::NUMBER && number.number >= 0 &&
+            tokens_[k + 3 + negative].type == TokenType::RIGHT_BRACKET)
+            ++cells[{ tokens_[k].letter,
+                      negative ? -number.number : number.number }];
+    }
+    for (const auto& [cell, count] : cells) {
+        add(index, "memory-scalar",
+            std::string(1, cell.first) + "[" + std::to_string(cell.second) +
+              "] holds scalar state in a loop (" + std::to_string(count) +
+              (count == 1 ? " access" : " accesses") +
+              "); a variable is an array slot, a memory cell a trie lookup",
+            3.0 * count);
+    }
+    check_invariants(index, *loop);
+}
+
+/**
+ * check_invariants
+ *
+ * Finds `a op b` subexpressions whose operands are literals or variables
+ * the loop never assigns. Operator precedence is respected: in
+ * `x - a + b` or `a + b * x`, `a + b` is not a subexpression.
+ *
+ * @param index The statement, inside loop
+ * @param loop Its innermost loop
+ * @return void
+ */
+void Advisor::check_invariants(std::size_t index, const Loop& loop) {
+    const auto& statement = statements_[index];
+    const auto first = tokens_[statement.begin].type;
+    if (first == TokenType::WHILE || first == TokenType::LOOP)
+        return; // the condition itself decides the loop
+    const auto changed = assigned(loop);
+    const auto invariant = [&](std::size_t k) {
+        const auto& token = tokens_[k];
+        if (token.type == TokenType::NUMBER)
+            return token.number >= 0;
+        return token.type == TokenType::LETTER &&
+               tokens_[k + 1].type != TokenType::LEFT_BRACKET &&
+               !changed.count(token.letter);
+    };
+    const auto text = [&](std::size_t k) {
+        const auto& token = tokens_[k];
+        return token.type == TokenType::LETTER
+                 ? std::string(1, token.letter)
+                 : std::to_string(token.number);
+    };
+    for (auto k = statement.begin; k + 2 < statement.end; ++k) {
+        const auto op = tokens_[k + 1].type;
+        if (!(is_additive(op) || is_multiplicative(op)) || !invariant(k) ||
+            !invariant(k + 2))
+            continue;
+        const auto before = k > statement.begin ? tokens_[k - 1].type
+                                                : TokenType::EOL;
+        const auto after = tokens_[k + 3].type;
+        if (is_multiplicative(before) ||
+            (is_additive(op) &&
+             (is_additive(before) || is_multiplicative(after))))
+            continue;
+        const auto from = statements_[loop.first].line;
+        const auto to = statements_[loop.last].line;
+        add(index, "loop-invariant",
+            "`" + text(k) + operator_text(op) + text(k + 2) +
+              "` does not change in the loop at lines " +
+              std::to_string(from) + "-" + std::to_string(to) +
+              "; compute it once before the loop",
+            2);
+        k += 2;
+    }
+}
+
+/**
+ * check_if_chains
+ *
+ * Finds runs of consecutive `IF x = k THEN n` statements on one variable.
+ *
+ * @param void
+ * @return void
+ */
+void Advisor::check_if_chains() {
+    const auto tested = [&](const Statement& s) -> char {
+        const auto* t = &tokens_[s.begin];
+        if (s.end - s.begin != 6 || t[0].type != TokenType::IF ||
+            t[1].type != TokenType::LETTER || t[2].type != TokenType::EQUAL ||
+            t[3].type != TokenType::NUMBER || t[4].type != TokenType::THEN ||
+            t[5].type != TokenType::NUMBER)
+            return 0;
+        return t[1].letter;
+    };
+    for (std::size_t i = 0; i < statements_.size();) {
+        const char letter = tested(statements_[i]);
+        auto j = i + 1;
+        while (letter && j < statements_.size() &&
+               tested(statements_[j]) == letter)
+            ++j;
+        const auto length = j - i;
+        if (letter && length >= SUBARUU_ADVISOR_IF_CHAIN) {
+            add(i, "if-chain",
+                std::to_string(length) + "-way IF " + letter +
+                  " = k THEN chain tests up to " + std::to_string(length) +
+                  " conditions; put the most frequent cases first or split "
+                  "it with IF " + letter + " < k",
+                static_cast<double>(length));
+        }
+        i = j;
+    }
+}
+
+/**
+ * assigned
+ *
+ * @param loop A loop
+ * @return Letters assigned by LET or INPUT in the loop
+ */
+std::unordered_set<char> Advisor::assigned(const Loop& loop) const {
+    std::unordered_set<char> letters;
+    for (auto i = loop.first; i <= loop.last; ++i) {
+        const auto& statement = statements_[i];
+        const auto first = tokens_[statement.begin].type;
+        if (first == TokenType::LET) {
+            letters.insert(tokens_[statement.begin + 1].letter);
+        } else if (first == TokenType::INPUT) {
+            for (auto k = statement.begin; k < statement.end; ++k)
+                if (tokens_[k].type == TokenType::LETTER)
+                    letters.insert(tokens_[k].letter);
+        }
+    }
+    return letters;
+}
+
+/**
+ * innermost
+ *
+ * @param index A statement
+ * @return The smallest loop containing it, or nullptr
+ */
+const Advisor::Loop* Advisor::innermost(std::size_t index) const {
+    const Loop* best = nullptr;
+    for (const auto& loop : loops_) {
+        if (loop.first <= index && index <= loop.last &&
+            (!best || loop.last - loop.first < best->last - best->first))
+            best = &loop;
+    }
+    return best;
+}
+
+/**
+ * add
+ *
+ * Records a finding, weighted by the profiled executions of its line or,
+ * without a profile, SUBARUU_ADVISOR_ITERATIONS per enclosing loop.
+ *
+ * @param index The statement
+ * @param kind The pattern
+ * @param message What is slow and what to do instead
+ * @param cost Estimated cost per execution
+ * @return void
+ */
+void Advisor::add(std::size_t index,
+                  const char* kind,
+                  std::string message,
+                  double cost) {
+    const int line = statements_[index].line;
+    double weight = 0;
+    if (profile_) {
+        auto it = profile_->find(line);
+        weight = it != profile_->end() ? static_cast<double>(it->second) : 0;
+    } else {
+        int depth = 0;
+        for (const auto& loop : loops_)
+            depth += loop.first <= index && index <= loop.last;
+        weight = std::pow(SUBARUU_ADVISOR_ITERATIONS, depth);
+    }
+    findings_.push_back(Finding{
+      line, kind, std::move(message), cost, weight, profile_ != nullptr });
+}
@@ -0,0 +1,171 @@
+// bytecode.cc
+
+#include "../include/bytecode.h"
+#include "../include/history.h"
+
+#include <limits>
+#include <string>
+#include <string_view>
+#include <variant>
+
+/******************************************************************************/
+
+/**
+ * compile
+ *
+ * Encodes every token from the tokenizer's current position to EOF. A REM
+ * keeps its opcode but not its text: it is encoded as REM EOL, so skipping
+ * to the end of the line stays a one-token step.
+ *
+ * @param tokenizer A tokenizer over program text; it is left at EOF
+ * @return std::shared_ptr<const Bytecode> The encoded program
+ */
+std::shared_ptr<const Bytecode> Bytecode::compile(Tokenizer& tokenizer) {
+    auto code = std::make_shared<Bytecode>();
+    Pool pooled;
+    code->append(tokenizer, pooled);
+    code->code_.shrink_to_fit();
+    return code;
+}
+
+/**
+ * link
+ *
+ * Re-encodes the parts one after the other into a single program with one
+ * pool of literals, as compiling their texts joined by newlines would. A
+ * single part is returned as is.
+ *
+ * @param parts Compiled parts, in program order
+ * @return std::shared_ptr<const Bytecode> The linked program
+ */
+std::shared_ptr<const Bytecode> Bytecode::link(
+  const std::vector<std::shared_ptr<const Bytecode>>& parts) {
+    if (parts.size() == 1)
+        return parts.front();
+    auto code = std::make_shared<Bytecode>();
+    Pool pooled;
+    for (const auto& part : parts) {
+        if (!code->code_.empty() &&
+            code->code_.back() != static_cast<std::uint8_t>(TokenType::EOL))
+            code->emit(TokenType::EOL);
+        Tokenizer tokenizer(part);
+        code->append(tokenizer, pooled);
+    }
+    code->code_.shrink_to_fit();
+    return code;
+}
+
+/**
+ * size
+ *
+ * @return std::size_t Code bytes plus the bytes of pooled literals
+ */
+std::size_t Bytecode::size() const noexcept {
+    std::size_t bytes = code_.size();
+    for (const auto& text : strings_)
+        bytes += text.size();
+    for (const auto& number : numbers_)
+        bytes += msb(number) / 8 + 1;
+    return bytes;
+}
+
+/**
+ * fingerprint
+ *
+ * @return std::uint64_t Hash of the code bytes, then of each pooled number
+ *         and string with its length
+ */
+std::uint64_t Bytecode::fingerprint() const {
+    return hash_pools(History::hash(std::string_view(
+      reinterpret_cast<const char*>(code_.data()), code_.size())));
+}
+
+/**
+ * fingerprint
+ *
+ * Encodes the program a chunk at a time, hashing and dropping each chunk
+ * of code; only the literal pools are kept to the end. FNV-1a runs over
+ * bytes in order, so the result is that of compiling the whole program.
+ *
+ * @param tokenizer A tokenizer over program text; it is left at EOF
+ * @return std::uint64_t The fingerprint of the program's code
+ */
+std::uint64_t Bytecode::fingerprint(Tokenizer& tokenizer) {
+    constexpr std::size_t CHUNK = std::size_t(1) << 16;
+    Bytecode scratch;
+    Pool pooled;
+    std::uint64_t h = History::hash({});
+    do {
+        scratch.append(tokenizer, pooled, CHUNK);
+        h = History::hash(
+          std::string_view(reinterpret_cast<const char*>(scratch.code_.data()),
+                           scratch.code_.size()),
+          h);
+        scratch.code_.clear();
+    } while (!tokenizer.finished());
+    return scratch.hash_pools(h);
+}
+
+/******************************************************************************/
+
+void Bytecode::append(Tokenizer& tokenizer, Pool& pooled, std::size_t limit) {
+    while (!tokenizer.finished() && code_.size() < limit) {
+        const auto type = tokenizer.current_token();
+        emit(type);
+        switch (type) {
+            case TokenType::REM:
+                emit(TokenType::EOL);
+                tokenizer.skip_to_eol();
+                continue;
+            case TokenType::NUMBER: {
+                const auto value = tokenizer.get_num();
+                if (value <= std::numeric_limits<std::int64_t>::max()) {
+                    write_varint(static_cast<std::uint64_t>(value) << 1);
+                } else {
+                    write_varint(numbers_.size() << 1 | 1);
+                    numbers_.push_back(value);
+                }
+                break;
+            }
+            case TokenType::STRING: {
+                const auto [it, added] = pooled.try_emplace(
+                  std::string(tokenizer.get_string()), strings_.size());
+                if (added)
+                    strings_.push_back(it->first);
+                write_varint(it->second);
+                break;
+            }
+            case TokenType::LETTER:
+            case TokenType::STRING_VAR:
+                code_.push_back(static_cast<std::uint8_t>(
+                  std::get<char>(tokenizer.get_token_data())));
+                break;
+            default:
+                break;
+        }
+        tokenizer.next_token();
+    }
+}
+
+// Continues h over each pooled number and string with its length
+std::uint64_t Bytecode::hash_pools(std::uint64_t h) const {
+    const auto add = [&h](const std::string& text) {
+        h = History::hash(std::to_string(text.size()) + ':', h);
+        h = History::hash(text, h);
+    };
+    for (const auto& number : numbers_)
+        add(number.str());
+    for (const auto& text : strings_)
+        add(text);
+    return h;
+}
+
+// LEB128: seven bits per byte, low bits first, high bit set on all but the
+// last byte
+void Bytecode::write_varint(std::uint64_t value) {
+    while (value >= 0x80) {
+        code_.push_back(static_cast<std::uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    code_.push_back(static_cast<std::uint8_t>(value));
+}
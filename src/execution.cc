@@ -0,0 +1,182 @@
+// execution.cc
+
+#include "../include/execution.h"
+
+#include <cctype>
+#include <limits>
+#include <stdexcept>
+
+/******************************************************************************/
+
+/**
+ * Execution Constructor
+ *
+ * @param source The program file
+ * @param options Interpreter options; output and input are replaced by
+ *        this execution's buffers
+ * @param scheduler Queues coroutines that used their budget, or nullptr
+ * @throws std::runtime_error if the program cannot be loaded
+ */
+Execution::Execution(std::string_view source,
+                     SUBARUU::Options options,
+                     Scheduler scheduler)
+  : scheduler_(std::move(scheduler))
+  , in_(&input_)
+  , out_(&output_)
+  , gate_{ &input_ready_, &output_.size, SUBARUU_EXECUTION_OUTPUT }
+  , subaruu_(source, wire(options, in_, out_)) {}
+
+/**
+ * run
+ *
+ * @param budget Statements per step
+ * @return Task The coroutine; resume() starts it
+ */
+Execution::Task Execution::run(std::uint64_t budget) {
+    Pause pause;
+    do {
+        pause = co_await step(budget);
+    } while (pause != Pause::FINISHED);
+}
+
+/**
+ * feed
+ *
+ * @param text More input
+ * @return void
+ * @throws std::runtime_error after close_input()
+ */
+void Execution::feed(std::string_view text) {
+    if (input_ready_ == std::numeric_limits<std::size_t>::max())
+        throw std::runtime_error("Input already closed");
+    for (const char c : text) {
+        const bool space = std::isspace(static_cast<unsigned char>(c));
+        if (space && in_number_)
+            ++input_ready_;
+        in_number_ = !space;
+    }
+    input_.append(text);
+    wake(Pause::INPUT);
+}
+
+/**
+ * close_input
+ *
+ * Marks the end of input: INPUT then reads whatever is left, and a range
+ * INPUT, which waits for this, fills until the input runs out.
+ *
+ * @param void
+ * @return void
+ */
+void Execution::close_input() {
+    input_ready_ = std::numeric_limits<std::size_t>::max();
+    in_number_ = false;
+    wake(Pause::INPUT);
+}
+
+/**
+ * take_output
+ *
+ * @param void
+ * @return std::string Output PRINTed since the last call
+ */
+std::string Execution::take_output() {
+    std::string text;
+    text.swap(output_.data);
+    output_.size = 0;
+    wake(Pause::OUTPUT);
+    return text;
+}
+
+/******************************************************************************/
+
+/**
+ * await_suspend
+ *
+ * Runs the slice; the awaiting coroutine is suspended unless the program
+ * finished (or used its budget with no scheduler to queue it).
+ *
+ * @param waiter The awaiting coroutine
+ * @return bool true to suspend it
+ */
+bool Execution::Step::await_suspend(std::coroutine_handle<> waiter) {
+    pause_ = exec_.subaruu_.run_for(budget_, exec_.gate_);
+    switch (pause_) {
+        case Pause::FINISHED:
+            return false;
+        case Pause::BUDGET:
+            if (!exec_.scheduler_)
+                return false;
+            exec_.scheduler_(waiter);
+            return true;
+        default:
+            exec_.waiter_ = waiter;
+            exec_.waiting_for_ = pause_;
+            return true;
+    }
+}
+
+/**
+ * wire
+ *
+ * @param options Interpreter options
+ * @param in INPUT source
+ * @param out PRINT destination
+ * @return SUBARUU::Options The options reading and writing the buffers
+ */
+SUBARUU::Options Execution::wire(SUBARUU::Options options,
+                                 std::istream& in,
+                                 std::ostream& out) {
+    options.input = &in;
+    options.output = &out;
+    return options;
+}
+
+/**
+ * wake
+ *
+ * Resumes, through the scheduler if there is one, the coroutine waiting
+ * for `reason`.
+ *
+ * @param reason INPUT or OUTPUT
+ * @return void
+ */
+void Execution::wake(Pause reason) {
+    if (!waiter_ || waiting_for_ != reason)
+        return;
+    const auto waiter = std::exchange(waiter_, nullptr);
+    waiting_for_ = Pause::FINISHED;
+    if (scheduler_)
+        scheduler_(waiter);
+    else
+        waiter.resume();
+}
+
+/**
+ * Drops what INPUT has read and exposes the rest plus text.
+ */
+void Execution::InputBuf::append(std::string_view text) {
+    data.erase(0, static_cast<std::size_t>(gptr() - eback()));
+    data.append(text);
+    setg(data.data(), data.data(), data.data() + data.size());
+}
+
+Execution::InputBuf::int_type Execution::InputBuf::underflow() {
+    return gptr() < egptr() ? traits_type::to_int_type(*gptr())
+                            : traits_type::eof();
+}
+
+Execution::OutputBuf::int_type Execution::OutputBuf::overflow(int_type ch) {
+    if (traits_type::eq_int_type(ch, traits_type::eof()))
+        return traits_type::not_eof(ch);
+    data += traits_type::to_char_type(ch);
+    size = data.size();
+    return ch;
+}
+
+std::streamsize Execution::OutputBuf::xsputn(const char* s,
+                                             std::streamsize n) {
+    data.append(s, static_cast<std::size_t>(n));
+    size = data.size();
+    return n;
+}
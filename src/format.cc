@@ -0,0 +1,150 @@
+// format.cc
+
+#include "../include/format.h"
+#include "../include/config.h"
+
+#include <charconv>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+
+/******************************************************************************/
+
+namespace {
+
+// Pads around `size` bytes appended by write to fill field.width
+template <typename Write>
+void pad(std::string& out,
+         const Format::Field& field,
+         Format::Align align,
+         std::size_t size,
+         Write&& write) {
+    const std::size_t fill = field.width > size ? field.width - size : 0;
+    std::size_t before = 0;
+    if (align == Format::Align::RIGHT)
+        before = fill;
+    else if (align == Format::Align::CENTER)
+        before = fill / 2;
+    out.append(before, ' ');
+    write();
+    out.append(fill - before, ' ');
+}
+
+} // namespace
+
+/**
+ * Format Constructor
+ *
+ * @param text The format string
+ * @throws std::runtime_error on an unclosed or malformed field, a stray
+ *         '}' or a width above SUBARUU_FORMAT_WIDTH
+ */
+Format::Format(std::string_view text) {
+    std::string literal;
+    for (std::size_t i = 0; i < text.size(); ++i) {
+        const char c = text[i];
+        if (c == '}') {
+            if (i + 1 >= text.size() || text[i + 1] != '}')
+                throw std::runtime_error("Unmatched '}' in format");
+            literal += '}';
+            ++i;
+            continue;
+        }
+        if (c != '{') {
+            literal += c;
+            continue;
+        }
+        if (i + 1 < text.size() && text[i + 1] == '{') {
+            literal += '{';
+            ++i;
+            continue;
+        }
+        const auto close = text.find('}', i);
+        if (close == std::string_view::npos)
+            throw std::runtime_error("Unclosed '{' in format");
+        auto spec = text.substr(i + 1, close - i - 1);
+        Field field{ std::move(literal), Align::DEFAULT, false, 0 };
+        literal.clear();
+        if (!spec.empty() &&
+            (spec[0] == '<' || spec[0] == '>' || spec[0] == '^')) {
+            field.align = spec[0] == '<'   ? Align::LEFT
+                          : spec[0] == '>' ? Align::RIGHT
+                                           : Align::CENTER;
+            spec.remove_prefix(1);
+        }
+        if (!spec.empty() && spec[0] == '0') {
+            field.zero = true;
+            spec.remove_prefix(1);
+        }
+        if (!spec.empty()) {
+            const auto [end, error] = std::from_chars(
+              spec.data(), spec.data() + spec.size(), field.width);
+            if (error != std::errc() || end != spec.data() + spec.size())
+                throw std::runtime_error("Invalid format field {" +
+                                         std::string(text.substr(
+                                           i + 1, close - i - 1)) +
+                                         "}");
+        }
+        if (field.width > SUBARUU_FORMAT_WIDTH)
+            throw std::runtime_error("Format width above " +
+                                     std::to_string(SUBARUU_FORMAT_WIDTH));
+        fields_.push_back(std::move(field));
+        i = close;
+    }
+    suffix_ = std::move(literal);
+}
+
+/**
+ * write_number
+ *
+ * Values that fit in 64 bits are converted with std::to_chars on the
+ * stack; larger ones fall back to cpp_int::str().
+ *
+ * @param out Buffer to append to
+ * @param field The field
+ * @param value The item
+ * @return void
+ */
+void Format::write_number(std::string& out,
+                          const Field& field,
+                          const value_t& value) {
+    char buffer[24];
+    std::string large;
+    std::string_view digits;
+    if (value >= std::numeric_limits<std::int64_t>::min() &&
+        value <= std::numeric_limits<std::int64_t>::max()) {
+        const auto result = std::to_chars(
+          buffer, buffer + sizeof(buffer), value.convert_to<std::int64_t>());
+        digits = std::string_view(buffer, result.ptr - buffer);
+    } else {
+        large = value.str();
+        digits = large;
+    }
+    if (field.zero && digits.size() < field.width) {
+        // Zeros go between the sign and the digits: -0042
+        const std::size_t sign = digits[0] == '-' ? 1 : 0;
+        out.append(digits.substr(0, sign));
+        out.append(field.width - digits.size(), '0');
+        out.append(digits.substr(sign));
+        return;
+    }
+    const auto align = field.align == Align::DEFAULT ? Align::RIGHT
+                                                     : field.align;
+    pad(out, field, align, digits.size(), [&] { out.append(digits); });
+}
+
+/**
+ * write_string
+ *
+ * @param out Buffer to append to
+ * @param field The field
+ * @param value The item
+ * @return void
+ */
+void Format::write_string(std::string& out,
+                          const Field& field,
+                          const Str& value) {
+    const auto align = field.align == Align::DEFAULT ? Align::LEFT
+                                                     : field.align;
+    pad(out, field, align, value.size(), [&] { value.append_to(out); });
+}
@@ -0,0 +1,272 @@
+// hash_table.cc
+
+#include "../include/hash_table.h"
+#include "../include/config.h"
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <utility>
+
+/******************************************************************************/
+
+namespace {
+
+// splitmix64 finalizer: spreads nearby integers over the whole table
+std::uint64_t mix(std::uint64_t x) noexcept {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+} // namespace
+
+/**
+ * find
+ *
+ * @param key A number
+ * @return const value_t* The value stored under key, or nullptr
+ */
+const HashTable::value_t* HashTable::find(const value_t& key) const {
+    std::string big;
+    const auto slot = locate(number_key(key, big));
+    return slot == std::string::npos ? nullptr : &entries_[slot].value;
+}
+
+/**
+ * find
+ *
+ * @param key A string
+ * @return const value_t* The value stored under key, or nullptr
+ */
+const HashTable::value_t* HashTable::find(std::string_view key) const {
+    const auto slot = locate({ Kind::STRING, 0, key });
+    return slot == std::string::npos ? nullptr : &entries_[slot].value;
+}
+
+/**
+ * set
+ *
+ * @param key A number
+ * @param value The value to store under key, replacing any
+ * @return void
+ */
+void HashTable::set(const value_t& key, value_t value) {
+    std::string big;
+    insert(number_key(key, big), std::move(value));
+}
+
+/**
+ * set
+ *
+ * @param key A string
+ * @param value The value to store under key, replacing any
+ * @return void
+ */
+void HashTable::set(std::string_view key, value_t value) {
+    insert({ Kind::STRING, 0, key }, std::move(value));
+}
+
+/**
+ * erase
+ *
+ * @param key A number
+ * @return bool false if key was not present
+ */
+bool HashTable::erase(const value_t& key) {
+    std::string big;
+    return remove(number_key(key, big));
+}
+
+/**
+ * erase
+ *
+ * @param key A string
+ * @return bool false if key was not present
+ */
+bool HashTable::erase(std::string_view key) {
+    return remove({ Kind::STRING, 0, key });
+}
+
+/**
+ * stats
+ *
+ * @param void
+ * @return Stats Occupancy, lookups so far, and the longest probe sequence
+ *         a stored key needs
+ */
+HashTable::Stats HashTable::stats() const {
+    Stats stats;
+    stats.size = size_;
+    stats.capacity = hashes_.size();
+    stats.lookups = lookups_;
+    stats.probes = probes_;
+    const std::size_t mask = hashes_.size() - 1;
+    for (std::size_t slot = 0; slot < hashes_.size(); ++slot) {
+        if (hashes_[slot])
+            stats.longest = std::max(
+              stats.longest, ((slot - (hashes_[slot] & mask)) & mask) + 1);
+    }
+    return stats;
+}
+
+/******************************************************************************/
+
+/**
+ * number_key
+ *
+ * @param key A number
+ * @param big Storage for the text of a number beyond 64 bits
+ * @return Key The lookup key
+ */
+HashTable::Key HashTable::number_key(const value_t& key, std::string& big) {
+    if (key >= std::numeric_limits<std::int64_t>::min() &&
+        key <= std::numeric_limits<std::int64_t>::max())
+        return { Kind::NUMBER, key.convert_to<std::int64_t>(), {} };
+    big = key.str();
+    return { Kind::BIG, 0, big };
+}
+
+/**
+ * hash
+ *
+ * @param key The key
+ * @return std::uint64_t Its hash, never 0 (the empty-slot mark)
+ */
+std::uint64_t HashTable::hash(const Key& key) noexcept {
+    std::uint64_t h =
+      key.kind == Kind::NUMBER
+        ? mix(static_cast<std::uint64_t>(key.number))
+        : mix(std::hash<std::string_view>{}(key.text) +
+              static_cast<std::uint64_t>(key.kind));
+    return h ? h : 1;
+}
+
+/**
+ * matches
+ *
+ * @param entry A stored entry
+ * @param key The key
+ * @return bool true if entry is stored under key
+ */
+bool HashTable::matches(const Entry& entry, const Key& key) noexcept {
+    if (entry.kind != key.kind)
+        return false;
+    return key.kind == Kind::NUMBER ? entry.number == key.number
+                                    : entry.text == key.text;
+}
+
+/**
+ * locate
+ *
+ * Counts the lookup and the slots it examines for stats().
+ *
+ * @param key The key
+ * @return std::size_t The slot holding key, or std::string::npos
+ */
+std::size_t HashTable::locate(const Key& key) const {
+    ++lookups_;
+    if (size_ == 0)
+        return std::string::npos;
+    const std::uint64_t h = hash(key);
+    const std::size_t mask = hashes_.size() - 1;
+    for (std::size_t slot = h & mask;; slot = (slot + 1) & mask) {
+        ++probes_;
+        if (hashes_[slot] == 0)
+            return std::string::npos;
+        if (hashes_[slot] == h && matches(entries_[slot], key))
+            return slot;
+    }
+}
+
+/**
+ * insert
+ *
+ * Grows the table first if the entry would pass SUBARUU_TABLE_LOAD.
+ *
+ * @param key The key
+ * @param value The value to store under key, replacing any
+ * @return void
+ */
+void HashTable::insert(const Key& key, value_t value) {
+    if (static_cast<double>(size_ + 1) >
+        static_cast<double>(hashes_.size()) * SUBARUU_TABLE_LOAD)
+        grow();
+    const std::uint64_t h = hash(key);
+    const std::size_t mask = hashes_.size() - 1;
+    std::size_t slot = h & mask;
+    for (; hashes_[slot]; slot = (slot + 1) & mask) {
+        if (hashes_[slot] == h && matches(entries_[slot], key)) {
+            entries_[slot].value = std::move(value);
+            return;
+        }
+    }
+    hashes_[slot] = h;
+    auto& entry = entries_[slot];
+    entry.kind = key.kind;
+    entry.number = key.number;
+    entry.text.assign(key.text);
+    entry.value = std::move(value);
+    ++size_;
+}
+
+/**
+ * remove
+ *
+ * Erases by backward shift: each following entry of the cluster that may
+ * live in the hole (its home slot is not between the hole and itself)
+ * moves into it, so no probe sequence is ever broken.
+ *
+ * @param key The key
+ * @return bool false if key was not present
+ */
+bool HashTable::remove(const Key& key) {
+    std::size_t hole = locate(key);
+    if (hole == std::string::npos)
+        return false;
+    const std::size_t mask = hashes_.size() - 1;
+    for (std::size_t slot = (hole + 1) & mask; hashes_[slot];
+         slot = (slot + 1) & mask) {
+        const std::size_t home = hashes_[slot] & mask;
+        if (((slot - home) & mask) >= ((slot - hole) & mask)) {
+            hashes_[hole] = hashes_[slot];
+            entries_[hole] = std::move(entries_[slot]);
+            hole = slot;
+        }
+    }
+    hashes_[hole] = 0;
+    entries_[hole] = Entry{};
+    --size_;
+    return true;
+}
+
+/**
+ * grow
+ *
+ * Doubles the capacity (at least SUBARUU_TABLE_MIN) and reinserts every
+ * entry.
+ *
+ * @param void
+ * @return void
+ */
+void HashTable::grow() {
+    const std::size_t capacity =
+      std::max(SUBARUU_TABLE_MIN, hashes_.size() * 2);
+    std::vector<std::uint64_t> hashes(capacity, 0);
+    std::vector<Entry> entries(capacity);
+    const std::size_t mask = capacity - 1;
+    for (std::size_t old = 0; old < hashes_.size(); ++old) {
+        if (!hashes_[old])
+            continue;
+        std::size_t slot = hashes_[old] & mask;
+        while (hashes[slot])
+            slot = (slot + 1) & mask;
+        hashes[slot] = hashes_[old];
+        entries[slot] = std::move(entries_[old]);
+    }
+    hashes_.swap(hashes);
+    entries_.swap(entries);
+}
@@ -0,0 +1,194 @@
+// history.cc
+
+#include "../include/history.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+
+/******************************************************************************/
+
+namespace {
+
+const char* engine_name(bool compact) { return compact ? "compact" : "text"; }
+
+void write_header(std::ostream& out) {
+    out << "# hash engine verified load_ms run_ms statements cells peak_kb\n";
+}
+
+void write_run(std::ostream& out, const History::Run& run) {
+    out << std::hex << run.hash << std::dec << ' ' << engine_name(run.compact)
+        << ' ' << run.verified << ' ' << run.load_ms << ' ' << run.run_ms
+        << ' ' << run.statements << ' ' << run.memory_cells << ' '
+        << run.peak_kb << '\n';
+}
+
+// Mean of the last SUBARUU_HISTORY_WINDOW values
+double recent_mean(const std::vector<double>& times) {
+    const auto n = std::min(times.size(), SUBARUU_HISTORY_WINDOW);
+    double sum = 0;
+    for (auto it = times.end() - static_cast<long>(n); it != times.end(); ++it)
+        sum += *it;
+    return sum / static_cast<double>(n);
+}
+
+} // namespace
+
+/**
+ * History Constructor
+ *
+ * Malformed lines (and '#' comments) are skipped.
+ *
+ * @param path The history file; it need not exist yet
+ */
+History::History(std::string path)
+  : path_(std::move(path)) {
+    std::ifstream in(path_);
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.empty() || line[0] == '#')
+            continue;
+        std::istringstream fields(line);
+        Run run{};
+        std::string engine;
+        fields >> std::hex >> run.hash >> std::dec >> engine >> run.verified >>
+          run.load_ms >> run.run_ms >> run.statements >> run.memory_cells >>
+          run.peak_kb;
+        if (!fields || (engine != "compact" && engine != "text"))
+            continue;
+        run.compact = engine == "compact";
+        runs_.push_back(run);
+    }
+}
+
+/**
+ * hash
+ *
+ * @param text The text
+ * @param h The hash of what came before text, or the FNV offset basis
+ * @return std::uint64_t 64-bit FNV-1a hash of text
+ */
+std::uint64_t History::hash(std::string_view text, std::uint64_t h) noexcept {
+    for (unsigned char c : text) {
+        h ^= c;
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+/**
+ * choose
+ *
+ * A program with no history runs on the default engine; the next run tries
+ * the other one, and from then on the engine with the lower mean load plus
+ * run time over its last SUBARUU_HISTORY_WINDOW runs is chosen.
+ *
+ * @param hash The program hash
+ * @param compact The default engine
+ * @return Choice The engine and why
+ */
+History::Choice History::choose(std::uint64_t hash, bool compact) const {
+    Choice choice{ compact, "no history" };
+    std::vector<double> times[2]; // indexed by compact
+    for (const auto& run : runs_) {
+        if (run.hash != hash)
+            continue;
+        times[run.compact].push_back(run.load_ms + run.run_ms);
+    }
+    if (times[0].empty() && times[1].empty())
+        return choice;
+    if (times[compact].empty() || times[!compact].empty()) {
+        choice.compact = times[compact].empty() ? compact : !compact;
+        choice.reason =
+          std::string("trying ") + engine_name(choice.compact) + " engine";
+        return choice;
+    }
+    const double mean[2] = { recent_mean(times[0]), recent_mean(times[1]) };
+    choice.compact = mean[1] <= mean[0];
+    std::ostringstream reason;
+    reason << std::fixed << std::setprecision(3) << "compact " << mean[1]
+           << " ms vs text " << mean[0] << " ms (recent mean)";
+    choice.reason = reason.str();
+    return choice;
+}
+
+/**
+ * runs
+ *
+ * @param hash The program hash
+ * @return std::vector<Run> The recorded runs of that program, oldest first
+ */
+std::vector<History::Run> History::runs(std::uint64_t hash) const {
+    std::vector<Run> result;
+    for (const auto& run : runs_)
+        if (run.hash == hash)
+            result.push_back(run);
+    return result;
+}
+
+/**
+ * record
+ *
+ * Appends the run to the file. Once a program holds more than twice
+ * SUBARUU_HISTORY_WINDOW runs on one engine, the file is compacted
+ * instead: only the last SUBARUU_HISTORY_WINDOW runs of each program on
+ * each engine are kept, written beside the file and renamed over it.
+ *
+ * @param run The run to record
+ * @throws std::runtime_error if the file cannot be written
+ */
+void History::record(const Run& run) {
+    runs_.push_back(run);
+    const auto same = std::count_if(
+      runs_.begin(), runs_.end(), [&run](const Run& other) {
+          return other.hash == run.hash && other.compact == run.compact;
+      });
+    if (static_cast<std::size_t>(same) > 2 * SUBARUU_HISTORY_WINDOW) {
+        prune();
+        return;
+    }
+    const bool fresh = !std::filesystem::exists(path_);
+    std::ofstream out(path_, std::ios::app);
+    if (fresh)
+        write_header(out);
+    write_run(out, run);
+    if (!out)
+        throw std::runtime_error("Failed to write history file: " + path_);
+}
+
+/******************************************************************************/
+
+/**
+ * prune
+ *
+ * @param void
+ * @return void
+ * @throws std::runtime_error if the file cannot be written
+ */
+void History::prune() {
+    std::map<std::pair<std::uint64_t, bool>, std::size_t> kept;
+    std::vector<Run> recent;
+    for (auto it = runs_.rbegin(); it != runs_.rend(); ++it) {
+        if (++kept[{ it->hash, it->compact }] <= SUBARUU_HISTORY_WINDOW)
+            recent.push_back(*it);
+    }
+    runs_.assign(recent.rbegin(), recent.rend());
+    const std::string temporary = path_ + ".tmp";
+    {
+        std::ofstream out(temporary, std::ios::trunc);
+        write_header(out);
+        for (const auto& each : runs_)
+            write_run(out, each);
+        if (!out)
+            throw std::runtime_error("Failed to write history file: " +
+                                     temporary);
+    }
+    if (std::rename(temporary.c_str(), path_.c_str()) != 0)
+        throw std::runtime_error("Failed to replace history file: " + path_);
+}
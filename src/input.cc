@@ -0,0 +1,141 @@
+// input.cc
+
+#include "../include/input.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+
+/******************************************************************************/
+
+namespace {
+
+constexpr int CHUNK_DIGITS = 18;
+
+constexpr std::uint64_t pow10(int n) {
+    std::uint64_t result = 1;
+    while (n-- > 0)
+        result *= 10;
+    return result;
+}
+
+bool is_space(char c) {
+    return c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == '\f' ||
+           c == '\v';
+}
+
+} // namespace
+
+/**
+ * InputReader Constructor
+ *
+ * @param in The stream to read numbers from
+ * @param capacity Size of the read buffer in bytes
+ */
+InputReader::InputReader(std::istream& in, std::size_t capacity)
+  : in_(in)
+  , buffer_(std::max<std::size_t>(capacity, 1))
+  , pos_(buffer_.data())
+  , end_(buffer_.data()) {}
+
+/**
+ * fill
+ *
+ * Refills the buffer from the stream
+ *
+ * @param void
+ * @return false at end of input
+ */
+bool InputReader::fill() {
+    auto* buf = in_.rdbuf();
+    const auto n =
+      buf ? buf->sgetn(buffer_.data(), static_cast<std::streamsize>(
+                                         buffer_.size()))
+          : 0;
+    pos_ = buffer_.data();
+    end_ = buffer_.data() + std::max<std::streamsize>(n, 0);
+    return n > 0;
+}
+
+/**
+ * skip_space
+ *
+ * Advances past whitespace, refilling the buffer as needed
+ *
+ * @param void
+ * @return false if only whitespace remained
+ */
+bool InputReader::skip_space() {
+    for (;;) {
+        while (pos_ < end_ && is_space(*pos_))
+            ++pos_;
+        if (pos_ < end_)
+            return true;
+        if (!fill())
+            return false;
+    }
+}
+
+/**
+ * next
+ *
+ * Parses the next integer: an optional sign followed by digits, ended by
+ * whitespace or end of input
+ *
+ * @param value Receives the number
+ * @return true if a number was read, false at end of input
+ * @throws std::runtime_error on anything that is not an integer
+ */
+bool InputReader::next(value_t& value) {
+    if (!skip_space())
+        return false;
+    bool negative = false;
+    if (*pos_ == '-' || *pos_ == '+') {
+        negative = *pos_ == '-';
+        ++pos_;
+        if (pos_ == end_ && !fill())
+            throw std::runtime_error("Invalid number in input: sign only");
+    }
+    if (*pos_ < '0' || *pos_ > '9') {
+        throw std::runtime_error(std::string("Invalid number in input near '") +
+                                 *pos_ + "'");
+    }
+    std::uint64_t chunk = 0;
+    int digits = 0;
+    bool wide = false;
+    for (;;) {
+        if (pos_ == end_ && !fill())
+            break;
+        const char c = *pos_;
+        if (c < '0' || c > '9') {
+            if (!is_space(c)) {
+                throw std::runtime_error(
+                  std::string("Invalid number in input near '") + c + "'");
+            }
+            break;
+        }
+        if (digits == CHUNK_DIGITS) {
+            if (wide) {
+                value *= pow10(CHUNK_DIGITS);
+                value += chunk;
+            } else {
+                value = chunk;
+                wide = true;
+            }
+            chunk = 0;
+            digits = 0;
+        }
+        chunk = chunk * 10 + static_cast<std::uint64_t>(c - '0');
+        ++digits;
+        ++pos_;
+    }
+    if (wide) {
+        value *= pow10(digits);
+        value += chunk;
+    } else {
+        value = chunk;
+    }
+    if (negative)
+        value = -value;
+    return true;
+}
@@ -3,6 +3,7 @@
 #include "../include/io.h"
 #include <sstream>
 #include <stdexcept>
+#include <utility>
 
 /******************************************************************************/
 
@@ -17,6 +18,36 @@ IO::IO(std::string_view filename)
     load_file();
 }
 
+/**
+ * IO Constructor
+ *
+ * Wraps source text that is already in memory (e.g. a linked program)
+ *
+ * @param name The name reported by file()
+ * @param content The text to iterate over
+ */
+IO::IO(std::string_view name, std::string content)
+  : filename_(name)
+  , content_(std::make_shared<const std::string>(std::move(content))) {
+    current_pos_ = content_->begin();
+}
+
+/**
+ * share
+ *
+ * Readers share the loaded text, so this costs no copy of the content
+ *
+ * @return std::unique_ptr<IO> A reader over the same content, at its start
+ */
+std::unique_ptr<IO> IO::share() const {
+    return std::unique_ptr<IO>(new IO(filename_, content_));
+}
+
+IO::IO(std::string_view name, std::shared_ptr<const std::string> content)
+  : filename_(name)
+  , content_(std::move(content))
+  , current_pos_(content_->begin()) {}
+
 /**
  * IO Destructor
  *
@@ -42,8 +73,8 @@ void IO::load_file() {
     }
     std::stringstream buffer;
     buffer << file_stream.rdbuf();
-    content_ = buffer.str();
-    current_pos_ = content_.begin();
+    content_ = std::make_shared<const std::string>(buffer.str());
+    current_pos_ = content_->begin();
 }
 
 /**
@@ -53,18 +84,19 @@ void IO::load_file() {
  * @return void
  * Resets the iterator position to the beginning of the content
  */
-void IO::reset() noexcept { current_pos_ = content_.begin(); }
+void IO::reset() noexcept { current_pos_ = content_->begin(); }
 
 /**
  * close
  *
  * @param void
  * @return void
- * Clears the content and resets the iterator position
+ * Releases the content and resets the iterator position
  */
 void IO::close() noexcept {
-    content_.clear();
-    current_pos_ = content_.end();
+    static const auto empty = std::make_shared<const std::string>();
+    content_ = empty;
+    current_pos_ = content_->end();
 }
 
 /**
@@ -81,7 +113,7 @@ std::string IO::to_string(std::size_t n) {
         return {};
     auto end_pos = current_pos_;
     const auto chars_left =
-      static_cast<std::size_t>(std::distance(current_pos_, content_.end()));
+      static_cast<std::size_t>(std::distance(current_pos_, content_->end()));
     const auto chars_to_read = std::min(n, chars_left);
     std::advance(end_pos, static_cast<long>(chars_to_read));
     std::string result(current_pos_, end_pos);
@@ -118,21 +150,21 @@ void IO::set(std::string_view filename) {
 void IO::seek(long offset, std::ios_base::seekdir whence) {
     switch (whence) {
         case std::ios::beg:
-            current_pos_ = content_.begin();
+            current_pos_ = content_->begin();
             std::advance(current_pos_, offset);
             break;
         case std::ios::cur:
             std::advance(current_pos_, offset);
             break;
         case std::ios::end:
-            current_pos_ = content_.end();
+            current_pos_ = content_->end();
             std::advance(current_pos_, -offset);
             break;
         default:
             throw std::invalid_argument("Invalid seek direction");
     }
-    if (current_pos_ < content_.begin())
-        current_pos_ = content_.begin();
-    if (current_pos_ > content_.end())
-        current_pos_ = content_.end();
+    if (current_pos_ < content_->begin())
+        current_pos_ = content_->begin();
+    if (current_pos_ > content_->end())
+        current_pos_ = content_->end();
 }
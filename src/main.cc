@@ -1,12 +1,30 @@
 // main.cc
 
+#include <algorithm>
+#include <chrono>
+#include <csignal> // For kill
+#include <cstdint>
 #include <cstdlib> // For EXIT_SUCCESS, EXIT_FAILURE
 #include <cstring> // For strcmp
 #include <iostream>
+#include <memory>
 #include <string>
+#include <sys/resource.h> // For getrusage
+#include <sys/wait.h>     // For waitpid
+#include <unistd.h>       // For fork
+#include <utility>
+#include <vector>
 
+#include "../include/advisor.h"
+#include "../include/history.h"
+#include "../include/metrics.h"
+#include "../include/module.h"
+#include "../include/pipeline.h"
+#include "../include/segment.h"
 #include "../include/subaruu.h"
+#include "../include/sweep.h"
 #include "../include/tokenizer.h"
+#include "../include/writer.h"
 
 // SUBARU's version number.
 constexpr const char* VERSION = "2.1";
@@ -16,8 +34,244 @@ static std::string usage() {
     return std::string("VERSION: ") + VERSION +
            "\n"
            "***************************************\n"
-           "  Howto: ./subaru [-debug] file." +
-           std::string(SUBARUU_EXTENSION_LITERAL) + "\n";
+           "  Howto: ./subaru [-debug] [-no-verify] [-stats] [-engine compact|text]"
+           " [-fork-at LINE [-forks N]]\n"
+           "                [-profile PROFILE] [-metrics FILE|unix:PATH"
+           " [-metrics-interval MS]]\n"
+           "                [-output FILE[.gz]] [-gzip]\n"
+           "               "
+           " [-segment[-cow] SEGMENT]... [-save-segment FIRST LAST SEGMENT]\n"
+           "                file." +
+           std::string(SUBARUU_EXTENSION_LITERAL) +
+           "\n"
+           "         ./subaru -lint-perf [-profile PROFILE] file." +
+           std::string(SUBARUU_EXTENSION_LITERAL) +
+           "\n"
+           "         ./subaru -pipeline manifest\n"
+           "         ./subaru -sweep [-listen ENDPOINT [-workers N] |"
+           " -connect ENDPOINT] manifest\n";
+}
+
+/**
+ * @brief Parse a positive integer option value.
+ *
+ * @param text The option argument.
+ * @return The value, or 0 if text is not a positive integer.
+ */
+static int positive(const char* text) {
+    char* end = nullptr;
+    const long value = std::strtol(text, &end, 10);
+    if (*text == '\0' || *end != '\0' || value <= 0 || value > 1000000)
+        return 0;
+    return static_cast<int>(value);
+}
+
+/**
+ * @brief Run to fork_at, then run `forks` clones of the paused program one
+ * after another, clone k drawing RND from substream k.
+ *
+ * @return EXIT_FAILURE if the program ends before reaching fork_at.
+ */
+static int explore(SUBARUU& subaruu, int fork_at, int forks) {
+    if (!subaruu.run_until(fork_at)) {
+        std::cerr << "Line " << fork_at << " was never reached\n";
+        return EXIT_FAILURE;
+    }
+    for (int k = 0; k < forks; ++k) {
+        std::cout << "--- fork " << k << " ---\n";
+        subaruu.clone(static_cast<std::uint64_t>(k))->run();
+    }
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Run a sweep: all in this process, as a coordinator (forking
+ * `workers` local workers, if any) or as a worker. Merged results are
+ * printed as a table. A local worker that exits before the sweep is done
+ * is started again, up to SUBARUU_SWEEP_ATTEMPTS times; once none is left
+ * and none of any other is connected, the sweep fails.
+ *
+ * @return EXIT_SUCCESS once the sweep (or this worker's part) is done,
+ *         EXIT_FAILURE if any of its runs failed.
+ */
+static int run_sweep(const Sweep& sweep,
+                     const SUBARUU::Options& options,
+                     const char* listen,
+                     const char* connect,
+                     int workers,
+                     bool show_stats) {
+    // A sweep with a failed run fails, once its table is out
+    const auto status = [](const std::vector<Sweep::Result>& results) {
+        const auto ok = [](const Sweep::Result& result) { return result.ok; };
+        return std::all_of(results.begin(), results.end(), ok) ? EXIT_SUCCESS
+                                                               : EXIT_FAILURE;
+    };
+    if (connect) {
+        std::size_t failed = 0;
+        const auto runs = sweep.work(connect, options, &failed);
+        if (show_stats)
+            std::cerr << "sweep worker: " << runs << " runs, " << failed
+                      << " failed\n";
+        return failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    if (!listen) {
+        const auto results = sweep.run(0, sweep.size(), options);
+        sweep.table(std::cout, results);
+        return status(results);
+    }
+    Coordinator coordinator(sweep, listen);
+    const auto spawn = [&] {
+        const pid_t pid = ::fork();
+        if (pid == 0) {
+            int status = EXIT_SUCCESS;
+            try {
+                sweep.work(coordinator.endpoint(), options);
+            } catch (const std::exception& e) {
+                std::cerr << "Sweep Worker Error: " << e.what() << "\n";
+                status = EXIT_FAILURE;
+            }
+            std::cout.flush();
+            ::_exit(status);
+        }
+        return pid; // -1 if the fork failed
+    };
+    struct Child {
+        pid_t pid;
+        std::size_t restarts = 0;
+    };
+    std::vector<Child> children;
+    for (int k = 0; k < workers; ++k)
+        children.push_back(Child{ spawn() });
+    // Reaps workers that exited and starts them again; counts those alive
+    const auto supervise = [&] {
+        std::size_t alive = 0;
+        for (auto& child : children) {
+            if (child.pid > 0 &&
+                ::waitpid(child.pid, nullptr, WNOHANG) == child.pid)
+                child.pid = -1;
+            if (child.pid < 0 && child.restarts < SUBARUU_SWEEP_ATTEMPTS) {
+                ++child.restarts;
+                child.pid = spawn();
+            }
+            alive += child.pid > 0;
+        }
+        return alive;
+    };
+    std::vector<Sweep::Result> results;
+    try {
+        results = workers > 0 ? coordinator.run(supervise) : coordinator.run();
+    } catch (const std::exception&) {
+        for (const auto& child : children) {
+            if (child.pid > 0) {
+                ::kill(child.pid, SIGTERM);
+                ::waitpid(child.pid, nullptr, 0);
+            }
+        }
+        throw;
+    }
+    for (const auto& child : children)
+        if (child.pid > 0)
+            ::waitpid(child.pid, nullptr, 0);
+    sweep.table(std::cout, results);
+    if (show_stats) {
+        std::cerr << "sweep: " << results.size() << " runs, "
+                  << coordinator.retries() << " shards retried\n";
+    }
+    return status(results);
+}
+
+/**
+ * @brief Locate the run history: $SUBARU_HISTORY if set (empty disables
+ * it), else ~/.subaru_history.
+ *
+ * @return The history file, or "" if there is none.
+ */
+static std::string history_path() {
+    if (const char* path = std::getenv("SUBARU_HISTORY"))
+        return path;
+    if (const char* home = std::getenv("HOME"))
+        return std::string(home) + "/.subaru_history";
+    return "";
+}
+
+/**
+ * @brief Record a finished run in the history and, if asked, report it.
+ */
+static void report(const SUBARUU::Stats& stats,
+                   History* history,
+                   bool show) {
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    if (show) {
+        std::cerr << "engine: " << (stats.compact ? "compact" : "text") << " ("
+                  << stats.engine_reason << ")\n"
+                  << "verified: " << (stats.verified ? "yes" : "no") << "\n"
+                  << "load: " << stats.load_ms << " ms\n"
+                  << "run: " << stats.run_ms << " ms\n"
+                  << "statements: " << stats.statements << "\n"
+                  << "memory cells: " << stats.memory_cells << "\n"
+                  << "table entries: " << stats.tables.size << "\n"
+                  << "table load: "
+                  << (stats.tables.capacity
+                        ? static_cast<double>(stats.tables.size) /
+                            static_cast<double>(stats.tables.capacity)
+                        : 0.0)
+                  << "\n"
+                  << "table probes per lookup: "
+                  << (stats.tables.lookups
+                        ? static_cast<double>(stats.tables.probes) /
+                            static_cast<double>(stats.tables.lookups)
+                        : 0.0)
+                  << "\n"
+                  << "table longest probe: " << stats.tables.longest << "\n"
+                  << "memo hits: " << stats.memo_hits << " of "
+                  << stats.memo_lookups << "\n"
+                  << "peak memory: " << usage.ru_maxrss << " KB\n";
+    }
+    if (!history)
+        return;
+    try {
+        history->record({ stats.source_hash, stats.compact, stats.verified,
+                          stats.load_ms, stats.run_ms, stats.statements,
+                          stats.memory_cells, usage.ru_maxrss });
+    } catch (const std::exception& e) {
+        std::cerr << "Warning: " << e.what() << "\n";
+    }
+}
+
+/**
+ * @brief Start publishing live metrics if a target was given.
+ *
+ * @return The sampler, or nullptr; it must outlive every run using it.
+ */
+static std::unique_ptr<Metrics> start_metrics(const char* target,
+                                              int interval_ms,
+                                              const char* file,
+                                              SUBARUU::Options& options) {
+    if (!target)
+        return nullptr;
+    auto metrics = std::make_unique<Metrics>(
+      target, std::chrono::milliseconds(interval_ms), file);
+    options.metrics = metrics.get();
+    return metrics;
+}
+
+/**
+ * @brief Open the -output destination of PRINT, if any.
+ *
+ * @param path The -output file, or nullptr for stdout.
+ * @param gzip Whether -gzip was given; a path ending in ".gz" implies it.
+ * @return The stream, or nullptr to print to stdout as usual.
+ */
+static std::unique_ptr<OutputFile> open_output(const char* path, bool gzip) {
+    if (!path && !gzip)
+        return nullptr;
+    auto compression = gzip ? BufferedWriter::Compression::GZIP
+                            : BufferedWriter::compression_for(path);
+    return std::make_unique<OutputFile>(path ? path : "-",
+                                        SUBARUU_CHANNEL_BUFFER,
+                                        SUBARUU_CHANNEL_ASYNC_FLUSH,
+                                        compression);
 }
 
 /**
@@ -34,22 +288,128 @@ static bool valid(const std::string& filename) {
 }
 
 int main(int argc, char** argv) {
-    if (argc < 2) {
+    bool debug = false;
+    bool show_stats = false;
+    bool choose_engine = true;
+    bool pipeline = false;
+    bool sweep = false;
+    const char* listen = nullptr;  // sweep coordinator endpoint
+    const char* connect = nullptr; // sweep worker endpoint
+    int workers = 0;
+    bool lint_perf = false;
+    const char* profile = nullptr;
+    const char* metrics_target = nullptr;
+    int metrics_interval = 1000;
+    int fork_at = 0;
+    int forks = 2;
+    std::vector<std::pair<const char*, Segment::Access>> segments;
+    const char* const* save_segment = nullptr; // FIRST LAST SEGMENT
+    const char* output = nullptr;
+    bool gzip = false;
+    SUBARUU::Options options;
+    int arg = 1;
+    for (; arg < argc && argv[arg][0] == '-'; ++arg) {
+        if (std::strcmp(argv[arg], "-debug") == 0) {
+            debug = true;
+        } else if (std::strcmp(argv[arg], "-no-verify") == 0) {
+            options.verify = false;
+        } else if (std::strcmp(argv[arg], "-pipeline") == 0) {
+            pipeline = true;
+        } else if (std::strcmp(argv[arg], "-sweep") == 0) {
+            sweep = true;
+        } else if (std::strcmp(argv[arg], "-listen") == 0 && arg + 1 < argc) {
+            listen = argv[++arg];
+        } else if (std::strcmp(argv[arg], "-connect") == 0 && arg + 1 < argc) {
+            connect = argv[++arg];
+        } else if (std::strcmp(argv[arg], "-workers") == 0 && arg + 1 < argc &&
+                   (workers = positive(argv[arg + 1])) > 0) {
+            ++arg;
+        } else if (std::strcmp(argv[arg], "-lint-perf") == 0) {
+            lint_perf = true;
+        } else if (std::strcmp(argv[arg], "-profile") == 0 && arg + 1 < argc) {
+            profile = argv[++arg];
+        } else if (std::strcmp(argv[arg], "-metrics") == 0 && arg + 1 < argc) {
+            metrics_target = argv[++arg];
+        } else if (std::strcmp(argv[arg], "-metrics-interval") == 0 &&
+                   arg + 1 < argc &&
+                   (metrics_interval = positive(argv[arg + 1])) > 0) {
+            ++arg;
+        } else if (std::strcmp(argv[arg], "-output") == 0 && arg + 1 < argc) {
+            output = argv[++arg];
+        } else if (std::strcmp(argv[arg], "-gzip") == 0) {
+            gzip = true;
+        } else if (std::strcmp(argv[arg], "-stats") == 0) {
+            show_stats = true;
+        } else if (std::strcmp(argv[arg], "-engine") == 0 && arg + 1 < argc &&
+                   (std::strcmp(argv[arg + 1], "compact") == 0 ||
+                    std::strcmp(argv[arg + 1], "text") == 0)) {
+            options.compact = std::strcmp(argv[++arg], "compact") == 0;
+            choose_engine = false;
+        } else if (std::strcmp(argv[arg], "-segment") == 0 && arg + 1 < argc) {
+            segments.emplace_back(argv[++arg], Segment::Access::READ_ONLY);
+        } else if (std::strcmp(argv[arg], "-segment-cow") == 0 &&
+                   arg + 1 < argc) {
+            segments.emplace_back(argv[++arg], Segment::Access::COPY_ON_WRITE);
+        } else if (std::strcmp(argv[arg], "-save-segment") == 0 &&
+                   arg + 3 < argc) {
+            save_segment = argv + arg + 1;
+            arg += 3;
+        } else if (std::strcmp(argv[arg], "-fork-at") == 0 && arg + 1 < argc &&
+                   (fork_at = positive(argv[arg + 1])) > 0) {
+            ++arg;
+        } else if (std::strcmp(argv[arg], "-forks") == 0 && arg + 1 < argc &&
+                   (forks = positive(argv[arg + 1])) > 0) {
+            ++arg;
+        } else {
+            std::cerr << "Unknown option " << argv[arg] << "\n" << usage();
+            return EXIT_FAILURE;
+        }
+    }
+    if (arg >= argc) {
         std::cout << usage();
         return EXIT_SUCCESS;
     }
-
-    if (std::strcmp(argv[1], "-debug") == 0) {
-        if (argc < 3) {
-            std::cout << usage();
-            return EXIT_SUCCESS;
+    const char* file = argv[arg];
+    if (pipeline) {
+        try {
+            const auto metrics =
+              start_metrics(metrics_target, metrics_interval, file, options);
+            Pipeline(file).run(std::cout, options);
+        } catch (const std::exception& e) {
+            std::cerr << "Pipeline Error: " << e.what() << "\n";
+            return EXIT_FAILURE;
         }
-        if (!valid(argv[2])) {
-            std::cerr << "Invalid file extension. Expected a .subaru file.\n";
+        return EXIT_SUCCESS;
+    }
+    if (sweep) {
+        try {
+            return run_sweep(Sweep(file), options, listen, connect, workers,
+                             show_stats);
+        } catch (const std::exception& e) {
+            std::cerr << "Sweep Error: " << e.what() << "\n";
             return EXIT_FAILURE;
         }
+    }
+    if (!valid(file)) {
+        std::cerr << "Invalid file extension. Expected a .subaru file.\n";
+        return EXIT_FAILURE;
+    }
+
+    if (lint_perf) {
+        try {
+            Advisor::Profile hits;
+            if (profile)
+                hits = Advisor::load_profile(profile);
+            Advisor advisor(file, Module::link(file), profile ? &hits : nullptr);
+            std::cout << (advisor.findings().empty() ? "  no findings\n"
+                                                     : advisor.report());
+        } catch (const std::exception& e) {
+            std::cerr << "Advisor Error: " << e.what() << "\n";
+            return EXIT_FAILURE;
+        }
+    } else if (debug) {
         try {
-            Tokenizer tokenizer(argv[2]);
+            Tokenizer tokenizer(file);
             do {
                 auto token = tokenizer.current_token();
                 std::cout << tokenizer.token_to_string(token) << " ";
@@ -62,13 +422,33 @@ int main(int argc, char** argv) {
             return EXIT_FAILURE;
         }
     } else {
-        if (!valid(argv[1])) {
-            std::cerr << "Invalid file extension. Expected a .subaru file.\n";
-            return EXIT_FAILURE;
-        }
         try {
-            SUBARUU subaruu(argv[1]);
+            std::shared_ptr<History> history;
+            if (const auto path = history_path(); !path.empty())
+                history = std::make_shared<History>(path);
+            if (choose_engine)
+                options.history = history;
+            options.profile = profile != nullptr;
+            const auto metrics =
+              start_metrics(metrics_target, metrics_interval, file, options);
+            const auto printed = open_output(output, gzip);
+            options.output = printed.get();
+            SUBARUU subaruu(file, options);
+            for (const auto& [path, access] : segments)
+                subaruu.attach(Segment::map(path), access);
+            if (fork_at > 0)
+                return explore(subaruu, fork_at, forks);
             subaruu.run();
+            if (printed)
+                printed->close();
+            report(subaruu.stats(), history.get(), show_stats);
+            if (profile)
+                Advisor::save_profile(profile, subaruu.line_hits());
+            if (save_segment) {
+                Segment::capture(subaruu, SUBARUU::value_t(save_segment[0]),
+                                 SUBARUU::value_t(save_segment[1]))
+                  ->save(save_segment[2]);
+            }
         } catch (const std::exception& e) {
             std::cerr << "SUBARUU Error: " << e.what() << "\n";
             return EXIT_FAILURE;
@@ -0,0 +1,259 @@
+// metrics.cc
+
+#include "../include/metrics.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <poll.h>
+#include <sstream>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <utility>
+
+/******************************************************************************/
+
+namespace {
+
+constexpr char UNIX_PREFIX[] = "unix:";
+
+// Longest wait between checks for socket clients and for stop
+constexpr std::chrono::milliseconds POLL_SLICE{ 100 };
+
+// Counters are written as integers, rates as doubles
+template <typename Value>
+void metric(std::ostringstream& out,
+            const char* name,
+            const char* type,
+            const char* help,
+            const std::string& labels,
+            Value value) {
+    out << "# HELP " << name << ' ' << help << '\n'
+        << "# TYPE " << name << ' ' << type << '\n'
+        << name << labels << ' ' << value << '\n';
+}
+
+// Label values escape backslash, double quote and line feed, as the
+// Prometheus text format requires
+std::string label_value(const std::string& value) {
+    std::string escaped;
+    escaped.reserve(value.size());
+    for (const char c : value) {
+        switch (c) {
+            case '\\':
+                escaped += "\\\\";
+                break;
+            case '"':
+                escaped += "\\\"";
+                break;
+            case '\n':
+                escaped += "\\n";
+                break;
+            default:
+                escaped += c;
+        }
+    }
+    return escaped;
+}
+
+} // namespace
+
+/**
+ * Metrics Constructor
+ *
+ * @param target File to replace on every sample, or "unix:PATH" to serve
+ *               samples on a Unix socket
+ * @param interval Time between samples
+ * @param program Value of the program label
+ * @throws std::runtime_error if the socket cannot be opened
+ */
+Metrics::Metrics(std::string target,
+                 std::chrono::milliseconds interval,
+                 std::string program)
+  : target_(std::move(target))
+  , interval_(std::max(interval, std::chrono::milliseconds(1)))
+  , program_(std::move(program))
+  , last_time_(std::chrono::steady_clock::now()) {
+    if (target_.rfind(UNIX_PREFIX, 0) == 0) {
+        socket_path_ = target_.substr(sizeof(UNIX_PREFIX) - 1);
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        if (socket_path_.empty() ||
+            socket_path_.size() >= sizeof(address.sun_path))
+            throw std::runtime_error("Invalid metrics socket: " + target_);
+        std::memcpy(address.sun_path, socket_path_.c_str(),
+                    socket_path_.size());
+        ::unlink(socket_path_.c_str());
+        listen_fd_ = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (listen_fd_ < 0 ||
+            ::bind(listen_fd_, reinterpret_cast<sockaddr*>(&address),
+                   sizeof(address)) != 0 ||
+            ::listen(listen_fd_, 16) != 0) {
+            const std::string reason = std::strerror(errno);
+            if (listen_fd_ >= 0)
+                ::close(listen_fd_);
+            throw std::runtime_error("Failed to open metrics socket " +
+                                     socket_path_ + ": " + reason);
+        }
+    }
+    sample();
+    thread_ = std::thread(&Metrics::sampler, this);
+}
+
+/**
+ * Metrics Destructor
+ *
+ * Stops the sampler, which publishes a final sample, and removes the
+ * socket.
+ */
+Metrics::~Metrics() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    cv_.notify_all();
+    thread_.join();
+    if (listen_fd_ >= 0) {
+        ::close(listen_fd_);
+        ::unlink(socket_path_.c_str());
+    }
+}
+
+/**
+ * text
+ *
+ * @param void
+ * @return std::string The latest sample in Prometheus text format
+ */
+std::string Metrics::text() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return text_;
+}
+
+/******************************************************************************/
+
+/**
+ * sampler
+ *
+ * Thread body: samples every interval until stopped. With a socket it
+ * wakes at least every POLL_SLICE to answer clients.
+ *
+ * @param void
+ * @return void
+ */
+void Metrics::sampler() {
+    auto next = std::chrono::steady_clock::now() + interval_;
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stop_) {
+        if (listen_fd_ >= 0) {
+            lock.unlock();
+            const auto wait = std::min(
+              std::chrono::duration_cast<std::chrono::milliseconds>(
+                next - std::chrono::steady_clock::now()),
+              POLL_SLICE);
+            pollfd client{ listen_fd_, POLLIN, 0 };
+            if (::poll(&client, 1, static_cast<int>(std::max<long long>(
+                                     wait.count(), 0))) > 0)
+                serve();
+            lock.lock();
+        } else {
+            cv_.wait_until(lock, next, [this] { return stop_; });
+        }
+        if (std::chrono::steady_clock::now() >= next) {
+            lock.unlock();
+            sample();
+            lock.lock();
+            next += interval_;
+        }
+    }
+    lock.unlock();
+    sample();
+}
+
+/**
+ * sample
+ *
+ * Reads the counters, derives rates since the previous sample, and
+ * publishes the result: a file is written beside the target and renamed
+ * over it, so readers never see a partial sample.
+ *
+ * @param void
+ * @return void
+ */
+void Metrics::sample() {
+    constexpr auto relaxed = std::memory_order_relaxed;
+    const auto now = std::chrono::steady_clock::now();
+    const auto statements = counters_.statements.load(relaxed);
+    const auto jumps = counters_.jumps.load(relaxed);
+    const double seconds =
+      std::chrono::duration<double>(now - last_time_).count();
+    const auto rate = [seconds](std::uint64_t delta) {
+        return seconds > 0 ? static_cast<double>(delta) / seconds : 0.0;
+    };
+    const std::string labels = "{program=\"" + label_value(program_) + "\"}";
+    std::ostringstream out;
+    metric(out, "subaru_statements_total", "counter",
+           "Statements executed.", labels, statements);
+    metric(out, "subaru_statements_per_second", "gauge",
+           "Statements executed per second since the previous sample.",
+           labels, rate(statements - last_statements_));
+    metric(out, "subaru_current_line", "gauge", "Line number last started.",
+           labels, counters_.line.load(relaxed));
+    metric(out, "subaru_jumps_total", "counter",
+           "Taken GOTO, THEN and loop branches.", labels, jumps);
+    metric(out, "subaru_jumps_per_second", "gauge",
+           "Branches taken per second since the previous sample.", labels,
+           rate(jumps - last_jumps_));
+    metric(out, "subaru_memory_cells", "gauge",
+           "Indexed memory cells written.", labels,
+           counters_.memory_cells.load(relaxed));
+    metric(out, "subaru_bignum_promotions_total", "counter",
+           "Values stored that no longer fit in 64 bits.", labels,
+           counters_.bignums.load(relaxed));
+    metric(out, "subaru_output_bytes_total", "counter",
+           "Bytes written by PRINT to standard output.", labels,
+           counters_.output_bytes.load(relaxed));
+    last_statements_ = statements;
+    last_jumps_ = jumps;
+    last_time_ = now;
+
+    std::string text = out.str();
+    if (listen_fd_ < 0) {
+        const auto temp = target_ + ".tmp";
+        std::ofstream file(temp, std::ios::trunc);
+        file << text;
+        file.close();
+        if (file)
+            std::rename(temp.c_str(), target_.c_str());
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    text_ = std::move(text);
+}
+
+/**
+ * serve
+ *
+ * Writes the latest sample to one waiting client and disconnects it.
+ *
+ * @param void
+ * @return void
+ */
+void Metrics::serve() {
+    const int client = ::accept4(listen_fd_, nullptr, nullptr, SOCK_CLOEXEC);
+    if (client < 0)
+        return;
+    const auto sample = text();
+    std::size_t sent = 0;
+    while (sent < sample.size()) {
+        const auto n = ::send(client, sample.data() + sent,
+                              sample.size() - sent, MSG_NOSIGNAL);
+        if (n <= 0)
+            break;
+        sent += static_cast<std::size_t>(n);
+    }
+    ::close(client);
+}
@@ -0,0 +1,274 @@
+// module.cc
+
+#include "../include/module.h"
+#include "../include/common.h"
+#include "../include/io.h"
+#include "../include/tokenizer.h"
+
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_map>
+#include <unordered_set>
+
+/******************************************************************************/
+
+namespace {
+
+struct CacheEntry {
+    std::shared_ptr<const Module> module;
+    std::filesystem::file_time_type stamp;
+};
+
+std::mutex& cache_mutex() {
+    static std::mutex mutex;
+    return mutex;
+}
+
+std::unordered_map<std::string, CacheEntry>& cache() {
+    static std::unordered_map<std::string, CacheEntry> entries;
+    return entries;
+}
+
+std::string cache_key(std::string_view path) {
+    std::error_code ec;
+    auto key = std::filesystem::weakly_canonical(std::string(path), ec);
+    return ec ? std::string(path) : key.string();
+}
+
+// Appends a block of program text, keeping blocks on separate lines.
+void append_text(std::string& out, std::string_view text) {
+    if (text.empty())
+        return;
+    if (!out.empty() && out.back() != '\n' && out.back() != '\r')
+        out += '\n';
+    out += text;
+}
+
+// Collects the segments of a program in order, each module at most once
+struct Linker {
+    std::function<std::shared_ptr<const Module>(const std::string&)> load;
+    std::vector<std::shared_ptr<const Module>> modules; // keeps segments
+    std::vector<const Module::Segment*> segments;
+    std::unordered_map<int, std::string> owners;
+    std::unordered_set<std::string> merged;
+    std::string collisions;
+
+    void add(std::shared_ptr<const Module> module) {
+        for (int line : module->line_numbers()) {
+            auto [it, inserted] = owners.try_emplace(line, module->path());
+            if (!inserted && it->second != module->path()) {
+                collisions += "\n  line " + std::to_string(line) + " in " +
+                              module->path() + " is already defined in " +
+                              it->second;
+            }
+        }
+        for (const auto& segment : module->segments()) {
+            segments.push_back(&segment);
+            if (segment.merge.empty())
+                continue;
+            // A module merged more than once is spliced in only the first time
+            if (!merged.insert(cache_key(segment.merge)).second)
+                continue;
+            add(load(segment.merge));
+        }
+        modules.push_back(std::move(module));
+    }
+
+    void link(std::string_view path, std::shared_ptr<const Module> root) {
+        merged.insert(cache_key(path));
+        add(std::move(root));
+        if (!collisions.empty()) {
+            throw std::runtime_error("Line number collision while merging " +
+                                     std::string(path) + ":" + collisions);
+        }
+    }
+};
+
+} // namespace
+
+/**
+ * Module Constructor
+ *
+ * Reads and scans a module, recording its line numbers and splitting it
+ * around MERGE directives. A compiled module encodes each piece (see
+ * Bytecode) and drops the text.
+ *
+ * @param path The module's source file
+ * @param form Whether to keep bytecode or source text
+ * @throws std::runtime_error if the file cannot be opened or a MERGE
+ *         directive is malformed
+ */
+Module::Module(std::string_view path, Form form)
+  : path_(path) {
+    parse(IO(path), form);
+}
+
+/**
+ * load
+ *
+ * Returns the compiled form of a module, reading it only if it is not
+ * cached yet or its file has been modified since it was cached.
+ *
+ * @param path The module's source file
+ * @return Shared, immutable module
+ * @throws std::runtime_error if the module has to be read and cannot be
+ */
+std::shared_ptr<const Module> Module::load(std::string_view path) {
+    const auto key = cache_key(path);
+    std::error_code ec;
+    const auto stamp = std::filesystem::last_write_time(key, ec);
+    {
+        std::lock_guard<std::mutex> lock(cache_mutex());
+        auto it = cache().find(key);
+        if (it != cache().end() && it->second.stamp == stamp)
+            return it->second.module;
+    }
+    DEBUG_LOG("Loading module " << key);
+    auto module = std::make_shared<const Module>(path);
+    std::lock_guard<std::mutex> lock(cache_mutex());
+    cache()[key] = CacheEntry{ module, stamp };
+    return module;
+}
+
+/**
+ * clear_cache
+ *
+ * Drops every cached module; modules still referenced stay alive.
+ *
+ * @param void
+ * @return void
+ */
+void Module::clear_cache() noexcept {
+    std::lock_guard<std::mutex> lock(cache_mutex());
+    cache().clear();
+}
+
+/**
+ * compile
+ *
+ * Builds a program by splicing each merged module's code in place of its
+ * MERGE directive. Every module is merged at most once. Merged modules
+ * come from the cache; the root is compiled afresh and not cached, so a
+ * program without MERGE keeps only its code in memory once loaded.
+ *
+ * @param path The root module
+ * @return The linked program
+ * @throws std::runtime_error listing every line number defined by more than
+ *         one module
+ */
+std::shared_ptr<const Bytecode> Module::compile(std::string_view path) {
+    Linker linker;
+    linker.load = [](const std::string& module) { return load(module); };
+    linker.link(path, std::make_shared<const Module>(path));
+    std::vector<std::shared_ptr<const Bytecode>> parts;
+    for (const auto* segment : linker.segments)
+        parts.push_back(segment->code);
+    return Bytecode::link(parts);
+}
+
+/**
+ * link
+ *
+ * Builds the text of a program as compile() builds its code, for the text
+ * engine and tools that read the source. Modules are read afresh, not from
+ * the cache.
+ *
+ * @param path The root module
+ * @return The linked program text
+ * @throws std::runtime_error listing every line number defined by more than
+ *         one module
+ */
+std::string Module::link(std::string_view path) {
+    Linker linker;
+    linker.load = [](const std::string& module) {
+        return std::make_shared<const Module>(module, Form::SOURCE);
+    };
+    linker.link(path, linker.load(std::string(path)));
+    std::string text;
+    for (const auto* segment : linker.segments)
+        append_text(text, segment->text);
+    return text;
+}
+
+/**
+ * parse
+ *
+ * Scans module text line by line. MERGE directives must stand on their own
+ * line; the whole line, including any line number, is replaced by the
+ * merged module.
+ *
+ * @param source The module text
+ * @param form Whether segments keep bytecode or text
+ * @return void
+ * @throws std::runtime_error on a malformed MERGE directive
+ */
+void Module::parse(const IO& source, Form form) {
+    using TokenType = Tokenizer::TokenType;
+    Tokenizer tokenizer(source.share());
+    const auto dir = std::filesystem::path(path_).parent_path();
+    const auto size = static_cast<std::size_t>(source.end() - source.begin());
+    // Source text from..to as a segment; a module without MERGE is
+    // compiled in place, without copying its text
+    const auto segment = [&](std::size_t from, std::size_t to,
+                             std::string merge) {
+        Segment piece{ nullptr, {}, std::move(merge) };
+        const auto text = [&] {
+            return std::string(
+              source.begin() + static_cast<std::ptrdiff_t>(from),
+              source.begin() + static_cast<std::ptrdiff_t>(to));
+        };
+        if (form == Form::SOURCE) {
+            piece.text = text();
+        } else if (from == 0 && to == size) {
+            Tokenizer whole(source.share());
+            piece.code = Bytecode::compile(whole);
+        } else {
+            Tokenizer part(std::make_unique<IO>(path_, text()));
+            piece.code = Bytecode::compile(part);
+        }
+        segments_.push_back(std::move(piece));
+    };
+    std::size_t cut = 0;
+    while (!tokenizer.finished()) {
+        const auto line_start = tokenizer.offset();
+        // Not a definition until the line is known not to be a MERGE
+        bool numbered = false;
+        int number = 0;
+        if (tokenizer.current_token() == TokenType::NUMBER) {
+            numbered = true;
+            number = static_cast<int>(tokenizer.get_num());
+            tokenizer.next_token();
+        }
+        if (numbered && tokenizer.current_token() != TokenType::MERGE)
+            line_numbers_.push_back(number);
+        if (tokenizer.current_token() == TokenType::REM) {
+            tokenizer.skip_to_eol();
+            continue;
+        }
+        if (tokenizer.current_token() == TokenType::MERGE) {
+            tokenizer.next_token();
+            if (tokenizer.current_token() != TokenType::STRING)
+                throw std::runtime_error(path_ +
+                                         ": MERGE expects a quoted file name");
+            std::filesystem::path merge(std::string(tokenizer.get_string()));
+            tokenizer.next_token();
+            if (tokenizer.current_token() != TokenType::EOL &&
+                !tokenizer.finished())
+                throw std::runtime_error(path_ +
+                                         ": MERGE must stand on its own line");
+            if (merge.is_relative())
+                merge = dir / merge;
+            segment(cut, line_start, merge.string());
+            tokenizer.next_token();
+            cut = tokenizer.offset();
+            continue;
+        }
+        while (!tokenizer.finished() &&
+               tokenizer.current_token() != TokenType::EOL)
+            tokenizer.next_token();
+        tokenizer.next_token();
+    }
+    segment(cut, size, {});
+}
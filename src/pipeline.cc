@@ -0,0 +1,232 @@
+// pipeline.cc
+
+#include "../include/pipeline.h"
+#include "../include/io.h"
+
+#include <exception>
+#include <filesystem>
+#include <future>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+
+/******************************************************************************/
+
+namespace {
+
+bool within(const Pipeline::Range& inner, const Pipeline::Range& outer) {
+    return outer.first <= inner.first && inner.last <= outer.last;
+}
+
+} // namespace
+
+/**
+ * Pipeline Constructor
+ *
+ * @param path The manifest file
+ * @throws std::runtime_error if the file cannot be read or is malformed
+ */
+Pipeline::Pipeline(std::string_view path)
+  : path_(path) {
+    IO io(path);
+    parse(std::string(io.begin(), io.end()));
+}
+
+/**
+ * Pipeline Constructor
+ *
+ * @param path Name of the manifest, used to resolve program paths and in
+ *             error messages
+ * @param text The manifest
+ * @throws std::runtime_error if the manifest is malformed
+ */
+Pipeline::Pipeline(std::string_view path, std::string_view text)
+  : path_(path) {
+    parse(text);
+}
+
+/**
+ * run
+ *
+ * A stage starts as soon as the stages it reads from are done; a stage
+ * whose upstream failed fails with the same error.
+ *
+ * @param out Receives the PRINT output of every stage, in manifest order
+ * @param options Options for every stage; their output is redirected
+ * @throws std::runtime_error naming the first stage that failed, or if a
+ *         segment file cannot be mapped
+ */
+void Pipeline::run(std::ostream& out, const SUBARUU::Options& options) {
+    std::map<std::string, std::shared_ptr<const Segment>> mapped;
+    for (const auto& stage : stages_)
+        for (const auto& attachment : stage.segments)
+            if (!mapped.count(attachment.file))
+                mapped[attachment.file] = Segment::map(attachment.file);
+    const auto count = stages_.size();
+    std::vector<std::ostringstream> printed(count);
+    std::vector<std::shared_future<void>> done(count);
+    results_.clear();
+    results_.resize(count);
+    for (std::size_t i = 0; i < count; ++i) {
+        done[i] = std::async(std::launch::async, [this, i, &done, &printed,
+                                                  &mapped, options] {
+                      const auto& stage = stages_[i];
+                      for (const auto& input : stage.inputs)
+                          done[input.from].get();
+                      try {
+                          auto stage_options = options;
+                          stage_options.output = &printed[i];
+                          auto subaruu = std::make_unique<SUBARUU>(
+                            stage.program, stage_options);
+                          for (const auto& attachment : stage.segments)
+                              subaruu->attach(mapped.at(attachment.file),
+                                              attachment.access);
+                          for (const auto& input : stage.inputs)
+                              subaruu->copy_memory(*results_[input.from],
+                                                   input.range.first,
+                                                   input.range.last,
+                                                   input.at);
+                          subaruu->run();
+                          results_[i] = std::move(subaruu);
+                      } catch (const std::exception& e) {
+                          throw std::runtime_error("Stage " + stage.name +
+                                                   ": " + e.what());
+                      }
+                  }).share();
+    }
+    std::exception_ptr failure;
+    for (std::size_t i = 0; i < count; ++i) {
+        try {
+            done[i].get();
+        } catch (...) {
+            if (!failure)
+                failure = std::current_exception();
+        }
+        out << printed[i].str();
+    }
+    out.flush();
+    if (failure)
+        std::rethrow_exception(failure);
+}
+
+/**
+ * peek
+ *
+ * @param stage The stage name
+ * @param index The memory index
+ * @return value_t The cell's value once the stage has run
+ * @throws std::runtime_error if there is no such stage or it has not run
+ */
+Pipeline::value_t Pipeline::peek(std::string_view stage,
+                                 const value_t& index) const {
+    const auto i = find(stage);
+    if (i == stages_.size() || i >= results_.size() || !results_[i])
+        throw std::runtime_error("Stage " + std::string(stage) +
+                                 " has not run");
+    return results_[i]->peek(index);
+}
+
+/******************************************************************************/
+
+/**
+ * parse
+ *
+ * @param text The manifest
+ * @throws std::runtime_error naming the line of the first problem
+ */
+void Pipeline::parse(std::string_view text) {
+    const auto dir = std::filesystem::path(path_).parent_path();
+    std::istringstream in{ std::string(text) };
+    std::string line;
+    for (int number = 1; std::getline(in, line); ++number) {
+        const auto fail = [&](const std::string& message) {
+            throw std::runtime_error(path_ + ":" + std::to_string(number) +
+                                     ": " + message);
+        };
+        std::istringstream fields(line);
+        std::string keyword, name;
+        if (!(fields >> keyword) || keyword[0] == '#')
+            continue;
+        if (!(fields >> name))
+            fail("expected a stage name after " + keyword);
+        if (keyword == "stage") {
+            std::filesystem::path program;
+            if (!(fields >> program))
+                fail("expected a program for stage " + name);
+            if (find(name) != stages_.size())
+                fail("stage " + name + " is already defined");
+            if (program.is_relative())
+                program = dir / program;
+            stages_.push_back(Stage{ name, program.string(), {}, {}, {} });
+        } else if (keyword == "segment") {
+            const auto stage = find(name);
+            if (stage == stages_.size())
+                fail("unknown stage " + name);
+            std::filesystem::path file;
+            if (!(fields >> file))
+                fail("expected a segment file");
+            if (file.is_relative())
+                file = dir / file;
+            auto access = Segment::Access::READ_ONLY;
+            std::string mode;
+            if (fields >> mode) {
+                if (mode != "cow")
+                    fail("expected cow after the segment file");
+                access = Segment::Access::COPY_ON_WRITE;
+            }
+            stages_[stage].segments.push_back(
+              Attachment{ file.string(), access });
+        } else if (keyword == "output" || keyword == "input") {
+            const auto stage = find(name);
+            if (stage == stages_.size())
+                fail("unknown stage " + name);
+            std::size_t from = stage;
+            if (keyword == "input") {
+                std::string upstream;
+                fields >> upstream;
+                from = find(upstream);
+                if (from == stages_.size())
+                    fail("unknown stage " + upstream);
+                if (from >= stage)
+                    fail("stage " + name + " cannot read from " + upstream +
+                         ", which is not defined before it");
+            }
+            Range range;
+            if (!(fields >> range.first >> range.last) ||
+                range.last < range.first)
+                fail("expected a memory range FIRST LAST");
+            if (keyword == "output") {
+                stages_[stage].outputs.push_back(range);
+            } else {
+                value_t at = range.first;
+                std::string word;
+                if (fields >> word && (word != "at" || !(fields >> at)))
+                    fail("expected at DEST after the range");
+                bool exported = false;
+                for (const auto& output : stages_[from].outputs)
+                    exported = exported || within(range, output);
+                if (!exported)
+                    fail("the range is not an output of " + stages_[from].name);
+                stages_[stage].inputs.push_back(Input{ from, range, at });
+            }
+        } else {
+            fail("unknown keyword " + keyword);
+        }
+        std::string extra;
+        if (fields >> extra)
+            fail("unexpected " + extra);
+    }
+}
+
+/**
+ * find
+ *
+ * @param name A stage name
+ * @return std::size_t Its index, or stages_.size() if there is none
+ */
+std::size_t Pipeline::find(std::string_view name) const {
+    for (std::size_t i = 0; i < stages_.size(); ++i)
+        if (stages_[i].name == name)
+            return i;
+    return stages_.size();
+}
@@ -0,0 +1,188 @@
+// random.cc
+
+#include "../include/random.h"
+
+#include <limits>
+
+/******************************************************************************/
+
+namespace {
+
+// Below this many jumps, jumping one at a time is cheaper than building
+// the powers of the jump
+constexpr std::uint64_t LINEAR_JUMPS = 64;
+
+} // namespace
+
+/**
+ * Random Constructor
+ *
+ * @param seed Initial seed (substream 0)
+ */
+Random::Random(std::uint64_t seed) { this->seed(seed); }
+
+/**
+ * seed
+ *
+ * Resets the generator to a substream of the given seed. The state is
+ * expanded from the seed with splitmix64, then jumped `stream` times.
+ *
+ * @param seed The seed
+ * @param stream Substream index
+ * @return void
+ */
+void Random::seed(std::uint64_t seed, std::uint64_t stream) {
+    for (auto& word : s_) {
+        seed += 0x9e3779b97f4a7c15ULL;
+        std::uint64_t z = seed;
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        word = z ^ (z >> 31);
+    }
+    jump(stream);
+}
+
+/**
+ * jump
+ *
+ * Advances the state by 2^128 draws
+ *
+ * @param void
+ * @return void
+ */
+void Random::jump() noexcept { s_ = jumped(s_); }
+
+/**
+ * jump
+ *
+ * Advances the state by times * 2^128 draws: a few jumps are taken one at
+ * a time, more as the product of the powers of the jump named by the bits
+ * of times.
+ *
+ * @param times Number of jumps
+ * @return void
+ */
+void Random::jump(std::uint64_t times) {
+    if (times < LINEAR_JUMPS) {
+        while (times-- > 0)
+            jump();
+        return;
+    }
+    const auto& maps = powers();
+    for (std::size_t k = 0; times != 0; ++k, times >>= 1) {
+        if (times & 1)
+            s_ = apply(maps[k], s_);
+    }
+}
+
+/**
+ * jumped
+ *
+ * @param s A state
+ * @return State The state 2^128 draws later
+ */
+Random::State Random::jumped(State s) noexcept {
+    static constexpr std::uint64_t JUMP[] = { 0x180ec6d33cfd0abaULL,
+                                              0xd5a61266f0c9392cULL,
+                                              0xa9582618e03fc9aaULL,
+                                              0x39abdc4529b1661cULL };
+    State t{};
+    for (auto word : JUMP) {
+        for (int b = 0; b < 64; ++b) {
+            if (word & (std::uint64_t(1) << b)) {
+                for (std::size_t i = 0; i < t.size(); ++i)
+                    t[i] ^= s[i];
+            }
+            step(s);
+        }
+    }
+    return t;
+}
+
+/**
+ * apply
+ *
+ * @param map A linear map of the state
+ * @param s A state
+ * @return State The image of s: the sum of the images of its set bits
+ */
+Random::State Random::apply(const Map& map, const State& s) noexcept {
+    State out{};
+    for (std::size_t bit = 0; bit < map.size(); ++bit) {
+        if ((s[bit / 64] >> (bit % 64)) & 1) {
+            for (std::size_t i = 0; i < out.size(); ++i)
+                out[i] ^= map[bit][i];
+        }
+    }
+    return out;
+}
+
+/**
+ * powers
+ *
+ * Built on first use: the jump itself from the jumps of the 256 unit
+ * states, then each power as the square of the one before.
+ *
+ * @param void
+ * @return const std::vector<Map>& The jump raised to 2^k at index k
+ */
+const std::vector<Random::Map>& Random::powers() {
+    static const std::vector<Map> maps = [] {
+        std::vector<Map> maps(64);
+        for (std::size_t bit = 0; bit < maps[0].size(); ++bit) {
+            State unit{};
+            unit[bit / 64] = std::uint64_t(1) << (bit % 64);
+            maps[0][bit] = jumped(unit);
+        }
+        for (std::size_t k = 1; k < maps.size(); ++k) {
+            for (std::size_t bit = 0; bit < maps[k].size(); ++bit)
+                maps[k][bit] = apply(maps[k - 1], maps[k - 1][bit]);
+        }
+        return maps;
+    }();
+    return maps;
+}
+
+/**
+ * below
+ *
+ * Draws uniformly from [0, bound) with Lemire's multiply-and-reject method
+ *
+ * @param bound Exclusive upper bound, > 0
+ * @return The draw
+ */
+std::uint64_t Random::below(std::uint64_t bound) noexcept {
+    __extension__ using uint128 = unsigned __int128;
+    uint128 m = static_cast<uint128>(next()) * bound;
+    auto low = static_cast<std::uint64_t>(m);
+    if (low < bound) {
+        const std::uint64_t threshold = (0 - bound) % bound;
+        while (low < threshold) {
+            m = static_cast<uint128>(next()) * bound;
+            low = static_cast<std::uint64_t>(m);
+        }
+    }
+    return static_cast<std::uint64_t>(m >> 64);
+}
+
+/**
+ * below
+ *
+ * Draws from [0, bound) for bounds of any size. Bounds beyond 64 bits are
+ * served by reducing a draw 64 bits wider than the bound, which keeps the
+ * bias below 2^-64.
+ *
+ * @param bound Exclusive upper bound, > 0
+ * @return The draw
+ */
+Random::value_t Random::below(const value_t& bound) {
+    if (bound <= std::numeric_limits<std::uint64_t>::max())
+        return below(bound.convert_to<std::uint64_t>());
+    const auto bits = boost::multiprecision::msb(bound) + 1 + 64;
+    value_t wide = 0;
+    for (std::size_t filled = 0; filled < bits; filled += 64) {
+        wide <<= 64;
+        wide |= next();
+    }
+    return wide % bound;
+}
@@ -0,0 +1,176 @@
+// segment.cc
+
+#include "../include/segment.h"
+#include "../include/subaruu.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utility>
+
+/******************************************************************************/
+
+namespace {
+
+constexpr char MAGIC[8] = { 'S', 'U', 'B', 'A', 'R', 'U', 'S', 'G' };
+
+// File layout: header, then `count` cells for indices first, first + 1, ...
+struct Header {
+    char magic[8];
+    std::int64_t first;
+    std::uint64_t count;
+};
+
+} // namespace
+
+/**
+ * Segment Constructor
+ *
+ * @param first First index
+ * @param last Last index (inclusive)
+ */
+Segment::Segment(value_t first, value_t last)
+  : first_(std::move(first))
+  , last_(std::move(last)) {}
+
+/**
+ * Segment Destructor
+ *
+ * Unmaps a mapped segment.
+ */
+Segment::~Segment() {
+    if (mapping_)
+        ::munmap(mapping_, mapping_size_);
+}
+
+/**
+ * capture
+ *
+ * Copies the cells once; attaching the segment afterwards copies nothing.
+ *
+ * @param from The interpreter, e.g. one that ran a setup program
+ * @param first First index
+ * @param last Last index (inclusive)
+ * @return std::shared_ptr<const Segment> The snapshot
+ */
+std::shared_ptr<const Segment> Segment::capture(const SUBARUU& from,
+                                                const value_t& first,
+                                                const value_t& last) {
+    std::shared_ptr<Segment> segment(new Segment(first, last));
+    for (value_t index = first; index <= last; ++index) {
+        auto value = from.peek(index);
+        if (value != 0)
+            segment->cells_.set(index, std::move(value));
+    }
+    return segment;
+}
+
+/**
+ * map
+ *
+ * @param path A file written by save()
+ * @return std::shared_ptr<const Segment> The segment, backed by the file
+ * @throws std::runtime_error if the file cannot be mapped or is not a
+ *         segment file
+ */
+std::shared_ptr<const Segment> Segment::map(std::string_view path) {
+    const std::string name(path);
+    const int fd = ::open(name.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        throw std::runtime_error("Failed to open segment: " + name);
+    struct stat info {};
+    void* mapping = MAP_FAILED;
+    if (::fstat(fd, &info) == 0 &&
+        static_cast<std::size_t>(info.st_size) >= sizeof(Header))
+        mapping = ::mmap(nullptr, static_cast<std::size_t>(info.st_size),
+                         PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED)
+        throw std::runtime_error("Failed to map segment: " + name);
+    const auto size = static_cast<std::size_t>(info.st_size);
+    Header header;
+    std::memcpy(&header, mapping, sizeof(Header));
+    if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 ||
+        header.count == 0 ||
+        header.count != (size - sizeof(Header)) / sizeof(std::int64_t) ||
+        size != sizeof(Header) + header.count * sizeof(std::int64_t)) {
+        ::munmap(mapping, size);
+        throw std::runtime_error("Not a segment file: " + name);
+    }
+    value_t last = header.first;
+    last += header.count - 1;
+    std::shared_ptr<Segment> segment(new Segment(header.first, last));
+    segment->mapping_ = mapping;
+    segment->mapping_size_ = size;
+    segment->mapped_ = static_cast<const unsigned char*>(mapping) +
+                       sizeof(Header);
+    return segment;
+}
+
+/**
+ * save
+ *
+ * Every cell is checked before anything is written. The file is written
+ * beside the target and renamed over it, so a process that has the old
+ * file mapped keeps its pages and never sees a partial segment.
+ *
+ * @param path The file to write
+ * @throws std::runtime_error if an index or cell does not fit in 64 bits or
+ *         the file cannot be written; the target is then left as it was
+ */
+void Segment::save(std::string_view path) const {
+    constexpr auto min = std::numeric_limits<std::int64_t>::min();
+    constexpr auto max = std::numeric_limits<std::int64_t>::max();
+    const std::string name(path);
+    if (first_ < min || last_ > max)
+        throw std::runtime_error("Segment indices exceed 64 bits: " + name);
+    for (value_t index = first_; index <= last_; ++index) {
+        const auto value = get(index);
+        if (value < min || value > max)
+            throw std::runtime_error("Segment cell m[" + index.str() +
+                                     "] exceeds 64 bits: " + name);
+    }
+    Header header{};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.first = static_cast<std::int64_t>(first_);
+    header.count = static_cast<std::uint64_t>(last_ - first_ + 1);
+    const std::string temporary = name + ".tmp";
+    {
+        std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        for (value_t index = first_; index <= last_; ++index) {
+            const auto cell = static_cast<std::int64_t>(get(index));
+            out.write(reinterpret_cast<const char*>(&cell), sizeof(cell));
+        }
+        out.close();
+        if (!out) {
+            std::remove(temporary.c_str());
+            throw std::runtime_error("Failed to write segment: " + name);
+        }
+    }
+    if (std::rename(temporary.c_str(), name.c_str()) != 0) {
+        std::remove(temporary.c_str());
+        throw std::runtime_error("Failed to replace segment: " + name);
+    }
+}
+
+/**
+ * get
+ *
+ * @param index An index within the segment
+ * @return value_t The cell's value
+ */
+Segment::value_t Segment::get(const value_t& index) const {
+    if (!mapped_)
+        return cells_.get(index);
+    const auto offset = static_cast<std::size_t>(index - first_);
+    std::int64_t cell;
+    std::memcpy(&cell, mapped_ + offset * sizeof(cell), sizeof(cell));
+    return cell;
+}
@@ -0,0 +1,140 @@
+// sorter.cc
+
+#include "../include/sorter.h"
+#include "../include/config.h"
+
+#include <algorithm>
+#include <array>
+#include <numeric>
+#include <thread>
+#include <utility>
+
+/******************************************************************************/
+
+namespace {
+
+constexpr std::uint64_t SIGN = std::uint64_t(1) << 63;
+
+using Histogram = std::array<std::size_t, 256>;
+
+// Runs body(t) for t in [0, threads), on the calling thread when alone
+template <typename Body>
+void parallel(unsigned threads, Body&& body) {
+    if (threads == 1) {
+        body(0u);
+        return;
+    }
+    std::vector<std::thread> workers;
+    workers.reserve(threads - 1);
+    for (unsigned t = 1; t < threads; ++t)
+        workers.emplace_back(body, t);
+    body(0u);
+    for (auto& worker : workers)
+        worker.join();
+}
+
+} // namespace
+
+/**
+ * radix
+ *
+ * Keys are biased so that unsigned byte order is signed order (and
+ * inverted for descending, which keeps equal keys in their original
+ * order). Each thread owns a contiguous chunk: it counts the chunk's
+ * digits, then scatters it to offsets that follow the chunks before it,
+ * so every pass stays stable.
+ *
+ * @param keys Keys to sort in place
+ * @param order Payload permuted with the keys, or nullptr
+ * @param descending Largest key first
+ * @param threads Most threads to use; 0 for the hardware concurrency
+ * @return void
+ */
+void Sorter::radix(std::vector<std::int64_t>& keys,
+                   Order* order,
+                   bool descending,
+                   unsigned threads) {
+    const std::size_t n = keys.size();
+    if (n < 2)
+        return;
+    if (threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    threads = static_cast<unsigned>(std::clamp<std::size_t>(
+      n / SUBARUU_SORT_PARALLEL, 1, threads));
+
+    const std::uint64_t flip = descending ? ~SIGN : SIGN;
+    std::vector<std::uint64_t> from(n);
+    std::vector<std::uint64_t> to(n);
+    for (std::size_t i = 0; i < n; ++i)
+        from[i] = static_cast<std::uint64_t>(keys[i]) ^ flip;
+    Order scratch(order ? n : 0);
+
+    const auto chunk = [n, threads](unsigned t) {
+        return std::pair<std::size_t, std::size_t>(n * t / threads,
+                                                   n * (t + 1) / threads);
+    };
+    std::vector<Histogram> counts(threads);
+    for (int shift = 0; shift < 64; shift += 8) {
+        parallel(threads, [&](unsigned t) {
+            auto& count = counts[t];
+            count.fill(0);
+            const auto [begin, end] = chunk(t);
+            for (std::size_t i = begin; i < end; ++i)
+                ++count[(from[i] >> shift) & 0xff];
+        });
+        // Offsets: by digit, then by thread
+        std::size_t offset = 0;
+        bool uniform = false;
+        for (std::size_t digit = 0; digit < 256; ++digit) {
+            std::size_t total = 0;
+            for (unsigned t = 0; t < threads; ++t) {
+                const auto count = counts[t][digit];
+                counts[t][digit] = offset + total;
+                total += count;
+            }
+            uniform = uniform || total == n;
+            offset += total;
+        }
+        if (uniform)
+            continue;
+        parallel(threads, [&](unsigned t) {
+            auto& next = counts[t];
+            const auto [begin, end] = chunk(t);
+            for (std::size_t i = begin; i < end; ++i) {
+                const auto at = next[(from[i] >> shift) & 0xff]++;
+                to[at] = from[i];
+                if (order)
+                    scratch[at] = (*order)[i];
+            }
+        });
+        from.swap(to);
+        if (order)
+            order->swap(scratch);
+    }
+    for (std::size_t i = 0; i < n; ++i)
+        keys[i] = static_cast<std::int64_t>(from[i] ^ flip);
+}
+
+/**
+ * compare
+ *
+ * @param values Values to sort
+ * @param descending Largest value first
+ * @return Order Indices into values, in sorted order (stable)
+ */
+Sorter::Order Sorter::compare(const std::vector<value_t>& values,
+                              bool descending) {
+    Order order(values.size());
+    std::iota(order.begin(), order.end(), 0u);
+    if (descending)
+        std::stable_sort(order.begin(), order.end(),
+                         [&values](std::uint32_t a, std::uint32_t b) {
+                             return values[b] < values[a];
+                         });
+    else
+        std::stable_sort(order.begin(), order.end(),
+                         [&values](std::uint32_t a, std::uint32_t b) {
+                             return values[a] < values[b];
+                         });
+    return order;
+}
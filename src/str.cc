@@ -0,0 +1,287 @@
+// str.cc
+
+#include "../include/str.h"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+/******************************************************************************/
+
+static_assert(SUBARUU_STRING_INLINE <= 255, "inline size is stored in a byte");
+
+// Leaves hold text; concatenation nodes hold two children and cache the
+// total size and AVL height (leaves have height 0).
+struct Str::Node {
+    std::string leaf;
+    NodePtr left;
+    NodePtr right;
+    std::size_t size;
+    int height;
+};
+
+namespace {
+
+template <typename NodePtr>
+int height(const NodePtr& node) {
+    return node ? node->height : -1;
+}
+
+} // namespace
+
+template <typename Visit>
+void Str::for_each_leaf(const Node& node, Visit&& visit) {
+    if (node.height == 0) {
+        visit(node.leaf);
+        return;
+    }
+    for_each_leaf(*node.left, visit);
+    for_each_leaf(*node.right, visit);
+}
+
+/**
+ * Str Constructor
+ *
+ * @param text The string contents; short strings are stored inline
+ */
+Str::Str(std::string_view text) {
+    if (text.size() <= SUBARUU_STRING_INLINE) {
+        size_ = static_cast<std::uint8_t>(text.size());
+        std::memcpy(inline_, text.data(), text.size());
+    } else {
+        node_ = make_leaf(std::string(text));
+    }
+}
+
+Str::Str(NodePtr node) noexcept
+  : node_(std::move(node)) {}
+
+/**
+ * concat
+ *
+ * Concatenates two strings. Results that fit inline are copied; longer ones
+ * share both operands' leaves, with small trailing pieces coalesced into the
+ * neighbouring leaf.
+ *
+ * @param left The leading string
+ * @param right The trailing string
+ * @return The concatenation
+ */
+Str Str::concat(const Str& left, const Str& right) {
+    if (right.empty())
+        return left;
+    if (left.empty())
+        return right;
+    const auto total = left.size() + right.size();
+    if (total <= SUBARUU_STRING_INLINE) {
+        Str result;
+        result.size_ = static_cast<std::uint8_t>(total);
+        std::memcpy(result.inline_, left.inline_, left.size_);
+        std::memcpy(result.inline_ + left.size_, right.inline_, right.size_);
+        return result;
+    }
+    return Str(join(left.to_node(), right.to_node()));
+}
+
+std::size_t Str::size() const noexcept {
+    return node_ ? node_->size : size_;
+}
+
+int Str::depth() const noexcept { return node_ ? node_->height : 0; }
+
+/**
+ * at
+ *
+ * @param i Position, less than size()
+ * @return The byte at position i
+ */
+char Str::at(std::size_t i) const noexcept {
+    if (!node_)
+        return inline_[i];
+    const Node* node = node_.get();
+    while (node->height > 0) {
+        if (i < node->left->size) {
+            node = node->left.get();
+        } else {
+            i -= node->left->size;
+            node = node->right.get();
+        }
+    }
+    return node->leaf[i];
+}
+
+/**
+ * substr
+ *
+ * Short results are copied inline; longer ones share the leaves they span.
+ *
+ * @param pos First byte
+ * @param count Maximum number of bytes
+ * @return The substring, empty if pos is past the end
+ */
+Str Str::substr(std::size_t pos, std::size_t count) const {
+    const auto length = size();
+    if (pos >= length)
+        return Str();
+    count = std::min(count, length - pos);
+    std::string_view view;
+    if (flat(view))
+        return Str(view.substr(pos, count));
+    if (count <= SUBARUU_STRING_INLINE) {
+        Str result;
+        result.size_ = static_cast<std::uint8_t>(count);
+        for (std::size_t i = 0; i < count; ++i)
+            result.inline_[i] = at(pos + i);
+        return result;
+    }
+    return Str(slice(node_, pos, count));
+}
+
+/**
+ * compare
+ *
+ * Byte-wise lexicographic comparison, as std::string::compare.
+ *
+ * @param other The string to compare with
+ * @return Negative, zero or positive
+ */
+int Str::compare(const Str& other) const {
+    std::string_view lhs, rhs;
+    if (flat(lhs) && other.flat(rhs))
+        return lhs.compare(rhs);
+    return str().compare(other.str());
+}
+
+/**
+ * str
+ *
+ * @return The contents as one contiguous string
+ */
+std::string Str::str() const {
+    std::string out;
+    out.reserve(size());
+    append_to(out);
+    return out;
+}
+
+/**
+ * append_to
+ *
+ * Appends the contents to out leaf by leaf, without flattening the rope.
+ *
+ * @param out The string to append to
+ * @return void
+ */
+void Str::append_to(std::string& out) const {
+    if (!node_) {
+        out.append(inline_, size_);
+        return;
+    }
+    for_each_leaf(*node_, [&out](const std::string& leaf) { out += leaf; });
+}
+
+std::ostream& operator<<(std::ostream& out, const Str& s) {
+    if (!s.node_) {
+        out.write(s.inline_, s.size_);
+        return out;
+    }
+    Str::for_each_leaf(*s.node_, [&out](const std::string& leaf) {
+        out.write(leaf.data(), static_cast<std::streamsize>(leaf.size()));
+    });
+    return out;
+}
+
+/******************************************************************************/
+
+// Inline strings and single leaves are contiguous
+bool Str::flat(std::string_view& view) const noexcept {
+    if (!node_) {
+        view = std::string_view(inline_, size_);
+        return true;
+    }
+    if (node_->height == 0) {
+        view = node_->leaf;
+        return true;
+    }
+    return false;
+}
+
+Str::NodePtr Str::to_node() const {
+    if (node_)
+        return node_;
+    if (size_ == 0)
+        return nullptr;
+    return make_leaf(std::string(inline_, size_));
+}
+
+Str::NodePtr Str::make_leaf(std::string text) {
+    const auto size = text.size();
+    return std::make_shared<const Node>(
+      Node{ std::move(text), nullptr, nullptr, size, 0 });
+}
+
+Str::NodePtr Str::make_node(NodePtr left, NodePtr right) {
+    const auto size = left->size + right->size;
+    const auto h = 1 + std::max(left->height, right->height);
+    return std::make_shared<const Node>(
+      Node{ {}, std::move(left), std::move(right), size, h });
+}
+
+// Builds a node from two balanced subtrees whose heights differ by at most
+// two, rotating once or twice if they differ by exactly two.
+Str::NodePtr Str::balance(NodePtr left, NodePtr right) {
+    if (height(left) > height(right) + 1) {
+        if (height(left->left) >= height(left->right))
+            return make_node(left->left, make_node(left->right, right));
+        const auto& inner = left->right;
+        return make_node(make_node(left->left, inner->left),
+                         make_node(inner->right, right));
+    }
+    if (height(right) > height(left) + 1) {
+        if (height(right->right) >= height(right->left))
+            return make_node(make_node(left, right->left), right->right);
+        const auto& inner = right->left;
+        return make_node(make_node(left, inner->left),
+                         make_node(inner->right, right->right));
+    }
+    return make_node(std::move(left), std::move(right));
+}
+
+// AVL join: descends the spine of the taller tree to a subtree of matching
+// height, so a join costs O(|height difference|) new nodes. A short leaf is
+// always pushed down to the neighbouring leaf, where the two are coalesced
+// while they fit in SUBARUU_ROPE_LEAF bytes; character-at-a-time appends
+// thus fill leaves instead of growing the tree by one node per append.
+Str::NodePtr Str::join(NodePtr left, NodePtr right) {
+    if (!left)
+        return right;
+    if (!right)
+        return left;
+    const int hl = left->height;
+    const int hr = right->height;
+    if (hl == 0 && hr == 0 && left->size + right->size <= SUBARUU_ROPE_LEAF)
+        return make_leaf(left->leaf + right->leaf);
+    if (hl > hr + 1 || (hl > 0 && hr == 0 && right->size < SUBARUU_ROPE_LEAF))
+        return balance(left->left, join(left->right, std::move(right)));
+    if (hr > hl + 1 || (hr > 0 && hl == 0 && left->size < SUBARUU_ROPE_LEAF))
+        return balance(join(std::move(left), right->left), right->right);
+    return make_node(std::move(left), std::move(right));
+}
+
+Str::NodePtr Str::slice(const NodePtr& node,
+                        std::size_t pos,
+                        std::size_t count) {
+    if (count == 0)
+        return nullptr;
+    if (pos == 0 && count == node->size)
+        return node;
+    if (node->height == 0)
+        return make_leaf(node->leaf.substr(pos, count));
+    const auto split = node->left->size;
+    if (pos + count <= split)
+        return slice(node->left, pos, count);
+    if (pos >= split)
+        return slice(node->right, pos - split, count);
+    return join(slice(node->left, pos, split - pos),
+                slice(node->right, 0, pos + count - split));
+}
@@ -3,36 +3,116 @@
 // subaruu.cc
 
 #include "../include/subaruu.h"
+#include "../include/bytecode.h"
 #include "../include/common.h"
+#include "../include/input.h"
+#include "../include/module.h"
+#include "../include/sorter.h"
+#include "../include/str.h"
 #include "../include/tokenizer.h"
+#include "../include/verifier.h"
+#include "../include/writer.h"
 
+#include <algorithm>
 #include <cctype>
+#include <chrono>
+#include <filesystem>
 #include <iostream>
+#include <iterator>
+#include <limits>
 #include <memory>
+#include <numeric>
 #include <stdexcept>
+#include <string>
 #include <string_view>
 #include <unordered_map>
+#include <utility>
 #include <variant>
+#include <vector>
+
+namespace {
+
+double elapsed_ms(std::chrono::steady_clock::time_point since) {
+    return std::chrono::duration<double, std::milli>(
+             std::chrono::steady_clock::now() - since)
+      .count();
+}
+
+} // namespace
 
 /**
  * Constructs a new SUBARUU object and initialize with the given source file.
+ * MERGE directives are expanded at load (see Module::link) and the program
+ * is verified.
  *
  * @param source The source code file.
- * @throws std::runtime_error if tokenizer initialization fails
+ * @throws std::runtime_error if tokenizer initialization, linking or
+ *         verification fails
  */
 SUBARUU::SUBARUU(std::string_view source)
-  : tokenizer_(std::make_unique<Tokenizer>(source))
+  : SUBARUU(source, Options{}) {}
+
+/**
+ * Constructs a new SUBARUU object with explicit options.
+ *
+ * @param source The source code file.
+ * @param options Load options
+ * @throws std::runtime_error if tokenizer initialization, linking or
+ *         (when enabled) verification fails
+ */
+SUBARUU::SUBARUU(std::string_view source, const Options& options)
+  : options_(options)
+  , verified_(false)
+  , source_(source)
+  , tokenizer_(load(source_))
   , execution_finished_(false) {
     if (!tokenizer_)
         throw std::runtime_error("Failed to initialize Tokenizer");
     variables_.fill(value_t(0));
+    const auto started = std::chrono::steady_clock::now();
+    build_line_map();
+    stats_.load_ms += elapsed_ms(started);
+    attach_metrics();
+}
+
+/**
+ * Copy constructor behind clone(). Runtime caches start empty; they are
+ * rebuilt on demand.
+ *
+ * @param other The interpreter to copy
+ * @param stream RND substream for the copy (number of generator jumps)
+ * @throws std::runtime_error if other has open output channels
+ */
+SUBARUU::SUBARUU(const SUBARUU& other, std::uint64_t stream)
+  : options_(other.options_)
+  , verified_(other.verified_)
+  , stats_(other.stats_)
+  , line_hits_(other.line_hits_)
+  , source_(other.source_)
+  , tokenizer_(other.tokenizer_->clone())
+  , variables_(other.variables_)
+  , memory_(other.memory_)
+  , segments_(other.segments_)
+  , string_variables_(other.string_variables_)
+  , string_memory_(other.string_memory_)
+  , tables_(other.tables_)
+  , program_(other.program_)
+  , high_water_(other.high_water_)
+  , rng_(other.rng_)
+  , execution_finished_(other.execution_finished_)
+  , metered_(other.metered_)
+  , published_(other.published_) {
+    if (!other.channels_.empty())
+        dprintf("Runtime Error: Cannot clone with open channels", E_ERROR);
+    rng_.jump(stream);
+    attach_metrics();
 }
 
 /**
- * Runs the SUBARUU interpreter.
+ * Runs the SUBARUU interpreter from the current position to the end.
  */
 void SUBARUU::run() {
-    build_line_map();
+    const auto started = std::chrono::steady_clock::now();
     while (!finished()) {
         if (tokenizer_->finished()) {
             execution_finished_ = true;
@@ -40,6 +120,191 @@ void SUBARUU::run() {
         }
         line_statement();
     }
+    close_channels();
+    stats_.run_ms += elapsed_ms(started);
+    if (counters_)
+        publish_metrics();
+}
+
+/**
+ * Runs the interpreter until the next line to execute is `line`, leaving
+ * it positioned at that line's number. Hitting `line` by falling through
+ * or by a branch both count.
+ *
+ * @param line The line number to stop at
+ * @return true if execution stopped at line, false if the program ended
+ */
+bool SUBARUU::run_until(int line) {
+    const auto started = std::chrono::steady_clock::now();
+    while (!finished()) {
+        while (tokenizer_->current_token() == Tokenizer::TokenType::EOL)
+            tokenizer_->next_token();
+        if (tokenizer_->finished()) {
+            execution_finished_ = true;
+            break;
+        }
+        if (tokenizer_->current_token() == Tokenizer::TokenType::NUMBER &&
+            tokenizer_->get_num() == line) {
+            stats_.run_ms += elapsed_ms(started);
+            if (counters_)
+                publish_metrics();
+            return true;
+        }
+        line_statement();
+    }
+    close_channels();
+    stats_.run_ms += elapsed_ms(started);
+    if (counters_)
+        publish_metrics();
+    return false;
+}
+
+/**
+ * Runs a slice of the program for hosts that interleave executions. The
+ * gate is consulted before each statement for output and by INPUT for
+ * input, so a pause always leaves the interpreter at a statement boundary.
+ *
+ * @param budget Most statements to execute
+ * @param gate Input available and output backlog, owned by the caller
+ * @return Pause FINISHED at the end of the program, else why it stopped
+ * @throws std::runtime_error on runtime errors
+ */
+SUBARUU::Pause SUBARUU::run_for(std::uint64_t budget, const Gate& gate) {
+    const auto started = std::chrono::steady_clock::now();
+    gate_ = &gate;
+    Pause pause = Pause::BUDGET;
+    try {
+        for (std::uint64_t n = 0;; ++n) {
+            if (!finished() && tokenizer_->finished())
+                execution_finished_ = true;
+            if (finished()) {
+                pause = Pause::FINISHED;
+                break;
+            }
+            if (n == budget)
+                break;
+            if (gate.output_pending &&
+                *gate.output_pending >= gate.output_limit) {
+                pause = Pause::OUTPUT;
+                break;
+            }
+            line_statement();
+            if (input_paused_) {
+                input_paused_ = false;
+                pause = Pause::INPUT;
+                break;
+            }
+        }
+    } catch (...) {
+        gate_ = nullptr;
+        throw;
+    }
+    gate_ = nullptr;
+    if (pause == Pause::FINISHED)
+        close_channels();
+    stats_.run_ms += elapsed_ms(started);
+    if (counters_)
+        publish_metrics();
+    return pause;
+}
+
+/**
+ * Clones the interpreter (see the SUBARUU copy constructor).
+ *
+ * @param stream RND substream for the clone; 0 repeats this generator
+ * @return std::unique_ptr<SUBARUU> The independent copy
+ * @throws std::runtime_error if output channels are open
+ */
+std::unique_ptr<SUBARUU> SUBARUU::clone(std::uint64_t stream) const {
+    return std::unique_ptr<SUBARUU>(new SUBARUU(*this, stream));
+}
+
+/**
+ * Reports load and run metrics and the settings the program ran with.
+ * Times accumulate over run() and run_until() calls; a clone starts with
+ * the metrics of its parent.
+ *
+ * @return Stats The metrics so far
+ */
+SUBARUU::Stats SUBARUU::stats() const {
+    Stats stats = stats_;
+    stats.memory_cells = memory_.size() + string_memory_.size();
+    for (const auto& table : tables_) {
+        if (!table)
+            continue;
+        const auto each = table->stats();
+        stats.tables.size += each.size;
+        stats.tables.capacity += each.capacity;
+        stats.tables.lookups += each.lookups;
+        stats.tables.probes += each.probes;
+        stats.tables.longest = std::max(stats.tables.longest, each.longest);
+    }
+    return stats;
+}
+
+/**
+ * Links a program and, if enabled, verifies it, reporting every problem
+ * found at once. The compact engine links the compiled form of its modules
+ * (see Module::compile) and does not keep the program text: only the code
+ * and the libraries cached for later loads stay in memory. The text engine
+ * links the source text and never compiles it. With a run history the
+ * engine is chosen from past runs of the same program (see
+ * Bytecode::fingerprint), which the default engine's load identifies; if
+ * the other engine is chosen, its own load is timed from the start. The
+ * history never stands in for verification, since anyone can edit its
+ * file.
+ *
+ * @param path The program file
+ * @return std::unique_ptr<Tokenizer> Tokenizer over the linked program
+ * @throws std::runtime_error if linking or verification fails
+ */
+std::unique_ptr<Tokenizer> SUBARUU::load(const std::string& path) {
+    auto started = std::chrono::steady_clock::now();
+    std::uint64_t hash = 0;
+    // Loads the program for an engine, and its fingerprint when asked
+    const auto read = [&path, &hash](bool compact, bool identify) {
+        if (compact) {
+            auto code = Module::compile(path);
+            if (identify)
+                hash = code->fingerprint();
+            return std::make_unique<Tokenizer>(std::move(code));
+        }
+        auto text = std::make_unique<Tokenizer>(
+          std::make_unique<IO>(path, Module::link(path)));
+        if (identify)
+            hash = Bytecode::fingerprint(*text->clone());
+        return text;
+    };
+    History::Choice choice{ options_.compact, "as configured" };
+    auto tokenizer = read(choice.compact, true);
+    if (options_.history) {
+        choice = options_.history->choose(hash, options_.compact);
+        if (choice.compact != options_.compact) {
+            tokenizer.reset();
+            started = std::chrono::steady_clock::now();
+            tokenizer = read(choice.compact, false);
+        }
+    }
+    verified_ = false;
+    if (options_.verify) {
+        Verifier verifier(tokenizer->clone());
+        if (!verifier.ok()) {
+            dprintf("Verification failed for " + path + ":\n" +
+                      verifier.report(),
+                    E_ERROR);
+        }
+        verified_ = true;
+    }
+    // Stats describe the constructor's program, not CHAINed ones; only the
+    // first load leaves a reason
+    if (stats_.engine_reason.empty()) {
+        stats_.source_hash = hash;
+        stats_.compact = choice.compact;
+        stats_.verified = verified_;
+        stats_.engine_reason = std::move(choice.reason);
+        stats_.load_ms = elapsed_ms(started);
+    }
+    return tokenizer;
 }
 
 /**
@@ -60,6 +325,100 @@ std::string SUBARUU::get_token_string(Tokenizer::TokenType token) const {
  */
 bool SUBARUU::finished() const { return execution_finished_; }
 
+/**
+ * Reads a cell of indexed memory; unset cells read as 0.
+ *
+ * @param index The memory index
+ * @return value_t The stored value
+ */
+SUBARUU::value_t SUBARUU::peek(const value_t& index) const {
+    return read_memory(index);
+}
+
+/**
+ * Writes a cell of indexed memory.
+ *
+ * @param index The memory index
+ * @param value The value to store
+ */
+void SUBARUU::poke(const value_t& index, value_t value) {
+    write_memory(index, std::move(value));
+}
+
+/**
+ * Copies a range of another interpreter's indexed memory. Only the cells
+ * it wrote or reads through an attached segment are visited; unset cells
+ * are left alone here rather than written as 0.
+ *
+ * @param from The interpreter to copy from; it is only read
+ * @param first The first index to copy
+ * @param last The last index to copy
+ * @param at Where m[first] goes
+ * @throws std::runtime_error if a cell lands in a read-only segment
+ */
+void SUBARUU::copy_memory(const SUBARUU& from,
+                          const value_t& first,
+                          const value_t& last,
+                          const value_t& at) {
+    const value_t shift = at - first;
+    from.memory_.for_each(first, last,
+                          [&](const value_t& index, const value_t& value) {
+                              write_memory(index + shift, value);
+                          });
+    // Segment cells show through where from wrote nothing itself, the
+    // first segment holding a cell winning as in read_memory
+    for (std::size_t i = 0; i < from.segments_.size(); ++i) {
+        const auto& segment = *from.segments_[i].segment;
+        const value_t low = std::max(first, segment.first());
+        const value_t high = std::min(last, segment.last());
+        for (value_t index = low; index <= high; ++index) {
+            if (from.memory_.find(index))
+                continue;
+            bool shadowed = false;
+            for (std::size_t j = 0; j < i && !shadowed; ++j)
+                shadowed = from.segments_[j].segment->contains(index);
+            if (!shadowed)
+                write_memory(index + shift, segment.get(index));
+        }
+    }
+}
+
+/**
+ * Reads a numeric variable.
+ *
+ * @param name The variable, 'a' to 'z'
+ * @return value_t Its value
+ * @throws std::out_of_range for any other name
+ */
+SUBARUU::value_t SUBARUU::variable(char name) const {
+    return variables_.at(static_cast<std::size_t>(name - 'a'));
+}
+
+/**
+ * Sets a numeric variable, e.g. to seed a run before it starts.
+ *
+ * @param name The variable, 'a' to 'z'
+ * @param value The value
+ * @throws std::out_of_range for any other name
+ */
+void SUBARUU::set_variable(char name, value_t value) {
+    const auto var = static_cast<std::size_t>(name - 'a');
+    variables_.at(var) = std::move(value);
+    wrote(var);
+}
+
+/**
+ * Attaches a shared memory segment. Later attachments are searched first
+ * where segments overlap.
+ *
+ * @param segment The segment
+ * @param access Whether writes into it fail or go to a private copy
+ */
+void SUBARUU::attach(std::shared_ptr<const Segment> segment,
+                     Segment::Access access) {
+    segments_.insert(segments_.begin(), Attached{ std::move(segment), access });
+}
+
 /**
  * Debug print function with error handling.
  * Prints message to stderr and throws for errors but not warnings.
@@ -118,120 +477,429 @@ SUBARUU::value_t SUBARUU::safe_divide(value_t numerator, value_t denominator) {
 }
 
 /**
- * Parses and evaluates a factor in the expression.
- * A factor can be:
+ * Evaluates the expression at the current token and moves past it.
+ * An expression is built from factors:
  * - A number
- * - A variable
+ * - A variable, or indexed memory m[expression]
  * - A parenthesized expression
+ * - A negated factor, -factor
+ * - RND(n), a random number in [0, n)
+ * - LEN(s$), the length of a string
+ * - ASC(s$), the code of the first character of a string
+ * - GET(t, key), the value under key in table t (0 if none)
+ * - HAS(t, key), 1 if table t holds key, else 0
+ * combined by * and / and then by + and -, all left-associative. Each
+ * expression is compiled to postfix code (see compile_expression). Code
+ * is cached by offset once execution comes back to an expression (it
+ * starts before the furthest expression run so far); straight-line code
+ * that runs once is compiled into a scratch buffer instead.
  *
- * @return int The evaluated value of the factor
+ * @return value_t The evaluated value
  * @throws std::runtime_error on syntax errors
  */
-SUBARUU::value_t SUBARUU::factor() {
-    value_t result = 0;
-    const auto token = tokenizer_->current_token();
-    switch (token) {
-        case Tokenizer::TokenType::NUMBER:
-            result = tokenizer_->get_num();
-            tokenizer_->next_token();
-            break;
-        case Tokenizer::TokenType::LETTER: {
-            char var_name =
-              static_cast<char>(std::tolower(static_cast<unsigned char>(
-                std::get<char>(tokenizer_->get_token_data()))));
-            tokenizer_->next_token();
-            if (tokenizer_->current_token() ==
-                Tokenizer::TokenType::LEFT_BRACKET) {
-                tokenizer_->next_token(); // skip '['
-                value_t idx = expression();
-                accept(Tokenizer::TokenType::RIGHT_BRACKET);
-                auto it = memory_.find(idx);
-                result = (it != memory_.end()) ? it->second : 0;
-            } else {
-                result = variables_[var_name - 'a'];
+SUBARUU::value_t SUBARUU::expression() {
+    const auto start = tokenizer_->offset();
+    if (start > high_water_) {
+        high_water_ = start;
+        compile_expression(scratch_);
+        // LEN/ASC arguments evaluate nested expressions, which would
+        // reuse the scratch buffer
+        if (!scratch_.seeks)
+            return evaluate(scratch_);
+        const Postfix& code = expressions_[start] = std::move(scratch_);
+        scratch_ = Postfix{};
+        value_t result = evaluate(code);
+        tokenizer_->seek(code.end);
+        return result;
+    }
+    auto [it, added] = expressions_.try_emplace(start);
+    if (added) {
+        try {
+            compile_expression(it->second);
+        } catch (const std::exception&) {
+            expressions_.erase(it);
+            throw;
+        }
+        if (!it->second.seeks)
+            return evaluate(it->second);
+    }
+    const Postfix& code = it->second;
+    value_t result = evaluate(code);
+    tokenizer_->seek(code.end);
+    return result;
+}
+
+/**
+ * Compiles the expression at the current token to postfix code by
+ * precedence climbing over an explicit stack of pending operators and open
+ * brackets, so nesting depth costs no native stack. The tokenizer is left
+ * after the expression. String arguments of LEN and ASC are not compiled;
+ * the code records where they start and evaluation parses them in place.
+ *
+ * @param code Receives the compiled expression (previous contents are
+ *        discarded, their storage reused)
+ * @throws std::runtime_error on syntax errors, with the messages of
+ *         factor-level parsing ("Unexpected token in factor") and accept()
+ */
+void SUBARUU::compile_expression(Postfix& code) {
+    using Code = Postfix::Code;
+    code.ops.clear();
+    code.constants.clear();
+    code.seeks = false;
+    auto& pending = pending_;
+    pending.clear();
+    auto reduce = [&](int precedence) {
+        while (!pending.empty() && pending.back().precedence >= precedence) {
+            code.ops.push_back({ pending.back().code, 0 });
+            pending.pop_back();
+        }
+    };
+    const auto none = Tokenizer::TokenType::EOL;
+    bool operand = true;
+    for (;;) {
+        const auto token = tokenizer_->current_token();
+        if (operand) {
+            switch (token) {
+                case Tokenizer::TokenType::NUMBER: {
+                    const auto& num = std::get<value_t>(
+                      tokenizer_->get_token_data());
+                    if (num <= std::numeric_limits<std::size_t>::max()) {
+                        code.ops.push_back(
+                          { Code::PUSH_INT, static_cast<std::size_t>(num) });
+                    } else {
+                        code.ops.push_back({ Code::PUSH_CONST,
+                                             code.constants.size() });
+                        code.constants.push_back(num);
+                    }
+                    tokenizer_->next_token();
+                    operand = false;
+                    break;
+                }
+                case Tokenizer::TokenType::LETTER: {
+                    const auto var = static_cast<std::size_t>(
+                      tokenizer_->variable_num());
+                    tokenizer_->next_token();
+                    if (tokenizer_->current_token() ==
+                        Tokenizer::TokenType::LEFT_BRACKET) {
+                        tokenizer_->next_token();
+                        const std::size_t site =
+                          index_site(&code == &scratch_);
+                        if (site != NO_SITE) {
+                            accept(Tokenizer::TokenType::RIGHT_BRACKET);
+                            code.ops.push_back({ Code::LOAD_SITE, site });
+                            operand = false;
+                            break;
+                        }
+                        pending.push_back({ Code::LOAD_MEM,
+                                            0,
+                                            Tokenizer::TokenType::RIGHT_BRACKET,
+                                            true });
+                    } else {
+                        code.ops.push_back({ Code::PUSH_VAR, var });
+                        operand = false;
+                    }
+                    break;
+                }
+                case Tokenizer::TokenType::LEFT_PAREN:
+                    tokenizer_->next_token();
+                    pending.push_back({ Code::NEG,
+                                        0,
+                                        Tokenizer::TokenType::RIGHT_PAREN,
+                                        false });
+                    break;
+                case Tokenizer::TokenType::MINUS:
+                    tokenizer_->next_token();
+                    pending.push_back({ Code::NEG, 3, none, true });
+                    break;
+                case Tokenizer::TokenType::RND:
+                    tokenizer_->next_token();
+                    accept(Tokenizer::TokenType::LEFT_PAREN);
+                    pending.push_back({ Code::RND,
+                                        0,
+                                        Tokenizer::TokenType::RIGHT_PAREN,
+                                        true });
+                    break;
+                case Tokenizer::TokenType::LEN:
+                case Tokenizer::TokenType::ASC:
+                    tokenizer_->next_token();
+                    accept(Tokenizer::TokenType::LEFT_PAREN);
+                    code.ops.push_back(
+                      { token == Tokenizer::TokenType::LEN ? Code::LEN
+                                                           : Code::ASC,
+                        tokenizer_->offset() });
+                    code.seeks = true;
+                    skip_string_argument();
+                    operand = false;
+                    break;
+                case Tokenizer::TokenType::GET:
+                case Tokenizer::TokenType::HAS:
+                    tokenizer_->next_token();
+                    accept(Tokenizer::TokenType::LEFT_PAREN);
+                    code.ops.push_back(
+                      { token == Tokenizer::TokenType::GET ? Code::GET
+                                                           : Code::HAS,
+                        tokenizer_->offset() });
+                    code.seeks = true;
+                    skip_string_argument();
+                    operand = false;
+                    break;
+                default:
+                    dprintf("Syntax Error: Unexpected token in factor: " +
+                              std::string(tokenizer_->token_to_string(token)),
+                            E_ERROR);
             }
-            break;
+            continue;
+        }
+        Code op = Code::ADD;
+        int precedence = 0;
+        switch (token) {
+            case Tokenizer::TokenType::PLUS:
+                precedence = 1;
+                break;
+            case Tokenizer::TokenType::MINUS:
+                op = Code::SUB;
+                precedence = 1;
+                break;
+            case Tokenizer::TokenType::ASTERISK:
+                op = Code::MUL;
+                precedence = 2;
+                break;
+            case Tokenizer::TokenType::SLASH:
+                op = Code::DIV;
+                precedence = 2;
+                break;
+            default:
+                break;
         }
-        case Tokenizer::TokenType::LEFT_PAREN:
+        if (precedence > 0) {
+            reduce(precedence);
+            pending.push_back({ op, precedence, none, true });
             tokenizer_->next_token();
-            result = expression();
-            accept(Tokenizer::TokenType::RIGHT_PAREN);
+            operand = true;
+            continue;
+        }
+        reduce(1);
+        if (pending.empty())
             break;
-        case Tokenizer::TokenType::MINUS: {
+        // The innermost open bracket has to close here
+        const PendingOp group = pending.back();
+        pending.pop_back();
+        accept(group.closer);
+        if (group.emits)
+            code.ops.push_back({ group.code, 0 });
+    }
+    code.end = tokenizer_->offset();
+    // A product of variables and constants may be memoized (let_value);
+    // not a quotient, whose division by zero must warn every time
+    code.inputs.clear();
+    code.memoized = false;
+    bool multiplies = false;
+    code.pure = std::all_of(
+      code.ops.begin(), code.ops.end(), [&](const Postfix::Op& op) {
+          switch (op.code) {
+              case Code::PUSH_VAR:
+                  if (std::find(code.inputs.begin(), code.inputs.end(),
+                                op.arg) == code.inputs.end())
+                      code.inputs.push_back(op.arg);
+                  return true;
+              case Code::MUL:
+                  multiplies = true;
+                  return true;
+              case Code::PUSH_INT:
+              case Code::PUSH_CONST:
+              case Code::NEG:
+              case Code::ADD:
+              case Code::SUB:
+                  return true;
+              default:
+                  return false;
+          }
+      });
+    code.pure = code.pure && multiplies;
+}
+
+/**
+ * Moves from the start of a LEN/ASC argument past its closing parenthesis,
+ * stopping at the end of the line if there is none (evaluating the
+ * argument then reports the error).
+ */
+void SUBARUU::skip_string_argument() {
+    int depth = 0;
+    for (;; tokenizer_->next_token()) {
+        const auto token = tokenizer_->current_token();
+        if (is_statement_end(token))
+            return;
+        if (token == Tokenizer::TokenType::LEFT_PAREN) {
+            ++depth;
+        } else if (token == Tokenizer::TokenType::RIGHT_PAREN &&
+                   depth-- == 0) {
             tokenizer_->next_token();
-            result = -factor();
-            break;
+            return;
         }
-        default:
-            dprintf("Syntax Error: Unexpected token in factor: " +
-                      std::string(tokenizer_->token_to_string(token)),
-                    E_ERROR);
     }
-    return result;
 }
 
 /**
- * Parses and evaluates a term in the expression.
- * A term consists of factors connected by * or / operators.
+ * Parses the table and key of SET, DEL, GET or HAS.
+ * Format: t, key
+ * where t is a letter naming one of the tables and key a numeric or string
+ * expression.
  *
- * @return int The evaluated term value
+ * @param visit Called with the table and the key
+ * @return What visit returns
+ * @throws std::runtime_error on syntax errors
  */
-SUBARUU::value_t SUBARUU::term() {
-    value_t result = factor();
-    auto token = tokenizer_->current_token();
-    while (token == Tokenizer::TokenType::ASTERISK ||
-           token == Tokenizer::TokenType::SLASH) {
-        auto op = token;
-        tokenizer_->next_token();
-        value_t rhs = factor();
-        if (op == Tokenizer::TokenType::ASTERISK)
-            result *= rhs;
-        else
-            result = safe_divide(result, rhs);
-        token = tokenizer_->current_token();
+template <typename Visit>
+decltype(auto) SUBARUU::table_access(Visit&& visit) {
+    if (tokenizer_->current_token() != Tokenizer::TokenType::LETTER)
+        dprintf("Syntax Error: Expected table name", E_ERROR);
+    auto& table = tables_[tokenizer_->variable_num()];
+    tokenizer_->next_token();
+    accept(Tokenizer::TokenType::SEPARATOR);
+    if (is_string_start(tokenizer_->current_token())) {
+        // Local: the rest of the statement may look up other string keys
+        std::string key;
+        string_expression().append_to(key);
+        return visit(table, std::string_view(key));
     }
-    return result;
+    return visit(table, expression());
 }
 
 /**
- * Parses and evaluates a complete expression.
- * An expression consists of terms connected by + or - operators.
- * Also handles special case of line numbers.
+ * Gives SET or DEL a table of its own to change: creates the table on its
+ * first write and copies one still shared with a parent or clone, so a
+ * clone costs nothing per table until it writes there.
  *
- * @return int The evaluated expression value
+ * @param table The slot in tables_
+ * @return HashTable& The table, owned by this interpreter alone
  */
-SUBARUU::value_t SUBARUU::expression() {
-    value_t result = term();
-    auto token = tokenizer_->current_token();
-    // Special stop if the next token is a valid line-number; leave it for the
-    // caller.
-    if (token == Tokenizer::TokenType::NUMBER &&
-        is_valid_line_number(tokenizer_->get_num())) {
-        return result;
-    }
-    while (token == Tokenizer::TokenType::PLUS ||
-           token == Tokenizer::TokenType::MINUS) {
-        auto op = token;
-        tokenizer_->next_token();
-        value_t rhs = term();
-        if (op == Tokenizer::TokenType::PLUS)
-            result += rhs;
-        else
-            result -= rhs;
-        token = tokenizer_->current_token();
+HashTable& SUBARUU::writable(std::shared_ptr<HashTable>& table) {
+    if (!table)
+        table = std::make_shared<HashTable>();
+    else if (table.use_count() > 1)
+        table = std::make_shared<HashTable>(*table);
+    return *table;
+}
+
+/**
+ * Runs postfix code on the operand stack. Operands are evaluated left to
+ * right as in the source, so RND draws and warnings happen in source order.
+ * Nested evaluations (from LEN/ASC arguments) share the stack above the
+ * current top.
+ *
+ * @param code The compiled expression
+ * @return value_t The value left on the stack
+ * @throws std::runtime_error on runtime errors
+ */
+SUBARUU::value_t SUBARUU::evaluate(const Postfix& code) {
+    using Code = Postfix::Code;
+    for (const auto& op : code.ops) {
+        switch (op.code) {
+            case Code::PUSH_INT:
+                operands_.emplace_back(op.arg);
+                break;
+            case Code::PUSH_CONST:
+                operands_.push_back(code.constants[op.arg]);
+                break;
+            case Code::PUSH_VAR:
+                operands_.push_back(variables_[op.arg]);
+                break;
+            case Code::LOAD_MEM:
+                operands_.back() = read_memory(operands_.back());
+                break;
+            case Code::LOAD_SITE:
+                operands_.push_back(load_site(sites_[op.arg]));
+                break;
+            case Code::NEG:
+                operands_.back() = -operands_.back();
+                break;
+            case Code::RND:
+                operands_.back() = random_below(operands_.back());
+                break;
+            case Code::LEN:
+            case Code::ASC: {
+                tokenizer_->seek(op.arg);
+                Str text = string_expression();
+                accept(Tokenizer::TokenType::RIGHT_PAREN);
+                if (op.code == Code::LEN) {
+                    operands_.emplace_back(text.size());
+                    break;
+                }
+                if (text.empty())
+                    dprintf("Runtime Error: ASC of an empty string", E_ERROR);
+                operands_.emplace_back(static_cast<unsigned char>(text.at(0)));
+                break;
+            }
+            case Code::GET:
+            case Code::HAS: {
+                tokenizer_->seek(op.arg);
+                const value_t* found =
+                  table_access([](const std::shared_ptr<HashTable>& table,
+                                  const auto& key) -> const value_t* {
+                      return table ? table->find(key) : nullptr;
+                  });
+                accept(Tokenizer::TokenType::RIGHT_PAREN);
+                if (op.code == Code::HAS)
+                    operands_.emplace_back(found ? 1 : 0);
+                else if (found)
+                    operands_.push_back(*found);
+                else
+                    operands_.emplace_back(0);
+                break;
+            }
+            default: {
+                value_t rhs = std::move(operands_.back());
+                operands_.pop_back();
+                value_t& lhs = operands_.back();
+                if (op.code == Code::ADD)
+                    lhs += rhs;
+                else if (op.code == Code::SUB)
+                    lhs -= rhs;
+                else if (op.code == Code::MUL)
+                    lhs *= rhs;
+                else
+                    lhs = safe_divide(std::move(lhs), std::move(rhs));
+            }
+        }
     }
+    value_t result = std::move(operands_.back());
+    operands_.pop_back();
     return result;
 }
 
 /**
  * Parses and evaluates a relation (comparison expression).
  * Returns 1 for true conditions, 0 for false.
- * Non-zero values in simple expressions are treated as true.
+ * Non-zero values in simple expressions are treated as true. Strings are
+ * compared byte-wise and must always be compared.
  *
  * @return int 1 for true, 0 for false
  * @throws std::runtime_error on invalid comparison operator
  */
 int SUBARUU::relation() {
+    if (is_string_start(tokenizer_->current_token())) {
+        Str left = string_expression();
+        auto token = tokenizer_->current_token();
+        tokenizer_->next_token();
+        switch (token) {
+            case Tokenizer::TokenType::EQUAL:
+                return left.compare(string_expression()) == 0;
+            case Tokenizer::TokenType::LT:
+                return left.compare(string_expression()) < 0;
+            case Tokenizer::TokenType::GT:
+                return left.compare(string_expression()) > 0;
+            case Tokenizer::TokenType::LT_EQ:
+                return left.compare(string_expression()) <= 0;
+            case Tokenizer::TokenType::GT_EQ:
+                return left.compare(string_expression()) >= 0;
+            case Tokenizer::TokenType::NOT_EQUAL:
+                return left.compare(string_expression()) != 0;
+            default:
+                dprintf("Syntax Error: Expected comparison after string",
+                        E_ERROR);
+                return 0;
+        }
+    }
     value_t left = expression();
     auto token = tokenizer_->current_token();
     switch (token) {
@@ -259,194 +927,1479 @@ int SUBARUU::relation() {
 }
 
 /**
- * Executes a LET statement.
- * Format: LET variable = expression
- *
- * @throws std::runtime_error on syntax errors
+ * Checks if a token starts a string expression
  */
-void SUBARUU::let_statement() {
-    if (tokenizer_->current_token() != Tokenizer::TokenType::LETTER) {
-        dprintf("Syntax Error: Expected variable name", E_ERROR);
-        return;
+bool SUBARUU::is_string_start(Tokenizer::TokenType token) const {
+    switch (token) {
+        case Tokenizer::TokenType::STRING:
+        case Tokenizer::TokenType::STRING_VAR:
+        case Tokenizer::TokenType::MID_DOLLAR:
+        case Tokenizer::TokenType::LEFT_DOLLAR:
+        case Tokenizer::TokenType::RIGHT_DOLLAR:
+        case Tokenizer::TokenType::CHR_DOLLAR:
+        case Tokenizer::TokenType::STR_DOLLAR:
+            return true;
+        default:
+            return false;
     }
-    char var_name = static_cast<char>(std::tolower(static_cast<unsigned char>(
-      std::get<char>(tokenizer_->get_token_data()))));
-    tokenizer_->next_token();
-    bool indexed = false;
-    value_t idx = 0;
-    if (tokenizer_->current_token() == Tokenizer::TokenType::LEFT_BRACKET) {
-        indexed = true;
+}
+
+/**
+ * Parses and evaluates a string expression.
+ * A string expression consists of string factors joined by +.
+ *
+ * @return Str The concatenated string
+ */
+Str SUBARUU::string_expression() {
+    Str result = string_factor();
+    while (tokenizer_->current_token() == Tokenizer::TokenType::PLUS) {
         tokenizer_->next_token();
-        idx = expression();
-        accept(Tokenizer::TokenType::RIGHT_BRACKET);
+        result = Str::concat(result, string_factor());
     }
-    accept(Tokenizer::TokenType::EQUAL);
-    value_t value = expression();
-    if (indexed)
-        memory_[idx] = value;
-    else
-        variables_[var_name - 'a'] = value;
+    return result;
 }
 
 /**
- * Executes an IF statement.
- * Format: IF condition THEN line_number
+ * Parses and evaluates a string factor.
+ * A string factor can be:
+ * - A string literal
+ * - A string variable a$ or indexed string a$[i]
+ * - MID$(s$, start [, n]), n characters from 1-based position start
+ * - LEFT$(s$, n) or RIGHT$(s$, n)
+ * - CHR$(n), the one-character string with code n
+ * - STR$(n), the decimal text of n
  *
- * @throws std::runtime_error on syntax errors
+ * @return Str The evaluated string
+ * @throws std::runtime_error on syntax errors or invalid arguments
  */
-void SUBARUU::if_statement() {
-    accept(Tokenizer::TokenType::IF);
-    int cond = relation();
-    accept(Tokenizer::TokenType::THEN);
-    if (tokenizer_->current_token() != Tokenizer::TokenType::NUMBER) {
-        dprintf("Syntax Error: Expected line number after THEN", E_ERROR);
-        return;
-    }
-    int line_number = static_cast<int>(tokenizer_->get_num());
-    tokenizer_->next_token();
-    if (cond) {
-        if (line_positions_.find(line_number) == line_positions_.end()) {
-            dprintf("Runtime Error: Line number " +
-                      std::to_string(line_number) + " not found",
-                    E_ERROR);
-            return;
+Str SUBARUU::string_factor() {
+    const auto token = tokenizer_->current_token();
+    switch (token) {
+        case Tokenizer::TokenType::STRING:
+            return string_literal();
+        case Tokenizer::TokenType::STRING_VAR: {
+            const int var = tokenizer_->variable_num();
+            tokenizer_->next_token();
+            if (tokenizer_->current_token() !=
+                Tokenizer::TokenType::LEFT_BRACKET)
+                return string_variables_[var];
+            tokenizer_->next_token();
+            value_t idx = expression();
+            accept(Tokenizer::TokenType::RIGHT_BRACKET);
+            return string_memory_.get(idx);
         }
-        tokenizer_->reset();
-        if (!find_target_line(line_number)) {
-            dprintf("Internal Error: Failed to find valid line number " +
-                      std::to_string(line_number),
-                    E_ERROR);
+        case Tokenizer::TokenType::MID_DOLLAR: {
+            tokenizer_->next_token();
+            accept(Tokenizer::TokenType::LEFT_PAREN);
+            Str text = string_expression();
+            accept(Tokenizer::TokenType::SEPARATOR);
+            value_t start = expression();
+            std::size_t count = std::numeric_limits<std::size_t>::max();
+            if (tokenizer_->current_token() ==
+                Tokenizer::TokenType::SEPARATOR) {
+                tokenizer_->next_token();
+                count = string_count(expression(), "MID$");
+            }
+            accept(Tokenizer::TokenType::RIGHT_PAREN);
+            if (start < 1)
+                dprintf("Runtime Error: MID$ start must be at least 1",
+                        E_ERROR);
+            if (start > text.size())
+                return Str();
+            return text.substr(static_cast<std::size_t>(start) - 1, count);
         }
-    } else {
-        if (tokenizer_->current_token() == Tokenizer::TokenType::EOL)
+        case Tokenizer::TokenType::LEFT_DOLLAR:
+        case Tokenizer::TokenType::RIGHT_DOLLAR: {
+            const bool left = token == Tokenizer::TokenType::LEFT_DOLLAR;
+            tokenizer_->next_token();
+            accept(Tokenizer::TokenType::LEFT_PAREN);
+            Str text = string_expression();
+            accept(Tokenizer::TokenType::SEPARATOR);
+            auto count =
+              std::min(string_count(expression(), left ? "LEFT$" : "RIGHT$"),
+                       text.size());
+            accept(Tokenizer::TokenType::RIGHT_PAREN);
+            return text.substr(left ? 0 : text.size() - count, count);
+        }
+        case Tokenizer::TokenType::CHR_DOLLAR: {
+            tokenizer_->next_token();
+            accept(Tokenizer::TokenType::LEFT_PAREN);
+            value_t code = expression();
+            accept(Tokenizer::TokenType::RIGHT_PAREN);
+            if (code < 0 || code > 255)
+                dprintf("Runtime Error: CHR$ code must be between 0 and 255",
+                        E_ERROR);
+            const char c = static_cast<char>(static_cast<int>(code));
+            return Str(std::string_view(&c, 1));
+        }
+        case Tokenizer::TokenType::STR_DOLLAR: {
             tokenizer_->next_token();
+            accept(Tokenizer::TokenType::LEFT_PAREN);
+            value_t n = expression();
+            accept(Tokenizer::TokenType::RIGHT_PAREN);
+            return Str(n.str());
+        }
+        default:
+            dprintf("Syntax Error: Expected string expression, got " +
+                      std::string(tokenizer_->token_to_string(token)),
+                    E_ERROR);
+            return Str();
     }
 }
 
 /**
- * Executes a GOTO statement.
- * Format: GOTO line_number
+ * Returns the current string literal, shared with every other occurrence of
+ * the same text (see build_line_map), and moves past it.
+ *
+ * @return Str The literal
+ */
+Str SUBARUU::string_literal() {
+    auto it = program_->literals.find(tokenizer_->offset());
+    Str result = it != program_->literals.end() ? it->second
+                                       : Str(tokenizer_->get_string());
+    tokenizer_->next_token();
+    return result;
+}
+
+/**
+ * Converts a character count argument, clamping counts beyond any string.
+ *
+ * @param n The count
+ * @param fn Function name for the error message
+ * @return std::size_t The count
+ * @throws std::runtime_error if n is negative
+ */
+std::size_t SUBARUU::string_count(const value_t& n, std::string_view fn) {
+    if (n < 0) {
+        dprintf("Runtime Error: " + std::string(fn) +
+                  " count must not be negative",
+                E_ERROR);
+    }
+    if (n >= std::numeric_limits<std::size_t>::max())
+        return std::numeric_limits<std::size_t>::max();
+    return static_cast<std::size_t>(n);
+}
+
+/**
+ * Parses and evaluates a condition.
+ * Format: and_condition [OR and_condition]...
+ * Once an operand is true the remaining ones are skipped unevaluated.
+ *
+ * @return int 1 for true, 0 for false
+ */
+int SUBARUU::condition() {
+    int result = and_condition();
+    while (tokenizer_->current_token() == Tokenizer::TokenType::OR) {
+        tokenizer_->next_token();
+        if (result)
+            skip_operand(false);
+        else
+            result = and_condition();
+    }
+    return result;
+}
+
+/**
+ * Parses and evaluates a conjunction.
+ * Format: not_condition [AND not_condition]...
+ * Once an operand is false the remaining ones are skipped unevaluated.
+ *
+ * @return int 1 for true, 0 for false
+ */
+int SUBARUU::and_condition() {
+    int result = not_condition();
+    while (tokenizer_->current_token() == Tokenizer::TokenType::AND) {
+        tokenizer_->next_token();
+        if (!result)
+            skip_operand(true);
+        else
+            result = not_condition();
+    }
+    return result;
+}
+
+/**
+ * Parses and evaluates a negation, relation or parenthesized condition.
+ * Format: NOT not_condition | ( condition ) | relation
+ * Comparisons bind tighter than NOT, so NOT a = b is NOT (a = b).
+ *
+ * @return int 1 for true, 0 for false
+ */
+int SUBARUU::not_condition() {
+    if (tokenizer_->current_token() == Tokenizer::TokenType::NOT) {
+        tokenizer_->next_token();
+        return !not_condition();
+    }
+    if (tokenizer_->current_token() == Tokenizer::TokenType::LEFT_PAREN &&
+        is_condition_group()) {
+        tokenizer_->next_token();
+        int result = condition();
+        accept(Tokenizer::TokenType::RIGHT_PAREN);
+        return result;
+    }
+    return relation();
+}
+
+/**
+ * Moves past an operand of AND (stop_at_and) or OR without evaluating it:
+ * up to the next AND/OR at the same nesting level or the end of the
+ * condition. The end is cached per operand, so later skips are one seek.
+ *
+ * @param stop_at_and True when skipping an AND operand
+ */
+void SUBARUU::skip_operand(bool stop_at_and) {
+    const auto key = tokenizer_->offset() * 2 + (stop_at_and ? 1 : 0);
+    auto it = skip_targets_.find(key);
+    if (it != skip_targets_.end()) {
+        tokenizer_->seek(it->second);
+        return;
+    }
+    int depth = 0;
+    for (;;) {
+        const auto token = tokenizer_->current_token();
+        if (is_statement_end(token) || token == Tokenizer::TokenType::THEN)
+            break;
+        if (token == Tokenizer::TokenType::LEFT_PAREN ||
+            token == Tokenizer::TokenType::LEFT_BRACKET) {
+            ++depth;
+        } else if (token == Tokenizer::TokenType::RIGHT_PAREN ||
+                   token == Tokenizer::TokenType::RIGHT_BRACKET) {
+            if (depth == 0)
+                break;
+            --depth;
+        } else if (depth == 0 &&
+                   (token == Tokenizer::TokenType::OR ||
+                    (stop_at_and && token == Tokenizer::TokenType::AND))) {
+            break;
+        }
+        tokenizer_->next_token();
+    }
+    skip_targets_.emplace(key, tokenizer_->offset());
+}
+
+/**
+ * Decides whether the '(' at the current token opens a parenthesized
+ * condition, e.g. (a < 1 OR b), rather than a numeric subexpression, e.g.
+ * (a + 1) < 2: it does if a comparison or logical operator appears directly
+ * inside it. The answer is cached per offset.
+ *
+ * @return bool True for a parenthesized condition
+ */
+bool SUBARUU::is_condition_group() {
+    const auto start = tokenizer_->offset();
+    auto cached = condition_groups_.find(start);
+    if (cached != condition_groups_.end())
+        return cached->second;
+    bool group = false;
+    int depth = 0;
+    while (!is_statement_end(tokenizer_->current_token())) {
+        const auto token = tokenizer_->current_token();
+        if (token == Tokenizer::TokenType::LEFT_PAREN ||
+            token == Tokenizer::TokenType::LEFT_BRACKET) {
+            ++depth;
+        } else if (token == Tokenizer::TokenType::RIGHT_PAREN ||
+                   token == Tokenizer::TokenType::RIGHT_BRACKET) {
+            if (--depth == 0)
+                break;
+        } else if (depth == 1) {
+            switch (token) {
+                case Tokenizer::TokenType::EQUAL:
+                case Tokenizer::TokenType::LT:
+                case Tokenizer::TokenType::GT:
+                case Tokenizer::TokenType::LT_EQ:
+                case Tokenizer::TokenType::GT_EQ:
+                case Tokenizer::TokenType::NOT_EQUAL:
+                case Tokenizer::TokenType::AND:
+                case Tokenizer::TokenType::OR:
+                case Tokenizer::TokenType::NOT:
+                    group = true;
+                    break;
+                default:
+                    break;
+            }
+            if (group)
+                break;
+        }
+        tokenizer_->next_token();
+    }
+    tokenizer_->seek(start);
+    condition_groups_.emplace(start, group);
+    return group;
+}
+
+/**
+ * Executes a LET statement.
+ * Format: LET variable = expression
+ *
+ * @throws std::runtime_error on syntax errors
+ */
+void SUBARUU::let_statement() {
+    if (tokenizer_->current_token() == Tokenizer::TokenType::STRING_VAR) {
+        let_string_statement();
+        return;
+    }
+    if (tokenizer_->current_token() != Tokenizer::TokenType::LETTER) {
+        dprintf("Syntax Error: Expected variable name", E_ERROR);
+        return;
+    }
+    char var_name = static_cast<char>(std::tolower(static_cast<unsigned char>(
+      std::get<char>(tokenizer_->get_token_data()))));
+    tokenizer_->next_token();
+    bool indexed = false;
+    std::size_t site = NO_SITE;
+    value_t idx = 0;
+    if (tokenizer_->current_token() == Tokenizer::TokenType::LEFT_BRACKET) {
+        indexed = true;
+        tokenizer_->next_token();
+        site = index_site(tokenizer_->offset() > high_water_);
+        if (site == NO_SITE)
+            idx = expression();
+        accept(Tokenizer::TokenType::RIGHT_BRACKET);
+    }
+    accept(Tokenizer::TokenType::EQUAL);
+    value_t value = indexed ? expression() : let_value();
+    count_bignum(value);
+    if (site != NO_SITE) {
+        store_site(sites_[site], std::move(value));
+    } else if (indexed) {
+        poke(idx, std::move(value));
+    } else {
+        variables_[var_name - 'a'] = std::move(value);
+        wrote(static_cast<std::size_t>(var_name - 'a'));
+    }
+}
+
+/**
+ * Evaluates the value of a LET to a variable. A product of variables and
+ * constants that runs again with none of its variables written since it
+ * last ran gives the same value, which is kept once the operands are
+ * large enough (SUBARUU_MEMO_LIMBS) for reuse to beat recomputing.
+ *
+ * @return value_t The evaluated value
+ * @throws std::runtime_error on syntax errors
+ */
+SUBARUU::value_t SUBARUU::let_value() {
+    const auto start = tokenizer_->offset();
+    const auto it = start > high_water_ ? expressions_.end()
+                                        : expressions_.find(start);
+    if (it == expressions_.end() || !it->second.pure)
+        return expression();
+    Postfix& code = it->second;
+    if (code.memoized) {
+        ++stats_.memo_lookups;
+        const bool unchanged = std::all_of(
+          code.inputs.begin(), code.inputs.end(), [&](std::size_t var) {
+              return versions_[var] <= code.stamp;
+          });
+        if (unchanged) {
+            ++stats_.memo_hits;
+            tokenizer_->seek(code.end);
+            return code.memo;
+        }
+    }
+    value_t result = evaluate(code);
+    tokenizer_->seek(code.end);
+    std::size_t limbs = result.backend().size();
+    for (const auto var : code.inputs)
+        limbs = std::max<std::size_t>(limbs, variables_[var].backend().size());
+    code.memoized = limbs >= SUBARUU_MEMO_LIMBS;
+    if (code.memoized) {
+        code.memo = result;
+        code.stamp = clock_;
+    }
+    return result;
+}
+
+/**
+ * Executes a string LET statement.
+ * Format: LET a$ = string_expression
+ *         LET a$[index] = string_expression
+ * Like m[...], indexed strings share one memory whatever the letter.
+ *
+ * @throws std::runtime_error on syntax errors
+ */
+void SUBARUU::let_string_statement() {
+    const int var = tokenizer_->variable_num();
+    tokenizer_->next_token();
+    bool indexed = false;
+    value_t idx = 0;
+    if (tokenizer_->current_token() == Tokenizer::TokenType::LEFT_BRACKET) {
+        indexed = true;
+        tokenizer_->next_token();
+        idx = expression();
+        accept(Tokenizer::TokenType::RIGHT_BRACKET);
+    }
+    accept(Tokenizer::TokenType::EQUAL);
+    Str value = string_expression();
+    if (indexed)
+        string_memory_.set(idx, std::move(value));
+    else
+        string_variables_[var] = std::move(value);
+}
+
+/**
+ * Executes an IF statement.
+ * Format: IF condition THEN line_number
+ * The condition may combine comparisons with NOT, AND and OR.
+ * A verified program branches to the target resolved at load; a branch
+ * without one, which verification should have ruled out, is checked.
+ *
+ * @throws std::runtime_error on syntax errors
+ */
+void SUBARUU::if_statement() {
+    accept(Tokenizer::TokenType::IF);
+    int cond = condition();
+    if (verified_ && cond) {
+        const auto site = program_->jump_sites.find(tokenizer_->offset());
+        if (site != program_->jump_sites.end()) {
+            count_jump();
+            tokenizer_->seek(site->second);
+            return;
+        }
+    }
+    accept(Tokenizer::TokenType::THEN);
+    if (tokenizer_->current_token() != Tokenizer::TokenType::NUMBER) {
+        dprintf("Syntax Error: Expected line number after THEN", E_ERROR);
+        return;
+    }
+    int line_number = static_cast<int>(tokenizer_->get_num());
+    tokenizer_->next_token();
+    if (cond) {
+        jump_to_line(line_number);
+    } else {
+        if (tokenizer_->current_token() == Tokenizer::TokenType::EOL)
+            tokenizer_->next_token();
+    }
+}
+
+/**
+ * Executes a GOTO statement.
+ * Format: GOTO line_number
+ */
+void SUBARUU::goto_statement() {
+    if (verified_) {
+        const auto site = program_->jump_sites.find(tokenizer_->offset());
+        if (site != program_->jump_sites.end()) {
+            count_jump();
+            tokenizer_->seek(site->second);
+            return;
+        }
+    }
+    accept(Tokenizer::TokenType::GOTO);
+    int line_number = static_cast<int>(tokenizer_->get_num());
+    accept(Tokenizer::TokenType::NUMBER);
+    jump_to_line(line_number);
+}
+
+/**
+ * Branches to a line, checking that it exists.
+ *
+ * @param line_number The target line number
+ * @throws std::runtime_error if the line does not exist
+ */
+void SUBARUU::jump_to_line(int line_number) {
+    auto it = program_->line_offsets.find(line_number);
+    if (it == program_->line_offsets.end()) {
+#ifdef DEBUG_MODE
+        log_available_lines(line_number);
+#endif
+        dprintf("Runtime Error: Line number " + std::to_string(line_number) +
+                  " not found",
+                E_ERROR);
+        return;
+    }
+    count_jump();
+    tokenizer_->seek(it->second);
+}
+
+/**
+ * Executes a CHAIN statement.
+ * Format: CHAIN "file"
+ * Replaces the running program and continues at the start of the chained
+ * one, keeping variables and indexed memory. Relative paths are resolved
+ * against the directory of the current program.
+ *
+ * @throws std::runtime_error if the chained program cannot be loaded
+ */
+void SUBARUU::chain_statement() {
+    accept(Tokenizer::TokenType::CHAIN);
+    if (tokenizer_->current_token() != Tokenizer::TokenType::STRING) {
+        dprintf("Syntax Error: Expected file name after CHAIN", E_ERROR);
+        return;
+    }
+    std::filesystem::path next(std::string(tokenizer_->get_string()));
+    if (next.is_relative())
+        next = std::filesystem::path(source_).parent_path() / next;
+    source_ = next.string();
+    tokenizer_ = load(source_);
+    build_line_map();
+}
+
+/**
+ * Executes a PRINT/PRINT$ statement.
+ * Format: PRINT [#n,] [expression|string|separator|TAB(n)]...
+ *         PRINT$ [#n,] [expression|string|separator|TAB(n)]...
+ *         PRINT [#n,] USING format; item [; item]...
+ * PRINT$ does not emit a trailing newline. With #n the items go to an open
+ * output channel instead of stdout (or Options::output).
+ */
+void SUBARUU::print_statement(bool newline) {
+    // Accept either PRINT or PRINT$
+    if (tokenizer_->current_token() == Tokenizer::TokenType::PRINT)
+        accept(Tokenizer::TokenType::PRINT);
+    else
+        accept(Tokenizer::TokenType::PRINT_DOLLAR);
+
+    std::ostream* out = console_;
+    int channel = 0;
+    if (tokenizer_->current_token() == Tokenizer::TokenType::HASH) {
+        channel = channel_number();
+        auto it = channels_.find(channel);
+        if (it == channels_.end()) {
+            dprintf("Runtime Error: Channel #" + std::to_string(channel) +
+                      " is not open",
+                    E_ERROR);
+            return;
+        }
+        out = it->second.get();
+        if (tokenizer_->current_token() == Tokenizer::TokenType::SEPARATOR)
+            tokenizer_->next_token();
+    }
+
+    bool need_space = false;
+    if (tokenizer_->current_token() == Tokenizer::TokenType::USING) {
+        print_using(*out);
+        goto end_print;
+    }
+    while (!tokenizer_->finished()) {
+        auto token = tokenizer_->current_token();
+        if (is_statement_end(token) || is_line_number())
+            break;
+        switch (token) {
+            case Tokenizer::TokenType::STRING:
+            case Tokenizer::TokenType::STRING_VAR:
+            case Tokenizer::TokenType::MID_DOLLAR:
+            case Tokenizer::TokenType::LEFT_DOLLAR:
+            case Tokenizer::TokenType::RIGHT_DOLLAR:
+            case Tokenizer::TokenType::CHR_DOLLAR:
+            case Tokenizer::TokenType::STR_DOLLAR:
+                if (need_space)
+                    *out << " ";
+                *out << string_expression();
+                need_space = true;
+                break;
+            case Tokenizer::TokenType::SEPARATOR:
+                need_space = false;
+                *out << " ";
+                tokenizer_->next_token();
+                break;
+            case Tokenizer::TokenType::TAB: {
+                tokenizer_->next_token();
+                accept(Tokenizer::TokenType::LEFT_PAREN);
+                value_t n = expression();
+                accept(Tokenizer::TokenType::RIGHT_PAREN);
+                // Clamp to a reasonable limit to avoid huge output
+                if (n < 0)
+                    n = 0;
+                if (n > 1000)
+                    n = 1000;
+                std::size_t count = 0;
+                try {
+                    count = static_cast<std::size_t>(
+                      n.convert_to<unsigned long long>());
+                } catch (...) {
+                    count = 0;
+                }
+                *out << std::string(count, ' ');
+                need_space = false;
+                break;
+            }
+            case Tokenizer::TokenType::LETTER:
+            case Tokenizer::TokenType::NUMBER:
+            case Tokenizer::TokenType::LEFT_PAREN:
+            case Tokenizer::TokenType::MINUS:
+            case Tokenizer::TokenType::RND:
+            case Tokenizer::TokenType::LEN:
+            case Tokenizer::TokenType::ASC:
+            case Tokenizer::TokenType::GET:
+            case Tokenizer::TokenType::HAS:
+                if (need_space)
+                    *out << " ";
+                *out << expression();
+                need_space = true;
+                break;
+            default:
+                goto end_print;
+        }
+    }
+end_print:
+    // Channels and Options::output are flushed by their owners, stdout
+    // after every line
+    if (newline) {
+        *out << '\n';
+        if (channel == 0 && !options_.output)
+            out->flush();
+    }
+    if (!*out) {
+        dprintf("Runtime Error: Failed to write to channel #" +
+                  std::to_string(channel),
+                E_ERROR);
+    }
+
+    auto final_token = tokenizer_->current_token();
+    if (is_line_number())
+        return;
+    if (final_token == Tokenizer::TokenType::EOF_TOKEN)
+        execution_finished_ = true;
+    else if (final_token == Tokenizer::TokenType::EOL)
+        tokenizer_->next_token();
+}
+
+/**
+ * Formats the items of PRINT USING into one buffer and writes it at once.
+ * Format: USING string-expression [; item [; item]...]
+ * Each distinct format text is compiled once (see Format). Fields take the
+ * items in order, starting over after the last one; output stops at the
+ * first field left without an item.
+ *
+ * @param out The statement's destination
+ * @throws std::runtime_error on a malformed format or items for a format
+ *         without fields
+ */
+void SUBARUU::print_using(std::ostream& out) {
+    accept(Tokenizer::TokenType::USING);
+    string_expression().append_to(format_key_);
+    auto it = formats_.find(format_key_);
+    if (it == formats_.end()) {
+        if (formats_.size() >= SUBARUU_FORMAT_CACHE)
+            formats_.clear();
+        try {
+            it = formats_.emplace(format_key_, Format(format_key_)).first;
+        } catch (const std::runtime_error& e) {
+            format_key_.clear();
+            dprintf("Runtime Error: " + std::string(e.what()), E_ERROR);
+            return;
+        }
+    }
+    format_key_.clear();
+    const Format& format = it->second;
+    const auto& fields = format.fields();
+
+    format_line_.clear();
+    std::size_t field = 0;
+    while (tokenizer_->current_token() == Tokenizer::TokenType::SEPARATOR) {
+        tokenizer_->next_token();
+        const auto token = tokenizer_->current_token();
+        if (is_statement_end(token) || is_line_number())
+            break;
+        if (fields.empty()) {
+            dprintf("Runtime Error: PRINT USING format has no fields",
+                    E_ERROR);
+            return;
+        }
+        if (field == fields.size()) {
+            format_line_ += format.suffix();
+            field = 0;
+        }
+        format_line_ += fields[field].prefix;
+        switch (token) {
+            case Tokenizer::TokenType::STRING:
+            case Tokenizer::TokenType::STRING_VAR:
+            case Tokenizer::TokenType::MID_DOLLAR:
+            case Tokenizer::TokenType::LEFT_DOLLAR:
+            case Tokenizer::TokenType::RIGHT_DOLLAR:
+            case Tokenizer::TokenType::CHR_DOLLAR:
+            case Tokenizer::TokenType::STR_DOLLAR:
+                Format::write_string(format_line_, fields[field],
+                                     string_expression());
+                break;
+            default:
+                Format::write_number(format_line_, fields[field],
+                                     expression());
+                break;
+        }
+        ++field;
+    }
+    if (field == fields.size())
+        format_line_ += format.suffix();
+    out.write(format_line_.data(),
+              static_cast<std::streamsize>(format_line_.size()));
+}
+
+/**
+ * Parses a channel reference.
+ * Format: #expression
+ *
+ * @return int The channel number
+ * @throws std::runtime_error if the number is out of range
+ */
+int SUBARUU::channel_number() {
+    accept(Tokenizer::TokenType::HASH);
+    value_t n = expression();
+    if (n < 1 || n > SUBARUU_MAX_CHANNELS) {
+        dprintf("Runtime Error: Channel number must be between 1 and " +
+                  std::to_string(SUBARUU_MAX_CHANNELS),
+                E_ERROR);
+    }
+    return static_cast<int>(n);
+}
+
+/**
+ * Executes an OPEN statement.
+ * Format: OPEN "file" FOR OUTPUT AS #n
+ * Each channel writes through its own large buffer, flushed to disk on a
+ * background thread (see BufferedWriter); a file name ending in ".gz" is
+ * gzip-compressed on that thread.
+ *
+ * @throws std::runtime_error on syntax errors, if the channel is already
+ *         open or the file cannot be created
+ */
+void SUBARUU::open_statement() {
+    accept(Tokenizer::TokenType::OPEN);
+    if (tokenizer_->current_token() != Tokenizer::TokenType::STRING) {
+        dprintf("Syntax Error: Expected file name after OPEN", E_ERROR);
+        return;
+    }
+    std::string path(tokenizer_->get_string());
+    tokenizer_->next_token();
+    accept(Tokenizer::TokenType::FOR);
+    accept(Tokenizer::TokenType::OUTPUT);
+    accept(Tokenizer::TokenType::AS);
+    int channel = channel_number();
+    if (channels_.count(channel) != 0) {
+        dprintf("Runtime Error: Channel #" + std::to_string(channel) +
+                  " is already open",
+                E_ERROR);
+        return;
+    }
+    try {
+        channels_[channel] = std::make_unique<OutputFile>(
+          path, SUBARUU_CHANNEL_BUFFER, SUBARUU_CHANNEL_ASYNC_FLUSH,
+          BufferedWriter::compression_for(path));
+    } catch (const std::exception& e) {
+        dprintf(std::string("Runtime Error: ") + e.what(), E_ERROR);
+    }
+    if (tokenizer_->current_token() == Tokenizer::TokenType::EOL)
+        tokenizer_->next_token();
+}
+
+/**
+ * Executes a CLOSE statement.
+ * Format: CLOSE [#n]
+ * Without a channel number every open channel is closed.
+ *
+ * @throws std::runtime_error if the channel is not open or a write failed
+ */
+void SUBARUU::close_statement() {
+    accept(Tokenizer::TokenType::CLOSE);
+    if (tokenizer_->current_token() == Tokenizer::TokenType::HASH) {
+        int channel = channel_number();
+        auto it = channels_.find(channel);
+        if (it == channels_.end()) {
+            dprintf("Runtime Error: Channel #" + std::to_string(channel) +
+                      " is not open",
+                    E_ERROR);
+            return;
+        }
+        auto file = std::move(it->second);
+        channels_.erase(it);
+        try {
+            file->close();
+        } catch (const std::exception& e) {
+            dprintf(std::string("Runtime Error: ") + e.what(), E_ERROR);
+        }
+    } else {
+        close_channels();
+    }
+    if (tokenizer_->current_token() == Tokenizer::TokenType::EOL)
+        tokenizer_->next_token();
+}
+
+/**
+ * Closes every open output channel.
+ *
+ * @throws std::runtime_error if a write to any channel failed
+ */
+void SUBARUU::close_channels() {
+    auto channels = std::move(channels_);
+    channels_.clear();
+    std::string errors;
+    for (auto& [channel, file] : channels) {
+        try {
+            file->close();
+        } catch (const std::exception& e) {
+            errors += (errors.empty() ? "" : "; ") + std::string(e.what());
+        }
+    }
+    if (!errors.empty())
+        dprintf("Runtime Error: " + errors, E_ERROR);
+}
+
+/**
+ * Executes an INPUT statement.
+ * Format: INPUT target [, target]...
+ * where a target is a variable, an indexed cell m[i], or a range
+ * m[lo TO hi]. Numbers are read from stdin, separated by whitespace. A range
+ * is filled in index order until it is full or the input ends; reading a
+ * single value past the end of input is an error.
+ *
+ * @throws std::runtime_error on syntax errors, malformed numbers or missing
+ *         input
+ */
+void SUBARUU::input_statement() {
+    if (gate_ && gate_->input_ready && !reserve_input())
+        return;
+    accept(Tokenizer::TokenType::INPUT);
+    if (!input_)
+        input_ = std::make_unique<InputReader>(
+          options_.input ? *options_.input : std::cin);
+    for (;;) {
+        if (tokenizer_->current_token() != Tokenizer::TokenType::LETTER) {
+            dprintf("Syntax Error: Expected variable after INPUT", E_ERROR);
+            return;
+        }
+        char var_name =
+          static_cast<char>(std::tolower(static_cast<unsigned char>(
+            std::get<char>(tokenizer_->get_token_data()))));
+        tokenizer_->next_token();
+        if (tokenizer_->current_token() == Tokenizer::TokenType::LEFT_BRACKET) {
+            tokenizer_->next_token();
+            value_t lo = expression();
+            if (tokenizer_->current_token() == Tokenizer::TokenType::TO) {
+                tokenizer_->next_token();
+                value_t hi = expression();
+                accept(Tokenizer::TokenType::RIGHT_BRACKET);
+                input_range(lo, hi);
+            } else {
+                accept(Tokenizer::TokenType::RIGHT_BRACKET);
+                poke(lo, input_value());
+            }
+        } else {
+            variables_[var_name - 'a'] = input_value();
+            wrote(static_cast<std::size_t>(var_name - 'a'));
+        }
+        if (tokenizer_->current_token() != Tokenizer::TokenType::SEPARATOR)
+            break;
+        tokenizer_->next_token();
+    }
+    if (tokenizer_->current_token() == Tokenizer::TokenType::EOL)
+        tokenizer_->next_token();
+}
+
+/**
+ * Takes the numbers the INPUT statement at the current token reads from
+ * run_for()'s gate: one per variable or cell, everything for a range. If
+ * the gate has fewer, the statement is left unexecuted for run_for() to
+ * report the pause.
+ *
+ * @return bool true if the statement may run
+ */
+bool SUBARUU::reserve_input() {
+    std::size_t& ready = *gate_->input_ready;
+    if (ready == std::numeric_limits<std::size_t>::max())
+        return true;
+    const auto start = tokenizer_->offset();
+    std::size_t demand = 1;
+    int depth = 0;
+    for (tokenizer_->next_token();; tokenizer_->next_token()) {
+        const auto token = tokenizer_->current_token();
+        if (is_statement_end(token) || (depth == 0 && is_line_number()))
+            break;
+        if (token == Tokenizer::TokenType::LEFT_BRACKET) {
+            ++depth;
+        } else if (token == Tokenizer::TokenType::RIGHT_BRACKET) {
+            --depth;
+        } else if (token == Tokenizer::TokenType::TO && depth > 0) {
+            demand = std::numeric_limits<std::size_t>::max();
+            break;
+        } else if (token == Tokenizer::TokenType::SEPARATOR && depth == 0) {
+            ++demand;
+        }
+    }
+    tokenizer_->seek(start);
+    if (demand > ready) {
+        --stats_.statements;
+        input_paused_ = true;
+        return false;
+    }
+    ready -= demand;
+    return true;
+}
+
+/**
+ * Reads one number for INPUT.
+ *
+ * @return value_t The number read
+ * @throws std::runtime_error on malformed input or end of input
+ */
+SUBARUU::value_t SUBARUU::input_value() {
+    value_t value;
+    try {
+        if (input_->next(value))
+            return value;
+    } catch (const std::exception& e) {
+        dprintf(std::string("Runtime Error: ") + e.what(), E_ERROR);
+    }
+    dprintf("Runtime Error: INPUT past end of data", E_ERROR);
+    return 0;
+}
+
+/**
+ * Fills indexed memory m[lo..hi] in ascending index order from a source,
+ * stopping early when the source runs dry. Each cell is inserted next to
+ * the previous one.
+ *
+ * @param lo First index
+ * @param hi Last index (inclusive)
+ * @param next Callable taking value_t& and returning false when exhausted
+ */
+template <typename Source>
+void SUBARUU::fill_range(const value_t& lo, const value_t& hi, Source&& next) {
+    value_t value;
+    for (value_t index = lo; index <= hi; ++index) {
+        if (!next(value))
+            break;
+        count_bignum(value);
+        write_memory(index, value);
+    }
+}
+
+/**
+ * Picks PRINT's default destination and, with Options::metrics, starts
+ * counting what it is sent.
+ */
+void SUBARUU::attach_metrics() {
+    console_ = options_.output ? options_.output : &std::cout;
+    if (!options_.metrics)
+        return;
+    counters_ = &options_.metrics->counters();
+    console_counter_ = std::make_unique<CountingStream>(*console_);
+    console_ = console_counter_.get();
+    published_.output_bytes = 0;
+}
+
+/**
+ * Adds the counts since the last call to the shared counters. Called every
+ * SUBARUU_METRICS_BATCH statements and when run() returns, so the
+ * executor never touches an atomic per statement.
  */
-void SUBARUU::goto_statement() {
-    accept(Tokenizer::TokenType::GOTO);
-    int line_number = static_cast<int>(tokenizer_->get_num());
-    accept(Tokenizer::TokenType::NUMBER);
+void SUBARUU::publish_metrics() {
+    constexpr auto relaxed = std::memory_order_relaxed;
+    Metered now = metered_;
+    now.statements = stats_.statements;
+    now.output_bytes = console_counter_->count();
+    now.memory_cells = memory_.size() + string_memory_.size();
+    counters_->statements.fetch_add(now.statements - published_.statements,
+                                    relaxed);
+    counters_->jumps.fetch_add(now.jumps - published_.jumps, relaxed);
+    counters_->bignums.fetch_add(now.bignums - published_.bignums, relaxed);
+    counters_->output_bytes.fetch_add(
+      now.output_bytes - published_.output_bytes, relaxed);
+    counters_->memory_cells.fetch_add(
+      now.memory_cells - published_.memory_cells, relaxed);
+    published_ = now;
+}
+
+/**
+ * Reads a cell of indexed memory: a cell written by this interpreter, else
+ * the cell of an attached segment, else 0.
+ *
+ * @param index The memory index
+ * @return value_t The cell's value
+ */
+SUBARUU::value_t SUBARUU::read_memory(const value_t& index) const {
+    if (const value_t* value = memory_.find(index))
+        return *value;
+    for (const auto& attached : segments_)
+        if (attached.segment->contains(index))
+            return attached.segment->get(index);
+    return 0;
+}
+
+/**
+ * Writes a cell of indexed memory. A cell of a copy-on-write segment is
+ * written to this interpreter's own memory, shadowing the segment.
+ *
+ * @param index The memory index
+ * @param value The value to store
+ * @throws std::runtime_error if the cell is in a read-only segment
+ */
+void SUBARUU::write_memory(const value_t& index, value_t value) {
+    for (const auto& attached : segments_) {
+        if (attached.access == Segment::Access::READ_ONLY &&
+            attached.segment->contains(index))
+            dprintf("Runtime Error: m[" + index.str() +
+                      "] is in a read-only segment",
+                    E_ERROR);
+    }
+    memory_.set(index, std::move(value));
+}
+
+/**
+ * Looks up the index site starting at the current token, the one after
+ * a '[', matching it on first sight. At a site the tokenizer is moved to
+ * its closing ']'; elsewhere it is left where it was. Code that runs once
+ * gains nothing from a site, so none is kept for it.
+ *
+ * @param run_once Whether the access is in code run for the first time
+ * @return std::size_t The site's number in sites_, or NO_SITE
+ */
+std::size_t SUBARUU::index_site(bool run_once) {
+    if (run_once)
+        return NO_SITE;
+    const std::size_t start = tokenizer_->offset();
+    auto [it, fresh] = site_ids_.try_emplace(start, NO_SITE);
+    if (fresh) {
+        IndexSite site{};
+        if (match_index_site(site)) {
+            it->second = sites_.size();
+            sites_.push_back(site);
+        } else {
+            tokenizer_->seek(start);
+        }
+        return it->second;
+    }
+    if (it->second != NO_SITE)
+        tokenizer_->seek(sites_[it->second].end);
+    return it->second;
+}
+
+/**
+ * Matches "v ]", "v + n ]", "v - n ]" or "n + v ]" at the current token,
+ * n being a number that fits in 64 bits.
+ *
+ * @param site Filled in on a match
+ * @return bool Whether the tokens match; the tokenizer is then at the ']'
+ */
+bool SUBARUU::match_index_site(IndexSite& site) {
+    using Token = Tokenizer::TokenType;
+    const auto number = [this](std::int64_t& out) {
+        if (tokenizer_->current_token() != Token::NUMBER)
+            return false;
+        const auto& num = std::get<value_t>(tokenizer_->get_token_data());
+        if (num > std::numeric_limits<std::int64_t>::max())
+            return false;
+        out = static_cast<std::int64_t>(num);
+        tokenizer_->next_token();
+        return true;
+    };
+    const auto letter = [this, &site] {
+        if (tokenizer_->current_token() != Token::LETTER)
+            return false;
+        site.var = static_cast<std::size_t>(tokenizer_->variable_num());
+        tokenizer_->next_token();
+        return true;
+    };
+    const auto accept_token = [this](Token token) {
+        if (tokenizer_->current_token() != token)
+            return false;
+        tokenizer_->next_token();
+        return true;
+    };
+    if (tokenizer_->current_token() == Token::NUMBER) {
+        if (!number(site.base) || !accept_token(Token::PLUS) || !letter())
+            return false;
+    } else {
+        if (!letter())
+            return false;
+        if (accept_token(Token::PLUS)) {
+            if (!number(site.base))
+                return false;
+        } else if (accept_token(Token::MINUS)) {
+            if (!number(site.base))
+                return false;
+            site.base = -site.base;
+        }
+    }
+    site.end = tokenizer_->offset();
+    return tokenizer_->current_token() == Token::RIGHT_BRACKET;
+}
+
+/**
+ * Computes a site's index when it is a regular 64-bit one: the variable
+ * below 2^62 in magnitude and the sum neither overflowing nor INT64_MIN.
+ *
+ * @param site The site
+ * @param index Set to the index when regular
+ * @return bool Whether it is
+ */
+bool SUBARUU::site_index(const IndexSite& site, std::int64_t& index) const {
+    const value_t& var = variables_[site.var];
+    const auto& backend = var.backend();
+    if (backend.size() != 1 || backend.limbs()[0] >= (1ull << 62))
+        return false;
+    const auto magnitude = static_cast<std::int64_t>(backend.limbs()[0]);
+    return !__builtin_add_overflow(site.base,
+                                   var.sign() < 0 ? -magnitude : magnitude,
+                                   &index) &&
+           index != std::numeric_limits<std::int64_t>::min();
+}
+
+/**
+ * Reads the cell of an index site through its cursor.
+ *
+ * @param site The site
+ * @return value_t The cell's value
+ */
+SUBARUU::value_t SUBARUU::load_site(IndexSite& site) {
+    std::int64_t index;
+    if (!site_index(site, index))
+        return read_memory(site.base + variables_[site.var]);
+    if (const value_t* value = memory_.find(index, site.cursor))
+        return *value;
+    return segments_.empty() ? value_t(0) : read_memory(index);
+}
+
+/**
+ * Writes the cell of an index site, through its cursor unless segments
+ * are attached.
+ *
+ * @param site The site
+ * @param value The value to store
+ * @throws std::runtime_error if the cell is in a read-only segment
+ */
+void SUBARUU::store_site(IndexSite& site, value_t value) {
+    std::int64_t index;
+    if (segments_.empty() && site_index(site, index))
+        memory_.set(index, std::move(value), site.cursor);
+    else
+        write_memory(site.base + variables_[site.var], std::move(value));
+}
+
+/**
+ * Bulk INPUT into indexed memory m[lo..hi], stopping early at end of input.
+ *
+ * @param lo First index
+ * @param hi Last index (inclusive)
+ * @throws std::runtime_error on malformed input
+ */
+void SUBARUU::input_range(const value_t& lo, const value_t& hi) {
+    try {
+        fill_range(lo, hi, [this](value_t& value) {
+            return input_->next(value);
+        });
+    } catch (const std::exception& e) {
+        dprintf(std::string("Runtime Error: ") + e.what(), E_ERROR);
+    }
+}
+
+/**
+ * Draws a random number in [0, bound) for RND.
+ *
+ * @param bound Exclusive upper bound
+ * @return value_t The draw
+ * @throws std::runtime_error if bound is not positive
+ */
+SUBARUU::value_t SUBARUU::random_below(const value_t& bound) {
+    if (bound <= 0) {
+        dprintf("Runtime Error: RND bound must be positive", E_ERROR);
+        return 0;
+    }
+    return rng_.below(bound);
+}
+
+/**
+ * Executes a RANDOMIZE statement.
+ * Format: RANDOMIZE seed [, stream]
+ * Restarts RND at the given substream (default 0) of the seed. Streams of
+ * one seed never overlap, so parallel runs can share a seed and differ only
+ * in their stream number.
+ *
+ * @throws std::runtime_error if the stream number is negative or too large
+ */
+void SUBARUU::randomize_statement() {
+    accept(Tokenizer::TokenType::RANDOMIZE);
+    value_t seed = expression();
+    value_t stream = 0;
+    if (tokenizer_->current_token() == Tokenizer::TokenType::SEPARATOR) {
+        tokenizer_->next_token();
+        stream = expression();
+    }
+    if (stream < 0 || stream > std::numeric_limits<std::uint64_t>::max()) {
+        dprintf("Runtime Error: RANDOMIZE stream out of range", E_ERROR);
+        return;
+    }
+    // Fold the seed into 64 bits: low word of the magnitude, inverted when
+    // negative so that s and -s differ
+    const value_t mask = std::numeric_limits<std::uint64_t>::max();
+    auto word = static_cast<std::uint64_t>(
+      (boost::multiprecision::abs(seed) & mask).convert_to<std::uint64_t>());
+    if (seed < 0)
+        word = ~word;
+    rng_.seed(word, stream.convert_to<std::uint64_t>());
     if (tokenizer_->current_token() == Tokenizer::TokenType::EOL)
         tokenizer_->next_token();
-    if (line_positions_.find(line_number) == line_positions_.end()) {
-        dprintf("Runtime Error: Line number " + std::to_string(line_number) +
-                  " not found",
-                E_ERROR);
+}
+
+/**
+ * Executes a bulk RND statement.
+ * Format: RND m[lo TO hi], bound
+ * Fills every cell of the range with RND(bound).
+ *
+ * @throws std::runtime_error on syntax errors or a non-positive bound
+ */
+void SUBARUU::rnd_statement() {
+    accept(Tokenizer::TokenType::RND);
+    if (tokenizer_->current_token() != Tokenizer::TokenType::LETTER) {
+        dprintf("Syntax Error: Expected m[lo TO hi] after RND", E_ERROR);
         return;
     }
-    tokenizer_->reset();
-    if (!find_target_line(line_number)) {
-        dprintf("Internal Error: Failed to find valid line number " +
-                  std::to_string(line_number),
-                E_ERROR);
+    tokenizer_->next_token();
+    accept(Tokenizer::TokenType::LEFT_BRACKET);
+    value_t lo = expression();
+    accept(Tokenizer::TokenType::TO);
+    value_t hi = expression();
+    accept(Tokenizer::TokenType::RIGHT_BRACKET);
+    accept(Tokenizer::TokenType::SEPARATOR);
+    value_t bound = expression();
+    if (bound <= 0) {
+        dprintf("Runtime Error: RND bound must be positive", E_ERROR);
+        return;
     }
+    if (bound <= std::numeric_limits<std::uint64_t>::max()) {
+        const auto small = bound.convert_to<std::uint64_t>();
+        fill_range(lo, hi, [this, small](value_t& value) {
+            value = rng_.below(small);
+            return true;
+        });
+    } else {
+        fill_range(lo, hi, [this, &bound](value_t& value) {
+            value = rng_.below(bound);
+            return true;
+        });
+    }
+    if (tokenizer_->current_token() == Tokenizer::TokenType::EOL)
+        tokenizer_->next_token();
 }
 
 /**
- * Skips through the code until finding a specific line number.
- * Assumes tokenizer has been reset to beginning.
+ * Executes a SORT statement.
+ * Format: SORT m[lo TO hi] [ASC|DESC] [, m[first]]
+ * Sorts the cells of the range in place, ascending by default. With
+ * m[first], the range of the same length starting there is permuted along
+ * with the keys, e.g. to keep values with their sort keys.
  *
- * @param line_number The target line number to find
- * @return bool True if line was found, false if reached end without finding
+ * @throws std::runtime_error on syntax errors or a range too large
  */
-bool SUBARUU::find_target_line(int line_number) {
-    bool at_line_start = true;
-    while (!tokenizer_->finished()) {
-        auto tok = tokenizer_->current_token();
-        if (at_line_start && tok == Tokenizer::TokenType::NUMBER &&
-            static_cast<int>(tokenizer_->get_num()) == line_number) {
-            tokenizer_->next_token();
-            return true;
+void SUBARUU::sort_statement() {
+    accept(Tokenizer::TokenType::SORT);
+    if (tokenizer_->current_token() != Tokenizer::TokenType::LETTER) {
+        dprintf("Syntax Error: Expected m[lo TO hi] after SORT", E_ERROR);
+        return;
+    }
+    tokenizer_->next_token();
+    accept(Tokenizer::TokenType::LEFT_BRACKET);
+    value_t lo = expression();
+    accept(Tokenizer::TokenType::TO);
+    value_t hi = expression();
+    accept(Tokenizer::TokenType::RIGHT_BRACKET);
+    bool descending = false;
+    if (tokenizer_->current_token() == Tokenizer::TokenType::DESC) {
+        descending = true;
+        tokenizer_->next_token();
+    } else if (tokenizer_->current_token() == Tokenizer::TokenType::ASC) {
+        tokenizer_->next_token();
+    }
+    if (tokenizer_->current_token() != Tokenizer::TokenType::SEPARATOR) {
+        sort_range(lo, hi, descending, nullptr);
+    } else {
+        tokenizer_->next_token();
+        if (tokenizer_->current_token() != Tokenizer::TokenType::LETTER) {
+            dprintf("Syntax Error: Expected m[first] after SORT range",
+                    E_ERROR);
+            return;
         }
-        at_line_start = (tok == Tokenizer::TokenType::EOL);
         tokenizer_->next_token();
+        accept(Tokenizer::TokenType::LEFT_BRACKET);
+        value_t first = expression();
+        accept(Tokenizer::TokenType::RIGHT_BRACKET);
+        sort_range(lo, hi, descending, &first);
     }
-    return false;
+    if (tokenizer_->current_token() == Tokenizer::TokenType::EOL)
+        tokenizer_->next_token();
 }
 
 /**
- * Executes a PRINT/PRINT$ statement.
- * Format: PRINT [expression|string|separator|TAB(n)]...
- *         PRINT$ [expression|string|separator|TAB(n)]...
- * PRINT$ does not emit a trailing newline.
+ * Sorts m[lo..hi] natively (see Sorter): radix sort when every cell fits
+ * in 64 bits, a comparison sort otherwise. Only cells whose value changes
+ * are written back.
+ *
+ * @param lo First index
+ * @param hi Last index (inclusive)
+ * @param descending Largest value first
+ * @param values First index of a range permuted with the keys, or nullptr
+ * @throws std::runtime_error if the range holds more than 2^32 cells
  */
-void SUBARUU::print_statement(bool newline) {
-    // Accept either PRINT or PRINT$
-    if (tokenizer_->current_token() == Tokenizer::TokenType::PRINT)
-        accept(Tokenizer::TokenType::PRINT);
-    else
-        accept(Tokenizer::TokenType::PRINT_DOLLAR);
+void SUBARUU::sort_range(const value_t& lo,
+                         const value_t& hi,
+                         bool descending,
+                         const value_t* values) {
+    if (hi <= lo)
+        return;
+    value_t span = hi - lo;
+    if (span >= std::numeric_limits<std::uint32_t>::max()) {
+        dprintf("Runtime Error: SORT range is too large", E_ERROR);
+        return;
+    }
+    const std::size_t n = span.convert_to<std::size_t>() + 1;
+    const value_t small_min = std::numeric_limits<std::int64_t>::min();
+    const value_t small_max = std::numeric_limits<std::int64_t>::max();
 
-    bool need_space = false;
-    while (!tokenizer_->finished()) {
-        auto token = tokenizer_->current_token();
-        if (is_statement_end(token) || is_line_number())
-            break;
-        switch (token) {
-            case Tokenizer::TokenType::STRING:
-                if (need_space)
-                    std::cout << " ";
-                std::cout << tokenizer_->get_string();
-                need_space = true;
-                tokenizer_->next_token();
-                break;
-            case Tokenizer::TokenType::SEPARATOR:
-                need_space = false;
-                std::cout << " ";
-                tokenizer_->next_token();
-                break;
-            case Tokenizer::TokenType::TAB: {
-                tokenizer_->next_token();
-                accept(Tokenizer::TokenType::LEFT_PAREN);
-                value_t n = expression();
-                accept(Tokenizer::TokenType::RIGHT_PAREN);
-                // Clamp to a reasonable limit to avoid huge output
-                if (n < 0)
-                    n = 0;
-                if (n > 1000)
-                    n = 1000;
-                std::size_t count = 0;
-                try {
-                    count = static_cast<std::size_t>(
-                      n.convert_to<unsigned long long>());
-                } catch (...) {
-                    count = 0;
-                }
-                std::cout << std::string(count, ' ');
-                need_space = false;
-                break;
-            }
-            case Tokenizer::TokenType::LETTER:
-            case Tokenizer::TokenType::NUMBER:
-            case Tokenizer::TokenType::LEFT_PAREN:
-            case Tokenizer::TokenType::MINUS:
-                if (need_space)
-                    std::cout << " ";
-                std::cout << expression();
-                need_space = true;
-                break;
-            default:
-                goto end_print;
+    std::vector<value_t> cells(n);
+    bool small = true;
+    value_t index = lo;
+    for (std::size_t i = 0; i < n; ++i, ++index) {
+        cells[i] = read_memory(index);
+        small = small && cells[i] >= small_min && cells[i] <= small_max;
+    }
+    Sorter::Order order;
+    if (small) {
+        std::vector<std::int64_t> keys(n);
+        for (std::size_t i = 0; i < n; ++i)
+            keys[i] = cells[i].convert_to<std::int64_t>();
+        if (values) {
+            order.resize(n);
+            std::iota(order.begin(), order.end(), 0u);
         }
+        Sorter::radix(keys, values ? &order : nullptr, descending);
+        index = lo;
+        for (std::size_t i = 0; i < n; ++i, ++index)
+            if (cells[i] != keys[i])
+                write_memory(index, keys[i]);
+    } else {
+        order = Sorter::compare(cells, descending);
+        index = lo;
+        for (std::size_t i = 0; i < n; ++i, ++index)
+            if (order[i] != i && cells[order[i]] != cells[i])
+                write_memory(index, cells[order[i]]);
     }
-end_print:
-    if (newline)
-        std::cout << std::endl;
+    if (!values)
+        return;
 
-    auto final_token = tokenizer_->current_token();
-    if (is_line_number())
+    index = *values;
+    for (std::size_t i = 0; i < n; ++i, ++index)
+        cells[i] = read_memory(index);
+    index = *values;
+    for (std::size_t i = 0; i < n; ++i, ++index)
+        if (order[i] != i && cells[order[i]] != cells[i])
+            write_memory(index, cells[order[i]]);
+}
+
+/**
+ * Executes a SET statement.
+ * Format: SET t, key, value
+ * Stores value under key in table t (a letter), replacing any value there.
+ * Keys are numbers or strings; GET(t, key) reads it back, HAS(t, key)
+ * tests for it.
+ *
+ * @throws std::runtime_error on syntax errors
+ */
+void SUBARUU::set_statement() {
+    accept(Tokenizer::TokenType::SET);
+    table_access([this](std::shared_ptr<HashTable>& table, const auto& key) {
+        accept(Tokenizer::TokenType::SEPARATOR);
+        value_t value = expression();
+        count_bignum(value);
+        writable(table).set(key, std::move(value));
+    });
+    if (tokenizer_->current_token() == Tokenizer::TokenType::EOL)
+        tokenizer_->next_token();
+}
+
+/**
+ * Executes a DEL statement.
+ * Format: DEL t, key
+ * Removes key from table t; a missing key is not an error.
+ *
+ * @throws std::runtime_error on syntax errors
+ */
+void SUBARUU::del_statement() {
+    accept(Tokenizer::TokenType::DEL);
+    table_access([](std::shared_ptr<HashTable>& table, const auto& key) {
+        if (table)
+            writable(table).erase(key);
+    });
+    if (tokenizer_->current_token() == Tokenizer::TokenType::EOL)
+        tokenizer_->next_token();
+}
+
+/**
+ * Executes a WHILE statement.
+ * Format: WHILE condition ... WEND
+ * A false condition continues after the matching WEND, resolved at load.
+ *
+ * @throws std::runtime_error on syntax errors
+ */
+void SUBARUU::while_statement() {
+    const auto at = tokenizer_->offset();
+    accept(Tokenizer::TokenType::WHILE);
+    if (!condition()) {
+        jump_to_loop(at);
+        accept(Tokenizer::TokenType::WEND);
+    }
+    if (tokenizer_->current_token() == Tokenizer::TokenType::EOL)
+        tokenizer_->next_token();
+}
+
+/**
+ * Executes a WEND statement: branches back to the matching WHILE, which
+ * re-evaluates its condition.
+ */
+void SUBARUU::wend_statement() { jump_to_loop(tokenizer_->offset()); }
+
+/**
+ * Executes a DO statement, which only marks the top of a DO ... LOOP.
+ */
+void SUBARUU::do_statement() {
+    accept(Tokenizer::TokenType::DO);
+    if (tokenizer_->current_token() == Tokenizer::TokenType::EOL)
+        tokenizer_->next_token();
+}
+
+/**
+ * Executes a LOOP statement.
+ * Format: DO ... LOOP [UNTIL condition | WHILE condition]
+ * Branches back to the matching DO unless the condition ends the loop; a
+ * bare LOOP repeats until a GOTO leaves it.
+ *
+ * @throws std::runtime_error on syntax errors
+ */
+void SUBARUU::loop_statement() {
+    const auto at = tokenizer_->offset();
+    accept(Tokenizer::TokenType::LOOP);
+    bool repeat = true;
+    if (tokenizer_->current_token() == Tokenizer::TokenType::UNTIL) {
+        tokenizer_->next_token();
+        repeat = !condition();
+    } else if (tokenizer_->current_token() == Tokenizer::TokenType::WHILE) {
+        tokenizer_->next_token();
+        repeat = condition();
+    }
+    if (repeat) {
+        jump_to_loop(at);
         return;
-    if (final_token == Tokenizer::TokenType::EOF_TOKEN)
-        execution_finished_ = true;
-    else if (final_token == Tokenizer::TokenType::EOL)
+    }
+    if (tokenizer_->current_token() == Tokenizer::TokenType::EOL)
         tokenizer_->next_token();
 }
 
+/**
+ * Branches from a loop keyword to its partner (see build_line_map).
+ *
+ * @param offset Source offset of the WHILE, WEND or LOOP token
+ */
+void SUBARUU::jump_to_loop(std::size_t offset) {
+    auto it = program_->loop_targets.find(offset);
+    if (it == program_->loop_targets.end()) {
+        dprintf("Internal Error: Unresolved loop at offset " +
+                  std::to_string(offset),
+                E_ERROR);
+        return;
+    }
+    count_jump();
+    tokenizer_->seek(it->second);
+}
+
 /**
  * Checks if the current token indicates end of statement
  */
@@ -477,11 +2430,13 @@ bool SUBARUU::is_valid_line_number(const value_t& num) const {
 
 /**
  * Executes a statement based on the current token.
- * Handles REM, PRINT/PRINT$, IF, GOTO, and LET statements.
+ * Handles REM, PRINT/PRINT$, IF, GOTO, CHAIN, OPEN/CLOSE, INPUT,
+ * RANDOMIZE/RND, WHILE/WEND, DO/LOOP and LET statements (numeric or string).
  *
  * @throws std::runtime_error on syntax errors
  */
 void SUBARUU::statement() {
+    ++stats_.statements;
     auto token = tokenizer_->current_token();
     switch (token) {
         case Tokenizer::TokenType::REM:
@@ -499,10 +2454,50 @@ void SUBARUU::statement() {
         case Tokenizer::TokenType::GOTO:
             goto_statement();
             break;
+        case Tokenizer::TokenType::CHAIN:
+            chain_statement();
+            break;
+        case Tokenizer::TokenType::OPEN:
+            open_statement();
+            break;
+        case Tokenizer::TokenType::CLOSE:
+            close_statement();
+            break;
+        case Tokenizer::TokenType::INPUT:
+            input_statement();
+            break;
+        case Tokenizer::TokenType::RANDOMIZE:
+            randomize_statement();
+            break;
+        case Tokenizer::TokenType::RND:
+            rnd_statement();
+            break;
+        case Tokenizer::TokenType::SORT:
+            sort_statement();
+            break;
+        case Tokenizer::TokenType::SET:
+            set_statement();
+            break;
+        case Tokenizer::TokenType::DEL:
+            del_statement();
+            break;
+        case Tokenizer::TokenType::WHILE:
+            while_statement();
+            break;
+        case Tokenizer::TokenType::WEND:
+            wend_statement();
+            break;
+        case Tokenizer::TokenType::DO:
+            do_statement();
+            break;
+        case Tokenizer::TokenType::LOOP:
+            loop_statement();
+            break;
         case Tokenizer::TokenType::LET:
             accept(Tokenizer::TokenType::LET);
             [[fallthrough]];
         case Tokenizer::TokenType::LETTER:
+        case Tokenizer::TokenType::STRING_VAR:
             let_statement();
             break;
         default:
@@ -522,17 +2517,54 @@ void SUBARUU::line_statement() {
         execution_finished_ = true;
         return;
     }
-    if (tokenizer_->current_token() == Tokenizer::TokenType::NUMBER)
+    if (tokenizer_->current_token() == Tokenizer::TokenType::NUMBER) {
+        if (options_.profile)
+            ++line_hits_[static_cast<int>(tokenizer_->get_num())];
+        if (counters_) {
+            counters_->line.store(
+              static_cast<std::uint64_t>(tokenizer_->get_num()),
+              std::memory_order_relaxed);
+            if (stats_.statements - published_.statements >=
+                SUBARUU_METRICS_BATCH)
+                publish_metrics();
+        }
         tokenizer_->next_token();
+    }
     statement();
 }
 
 /**
  * Builds a map of line numbers in the program.
- * Maps each line number to its position in the source.
+ * Maps each line number to its position in the source, and each GOTO/THEN
+ * followed by an existing line number to that line's position (used
+ * unchecked by verified programs). String literals are
+ * interned on the same pass: every occurrence of one text shares a single
+ * Str, so executing a literal never copies it. Loops are resolved too:
+ * WHILE and WEND map to each other and LOOP to its DO, so loop branches
+ * are direct seeks.
+ *
+ * @throws std::runtime_error on unmatched loop keywords
  */
 void SUBARUU::build_line_map() {
-    line_positions_.clear();
+    auto program = std::make_shared<Program>();
+    skip_targets_.clear();
+    condition_groups_.clear();
+    expressions_.clear();
+    sites_.clear();
+    site_ids_.clear();
+    high_water_ = 0;
+    std::unordered_map<std::string, Str> interned;
+    struct OpenLoop {
+        Tokenizer::TokenType kind;
+        std::size_t offset;
+        int line;
+    };
+    std::vector<OpenLoop> open_loops;
+    std::vector<std::pair<std::size_t, int>> jumps;
+    std::size_t jump_site = 0;
+    bool after_jump = false;
+    int line = 0;
+    auto previous = Tokenizer::TokenType::EOL;
     tokenizer_->reset();
 #ifdef DEBUG_MODE
     std::unordered_map<int, bool> found_lines;
@@ -544,18 +2576,74 @@ void SUBARUU::build_line_map() {
             value_t num_val = tokenizer_->get_num();
             if (is_valid_line_number(num_val)) {
                 int value = static_cast<int>(num_val);
-                line_positions_[value] = true;
+                program->line_offsets.try_emplace(value, tokenizer_->offset());
+                line = value;
 #ifdef DEBUG_MODE
                 found_lines[value] = true;
 #endif
             }
         }
+        if (tok == Tokenizer::TokenType::REM) {
+            tokenizer_->skip_to_eol();
+            at_line_start = true;
+            previous = Tokenizer::TokenType::EOL;
+            continue;
+        }
+        if (after_jump && tok == Tokenizer::TokenType::NUMBER &&
+            is_valid_line_number(tokenizer_->get_num()))
+            jumps.emplace_back(jump_site,
+                               static_cast<int>(tokenizer_->get_num()));
+        after_jump = tok == Tokenizer::TokenType::GOTO ||
+                     tok == Tokenizer::TokenType::THEN;
+        if (after_jump)
+            jump_site = tokenizer_->offset();
+        if (tok == Tokenizer::TokenType::STRING) {
+            const auto text = tokenizer_->get_string();
+            auto it = interned.try_emplace(std::string(text), text).first;
+            program->literals.emplace(tokenizer_->offset(), it->second);
+        }
+        const bool opens =
+          tok == Tokenizer::TokenType::DO ||
+          (tok == Tokenizer::TokenType::WHILE &&
+           previous != Tokenizer::TokenType::LOOP);
+        if (opens)
+            open_loops.push_back(OpenLoop{ tok, tokenizer_->offset(), line });
+        if (tok == Tokenizer::TokenType::WEND ||
+            tok == Tokenizer::TokenType::LOOP) {
+            const auto opener = tok == Tokenizer::TokenType::WEND
+                                  ? Tokenizer::TokenType::WHILE
+                                  : Tokenizer::TokenType::DO;
+            if (open_loops.empty() || open_loops.back().kind != opener) {
+                dprintf("Syntax Error: " + get_token_string(tok) +
+                          " without " + get_token_string(opener) +
+                          " at line " + std::to_string(line),
+                        E_ERROR);
+            }
+            const auto offset = tokenizer_->offset();
+            if (opener == Tokenizer::TokenType::WHILE)
+                program->loop_targets[open_loops.back().offset] = offset;
+            program->loop_targets[offset] = open_loops.back().offset;
+            open_loops.pop_back();
+        }
+        previous = tok;
         at_line_start = (tok == Tokenizer::TokenType::EOL);
         tokenizer_->next_token();
     }
+    for (const auto& [site, target] : jumps) {
+        auto it = program->line_offsets.find(target);
+        if (it != program->line_offsets.end())
+            program->jump_sites.emplace(site, it->second);
+    }
+    if (!open_loops.empty()) {
+        const auto& open = open_loops.back();
+        dprintf("Syntax Error: " + get_token_string(open.kind) +
+                  " at line " + std::to_string(open.line) + " is never closed",
+                E_ERROR);
+    }
 #ifdef DEBUG_MODE
     log_found_line_numbers(found_lines);
 #endif
+    program_ = std::move(program);
     tokenizer_->reset();
 }
 
@@ -576,7 +2664,7 @@ void SUBARUU::log_found_line_numbers(
 
 void SUBARUU::log_available_lines(int target_line) {
     DEBUG_LOG("Line " << target_line << " not found in map. Available lines:");
-    for (const auto& [line, _] : line_positions_)
+    for (const auto& [line, _] : program_->line_offsets)
         DEBUG_LOG(" " << line);
 }
 #endif
@@ -0,0 +1,752 @@
+// sweep.cc
+
+#include "../include/sweep.h"
+#include "../include/history.h"
+#include "../include/io.h"
+#include "../include/module.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <netdb.h>
+#include <poll.h>
+#include <sstream>
+#include <stdexcept>
+#include <streambuf>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <utility>
+
+/******************************************************************************/
+
+namespace {
+
+constexpr char UNIX_PREFIX[] = "unix:";
+
+// PRINT destination of sweep runs: accepts and drops everything
+struct Discard : std::streambuf {
+    int_type overflow(int_type ch) override {
+        return traits_type::not_eof(ch);
+    }
+    std::streamsize xsputn(const char*, std::streamsize n) override {
+        return n;
+    }
+};
+
+// A socket descriptor, closed when it goes out of scope
+class Socket {
+    public:
+        explicit Socket(int fd = -1) noexcept
+          : fd_(fd) {}
+        Socket(Socket&& other) noexcept
+          : fd_(std::exchange(other.fd_, -1)) {}
+        Socket& operator=(Socket&& other) noexcept {
+            std::swap(fd_, other.fd_);
+            return *this;
+        }
+        ~Socket() {
+            if (fd_ >= 0)
+                ::close(fd_);
+        }
+        [[nodiscard]] int fd() const noexcept { return fd_; }
+        int release() noexcept { return std::exchange(fd_, -1); }
+
+    private:
+        int fd_;
+};
+
+[[noreturn]] void socket_error(const std::string& what,
+                               const std::string& endpoint) {
+    throw std::runtime_error(what + " " + endpoint + ": " +
+                             std::strerror(errno));
+}
+
+/**
+ * Opens a stream socket listening on, or connected to, an endpoint:
+ * "unix:PATH" or "HOST:PORT". An empty HOST is every interface when
+ * listening and the local host when connecting.
+ *
+ * @param endpoint The endpoint
+ * @param listening Whether to listen rather than connect
+ * @param bound Set to the endpoint with the port actually bound
+ * @return Socket The socket
+ * @throws std::runtime_error if the endpoint is malformed or unreachable
+ */
+Socket open_socket(const std::string& endpoint,
+                   bool listening,
+                   std::string* bound = nullptr) {
+    if (endpoint.rfind(UNIX_PREFIX, 0) == 0) {
+        const std::string path = endpoint.substr(sizeof(UNIX_PREFIX) - 1);
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        if (path.empty() || path.size() >= sizeof(address.sun_path))
+            throw std::runtime_error("Invalid sweep socket: " + endpoint);
+        std::memcpy(address.sun_path, path.c_str(), path.size());
+        Socket socket(::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0));
+        if (socket.fd() < 0)
+            socket_error("Failed to open", endpoint);
+        const auto* raw = reinterpret_cast<sockaddr*>(&address);
+        if (listening) {
+            ::unlink(path.c_str());
+            if (::bind(socket.fd(), raw, sizeof(address)) != 0 ||
+                ::listen(socket.fd(), SOMAXCONN) != 0)
+                socket_error("Failed to listen on", endpoint);
+        } else if (::connect(socket.fd(), raw, sizeof(address)) != 0) {
+            socket_error("Failed to connect to", endpoint);
+        }
+        if (bound)
+            *bound = endpoint;
+        return socket;
+    }
+    const auto colon = endpoint.rfind(':');
+    if (colon == std::string::npos || colon + 1 == endpoint.size())
+        throw std::runtime_error("Invalid sweep endpoint: " + endpoint);
+    const std::string host = endpoint.substr(0, colon);
+    const std::string port = endpoint.substr(colon + 1);
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = listening ? AI_PASSIVE : 0;
+    addrinfo* found = nullptr;
+    const int status = ::getaddrinfo(host.empty() ? nullptr : host.c_str(),
+                                     port.c_str(), &hints, &found);
+    if (status != 0)
+        throw std::runtime_error("Failed to resolve " + endpoint + ": " +
+                                 ::gai_strerror(status));
+    Socket socket;
+    for (const addrinfo* at = found; at; at = at->ai_next) {
+        Socket attempt(::socket(at->ai_family, at->ai_socktype | SOCK_CLOEXEC,
+                                at->ai_protocol));
+        if (attempt.fd() < 0)
+            continue;
+        if (listening) {
+            const int on = 1;
+            ::setsockopt(attempt.fd(), SOL_SOCKET, SO_REUSEADDR, &on,
+                         sizeof(on));
+            if (::bind(attempt.fd(), at->ai_addr, at->ai_addrlen) != 0 ||
+                ::listen(attempt.fd(), SOMAXCONN) != 0)
+                continue;
+        } else if (::connect(attempt.fd(), at->ai_addr, at->ai_addrlen) != 0) {
+            continue;
+        }
+        socket = std::move(attempt);
+        break;
+    }
+    ::freeaddrinfo(found);
+    if (socket.fd() < 0)
+        socket_error(listening ? "Failed to listen on" : "Failed to connect to",
+                     endpoint);
+    if (bound) {
+        sockaddr_storage address{};
+        socklen_t length = sizeof(address);
+        char service[NI_MAXSERV] = "";
+        ::getsockname(socket.fd(), reinterpret_cast<sockaddr*>(&address),
+                      &length);
+        ::getnameinfo(reinterpret_cast<sockaddr*>(&address), length, nullptr,
+                      0, service, sizeof(service), NI_NUMERICSERV);
+        *bound = host + ":" + service;
+    }
+    return socket;
+}
+
+/**
+ * Sends all of text, without raising SIGPIPE on a closed peer.
+ *
+ * @return bool false if the connection failed
+ */
+bool send_all(int fd, std::string_view text) {
+    while (!text.empty()) {
+        const auto sent = ::send(fd, text.data(), text.size(), MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        text.remove_prefix(static_cast<std::size_t>(sent));
+    }
+    return true;
+}
+
+/**
+ * Reads what is available into buffer.
+ *
+ * @return bool false once the peer closed the connection or it failed
+ */
+bool receive(int fd, std::string& buffer) {
+    char block[4096];
+    for (;;) {
+        const auto got = ::recv(fd, block, sizeof(block), 0);
+        if (got < 0 && errno == EINTR)
+            continue;
+        if (got <= 0)
+            return false;
+        buffer.append(block, static_cast<std::size_t>(got));
+        return true;
+    }
+}
+
+/**
+ * Takes the first complete line out of buffer.
+ *
+ * @return bool false if buffer holds no complete line
+ */
+bool take_line(std::string& buffer, std::string& line) {
+    const auto end = buffer.find('\n');
+    if (end == std::string::npos)
+        return false;
+    line.assign(buffer, 0, end);
+    buffer.erase(0, end + 1);
+    return true;
+}
+
+std::string item_name(const Sweep::Item& item) {
+    return item.variable ? std::string(1, item.variable)
+                         : "m[" + item.index.str() + "]";
+}
+
+} // namespace
+
+/**
+ * Sweep Constructor
+ *
+ * @param path The manifest file
+ * @throws std::runtime_error if the file cannot be read or is malformed
+ */
+Sweep::Sweep(std::string_view path)
+  : path_(path)
+  , shard_size_(SUBARUU_SWEEP_SHARD) {
+    IO io(path);
+    parse(std::string(io.begin(), io.end()));
+}
+
+/**
+ * Sweep Constructor
+ *
+ * @param path Name of the manifest, used to resolve the program path and
+ *             in error messages
+ * @param text The manifest
+ * @throws std::runtime_error if the manifest is malformed
+ */
+Sweep::Sweep(std::string_view path, std::string_view text)
+  : path_(path)
+  , shard_size_(SUBARUU_SWEEP_SHARD) {
+    parse(text);
+}
+
+/**
+ * point
+ *
+ * @param run A run number below size()
+ * @return std::vector<value_t> The value of each axis' variable in it
+ */
+std::vector<Sweep::value_t> Sweep::point(std::size_t run) const {
+    std::vector<value_t> values(axes_.size());
+    for (std::size_t i = axes_.size(); i-- > 0;) {
+        const auto& axis = axes_[i].values;
+        values[i] = axis[run % axis.size()];
+        run /= axis.size();
+    }
+    return values;
+}
+
+/**
+ * run
+ *
+ * @param first The first run
+ * @param count Number of runs
+ * @param options Options for the program; PRINT output is dropped
+ * @return std::vector<Result> One result per run
+ * @throws std::runtime_error if the program cannot be loaded
+ */
+std::vector<Sweep::Result> Sweep::run(std::size_t first,
+                                      std::size_t count,
+                                      const SUBARUU::Options& options) const {
+    Discard discard;
+    std::ostream dropped(&discard);
+    auto run_options = options;
+    run_options.output = &dropped;
+    const SUBARUU loaded(program_, run_options);
+    std::vector<Result> results;
+    results.reserve(count);
+    for (std::size_t run = first; run < first + count && run < size_; ++run)
+        results.push_back(run_one(loaded, run));
+    return results;
+}
+
+/**
+ * table
+ *
+ * Columns: run, the axis variables, the report items and the status ("ok"
+ * or the error). Results need not be in order.
+ *
+ * @param out Where to write the table
+ * @param results Results of the runs
+ * @return void
+ */
+void Sweep::table(std::ostream& out, const std::vector<Result>& results) const {
+    out << "run";
+    for (const auto& axis : axes_)
+        out << '\t' << axis.variable;
+    for (const auto& item : report_)
+        out << '\t' << item_name(item);
+    out << "\tstatus\n";
+    std::vector<const Result*> ordered;
+    for (const auto& result : results)
+        ordered.push_back(&result);
+    std::sort(ordered.begin(), ordered.end(),
+              [](const Result* a, const Result* b) { return a->run < b->run; });
+    for (const auto* result : ordered) {
+        out << result->run;
+        for (const auto& value : point(result->run))
+            out << '\t' << value;
+        for (std::size_t i = 0; i < report_.size(); ++i) {
+            out << '\t';
+            if (result->ok)
+                out << result->values[i];
+        }
+        out << '\t' << (result->ok ? "ok" : "error: " + result->error) << '\n';
+    }
+}
+
+/**
+ * encode
+ *
+ * @param result A run's result
+ * @return std::string "RESULT RUN ok VALUE..." or "RESULT RUN error TEXT",
+ *         ending in a newline
+ */
+std::string Sweep::encode(const Result& result) {
+    std::string line = "RESULT " + std::to_string(result.run);
+    if (result.ok) {
+        line += " ok";
+        for (const auto& value : result.values)
+            line += " " + value.str();
+    } else {
+        std::string error = result.error;
+        std::replace(error.begin(), error.end(), '\n', ' ');
+        line += " error " + error;
+    }
+    return line + "\n";
+}
+
+/**
+ * decode
+ *
+ * @param line A line made by encode(), without its newline
+ * @return Result The result
+ * @throws std::runtime_error if the line is malformed
+ */
+Sweep::Result Sweep::decode(std::string_view line) {
+    std::istringstream fields{ std::string(line) };
+    std::string keyword, status;
+    Result result;
+    if (!(fields >> keyword >> result.run >> status) || keyword != "RESULT" ||
+        (status != "ok" && status != "error"))
+        throw std::runtime_error("Malformed sweep result: " + std::string(line));
+    result.ok = status == "ok";
+    if (!result.ok) {
+        std::getline(fields >> std::ws, result.error);
+        return result;
+    }
+    std::string word;
+    while (fields >> word) {
+        try {
+            result.values.emplace_back(word);
+        } catch (const std::exception&) {
+            throw std::runtime_error("Malformed sweep result: " +
+                                     std::string(line));
+        }
+    }
+    return result;
+}
+
+/**
+ * work
+ *
+ * @param endpoint The coordinator
+ * @param options Options for the program
+ * @param failed When given, incremented once per failed run
+ * @return std::size_t Runs done
+ * @throws std::runtime_error if the coordinator cannot be reached, refuses
+ *         this worker or breaks the protocol
+ */
+std::size_t Sweep::work(const std::string& endpoint,
+                        const SUBARUU::Options& options,
+                        std::size_t* failed) const {
+    const Socket socket = open_socket(endpoint, false);
+    const auto lost = [&endpoint] {
+        throw std::runtime_error("Lost the coordinator at " + endpoint);
+    };
+    if (!send_all(socket.fd(), "HELLO " + std::to_string(fingerprint_) + "\n"))
+        lost();
+    std::string buffer, line;
+    std::size_t done = 0;
+    for (;;) {
+        while (!take_line(buffer, line)) {
+            if (!receive(socket.fd(), buffer))
+                lost();
+        }
+        std::istringstream fields(line);
+        std::string keyword;
+        fields >> keyword;
+        if (keyword == "FINISH")
+            return done;
+        if (keyword == "BYE") {
+            std::string reason;
+            std::getline(fields >> std::ws, reason);
+            throw std::runtime_error("Coordinator refused this worker: " +
+                                     reason);
+        }
+        std::size_t shard = 0, first = 0, count = 0;
+        if (keyword != "SHARD" || !(fields >> shard >> first >> count) ||
+            first + count > size_)
+            throw std::runtime_error("Unexpected message from coordinator: " +
+                                     line);
+        std::vector<Result> results;
+        try {
+            results = run(first, count, options);
+        } catch (const std::exception& e) {
+            // The coordinator hears of a program that cannot be loaded as
+            // one failed run per run of the shard
+            for (std::size_t run = first; run < first + count; ++run)
+                results.push_back(Result{ run, false, {}, e.what() });
+        }
+        std::string reply;
+        for (const auto& result : results) {
+            reply += encode(result);
+            if (failed && !result.ok)
+                ++*failed;
+        }
+        reply += "DONE " + std::to_string(shard) + "\n";
+        if (!send_all(socket.fd(), reply))
+            lost();
+        done += count;
+    }
+}
+
+/******************************************************************************/
+
+/**
+ * parse
+ *
+ * @param text The manifest
+ * @throws std::runtime_error naming the line of the first problem, or if
+ *         the program cannot be read
+ */
+void Sweep::parse(std::string_view text) {
+    const auto dir = std::filesystem::path(path_).parent_path();
+    std::istringstream in{ std::string(text) };
+    std::string line;
+    for (int number = 1; std::getline(in, line); ++number) {
+        const auto fail = [&](const std::string& message) {
+            throw std::runtime_error(path_ + ":" + std::to_string(number) +
+                                     ": " + message);
+        };
+        const auto variable = [&](const std::string& word) {
+            if (word.size() != 1 || word[0] < 'a' || word[0] > 'z')
+                fail("expected a variable a to z, not " + word);
+            return word[0];
+        };
+        const auto numeric = [&](const std::string& word) {
+            try {
+                return value_t(word);
+            } catch (const std::exception&) {
+                fail("expected a number, not " + word);
+            }
+            return value_t(0);
+        };
+        std::istringstream fields(line);
+        std::string keyword;
+        if (!(fields >> keyword) || keyword[0] == '#')
+            continue;
+        if (keyword == "program") {
+            std::filesystem::path program;
+            if (!(fields >> program))
+                fail("expected a program");
+            if (!program_.empty())
+                fail("the program is already given");
+            if (program.is_relative())
+                program = dir / program;
+            program_ = program.string();
+        } else if (keyword == "vary") {
+            std::string name;
+            if (!(fields >> name))
+                fail("expected a variable after vary");
+            Axis axis{ variable(name), {} };
+            for (const auto& other : axes_)
+                if (other.variable == axis.variable)
+                    fail(name + " already varies");
+            std::vector<std::string> words;
+            for (std::string word; fields >> word;)
+                words.push_back(word);
+            if (words.size() >= 3 && words[1] == "TO") {
+                const value_t from = numeric(words[0]);
+                const value_t to = numeric(words[2]);
+                value_t step = 1;
+                if (words.size() == 5 && words[3] == "STEP")
+                    step = numeric(words[4]);
+                else if (words.size() != 3)
+                    fail("expected vary VAR FIRST TO LAST [STEP S]");
+                if (step <= 0 || to < from)
+                    fail("expected FIRST <= LAST and a positive STEP");
+                if ((to - from) / step >= SUBARUU_SWEEP_MAX_RUNS)
+                    fail("too many values for " + name);
+                for (value_t value = from; value <= to; value += step)
+                    axis.values.push_back(value);
+            } else {
+                for (const auto& word : words)
+                    axis.values.push_back(numeric(word));
+            }
+            if (axis.values.empty())
+                fail("expected values after vary " + name);
+            if (axis.values.size() > SUBARUU_SWEEP_MAX_RUNS / size_)
+                fail("the grid has more than " +
+                     std::to_string(SUBARUU_SWEEP_MAX_RUNS) + " points");
+            size_ *= axis.values.size();
+            axes_.push_back(std::move(axis));
+        } else if (keyword == "report") {
+            for (std::string word; fields >> word;) {
+                if (word.size() > 3 && word.compare(0, 2, "m[") == 0 &&
+                    word.back() == ']') {
+                    report_.push_back(
+                      Item{ 0, numeric(word.substr(2, word.size() - 3)) });
+                } else {
+                    report_.push_back(Item{ variable(word), 0 });
+                }
+            }
+        } else if (keyword == "shard") {
+            if (!(fields >> shard_size_) || shard_size_ == 0)
+                fail("expected a positive number of runs per shard");
+        } else {
+            fail("unknown keyword " + keyword);
+        }
+        std::string extra;
+        if (fields >> extra)
+            fail("unexpected " + extra);
+    }
+    if (program_.empty())
+        throw std::runtime_error(path_ + ": no program given");
+    fingerprint_ =
+      History::hash(std::string(text) + '\0' + Module::link(program_));
+}
+
+/**
+ * run_one
+ *
+ * @param loaded The program, loaded and not yet run
+ * @param run The run number
+ * @return Result What the run reported, or its error
+ */
+Sweep::Result Sweep::run_one(const SUBARUU& loaded, std::size_t run) const {
+    Result result;
+    result.run = run;
+    try {
+        const auto subaruu = loaded.clone();
+        const auto values = point(run);
+        for (std::size_t i = 0; i < axes_.size(); ++i)
+            subaruu->set_variable(axes_[i].variable, values[i]);
+        subaruu->run();
+        for (const auto& item : report_)
+            result.values.push_back(item.variable
+                                      ? subaruu->variable(item.variable)
+                                      : subaruu->peek(item.index));
+        result.ok = true;
+    } catch (const std::exception& e) {
+        result.error = e.what();
+    }
+    return result;
+}
+
+/******************************************************************************/
+
+/**
+ * Coordinator Constructor
+ *
+ * @param sweep The sweep to hand out; must outlive the coordinator
+ * @param endpoint Where to listen
+ * @throws std::runtime_error if the endpoint cannot be listened on
+ */
+Coordinator::Coordinator(const Sweep& sweep, const std::string& endpoint)
+  : sweep_(sweep) {
+    listen_fd_ = open_socket(endpoint, true, &endpoint_).release();
+    if (endpoint.rfind(UNIX_PREFIX, 0) == 0)
+        socket_path_ = endpoint.substr(sizeof(UNIX_PREFIX) - 1);
+}
+
+/**
+ * Coordinator Destructor
+ *
+ * Stops listening and removes the socket file.
+ */
+Coordinator::~Coordinator() {
+    ::close(listen_fd_);
+    if (!socket_path_.empty())
+        ::unlink(socket_path_.c_str());
+}
+
+/**
+ * run
+ *
+ * One thread polls the listening socket and every worker. A worker that
+ * disconnects, breaks the protocol or sends a result outside its shard or
+ * with the wrong number of report items is dropped and its shard queued
+ * again, ahead of the rest. When all runs are in, every worker connected
+ * so far is told to finish. Polls time out every SUBARUU_SWEEP_POLL_MS so
+ * that `supervise` can look after the worker processes even while none of
+ * them speaks.
+ *
+ * @param supervise Starts workers again and returns how many may still
+ *                  connect; without it, workers are awaited for ever
+ * @return std::vector<Sweep::Result> One result per run, in run order
+ * @throws std::runtime_error if a shard failed SUBARUU_SWEEP_ATTEMPTS
+ *         times, or no worker is connected and supervise expects none
+ */
+std::vector<Sweep::Result> Coordinator::run(
+  const std::function<std::size_t()>& supervise) {
+    struct Shard {
+        std::size_t first;
+        std::size_t count;
+        std::size_t attempts = 0;
+    };
+    struct Worker {
+        explicit Worker(Socket accepted)
+          : socket(std::move(accepted)) {}
+
+        Socket socket;
+        std::string buffer;
+        bool greeted = false;
+        bool failed = false;
+        std::size_t shard = SIZE_MAX; // SIZE_MAX when idle
+        std::vector<Sweep::Result> results;
+    };
+    const std::size_t size = sweep_.size();
+    std::vector<Shard> shards;
+    std::deque<std::size_t> queue;
+    for (std::size_t first = 0; first < size; first += sweep_.shard_size()) {
+        queue.push_back(shards.size());
+        shards.push_back(Shard{ first, std::min(sweep_.shard_size(),
+                                                size - first) });
+    }
+    std::vector<Sweep::Result> results(size);
+    std::size_t remaining = shards.size();
+    std::deque<Worker> workers;
+    const std::string expected =
+      "HELLO " + std::to_string(sweep_.fingerprint());
+
+    // A line from a worker; false if the worker broke the protocol
+    const auto handle = [&](Worker& worker, const std::string& line) {
+        if (!worker.greeted) {
+            worker.greeted = line == expected;
+            if (!worker.greeted)
+                send_all(worker.socket.fd(), "BYE different sweep\n");
+            return worker.greeted;
+        }
+        if (worker.shard == SIZE_MAX)
+            return false;
+        const auto& shard = shards[worker.shard];
+        if (line.rfind("RESULT ", 0) == 0) {
+            try {
+                // Runs come in order, so each must be the next one, and a
+                // run that succeeded reports every item
+                auto result = Sweep::decode(line);
+                if (worker.results.size() == shard.count ||
+                    result.run != shard.first + worker.results.size() ||
+                    (result.ok &&
+                     result.values.size() != sweep_.report().size()))
+                    return false;
+                worker.results.push_back(std::move(result));
+                return true;
+            } catch (const std::exception&) {
+                return false;
+            }
+        }
+        if (line != "DONE " + std::to_string(worker.shard) ||
+            worker.results.size() != shard.count)
+            return false;
+        for (auto& result : worker.results)
+            results[result.run] = std::move(result);
+        worker.results.clear();
+        worker.shard = SIZE_MAX;
+        --remaining;
+        return true;
+    };
+
+    while (remaining > 0) {
+        for (auto it = workers.begin(); it != workers.end();) {
+            if (!it->failed) {
+                ++it;
+                continue;
+            }
+            if (it->shard != SIZE_MAX) {
+                if (shards[it->shard].attempts >= SUBARUU_SWEEP_ATTEMPTS)
+                    throw std::runtime_error(
+                      "Sweep shard " + std::to_string(it->shard) + " failed " +
+                      std::to_string(SUBARUU_SWEEP_ATTEMPTS) + " times");
+                queue.push_front(it->shard);
+                ++retries_;
+            }
+            it = workers.erase(it);
+        }
+        for (auto& worker : workers) {
+            if (worker.greeted && !worker.failed &&
+                worker.shard == SIZE_MAX && !queue.empty()) {
+                const auto shard = queue.front();
+                queue.pop_front();
+                ++shards[shard].attempts;
+                worker.shard = shard;
+                worker.failed = !send_all(
+                  worker.socket.fd(),
+                  "SHARD " + std::to_string(shard) + " " +
+                    std::to_string(shards[shard].first) + " " +
+                    std::to_string(shards[shard].count) + "\n");
+            }
+        }
+
+        const bool abandoned = supervise && supervise() == 0;
+        std::vector<pollfd> polled{ { listen_fd_, POLLIN, 0 } };
+        for (const auto& worker : workers)
+            polled.push_back({ worker.socket.fd(), POLLIN, 0 });
+        if (::poll(polled.data(), polled.size(), SUBARUU_SWEEP_POLL_MS) < 0) {
+            if (errno == EINTR)
+                continue;
+            throw std::runtime_error(std::string("Sweep poll failed: ") +
+                                     std::strerror(errno));
+        }
+        for (std::size_t i = 1; i < polled.size(); ++i) {
+            if (!polled[i].revents)
+                continue;
+            auto& worker = workers[i - 1];
+            if (!receive(worker.socket.fd(), worker.buffer)) {
+                worker.failed = true;
+                continue;
+            }
+            std::string line;
+            while (!worker.failed && take_line(worker.buffer, line))
+                worker.failed = !handle(worker, line);
+        }
+        if (polled[0].revents & POLLIN) {
+            Socket accepted(::accept4(listen_fd_, nullptr, nullptr,
+                                      SOCK_CLOEXEC));
+            if (accepted.fd() >= 0)
+                workers.emplace_back(std::move(accepted));
+        }
+        if (abandoned && workers.empty())
+            throw std::runtime_error(
+              "No sweep workers left with " + std::to_string(remaining) +
+              " shards to go");
+    }
+    // Workers still waiting to be accepted are done too
+    pollfd pending{ listen_fd_, POLLIN, 0 };
+    while (::poll(&pending, 1, 0) > 0 && (pending.revents & POLLIN)) {
+        Socket accepted(::accept4(listen_fd_, nullptr, nullptr, SOCK_CLOEXEC));
+        if (accepted.fd() < 0)
+            break;
+        workers.emplace_back(std::move(accepted));
+    }
+    for (const auto& worker : workers)
+        send_all(worker.socket.fd(), "FINISH\n");
+    return results;
+}
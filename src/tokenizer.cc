@@ -1,6 +1,7 @@
 // tokenizer.cc
 
 #include "../include/tokenizer.h"
+#include "../include/bytecode.h"
 #include "../include/common.h"
 
 #include <boost/multiprecision/cpp_int.hpp>
@@ -8,6 +9,7 @@
 #include <cstdlib>
 #include <iostream>
 #include <string_view>
+#include <utility>
 
 /******************************************************************************/
 
@@ -27,6 +29,37 @@ Tokenizer::Tokenizer(std::string_view source)
     current_token_ = get_next_token();
 }
 
+/**
+ * Tokenizer Constructor
+ *
+ * Constructs a new Tokenizer over an already opened IO (e.g. a linked
+ * program held in memory)
+ *
+ * @param io The IO to read from; the tokenizer takes ownership
+ */
+Tokenizer::Tokenizer(std::unique_ptr<IO> io)
+  : io_(std::move(io))
+  , current_token_(TokenType::ERROR)
+  , token_data_(std::monostate()) {
+    current_token_ = get_next_token();
+}
+
+/**
+ * Tokenizer Constructor
+ *
+ * Constructs a Tokenizer that decodes a compiled program (see Bytecode).
+ * Offsets are then positions in the code rather than in source text, and
+ * the character-level helpers (peek_char, skip_char) have nothing to read.
+ *
+ * @param code The compiled program, shared with other tokenizers
+ */
+Tokenizer::Tokenizer(std::shared_ptr<const Bytecode> code)
+  : code_(std::move(code))
+  , current_token_(TokenType::ERROR)
+  , token_data_(std::monostate()) {
+    current_token_ = get_next_token();
+}
+
 /**
  * Tokenizer Destructor
  *
@@ -51,11 +84,29 @@ Tokenizer::~Tokenizer() {
  */
 void Tokenizer::reset() {
     DEBUG_LOG("Resetting tokenizer");
-    io_->reset();
+    if (code_)
+        code_pos_ = 0;
+    else
+        io_->reset();
     token_data_ = std::monostate();
     current_token_ = get_next_token();
 }
 
+/**
+ * clone
+ *
+ * Creates a tokenizer over the same text (shared, not copied) positioned
+ * at the current token
+ *
+ * @return std::unique_ptr<Tokenizer> The copy
+ */
+std::unique_ptr<Tokenizer> Tokenizer::clone() const {
+    auto copy = code_ ? std::make_unique<Tokenizer>(code_)
+                      : std::make_unique<Tokenizer>(io_->share());
+    copy->seek(token_offset_);
+    return copy;
+}
+
 /**
  * reset
  *
@@ -66,6 +117,24 @@ void Tokenizer::reset() {
  */
 void Tokenizer::reset(TokenType to) { current_token_ = to; }
 
+/**
+ * seek
+ *
+ * Moves to a token start previously reported by offset() and lexes the
+ * token found there
+ *
+ * @param offset Source offset of the token
+ * @return void
+ */
+void Tokenizer::seek(std::size_t offset) {
+    if (code_)
+        code_pos_ = offset;
+    else
+        io_->seek(static_cast<long>(offset));
+    token_data_ = std::monostate();
+    current_token_ = get_next_token();
+}
+
 /**
  * peek_char
  *
@@ -75,6 +144,8 @@ void Tokenizer::reset(TokenType to) { current_token_ = to; }
  * @return Next character in input stream
  */
 char Tokenizer::peek_char() {
+    if (code_)
+        return '\0';
     auto it = io_->position();
     auto end = io_->end();
     if (it != end) {
@@ -94,7 +165,10 @@ char Tokenizer::peek_char() {
  * @param void
  * @return void
  */
-void Tokenizer::skip_char() { io_->next(); }
+void Tokenizer::skip_char() {
+    if (!code_)
+        io_->next();
+}
 
 /**
  * token_to_string
@@ -114,6 +188,8 @@ std::string_view Tokenizer::token_to_string(TokenType token) const {
             return "NUMBER";
         case TokenType::LETTER:
             return "LETTER";
+        case TokenType::STRING_VAR:
+            return "STRING_VAR";
         case TokenType::STRING:
             return "STRING";
         case TokenType::EQUAL:
@@ -150,10 +226,78 @@ std::string_view Tokenizer::token_to_string(TokenType token) const {
             return "PRINT$";
         case TokenType::TAB: // NEW
             return "TAB";
+        case TokenType::USING:
+            return "USING";
         case TokenType::REM:
             return "REM";
         case TokenType::GOTO:
             return "GOTO";
+        case TokenType::MERGE:
+            return "MERGE";
+        case TokenType::CHAIN:
+            return "CHAIN";
+        case TokenType::OPEN:
+            return "OPEN";
+        case TokenType::FOR:
+            return "FOR";
+        case TokenType::OUTPUT:
+            return "OUTPUT";
+        case TokenType::AS:
+            return "AS";
+        case TokenType::CLOSE:
+            return "CLOSE";
+        case TokenType::HASH:
+            return "HASH";
+        case TokenType::INPUT:
+            return "INPUT";
+        case TokenType::TO:
+            return "TO";
+        case TokenType::RND:
+            return "RND";
+        case TokenType::RANDOMIZE:
+            return "RANDOMIZE";
+        case TokenType::LEN:
+            return "LEN";
+        case TokenType::ASC:
+            return "ASC";
+        case TokenType::MID_DOLLAR:
+            return "MID$";
+        case TokenType::LEFT_DOLLAR:
+            return "LEFT$";
+        case TokenType::RIGHT_DOLLAR:
+            return "RIGHT$";
+        case TokenType::CHR_DOLLAR:
+            return "CHR$";
+        case TokenType::STR_DOLLAR:
+            return "STR$";
+        case TokenType::WHILE:
+            return "WHILE";
+        case TokenType::WEND:
+            return "WEND";
+        case TokenType::DO:
+            return "DO";
+        case TokenType::LOOP:
+            return "LOOP";
+        case TokenType::UNTIL:
+            return "UNTIL";
+        case TokenType::SORT:
+            return "SORT";
+        case TokenType::DESC:
+            return "DESC";
+        case TokenType::SET:
+            return "SET";
+        case TokenType::GET:
+            return "GET";
+        case TokenType::HAS:
+            return "HAS";
+        case TokenType::DEL:
+            return "DEL";
+        case TokenType::AND:
+            return "AND";
+        case TokenType::OR:
+            return "OR";
+        case TokenType::NOT:
+            return "NOT";
         case TokenType::LEFT_PAREN:
             return "LEFT_PAREN";
         case TokenType::RIGHT_PAREN:
@@ -177,7 +321,7 @@ std::string_view Tokenizer::token_to_string(TokenType token) const {
  * @param void
  * @return Reference to variant containing:
  * - Empty state (monostate)
- * - String value
+ * - String value, owned or viewed in a Bytecode literal pool
  * - Integer value
  * - Character value
  */
@@ -227,6 +371,8 @@ int Tokenizer::variable_num() const {
  */
 std::string_view Tokenizer::get_string() const {
     static const std::string empty;
+    if (std::holds_alternative<std::string_view>(token_data_))
+        return std::get<std::string_view>(token_data_);
     if (std::holds_alternative<std::string>(token_data_))
         return std::get<std::string>(token_data_);
     return empty;
@@ -261,8 +407,11 @@ boost::multiprecision::cpp_int Tokenizer::get_num() const {
 void Tokenizer::next_token() {
     if (finished())
         return;
-    while (!io_->eof() && (io_->current() == ' ' || io_->current() == '\t'))
-        io_->next();
+    if (!code_) {
+        while (!io_->eof() &&
+               (io_->current() == ' ' || io_->current() == '\t'))
+            io_->next();
+    }
     current_token_ = get_next_token();
 }
 
@@ -277,6 +426,13 @@ void Tokenizer::next_token() {
  * @return void
  */
 void Tokenizer::skip_to_eol() {
+    if (code_) {
+        auto type = TokenType::ERROR;
+        while (code_pos_ < code_->end() && type != TokenType::EOL)
+            code_pos_ = code_->decode(code_pos_, type, token_data_);
+        current_token_ = get_next_token();
+        return;
+    }
     while (!io_->eof() && io_->current() != '\n' && io_->current() != '\r')
         io_->next();
     if (!io_->eof()) {
@@ -311,13 +467,24 @@ void Tokenizer::skip_to_eol() {
  * - Line endings
  */
 Tokenizer::TokenType Tokenizer::get_next_token() {
-    if (io_->eof())
+    if (code_) {
+        token_offset_ = code_pos_;
+        if (code_pos_ >= code_->end())
+            return TokenType::EOF_TOKEN;
+        TokenType type;
+        code_pos_ = code_->decode(code_pos_, type, token_data_);
+        return type;
+    }
+    if (io_->eof()) {
+        token_offset_ = io_->offset();
         return TokenType::EOF_TOKEN;
+    }
     char c = io_->current();
     while (!io_->eof() && (c == ' ' || c == '\t')) {
         io_->next();
         c = io_->current();
     }
+    token_offset_ = io_->offset();
     if (c == '\n' || c == '\r') {
         if (c == '\r') {
             io_->next();
@@ -337,6 +504,11 @@ Tokenizer::TokenType Tokenizer::get_next_token() {
             return token_keyword();
         token_data_ = c;
         io_->next();
+        // a$ names a string variable (no whitespace allowed before the $)
+        if (!io_->eof() && io_->current() == '$') {
+            io_->next();
+            return TokenType::STRING_VAR;
+        }
         return TokenType::LETTER;
     }
     if (c == ',' || c == ';') {
@@ -392,6 +564,9 @@ Tokenizer::TokenType Tokenizer::get_next_token() {
         case ']':
             io_->next();
             return TokenType::RIGHT_BRACKET;
+        case '#':
+            io_->next();
+            return TokenType::HASH;
         default:
             io_->next();
             return TokenType::ERROR;
@@ -459,12 +634,28 @@ Tokenizer::TokenType Tokenizer::token_keyword() {
         io_->next();
     }
 
-    // Detect PRINT$ (no whitespace allowed between T and $)
-    if (!io_->eof() && keyword == "PRINT" && io_->current() == '$') {
-        io_->next(); // consume '$'
-        while (!io_->eof() && (io_->current() == ' ' || io_->current() == '\t'))
-            io_->next();
-        return TokenType::PRINT_DOLLAR;
+    // Detect PRINT$, MID$ etc. (no whitespace allowed before the $)
+    if (!io_->eof() && io_->current() == '$') {
+        TokenType dollar = TokenType::ERROR;
+        if (keyword == "PRINT")
+            dollar = TokenType::PRINT_DOLLAR;
+        else if (keyword == "MID")
+            dollar = TokenType::MID_DOLLAR;
+        else if (keyword == "LEFT")
+            dollar = TokenType::LEFT_DOLLAR;
+        else if (keyword == "RIGHT")
+            dollar = TokenType::RIGHT_DOLLAR;
+        else if (keyword == "CHR")
+            dollar = TokenType::CHR_DOLLAR;
+        else if (keyword == "STR")
+            dollar = TokenType::STR_DOLLAR;
+        if (dollar != TokenType::ERROR) {
+            io_->next(); // consume '$'
+            while (!io_->eof() &&
+                   (io_->current() == ' ' || io_->current() == '\t'))
+                io_->next();
+            return dollar;
+        }
     }
 
     while (!io_->eof() && (io_->current() == ' ' || io_->current() == '\t'))
@@ -482,8 +673,64 @@ Tokenizer::TokenType Tokenizer::token_keyword() {
         return TokenType::THEN;
     if (keyword == "GOTO")
         return TokenType::GOTO;
+    if (keyword == "MERGE")
+        return TokenType::MERGE;
+    if (keyword == "CHAIN")
+        return TokenType::CHAIN;
+    if (keyword == "OPEN")
+        return TokenType::OPEN;
+    if (keyword == "FOR")
+        return TokenType::FOR;
+    if (keyword == "OUTPUT")
+        return TokenType::OUTPUT;
+    if (keyword == "AS")
+        return TokenType::AS;
+    if (keyword == "CLOSE")
+        return TokenType::CLOSE;
+    if (keyword == "INPUT")
+        return TokenType::INPUT;
+    if (keyword == "TO")
+        return TokenType::TO;
+    if (keyword == "RND")
+        return TokenType::RND;
+    if (keyword == "RANDOMIZE")
+        return TokenType::RANDOMIZE;
+    if (keyword == "LEN")
+        return TokenType::LEN;
+    if (keyword == "ASC")
+        return TokenType::ASC;
+    if (keyword == "WHILE")
+        return TokenType::WHILE;
+    if (keyword == "WEND")
+        return TokenType::WEND;
+    if (keyword == "DO")
+        return TokenType::DO;
+    if (keyword == "LOOP")
+        return TokenType::LOOP;
+    if (keyword == "UNTIL")
+        return TokenType::UNTIL;
+    if (keyword == "SORT")
+        return TokenType::SORT;
+    if (keyword == "DESC")
+        return TokenType::DESC;
+    if (keyword == "SET")
+        return TokenType::SET;
+    if (keyword == "GET")
+        return TokenType::GET;
+    if (keyword == "HAS")
+        return TokenType::HAS;
+    if (keyword == "DEL")
+        return TokenType::DEL;
+    if (keyword == "AND")
+        return TokenType::AND;
+    if (keyword == "OR")
+        return TokenType::OR;
+    if (keyword == "NOT")
+        return TokenType::NOT;
     if (keyword == "TAB") // allow TAB(n) inside PRINT/PRINT$
         return TokenType::TAB;
+    if (keyword == "USING")
+        return TokenType::USING;
 
     return TokenType::ERROR;
 }
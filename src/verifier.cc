@@ -0,0 +1,707 @@
+// verifier.cc
+
+#include "../include/verifier.h"
+
+#include <boost/multiprecision/cpp_int.hpp>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+
+/******************************************************************************/
+
+namespace {
+
+using TokenType = Tokenizer::TokenType;
+
+// Thrown inside a statement to abandon it; caught by verify()
+struct SyntaxError : std::runtime_error {
+    using std::runtime_error::runtime_error;
+};
+
+bool is_comparison(TokenType type) {
+    switch (type) {
+        case TokenType::EQUAL:
+        case TokenType::LT:
+        case TokenType::GT:
+        case TokenType::LT_EQ:
+        case TokenType::GT_EQ:
+        case TokenType::NOT_EQUAL:
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool is_string_start(TokenType type) {
+    switch (type) {
+        case TokenType::STRING:
+        case TokenType::STRING_VAR:
+        case TokenType::MID_DOLLAR:
+        case TokenType::LEFT_DOLLAR:
+        case TokenType::RIGHT_DOLLAR:
+        case TokenType::CHR_DOLLAR:
+        case TokenType::STR_DOLLAR:
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool is_numeric_start(TokenType type) {
+    switch (type) {
+        case TokenType::NUMBER:
+        case TokenType::LETTER:
+        case TokenType::LEFT_PAREN:
+        case TokenType::MINUS:
+        case TokenType::RND:
+        case TokenType::LEN:
+        case TokenType::ASC:
+        case TokenType::GET:
+        case TokenType::HAS:
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool is_end(TokenType type) {
+    return type == TokenType::EOL || type == TokenType::EOF_TOKEN;
+}
+
+bool is_line_label(long long number) {
+    return number >= 10 && number % 10 == 0;
+}
+
+} // namespace
+
+/**
+ * Verifier Constructor
+ *
+ * Verifies a whole program; the result is available through ok(),
+ * diagnostics() and report().
+ *
+ * @param name Name used for the program's IO
+ * @param text The linked program text
+ */
+Verifier::Verifier(std::string_view name, std::string text)
+  : Verifier(std::make_unique<Tokenizer>(
+      std::make_unique<IO>(name, std::move(text)))) {}
+
+/**
+ * Verifier Constructor
+ *
+ * @param tokenizer Tokenizer over the program, text or compiled
+ */
+Verifier::Verifier(std::unique_ptr<Tokenizer> tokenizer)
+  : tokenizer_(std::move(tokenizer)) {
+    next_line();
+    verify();
+    check_jumps();
+}
+
+/**
+ * report
+ *
+ * @param void
+ * @return Every problem found, one per line
+ */
+std::string Verifier::report() const {
+    std::string out;
+    for (const auto& d : diagnostics_) {
+        if (!out.empty())
+            out += '\n';
+        out += "  line " + std::to_string(d.line) + ": " + d.message;
+    }
+    return out;
+}
+
+/**
+ * next_line
+ *
+ * Reads the tokens up to the next end of line, tagging each with its BASIC
+ * line number and recording the line numbers that can be jumped to. REM
+ * text is dropped.
+ *
+ * @param void
+ * @return void
+ */
+void Verifier::next_line() {
+    tokens_.clear();
+    pos_ = 0;
+    while (!tokenizer_->finished()) {
+        const auto type = tokenizer_->current_token();
+        long long number = -1;
+        if (type == TokenType::NUMBER) {
+            const auto value = tokenizer_->get_num();
+            if (value <= std::numeric_limits<long long>::max())
+                number = static_cast<long long>(value);
+        }
+        if (at_line_start_ && is_line_label(number) &&
+            number <= std::numeric_limits<int>::max()) {
+            line_ = static_cast<int>(number);
+            lines_.insert(number);
+        }
+        tokens_.push_back(Token{ type, line_, number });
+        if (type == TokenType::REM) {
+            tokenizer_->skip_to_eol();
+            tokens_.push_back(Token{ TokenType::EOL, line_, -1 });
+            at_line_start_ = true;
+            return;
+        }
+        at_line_start_ = type == TokenType::EOL;
+        tokenizer_->next_token();
+        if (at_line_start_)
+            return;
+    }
+    tokens_.push_back(Token{ TokenType::EOF_TOKEN, line_, -1 });
+}
+
+/**
+ * verify
+ *
+ * Checks statement by statement. A broken statement is reported and
+ * skipped, so one run reports every problem in the program.
+ *
+ * @param void
+ * @return void
+ */
+void Verifier::verify() {
+    while (!at(TokenType::EOF_TOKEN)) {
+        if (at(TokenType::EOL)) {
+            advance();
+            continue;
+        }
+        if (at(TokenType::NUMBER))
+            advance(); // line number
+        if (is_end(peek().type))
+            continue;
+        const int line = peek().line;
+        if (!balanced(pos_)) {
+            diagnose(line, "Unbalanced parentheses or brackets");
+            skip_to_eol();
+            continue;
+        }
+        try {
+            statement();
+            end_of_statement();
+        } catch (const SyntaxError& e) {
+            diagnose(line, e.what());
+            skip_to_eol();
+        }
+    }
+    for (const auto& open : loops_)
+        diagnose(open.line, name(open.kind) + " is never closed");
+}
+
+/**
+ * check_jumps
+ *
+ * Reports the jump targets that name no line, each among the diagnostics
+ * where its statement was checked.
+ *
+ * @param void
+ * @return void
+ */
+void Verifier::check_jumps() {
+    for (auto it = jumps_.rbegin(); it != jumps_.rend(); ++it) {
+        if (lines_.count(it->number))
+            continue;
+        diagnostics_.insert(
+          diagnostics_.begin() + static_cast<std::ptrdiff_t>(it->diagnostic),
+          Diagnostic{ it->line,
+                      std::string(it->keyword) + " target " +
+                        (it->number < 0 ? std::string("(out of range)")
+                                        : std::to_string(it->number)) +
+                        " not found" });
+    }
+    jumps_.clear();
+}
+
+bool Verifier::balanced(std::size_t from) const {
+    int parens = 0;
+    int brackets = 0;
+    for (auto i = from; !is_end(tokens_[i].type); ++i) {
+        switch (tokens_[i].type) {
+            case TokenType::LEFT_PAREN:
+                ++parens;
+                break;
+            case TokenType::RIGHT_PAREN:
+                --parens;
+                break;
+            case TokenType::LEFT_BRACKET:
+                ++brackets;
+                break;
+            case TokenType::RIGHT_BRACKET:
+                --brackets;
+                break;
+            default:
+                break;
+        }
+        if (parens < 0 || brackets < 0)
+            return false;
+    }
+    return parens == 0 && brackets == 0;
+}
+
+void Verifier::skip_to_eol() {
+    while (!is_end(peek().type))
+        advance();
+}
+
+void Verifier::diagnose(int line, std::string message) {
+    diagnostics_.push_back(Diagnostic{ line, std::move(message) });
+}
+
+/******************************************************************************/
+
+void Verifier::statement() {
+    const auto type = peek().type;
+    switch (type) {
+        case TokenType::REM:
+            advance();
+            break;
+        case TokenType::PRINT:
+        case TokenType::PRINT_DOLLAR:
+            print_statement();
+            break;
+        case TokenType::IF:
+            advance();
+            condition();
+            expect(TokenType::THEN, "THEN");
+            jump_target("THEN");
+            break;
+        case TokenType::GOTO:
+            advance();
+            jump_target("GOTO");
+            break;
+        case TokenType::CHAIN:
+            advance();
+            expect(TokenType::STRING, "file name after CHAIN");
+            break;
+        case TokenType::OPEN:
+            advance();
+            expect(TokenType::STRING, "file name after OPEN");
+            expect(TokenType::FOR, "FOR");
+            expect(TokenType::OUTPUT, "OUTPUT");
+            expect(TokenType::AS, "AS");
+            expect(TokenType::HASH, "#channel");
+            expression();
+            break;
+        case TokenType::CLOSE:
+            advance();
+            if (at(TokenType::HASH)) {
+                advance();
+                expression();
+            }
+            break;
+        case TokenType::INPUT:
+            input_statement();
+            break;
+        case TokenType::RANDOMIZE:
+            advance();
+            expression();
+            if (at(TokenType::SEPARATOR)) {
+                advance();
+                expression();
+            }
+            break;
+        case TokenType::RND:
+            advance();
+            expect(TokenType::LETTER, "m[lo TO hi] after RND");
+            expect(TokenType::LEFT_BRACKET, "[");
+            expression();
+            expect(TokenType::TO, "TO");
+            expression();
+            expect(TokenType::RIGHT_BRACKET, "]");
+            expect(TokenType::SEPARATOR, ", bound");
+            expression();
+            break;
+        case TokenType::SORT:
+            advance();
+            expect(TokenType::LETTER, "m[lo TO hi] after SORT");
+            expect(TokenType::LEFT_BRACKET, "[");
+            expression();
+            expect(TokenType::TO, "TO");
+            expression();
+            expect(TokenType::RIGHT_BRACKET, "]");
+            if (at(TokenType::ASC) || at(TokenType::DESC))
+                advance();
+            if (at(TokenType::SEPARATOR)) {
+                advance();
+                expect(TokenType::LETTER, "m[first] after SORT range");
+                expect(TokenType::LEFT_BRACKET, "[");
+                expression();
+                expect(TokenType::RIGHT_BRACKET, "]");
+            }
+            break;
+        case TokenType::SET:
+            advance();
+            table_key("SET");
+            expect(TokenType::SEPARATOR, ", value");
+            expression();
+            break;
+        case TokenType::DEL:
+            advance();
+            table_key("DEL");
+            break;
+        case TokenType::WHILE:
+            open_loop(type);
+            condition();
+            break;
+        case TokenType::WEND:
+            close_loop(TokenType::WHILE);
+            break;
+        case TokenType::DO:
+            open_loop(type);
+            break;
+        case TokenType::LOOP:
+            close_loop(TokenType::DO);
+            if (at(TokenType::UNTIL) || at(TokenType::WHILE)) {
+                advance();
+                condition();
+            }
+            break;
+        case TokenType::LET:
+            advance();
+            assignment();
+            break;
+        case TokenType::LETTER:
+        case TokenType::STRING_VAR:
+            assignment();
+            break;
+        default:
+            fail("Unrecognized statement " + name(type));
+    }
+}
+
+// A statement ends at the end of the line, at ':' or, as in the executor,
+// where a line number begins
+void Verifier::end_of_statement() {
+    if (is_end(peek().type) || is_line_label(peek().number))
+        return;
+    fail("Unexpected " + name(peek().type) + " after statement");
+}
+
+void Verifier::print_statement() {
+    advance();
+    if (at(TokenType::HASH)) {
+        advance();
+        expression();
+        if (at(TokenType::SEPARATOR))
+            advance();
+    }
+    if (at(TokenType::USING)) {
+        advance();
+        string_expression();
+        while (at(TokenType::SEPARATOR)) {
+            advance();
+            const auto type = peek().type;
+            if (is_end(type) || is_line_label(peek().number))
+                return;
+            if (is_string_start(type))
+                string_expression();
+            else
+                expression();
+        }
+        return;
+    }
+    for (;;) {
+        const auto type = peek().type;
+        if (is_end(type) || is_line_label(peek().number))
+            return;
+        if (is_string_start(type)) {
+            string_expression();
+        } else if (type == TokenType::SEPARATOR) {
+            advance();
+        } else if (type == TokenType::TAB) {
+            advance();
+            expect(TokenType::LEFT_PAREN, "( after TAB");
+            expression();
+            expect(TokenType::RIGHT_PAREN, ")");
+        } else if (is_numeric_start(type)) {
+            expression();
+        } else {
+            return;
+        }
+    }
+}
+
+void Verifier::input_statement() {
+    advance();
+    for (;;) {
+        expect(TokenType::LETTER, "variable after INPUT");
+        if (at(TokenType::LEFT_BRACKET)) {
+            advance();
+            expression();
+            if (at(TokenType::TO)) {
+                advance();
+                expression();
+            }
+            expect(TokenType::RIGHT_BRACKET, "]");
+        }
+        if (!at(TokenType::SEPARATOR))
+            return;
+        advance();
+    }
+}
+
+void Verifier::assignment() {
+    if (at(TokenType::STRING_VAR)) {
+        advance();
+        index();
+        expect(TokenType::EQUAL, "=");
+        string_expression();
+        return;
+    }
+    expect(TokenType::LETTER, "variable name");
+    index();
+    expect(TokenType::EQUAL, "=");
+    expression();
+}
+
+// Missing targets are reported without abandoning the statement, once all
+// line numbers are known
+void Verifier::jump_target(const char* keyword) {
+    if (!at(TokenType::NUMBER))
+        fail(std::string("Expected line number after ") + keyword);
+    const auto& target = peek();
+    jumps_.push_back(
+      Jump{ target.line, target.number, keyword, diagnostics_.size() });
+    advance();
+}
+
+void Verifier::open_loop(TokenType kind) {
+    loops_.push_back(OpenLoop{ kind, peek().line });
+    advance();
+}
+
+void Verifier::close_loop(TokenType opener) {
+    const auto closer = peek().type;
+    if (loops_.empty() || loops_.back().kind != opener) {
+        diagnose(peek().line, name(closer) + " without " + name(opener));
+    } else {
+        loops_.pop_back();
+    }
+    advance();
+}
+
+/******************************************************************************/
+
+void Verifier::condition() {
+    and_condition();
+    while (at(TokenType::OR)) {
+        advance();
+        and_condition();
+    }
+}
+
+void Verifier::and_condition() {
+    not_condition();
+    while (at(TokenType::AND)) {
+        advance();
+        not_condition();
+    }
+}
+
+void Verifier::not_condition() {
+    if (at(TokenType::NOT)) {
+        advance();
+        not_condition();
+        return;
+    }
+    if (at(TokenType::LEFT_PAREN) && is_condition_group()) {
+        advance();
+        condition();
+        expect(TokenType::RIGHT_PAREN, ")");
+        return;
+    }
+    relation();
+}
+
+// Same rule as the executor: '(' opens a condition if a comparison or
+// logical operator sits directly inside it
+bool Verifier::is_condition_group() const {
+    int depth = 0;
+    for (auto i = pos_; !is_end(tokens_[i].type); ++i) {
+        const auto type = tokens_[i].type;
+        if (type == TokenType::LEFT_PAREN || type == TokenType::LEFT_BRACKET) {
+            ++depth;
+        } else if (type == TokenType::RIGHT_PAREN ||
+                   type == TokenType::RIGHT_BRACKET) {
+            if (--depth == 0)
+                return false;
+        } else if (depth == 1 &&
+                   (is_comparison(type) || type == TokenType::AND ||
+                    type == TokenType::OR || type == TokenType::NOT)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void Verifier::relation() {
+    if (is_string_start(peek().type)) {
+        string_expression();
+        if (!is_comparison(peek().type))
+            fail("Expected comparison after string");
+        advance();
+        string_expression();
+        return;
+    }
+    expression();
+    if (is_comparison(peek().type)) {
+        advance();
+        expression();
+    }
+}
+
+void Verifier::expression() {
+    term();
+    while (at(TokenType::PLUS) || at(TokenType::MINUS)) {
+        advance();
+        term();
+    }
+}
+
+void Verifier::term() {
+    factor();
+    while (at(TokenType::ASTERISK) || at(TokenType::SLASH)) {
+        advance();
+        factor();
+    }
+}
+
+void Verifier::factor() {
+    switch (peek().type) {
+        case TokenType::NUMBER:
+            advance();
+            break;
+        case TokenType::LETTER:
+            advance();
+            index();
+            break;
+        case TokenType::LEFT_PAREN:
+            advance();
+            expression();
+            expect(TokenType::RIGHT_PAREN, ")");
+            break;
+        case TokenType::MINUS:
+            advance();
+            factor();
+            break;
+        case TokenType::RND:
+            advance();
+            expect(TokenType::LEFT_PAREN, "( after RND");
+            expression();
+            expect(TokenType::RIGHT_PAREN, ")");
+            break;
+        case TokenType::LEN:
+        case TokenType::ASC:
+            advance();
+            expect(TokenType::LEFT_PAREN, "(");
+            string_expression();
+            expect(TokenType::RIGHT_PAREN, ")");
+            break;
+        case TokenType::GET:
+        case TokenType::HAS:
+            advance();
+            expect(TokenType::LEFT_PAREN, "(");
+            table_key("GET/HAS");
+            expect(TokenType::RIGHT_PAREN, ")");
+            break;
+        default:
+            fail("Unexpected " + name(peek().type) + " in expression");
+    }
+}
+
+void Verifier::string_expression() {
+    string_factor();
+    while (at(TokenType::PLUS)) {
+        advance();
+        string_factor();
+    }
+}
+
+void Verifier::string_factor() {
+    const auto type = peek().type;
+    switch (type) {
+        case TokenType::STRING:
+            advance();
+            break;
+        case TokenType::STRING_VAR:
+            advance();
+            index();
+            break;
+        case TokenType::MID_DOLLAR:
+            advance();
+            expect(TokenType::LEFT_PAREN, "(");
+            string_expression();
+            expect(TokenType::SEPARATOR, ",");
+            expression();
+            if (at(TokenType::SEPARATOR)) {
+                advance();
+                expression();
+            }
+            expect(TokenType::RIGHT_PAREN, ")");
+            break;
+        case TokenType::LEFT_DOLLAR:
+        case TokenType::RIGHT_DOLLAR:
+            advance();
+            expect(TokenType::LEFT_PAREN, "(");
+            string_expression();
+            expect(TokenType::SEPARATOR, ",");
+            expression();
+            expect(TokenType::RIGHT_PAREN, ")");
+            break;
+        case TokenType::CHR_DOLLAR:
+        case TokenType::STR_DOLLAR:
+            advance();
+            expect(TokenType::LEFT_PAREN, "(");
+            expression();
+            expect(TokenType::RIGHT_PAREN, ")");
+            break;
+        default:
+            fail("Expected string expression, got " + name(type));
+    }
+}
+
+// Optional [index] after a variable
+void Verifier::index() {
+    if (!at(TokenType::LEFT_BRACKET))
+        return;
+    advance();
+    expression();
+    expect(TokenType::RIGHT_BRACKET, "]");
+}
+
+void Verifier::table_key(const char* keyword) {
+    expect(TokenType::LETTER, (std::string("table after ") + keyword).c_str());
+    expect(TokenType::SEPARATOR, ", key");
+    if (is_string_start(peek().type))
+        string_expression();
+    else
+        expression();
+}
+
+/******************************************************************************/
+
+void Verifier::advance() {
+    if (at(TokenType::EOL))
+        next_line();
+    else if (!at(TokenType::EOF_TOKEN))
+        ++pos_;
+}
+
+void Verifier::expect(TokenType type, const char* what) {
+    if (!at(type))
+        fail(std::string("Expected ") + what + ", got " + name(peek().type));
+    advance();
+}
+
+void Verifier::fail(const std::string& message) const {
+    throw SyntaxError(message);
+}
+
+std::string Verifier::name(TokenType type) const {
+    return std::string(tokenizer_->token_to_string(type));
+}
@@ -0,0 +1,324 @@
+// writer.cc
+
+#include "../include/writer.h"
+#include "../include/config.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <unistd.h>
+#ifdef SUBARUU_WITH_ZLIB
+#include <zlib.h>
+#endif
+
+/******************************************************************************/
+
+// The gzip stream of a compressing writer and its output block
+struct BufferedWriter::Deflater {
+#ifdef SUBARUU_WITH_ZLIB
+    z_stream stream{};
+    std::vector<unsigned char> out;
+    bool dirty = false; // input since the last sync point
+
+    ~Deflater() { deflateEnd(&stream); }
+#endif
+};
+
+/**
+ * compression_for
+ *
+ * @param path An output path
+ * @return Compression GZIP if path ends in ".gz"
+ */
+BufferedWriter::Compression BufferedWriter::compression_for(
+  std::string_view path) noexcept {
+    constexpr std::string_view suffix = ".gz";
+    return path.size() > suffix.size() &&
+               path.substr(path.size() - suffix.size()) == suffix
+             ? Compression::GZIP
+             : Compression::NONE;
+}
+
+/**
+ * BufferedWriter Constructor
+ *
+ * Creates (or truncates) the output file and sets up the put area
+ *
+ * @param path The file to write, or "-" for stdout
+ * @param capacity Size of each buffer in bytes
+ * @param async Whether full buffers are written by a flusher thread
+ * @param compression How blocks are encoded on their way to the file
+ * @throws std::runtime_error If the file cannot be opened, or GZIP was
+ *         asked of a build without zlib
+ */
+BufferedWriter::BufferedWriter(std::string_view path,
+                               std::size_t capacity,
+                               bool async,
+                               Compression compression)
+  : path_(path)
+  , fd_(-1)
+  , async_(async)
+  , active_(std::max<std::size_t>(capacity, 1))
+  , pending_(async ? active_.size() : 0)
+  , pending_size_(0)
+  , stop_(false)
+  , error_(0) {
+    if (compression == Compression::GZIP) {
+#ifdef SUBARUU_WITH_ZLIB
+        deflater_ = std::make_unique<Deflater>();
+        // windowBits 15 + 16 selects the gzip wrapper
+        if (deflateInit2(&deflater_->stream, SUBARUU_GZIP_LEVEL, Z_DEFLATED,
+                         15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+            throw std::runtime_error("Failed to start compressing " + path_);
+        }
+        deflater_->out.resize(active_.size());
+#else
+        throw std::runtime_error("Cannot compress " + path_ +
+                                 ": built without zlib");
+#endif
+    }
+    fd_ = path_ == "-"
+            ? ::fcntl(STDOUT_FILENO, F_DUPFD_CLOEXEC, 0)
+            : ::open(path_.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                     0644);
+    if (fd_ < 0)
+        throw std::runtime_error("Failed to open file for output: " + path_);
+    setp(active_.data(), active_.data() + active_.size());
+    if (async_)
+        thread_ = std::thread(&BufferedWriter::flusher, this);
+}
+
+/**
+ * BufferedWriter Destructor
+ *
+ * Flushes and closes the file; write errors are dropped here, call close()
+ * to observe them
+ */
+BufferedWriter::~BufferedWriter() {
+    try {
+        close();
+    } catch (...) {
+    }
+}
+
+/**
+ * close
+ *
+ * Writes out everything buffered (and the gzip trailer), stops the flusher
+ * thread and closes the file. Does nothing if already closed.
+ *
+ * @param void
+ * @return void
+ * @throws std::runtime_error If any write to the file failed
+ */
+void BufferedWriter::close() {
+    if (fd_ < 0)
+        return;
+    hand_off(true);
+    if (async_) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        cv_.notify_all();
+        thread_.join();
+    }
+    if (deflater_ && error_ == 0)
+        error_ = emit(nullptr, 0, Flush::FINISH);
+    ::close(fd_);
+    fd_ = -1;
+    setp(nullptr, nullptr);
+    if (error_ != 0) {
+        throw std::runtime_error("Failed to write " + path_ + ": " +
+                                 std::strerror(error_));
+    }
+}
+
+/**
+ * overflow
+ *
+ * Called by the stream when the put area is full
+ *
+ * @param ch The character that did not fit, or eof
+ * @return ch on success, eof after a write error
+ */
+BufferedWriter::int_type BufferedWriter::overflow(int_type ch) {
+    if (fd_ < 0)
+        return traits_type::eof();
+    hand_off(false);
+    if (error_ != 0)
+        return traits_type::eof();
+    if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+        *pptr() = traits_type::to_char_type(ch);
+        pbump(1);
+    }
+    return traits_type::not_eof(ch);
+}
+
+/**
+ * sync
+ *
+ * Writes out the put area and waits until the file has received it; a
+ * compressed file gets a sync point, so it decompresses up to here
+ *
+ * @param void
+ * @return 0 on success, -1 after a write error
+ */
+int BufferedWriter::sync() {
+    if (fd_ < 0)
+        return -1;
+    hand_off(true);
+    // The flusher is idle now, so the stream is ours
+    if (deflater_ && error_ == 0)
+        error_ = emit(nullptr, 0, Flush::SYNC);
+    return error_ != 0 ? -1 : 0;
+}
+
+/**
+ * hand_off
+ *
+ * Passes the filled part of the put area on to the file: directly in sync
+ * mode, otherwise by swapping buffers with the flusher thread once it has
+ * finished the previous block
+ *
+ * @param wait Whether to wait until the block has been written
+ * @return void
+ */
+void BufferedWriter::hand_off(bool wait) {
+    const auto size = static_cast<std::size_t>(pptr() - pbase());
+    if (!async_) {
+        if (size > 0 && error_ == 0)
+            error_ = emit(pbase(), size, Flush::NONE);
+        setp(active_.data(), active_.data() + active_.size());
+        return;
+    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [this] { return pending_size_ == 0; });
+    if (size > 0) {
+        active_.swap(pending_);
+        pending_size_ = size;
+        cv_.notify_all();
+    }
+    setp(active_.data(), active_.data() + active_.size());
+    if (wait)
+        cv_.wait(lock, [this] { return pending_size_ == 0; });
+}
+
+/**
+ * emit
+ *
+ * Writes a block to the file, deflating it first if compressing
+ *
+ * @param data The bytes to write
+ * @param size Number of bytes
+ * @param flush How a compressed stream ends the block; ignored otherwise
+ * @return 0 on success, otherwise the errno of the failed write
+ */
+int BufferedWriter::emit(const char* data, std::size_t size, Flush flush) {
+    if (!deflater_)
+        return write_all(data, size);
+#ifdef SUBARUU_WITH_ZLIB
+    if (flush == Flush::SYNC && !deflater_->dirty)
+        return 0;
+    deflater_->dirty = flush == Flush::NONE && (deflater_->dirty || size > 0);
+    const int mode = flush == Flush::FINISH ? Z_FINISH
+                     : flush == Flush::SYNC ? Z_SYNC_FLUSH
+                                            : Z_NO_FLUSH;
+    auto& stream = deflater_->stream;
+    auto& out = deflater_->out;
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+    stream.avail_in = static_cast<uInt>(size);
+    for (;;) {
+        stream.next_out = out.data();
+        stream.avail_out = static_cast<uInt>(out.size());
+        const int status = deflate(&stream, mode);
+        if (status == Z_STREAM_ERROR)
+            return EIO;
+        const std::size_t produced = out.size() - stream.avail_out;
+        if (produced > 0) {
+            const int error = write_all(
+              reinterpret_cast<const char*>(out.data()), produced);
+            if (error != 0)
+                return error;
+        }
+        // Done once deflate stops filling whole output blocks
+        if (mode == Z_FINISH ? status == Z_STREAM_END : stream.avail_out != 0)
+            return 0;
+    }
+#else
+    static_cast<void>(flush);
+    return EINVAL;
+#endif
+}
+
+/**
+ * write_all
+ *
+ * Writes a block to the file, retrying short and interrupted writes
+ *
+ * @param data The bytes to write
+ * @param size Number of bytes
+ * @return 0 on success, otherwise the errno of the failed write
+ */
+int BufferedWriter::write_all(const char* data, std::size_t size) {
+    while (size > 0) {
+        const auto written = ::write(fd_, data, size);
+        if (written < 0) {
+            if (errno == EINTR)
+                continue;
+            return errno;
+        }
+        data += written;
+        size -= static_cast<std::size_t>(written);
+    }
+    return 0;
+}
+
+/**
+ * flusher
+ *
+ * Flusher thread body: writes each handed-off block until stopped
+ *
+ * @param void
+ * @return void
+ */
+void BufferedWriter::flusher() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        cv_.wait(lock, [this] { return pending_size_ > 0 || stop_; });
+        if (pending_size_ == 0)
+            return;
+        const auto size = pending_size_;
+        const bool failed = error_ != 0;
+        lock.unlock();
+        const int error =
+          failed ? 0 : emit(pending_.data(), size, Flush::NONE);
+        lock.lock();
+        if (error != 0)
+            error_ = error;
+        pending_size_ = 0;
+        cv_.notify_all();
+    }
+}
+
+/******************************************************************************/
+
+/**
+ * OutputFile Constructor
+ *
+ * @param path The file to write
+ * @param capacity Size of each buffer in bytes
+ * @param async Whether full buffers are written by a flusher thread
+ * @param compression How blocks are encoded on their way to the file
+ * @throws std::runtime_error If the file cannot be opened
+ */
+OutputFile::OutputFile(std::string_view path,
+                       std::size_t capacity,
+                       bool async,
+                       BufferedWriter::Compression compression)
+  : std::ostream(nullptr)
+  , buffer_(path, capacity, async, compression) {
+    rdbuf(&buffer_);
+}
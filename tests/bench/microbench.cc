@@ -0,0 +1,326 @@
+// microbench.cc
+//
+// Component microbenchmarks (Google Benchmark). Build and run with
+//   make microbench
+// Extra arguments can be passed through BENCH_ARGS, e.g.
+//   make microbench BENCH_ARGS=--benchmark_filter=Jump
+
+#include "../../include/bytecode.h"
+#include "../../include/io.h"
+#include "../../include/subaruu.h"
+#include "../../include/tokenizer.h"
+
+#include <algorithm>
+#include <benchmark/benchmark.h>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Writes `text` to a program file in the temp directory and removes it again
+// when the benchmark is done with it.
+class TempProgram {
+    public:
+        TempProgram(const std::string& name, const std::string& text)
+          : path_((std::filesystem::temp_directory_path() /
+                   ("subaru_bench_" + name + ".subaru"))
+                    .string()) {
+            std::ofstream(path_, std::ios::binary) << text;
+        }
+        ~TempProgram() { std::filesystem::remove(path_); }
+        const std::string& path() const { return path_; }
+
+    private:
+        std::string path_;
+};
+
+// Swallows PRINT output while a benchmarked program runs.
+class MuteCout {
+    public:
+        MuteCout()
+          : old_(std::cout.rdbuf(sink_.rdbuf())) {}
+        ~MuteCout() { std::cout.rdbuf(old_); }
+
+    private:
+        std::stringstream sink_;
+        std::streambuf* old_;
+};
+
+// Runs a fresh interpreter over `path` per iteration; only run() is timed.
+void run_program(benchmark::State& state,
+                 const std::string& path,
+                 std::int64_t items_per_run) {
+    MuteCout mute;
+    for (auto _ : state) {
+        state.PauseTiming();
+        auto interp = std::make_unique<SUBARUU>(path);
+        state.ResumeTiming();
+        interp->run();
+        state.PauseTiming();
+        interp.reset();
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(state.iterations() * items_per_run);
+}
+
+} // namespace
+
+/******************************************************************************/
+
+// IO::load_file() (via the constructor) by file size
+static void BM_IOLoadFile(benchmark::State& state) {
+    const auto size = static_cast<std::size_t>(state.range(0));
+    std::string text;
+    while (text.size() < size)
+        text += "10 LET a = a + 1\n";
+    text.resize(size);
+    TempProgram program("io_" + std::to_string(size), text);
+    for (auto _ : state) {
+        IO io(program.path());
+        benchmark::DoNotOptimize(io.current());
+    }
+    state.SetBytesProcessed(state.iterations() *
+                            static_cast<std::int64_t>(size));
+}
+BENCHMARK(BM_IOLoadFile)->RangeMultiplier(8)->Range(1 << 10, 1 << 24);
+
+// Tokenizer::next_token() throughput by token mix
+static void BM_TokenizerNextToken(benchmark::State& state) {
+    static const char* const mixes[] = {
+        "10 LET a = 12345 + 678 * 9\n",                // numbers
+        "20 IF a THEN 30\n30 GOTO 40\n40 PRINT$ a\n",  // keywords
+        "50 PRINT \"the quick brown fox\", \"jumps\"\n", // strings
+        "60 LET b = (a + b) * (c - d) / -(e + f)\n",   // operators
+        "70 LET m[100 + a] = m[200 + a] * m[300]\n",   // indexed memory
+    };
+    static const char* const names[] = {
+        "numbers", "keywords", "strings", "operators", "indexed"
+    };
+    const auto mix = static_cast<std::size_t>(state.range(0));
+    std::string text;
+    while (text.size() < (1 << 16))
+        text += mixes[mix];
+    Tokenizer tokenizer(std::make_unique<IO>("bench", text));
+    std::int64_t tokens = 0;
+    for (auto _ : state) {
+        tokenizer.reset();
+        while (!tokenizer.finished()) {
+            tokenizer.next_token();
+            ++tokens;
+        }
+    }
+    state.SetLabel(names[mix]);
+    state.SetItemsProcessed(tokens);
+    state.SetBytesProcessed(state.iterations() *
+                            static_cast<std::int64_t>(text.size()));
+}
+BENCHMARK(BM_TokenizerNextToken)->DenseRange(0, 4);
+
+// token_number() by digit count; reset() re-lexes the leading number
+static void BM_TokenNumber(benchmark::State& state) {
+    const auto digits = static_cast<std::size_t>(state.range(0));
+    std::string text;
+    for (std::size_t i = 0; i < digits; ++i)
+        text += static_cast<char>('1' + i % 9);
+    Tokenizer tokenizer(std::make_unique<IO>("bench", text));
+    for (auto _ : state) {
+        tokenizer.reset();
+        benchmark::DoNotOptimize(tokenizer.get_token_data());
+    }
+    state.SetBytesProcessed(state.iterations() *
+                            static_cast<std::int64_t>(digits));
+}
+BENCHMARK(BM_TokenNumber)->RangeMultiplier(4)->Range(1, 10000);
+
+// Token walk over a program held as compact bytecode (arg 0) or as one
+// wide {type, TokenData} record per token (arg 1). The bytes_per_source
+// counter is the in-memory size relative to the source text.
+static void BM_DecodeProgram(benchmark::State& state) {
+    struct WideToken {
+        Tokenizer::TokenType type;
+        Tokenizer::TokenData data;
+    };
+    std::string text;
+    for (int line = 10; text.size() < (1 << 16); line += 10)
+        text += std::to_string(line) + " LET m[a + " + std::to_string(line) +
+                "] = m[a] * 3 + b : PRINT \"value\", m[a]\n";
+    Tokenizer source(std::make_unique<IO>("bench", text));
+    std::int64_t tokens = 0;
+    double bytes = 0;
+    if (state.range(0) == 0) {
+        const auto code = Bytecode::compile(source);
+        bytes = static_cast<double>(code->size());
+        Tokenizer tokenizer(code);
+        for (auto _ : state) {
+            tokenizer.reset();
+            while (!tokenizer.finished()) {
+                benchmark::DoNotOptimize(tokenizer.get_token_data());
+                tokenizer.next_token();
+                ++tokens;
+            }
+        }
+        state.SetLabel("compact");
+    } else {
+        std::vector<WideToken> program;
+        for (; !source.finished(); source.next_token())
+            program.push_back({ source.current_token(),
+                                source.get_token_data() });
+        bytes = static_cast<double>(program.capacity() * sizeof(WideToken));
+        Tokenizer::TokenData current;
+        for (auto _ : state) {
+            for (const auto& token : program) {
+                current = token.data;
+                benchmark::DoNotOptimize(current);
+                ++tokens;
+            }
+        }
+        state.SetLabel("wide");
+    }
+    state.SetItemsProcessed(tokens);
+    state.counters["bytes_per_source"] =
+      bytes / static_cast<double>(text.size());
+}
+BENCHMARK(BM_DecodeProgram)->DenseRange(0, 1);
+
+// SUBARUU::expression() on representative expressions, via LET lines
+static void BM_Expression(benchmark::State& state) {
+    static const char* const exprs[] = {
+        "a + b",
+        "a * b + c / d",
+        "(a + b) * (c - d) / 7",
+        "m[100 + a] * m[200 + a] + e",
+        "-(-(-(a + 1)))",
+        "f * f * f",
+    };
+    constexpr int lines = 256;
+    const auto which = static_cast<std::size_t>(state.range(0));
+    std::string text = "10 LET a = 5\n20 LET b = 3\n30 LET c = 8\n"
+                       "40 LET d = 2\n50 LET e = 1\n"
+                       "60 LET f = 123456789012345678901234567890\n";
+    for (int i = 0; i < lines; ++i)
+        text += std::to_string(100 + i * 10) + " LET x = " + exprs[which] +
+                "\n";
+    TempProgram program("expr_" + std::to_string(which), text);
+    state.SetLabel(exprs[which]);
+    run_program(state, program.path(), lines);
+}
+BENCHMARK(BM_Expression)->DenseRange(0, 5);
+
+// memory_ reads and writes by access pattern
+static std::vector<long> memory_pattern(std::int64_t pattern, long cells) {
+    std::vector<long> order(static_cast<std::size_t>(cells));
+    for (long i = 0; i < cells; ++i)
+        order[static_cast<std::size_t>(i)] = i;
+    if (pattern == 1) {
+        for (auto& index : order)
+            index *= 4096;
+    } else if (pattern == 2) {
+        std::mt19937_64 rng(42);
+        std::shuffle(order.begin(), order.end(), rng);
+    }
+    return order;
+}
+
+static void BM_MemoryWrite(benchmark::State& state) {
+    static const char* const names[] = { "sequential", "strided", "random" };
+    const auto order = memory_pattern(state.range(0), state.range(1));
+    auto interp = std::make_unique<SUBARUU>("tests/test.subaru");
+    for (auto _ : state) {
+        for (long index : order)
+            interp->poke(index, index);
+    }
+    state.SetLabel(names[state.range(0)]);
+    state.SetItemsProcessed(state.iterations() *
+                            static_cast<std::int64_t>(order.size()));
+}
+BENCHMARK(BM_MemoryWrite)
+  ->ArgsProduct({ { 0, 1, 2 }, { 1 << 10, 1 << 14, 1 << 18 } });
+
+static void BM_MemoryRead(benchmark::State& state) {
+    static const char* const names[] = { "sequential", "strided", "random" };
+    const auto order = memory_pattern(state.range(0), state.range(1));
+    auto interp = std::make_unique<SUBARUU>("tests/test.subaru");
+    for (long index : order)
+        interp->poke(index, index);
+    for (auto _ : state) {
+        for (long index : order)
+            benchmark::DoNotOptimize(interp->peek(index));
+    }
+    state.SetLabel(names[state.range(0)]);
+    state.SetItemsProcessed(state.iterations() *
+                            static_cast<std::int64_t>(order.size()));
+}
+BENCHMARK(BM_MemoryRead)
+  ->ArgsProduct({ { 0, 1, 2 }, { 1 << 10, 1 << 14, 1 << 18 } });
+
+// Jump cost by program size (lines) and target distance (lines). The loop
+// sits at the end of the program: a GOTO skips `distance` lines forward and
+// an IF jumps back to the top of the loop.
+static void BM_Jump(benchmark::State& state) {
+    constexpr int iterations = 100;
+    const auto size = static_cast<int>(state.range(0));
+    const auto distance = static_cast<int>(state.range(1));
+    int line = 10;
+    auto next = [&line]() {
+        line += 10;
+        return std::to_string(line);
+    };
+    const int loop = size - distance - 2;
+    std::string text = "10 GOTO " + std::to_string(10 + 10 * loop) + "\n";
+    while (line < 10 * loop)
+        text += next() + " REM filler\n";
+    text += next() + " LET i = i + 1\n";
+    const int target = line + 10 * (distance + 2);
+    text += next() + " GOTO " + std::to_string(target) + "\n";
+    for (int i = 0; i < distance; ++i)
+        text += next() + " REM skipped\n";
+    text += next() + " IF i < " + std::to_string(iterations) + " THEN " +
+            std::to_string(10 + 10 * loop) + "\n";
+    TempProgram program(
+      "jump_" + std::to_string(size) + "_" + std::to_string(distance), text);
+    run_program(state, program.path(), 2 * iterations);
+}
+BENCHMARK(BM_Jump)->ArgsProduct({ { 1 << 8, 1 << 12 }, { 1, 16, 128 } });
+
+// Counting loop of 1000 iterations as IF/GOTO, WHILE/WEND and DO/LOOP,
+// placed after `filler` lines so line-number jumps have code to scan past
+static void BM_Loop(benchmark::State& state) {
+    static const char* const names[] = { "if-goto", "while-wend", "do-loop" };
+    static const char* const bodies[] = {
+        "LET i = 0\n@ IF i >= 1000 THEN #\n@ LET i = i + 1\n@ GOTO $\n",
+        "LET i = 0\n@ WHILE i < 1000\n@ LET i = i + 1\n@ WEND\n",
+        "LET i = 0\n@ DO\n@ LET i = i + 1\n@ LOOP UNTIL i >= 1000\n",
+    };
+    const auto kind = static_cast<std::size_t>(state.range(0));
+    const auto filler = static_cast<int>(state.range(1));
+    std::string text;
+    int line = 10;
+    for (int i = 0; i < filler; ++i, line += 10)
+        text += std::to_string(line) + " REM filler\n";
+    const int top = line + 10;
+    text += std::to_string(line);
+    for (const char* c = bodies[kind]; *c; ++c) {
+        if (*c == '@')
+            text += std::to_string(line += 10);
+        else if (*c == '$')
+            text += std::to_string(top);
+        else if (*c == '#')
+            text += std::to_string(top + 40);
+        else
+            text += *c;
+    }
+    text += std::to_string(top + 40) + " REM done\n";
+    TempProgram program(
+      "loop_" + std::to_string(kind) + "_" + std::to_string(filler), text);
+    state.SetLabel(names[kind]);
+    run_program(state, program.path(), 1000);
+}
+BENCHMARK(BM_Loop)->ArgsProduct({ { 0, 1, 2 }, { 0, 256 } });
+
+BENCHMARK_MAIN();
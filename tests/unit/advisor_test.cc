@@ -0,0 +1,106 @@
+#include "../../include/advisor.h"
+#include <catch2/catch_test_macros.hpp>
+#include <filesystem>
+#include <string>
+
+namespace {
+
+std::size_t count(const Advisor& advisor, const std::string& kind) {
+    std::size_t n = 0;
+    for (const auto& finding : advisor.findings())
+        n += finding.kind == kind;
+    return n;
+}
+
+} // namespace
+
+TEST_CASE("Advisor Findings", "[advisor]") {
+    SECTION("Slow patterns inside loops") {
+        Advisor advisor("slow",
+                        "10 LET i = 0\n"
+                        "20 LET n = 5\n"
+                        "30 WHILE i < 100\n"
+                        "40 REM counting\n"
+                        "50 LET m[3] = m[3] + i * n\n"
+                        "60 LET i = i + n * 2\n"
+                        "70 WEND\n"
+                        "80 LET k = 0\n"
+                        "90 PRINT k\n"
+                        "100 LET k = k + 1\n"
+                        "110 IF k < 9 THEN 90\n");
+        REQUIRE(count(advisor, "rem-in-loop") == 1);
+        REQUIRE(count(advisor, "memory-scalar") == 1);
+        // n * 2 is invariant; i * n is not, i being assigned in the loop
+        REQUIRE(count(advisor, "loop-invariant") == 1);
+        REQUIRE(count(advisor, "print-in-loop") == 1);
+        const auto report = advisor.report();
+        REQUIRE(report.find("line 50: m[3] holds scalar state in a loop "
+                            "(2 accesses)") != std::string::npos);
+        REQUIRE(report.find("`n * 2` does not change in the loop at lines "
+                            "30-70") != std::string::npos);
+        REQUIRE(report.find("line 90: PRINT in a 3-statement loop") !=
+                std::string::npos);
+        // PRINT (20 x ~10) ranks first
+        REQUIRE(advisor.findings().front().kind == "print-in-loop");
+    }
+
+    SECTION("Precedence decides what is a subexpression") {
+        Advisor advisor("precedence",
+                        "10 DO\n"
+                        "20 LET x = x - a + b\n"
+                        "30 LET y = a + b * x\n"
+                        "40 LET z = x * a * b\n"
+                        "50 LET w = x + a * b\n"
+                        "60 LOOP UNTIL x > 9\n");
+        REQUIRE(count(advisor, "loop-invariant") == 1);
+        REQUIRE(advisor.report().find("line 50: `a * b`") != std::string::npos);
+    }
+
+    SECTION("Nothing to report outside loops") {
+        Advisor advisor("straight",
+                        "10 REM setup\n"
+                        "20 LET m[1] = 2 * 3\n"
+                        "30 PRINT m[1]\n");
+        REQUIRE(advisor.findings().empty());
+    }
+
+    SECTION("IF chains") {
+        Advisor advisor("chain",
+                        "10 IF c = 1 THEN 100\n"
+                        "20 IF c = 2 THEN 100\n"
+                        "30 IF c = 3 THEN 100\n"
+                        "40 IF c = 4 THEN 100\n"
+                        "50 IF d = 5 THEN 100\n"
+                        "100 REM done\n");
+        REQUIRE(count(advisor, "if-chain") == 1);
+        REQUIRE(advisor.findings()[0].line == 10);
+        REQUIRE(advisor.report().find("4-way IF c = k THEN chain") !=
+                std::string::npos);
+    }
+}
+
+TEST_CASE("Advisor Profiles", "[advisor]") {
+    const std::string text = "10 LET i = 0\n"
+                             "20 LET i = i + 1\n"
+                             "30 REM hot\n"
+                             "40 IF i < 5 THEN 20\n"
+                             "50 LET j = 0\n"
+                             "60 LET m[1] = j\n"
+                             "70 LET j = j + 1\n"
+                             "80 IF j < 2 THEN 60\n";
+    Advisor::Profile profile{ { 30, 5000 }, { 60, 2 } };
+    const std::string path = "temp_advisor_profile.txt";
+    Advisor::save_profile(path, profile);
+    const auto loaded = Advisor::load_profile(path);
+    REQUIRE(loaded == profile);
+    std::filesystem::remove(path);
+
+    // Statically both weigh ~10 and memory-scalar (3) outranks REM (1)
+    Advisor estimated("profile", text);
+    REQUIRE(estimated.findings().front().kind == "memory-scalar");
+    Advisor measured("profile", text, &loaded);
+    REQUIRE(measured.findings().front().kind == "rem-in-loop");
+    REQUIRE(measured.findings().front().measured);
+    REQUIRE(measured.report().find("[rem-in-loop, 1 x 5000]") !=
+            std::string::npos);
+}
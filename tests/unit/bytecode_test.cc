@@ -0,0 +1,102 @@
+#include "../../include/bytecode.h"
+#include "../../include/io.h"
+#include "../../include/tokenizer.h"
+#include <boost/multiprecision/cpp_int.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <variant>
+#include <vector>
+
+namespace {
+
+std::unique_ptr<Tokenizer> text_tokenizer(const std::string& text) {
+    return std::make_unique<Tokenizer>(std::make_unique<IO>("test", text));
+}
+
+} // namespace
+
+TEST_CASE("Bytecode Round Trip", "[bytecode]") {
+    const std::string text =
+      "10 LET a = 12345678901234567890123 + 7 * -b\n"
+      "20 PRINT \"hi\", \"there\", \"hi\"; s$\n"
+      "30 IF a <= 3 AND NOT b <> 2 THEN 10 : REM note: here\n"
+      "40 LET m[a] = 9223372036854775807 + 9223372036854775808\n"
+      "50 REM last";
+    auto reference = text_tokenizer(text);
+    auto source = text_tokenizer(text);
+    Tokenizer decoded(Bytecode::compile(*source));
+
+    SECTION("Decoding yields the lexed tokens and their data") {
+        while (!reference->finished()) {
+            const auto type = reference->current_token();
+            REQUIRE(decoded.current_token() == type);
+            if (type == Tokenizer::TokenType::NUMBER)
+                REQUIRE(decoded.get_num() == reference->get_num());
+            if (type == Tokenizer::TokenType::STRING)
+                REQUIRE(decoded.get_string() == reference->get_string());
+            if (type == Tokenizer::TokenType::LETTER ||
+                type == Tokenizer::TokenType::STRING_VAR)
+                REQUIRE(decoded.variable_num() == reference->variable_num());
+            if (type == Tokenizer::TokenType::REM) {
+                reference->skip_to_eol();
+                decoded.skip_to_eol();
+                continue;
+            }
+            reference->next_token();
+            decoded.next_token();
+        }
+        REQUIRE(decoded.finished());
+    }
+
+    SECTION("Offsets can be sought back to") {
+        decoded.next_token();
+        decoded.next_token();
+        const auto offset = decoded.offset();
+        REQUIRE(decoded.variable_num() == 0);
+        while (!decoded.finished())
+            decoded.next_token();
+        decoded.seek(offset);
+        REQUIRE(decoded.current_token() == Tokenizer::TokenType::LETTER);
+        decoded.reset();
+        REQUIRE(decoded.get_num() == 10);
+    }
+
+    SECTION("String literals are viewed in the pool, not copied") {
+        std::vector<const char*> seen;
+        for (; !decoded.finished(); decoded.next_token()) {
+            if (decoded.current_token() == Tokenizer::TokenType::STRING) {
+                REQUIRE(std::holds_alternative<std::string_view>(
+                  decoded.get_token_data()));
+                seen.push_back(decoded.get_string().data());
+            }
+        }
+        // "hi", "there", "hi": one pooled text serves both visits of "hi"
+        REQUIRE(seen.size() == 3);
+        REQUIRE(seen[0] == seen[2]);
+    }
+}
+
+TEST_CASE("Bytecode Fingerprint Without Code", "[bytecode]") {
+    // Long enough to be hashed in several chunks
+    std::string text;
+    for (int line = 1; line <= 20000; ++line)
+        text += std::to_string(line) + " PRINT \"x" + std::to_string(line % 7) +
+                "\", 123456789012345678901234567890 + a\n";
+    auto source = text_tokenizer(text);
+    auto streamed = text_tokenizer(text);
+    REQUIRE(Bytecode::fingerprint(*streamed) ==
+            Bytecode::compile(*source)->fingerprint());
+    REQUIRE(streamed->finished());
+}
+
+TEST_CASE("Bytecode Size", "[bytecode]") {
+    std::string text;
+    for (int line = 10; line <= 10000; line += 10)
+        text += std::to_string(line) + " LET m[a + " + std::to_string(line) +
+                "] = m[a] * 3 + b : PRINT \"value\", m[a]\n";
+    auto source = text_tokenizer(text);
+    const auto code = Bytecode::compile(*source);
+    REQUIRE(code->size() < text.size());
+}
@@ -0,0 +1,115 @@
+#include "../../include/execution.h"
+#include "temp_file.h"
+#include <catch2/catch_test_macros.hpp>
+#include <coroutine>
+#include <deque>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Records every pause of a host coroutine stepping exec
+Execution::Task record(Execution& exec,
+                       std::uint64_t budget,
+                       std::vector<Execution::Pause>& pauses) {
+    for (;;) {
+        const auto pause = co_await exec.step(budget);
+        pauses.push_back(pause);
+        if (pause == Execution::Pause::FINISHED)
+            co_return;
+    }
+}
+
+} // namespace
+
+TEST_CASE("Execution Interleaving", "[execution]") {
+    const TempFile file("temp_execution.subaru", "10 LET i = 0\n"
+                                                 "20 LET i = i + 1\n"
+                                                 "30 IF i < 50 THEN 20\n"
+                                                 "40 PRINT i\n");
+    const std::string& program = file.path();
+    std::deque<std::coroutine_handle<>> queue;
+    const auto scheduler = [&queue](std::coroutine_handle<> h) {
+        queue.push_back(h);
+    };
+    Execution first(program, SUBARUU::Options{}, scheduler);
+    Execution second(program, SUBARUU::Options{}, scheduler);
+    std::vector<Execution::Pause> first_pauses;
+    std::vector<Execution::Pause> second_pauses;
+    auto a = record(first, 10, first_pauses);
+    auto c = record(second, 7, second_pauses);
+    a.resume();
+    c.resume();
+    std::size_t turns = 0;
+    while (!queue.empty()) {
+        auto next = queue.front();
+        queue.pop_front();
+        next.resume();
+        ++turns;
+    }
+    REQUIRE(a.done());
+    REQUIRE(c.done());
+    REQUIRE(turns > 20);
+    REQUIRE(first_pauses.size() == 11);
+    REQUIRE(first_pauses.back() == Execution::Pause::FINISHED);
+    REQUIRE(second_pauses.size() == 15);
+    REQUIRE(second_pauses.front() == Execution::Pause::BUDGET);
+    REQUIRE(first.take_output() == "50\n");
+    REQUIRE(second.take_output() == "50\n");
+}
+
+TEST_CASE("Execution Input And Output Waits", "[execution]") {
+    const std::string program = "temp_execution.subaru";
+
+    SECTION("INPUT waits for complete numbers and ranges for the end") {
+        const TempFile file(program, "10 INPUT a, b\n"
+                                     "20 PRINT a + b\n"
+                                     "30 INPUT m[1 TO 3]\n"
+                                     "40 PRINT m[1] + m[3]\n");
+        Execution exec(program, SUBARUU::Options{});
+        auto task = exec.run(100);
+        task.resume();
+        REQUIRE_FALSE(task.done());
+        exec.feed("1 2");
+        REQUIRE_FALSE(task.done());
+        REQUIRE(exec.pending_output() == 0);
+        exec.feed("\n4 5 ");
+        REQUIRE(exec.take_output() == "3\n");
+        exec.feed("6");
+        REQUIRE_FALSE(task.done());
+        exec.close_input();
+        REQUIRE(task.done());
+        task.result();
+        REQUIRE(exec.take_output() == "10\n");
+        REQUIRE_THROWS_AS(exec.feed("7"), std::runtime_error);
+    }
+
+    SECTION("PRINT waits while the output buffer is full") {
+        const TempFile file(program, "10 LET i = 0\n"
+                                     "20 PRINT \"0123456789\"\n"
+                                     "30 LET i = i + 1\n"
+                                     "40 IF i < 20000 THEN 20\n");
+        Execution exec(program, SUBARUU::Options{});
+        auto task = exec.run(1000000);
+        task.resume();
+        REQUIRE_FALSE(task.done());
+        REQUIRE(exec.pending_output() >= SUBARUU_EXECUTION_OUTPUT);
+        REQUIRE(exec.pending_output() < SUBARUU_EXECUTION_OUTPUT + 11);
+        std::size_t total = 0;
+        while (!task.done())
+            total += exec.take_output().size();
+        total += exec.take_output().size();
+        REQUIRE(total == 20000 * 11);
+    }
+
+    SECTION("Runtime errors end the task") {
+        const TempFile file(program, "10 LET a = 1\n"
+                                     "20 GOTO 99\n");
+        Execution exec(program, SUBARUU::Options{ false });
+        auto task = exec.run(100);
+        task.resume();
+        REQUIRE(task.done());
+        REQUIRE_THROWS_AS(task.result(), std::runtime_error);
+    }
+}
@@ -0,0 +1,71 @@
+#include "../../include/format.h"
+#include "../../include/subaruu.h"
+#include "temp_file.h"
+#include <catch2/catch_test_macros.hpp>
+#include <stdexcept>
+#include <string>
+
+TEST_CASE("Format Compilation", "[format]") {
+    const Format format("a{{b}} {>5}|{<04}|{^7}!");
+    const auto& fields = format.fields();
+    REQUIRE(fields.size() == 3);
+    REQUIRE(fields[0].prefix == "a{b} ");
+    REQUIRE(fields[0].align == Format::Align::RIGHT);
+    REQUIRE(fields[0].width == 5);
+    REQUIRE(fields[1].prefix == "|");
+    REQUIRE(fields[1].align == Format::Align::LEFT);
+    REQUIRE(fields[1].zero);
+    REQUIRE(fields[1].width == 4);
+    REQUIRE(fields[2].align == Format::Align::CENTER);
+    REQUIRE(format.suffix() == "!");
+
+    const Format plain("{}");
+    REQUIRE(plain.fields()[0].align == Format::Align::DEFAULT);
+    REQUIRE(plain.fields()[0].width == 0);
+
+    REQUIRE_THROWS_AS(Format("{"), std::runtime_error);
+    REQUIRE_THROWS_AS(Format("}"), std::runtime_error);
+    REQUIRE_THROWS_AS(Format("{5x}"), std::runtime_error);
+    REQUIRE_THROWS_AS(Format("{99999}"), std::runtime_error);
+}
+
+TEST_CASE("Format Items", "[format]") {
+    const Format format("{5}{05}{^6}{<4}{0}");
+    const auto& f = format.fields();
+    std::string out;
+    Format::write_number(out, f[0], 42);
+    Format::write_number(out, f[1], -42);
+    Format::write_string(out, f[2], Str("ab"));
+    Format::write_number(out, f[3], 7);
+    Format::write_string(out, f[4], Str("long"));
+    REQUIRE(out == "   42-0042  ab  7   long");
+
+    out.clear();
+    Format::value_t big = 1;
+    big <<= 70;
+    Format::write_number(out, f[1], big);
+    Format::write_number(out, f[0], -big);
+    REQUIRE(out == "1180591620717411303424-1180591620717411303424");
+}
+
+TEST_CASE("PRINT USING", "[format]") {
+    const std::string program =
+      "10 LET a = 7\n"
+      "20 LET b$ = \"xy\"\n"
+      "30 PRINT USING \"[{4}] [{<4}] [{03}]\"; a; b$; a - 9\n"
+      "40 PRINT USING \"{} \"; 1; 2; 3\n"
+      "50 PRINT USING \"{>3}={}\"; b$\n"
+      "60 PRINT$ USING \"no fields\"\n"
+      "70 PRINT USING \"{{{}}}\"; LEN(b$);\n";
+    const std::string expected = "[   7] [xy  ] [-02]\n"
+                                 "1 2 3 \n"
+                                 " xy\n"
+                                 "no fields{2}\n";
+    REQUIRE(run_program(program, true) == expected);
+    REQUIRE(run_program(program, false) == expected);
+
+    REQUIRE_THROWS_AS(run_program("10 PRINT USING \"{x}\"; 1\n", true),
+                      std::runtime_error);
+    REQUIRE_THROWS_AS(run_program("10 PRINT USING \"none\"; 1\n", true),
+                      std::runtime_error);
+}
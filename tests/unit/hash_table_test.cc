@@ -0,0 +1,110 @@
+#include "../../include/hash_table.h"
+#include "../../include/subaruu.h"
+#include "temp_file.h"
+#include <catch2/catch_test_macros.hpp>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+
+TEST_CASE("Hash Table", "[table]") {
+    HashTable table;
+    REQUIRE(table.find(1) == nullptr);
+
+    SECTION("Numbers, strings and big numbers are distinct keys") {
+        HashTable::value_t big = 1;
+        big <<= 100;
+        table.set(5, 50);
+        table.set("5", 51);
+        table.set(big, 52);
+        table.set(big.str(), 53);
+        REQUIRE(table.size() == 4);
+        REQUIRE(*table.find(5) == 50);
+        REQUIRE(*table.find("5") == 51);
+        REQUIRE(*table.find(big) == 52);
+        REQUIRE(*table.find(big.str()) == 53);
+        table.set(5, -1);
+        REQUIRE(*table.find(5) == -1);
+        REQUIRE(table.size() == 4);
+        REQUIRE(table.erase(big));
+        REQUIRE_FALSE(table.erase(big));
+        REQUIRE(table.find(big) == nullptr);
+        REQUIRE(*table.find(big.str()) == 53);
+    }
+
+    SECTION("Matches a map under random inserts and erases") {
+        std::mt19937_64 gen(11);
+        std::map<long long, int> reference;
+        bool same = true;
+        for (int i = 0; i < 20000; ++i) {
+            const long long key = static_cast<long long>(gen() % 2000) - 1000;
+            if (gen() % 3 == 0) {
+                same = same && table.erase(key) == (reference.erase(key) == 1);
+            } else {
+                table.set(key, i);
+                reference[key] = i;
+            }
+        }
+        REQUIRE(same);
+        REQUIRE(table.size() == reference.size());
+        for (long long key = -1000; key < 1000; ++key) {
+            const auto* found = table.find(key);
+            const auto it = reference.find(key);
+            same = same && (found != nullptr) == (it != reference.end()) &&
+                   (!found || *found == it->second);
+        }
+        REQUIRE(same);
+        const auto stats = table.stats();
+        REQUIRE(stats.size == reference.size());
+        REQUIRE(stats.capacity >= stats.size);
+        REQUIRE(static_cast<double>(stats.size) <=
+                static_cast<double>(stats.capacity) * 0.75);
+        REQUIRE(stats.longest >= 1);
+        REQUIRE(stats.probes >= stats.lookups - 2000);
+    }
+}
+
+TEST_CASE("SET, GET, HAS and DEL", "[table]") {
+    const std::string program =
+      "10 LET i = 1\n"
+      "20 SET s, i * 3, i\n"
+      "30 LET i = i + 1\n"
+      "40 IF i < 6 THEN 20\n"
+      "50 SET n, \"red\", 7\n"
+      "60 SET n, \"re\" + \"d\", GET(n, \"red\") + GET(s, 12)\n"
+      "70 PRINT GET(s, 9); HAS(s, 9); HAS(s, 10); GET(s, 10); GET(n, \"red\")\n"
+      "80 DEL s, 9\n"
+      "90 DEL s, 1000\n"
+      "100 IF HAS(s, 9) = 0 AND HAS(n, \"red\") THEN 120\n"
+      "110 PRINT \"wrong\"\n"
+      "120 LET a$ = \"x\"\n"
+      "130 SET s, a$, GET(s, 15) * 2\n"
+      "140 PRINT GET(s, a$); HAS(s, 3); HAS(n, 3)\n";
+    const std::string expected = "3 1 0 0 11\n"
+                                 "10 1 0\n";
+    SUBARUU::Stats stats;
+    REQUIRE(run_program(program, true, &stats) == expected);
+    REQUIRE(run_program(program, false) == expected);
+    REQUIRE(stats.tables.size == 6);
+    REQUIRE(stats.tables.capacity == 32);
+    REQUIRE(stats.tables.lookups >= 11);
+}
+
+TEST_CASE("Tables are shared with clones until written", "[table]") {
+    const TempFile program("temp_table_clone.subaru",
+                           "10 SET t, 1, 5\n"
+                           "20 SET t, m[1], 7\n"
+                           "30 PRINT GET(t, 1); GET(t, 0); HAS(t, 2)\n");
+    std::ostringstream out;
+    SUBARUU::Options options;
+    options.output = &out;
+    SUBARUU interpreter(program.path(), options);
+    REQUIRE(interpreter.run_until(20));
+    auto fork = interpreter.clone();
+    fork->poke(1, 1);
+    fork->run();
+    interpreter.run();
+    REQUIRE(out.str() == "7 0 0\n5 7 0\n");
+    REQUIRE(fork->stats().tables.size == 1);
+    REQUIRE(interpreter.stats().tables.size == 2);
+}
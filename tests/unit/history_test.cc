@@ -0,0 +1,168 @@
+#include "../../include/history.h"
+#include "../../include/subaruu.h"
+#include <catch2/catch_test_macros.hpp>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+History::Run make_run(std::uint64_t hash, bool compact, double ms) {
+    return { hash, compact, true, 0.5, ms, 100, 4, 2048 };
+}
+
+} // namespace
+
+TEST_CASE("History Records", "[history]") {
+    const std::string path = "temp_history_test.txt";
+    std::filesystem::remove(path);
+
+    SECTION("Hash depends on the text only") {
+        REQUIRE(History::hash("10 PRINT 1\n") == History::hash("10 PRINT 1\n"));
+        REQUIRE(History::hash("10 PRINT 1\n") != History::hash("10 PRINT 2\n"));
+    }
+
+    SECTION("Runs survive a reload") {
+        {
+            History history(path);
+            REQUIRE(history.runs(42).empty());
+            history.record(make_run(42, true, 3.25));
+            history.record(make_run(7, false, 1));
+        }
+        History history(path);
+        const auto runs = history.runs(42);
+        REQUIRE(runs.size() == 1);
+        REQUIRE(runs[0].compact);
+        REQUIRE(runs[0].verified);
+        REQUIRE(runs[0].run_ms == 3.25);
+        REQUIRE(runs[0].statements == 100);
+        REQUIRE(runs[0].peak_kb == 2048);
+        REQUIRE(history.runs(7).size() == 1);
+    }
+
+    SECTION("The file keeps a bounded number of runs per program") {
+        {
+            History history(path);
+            history.record(make_run(7, false, 1));
+            for (std::size_t i = 0; i < 5 * SUBARUU_HISTORY_WINDOW; ++i)
+                history.record(make_run(42, true, static_cast<double>(i)));
+            REQUIRE(history.runs(42).size() <= 2 * SUBARUU_HISTORY_WINDOW);
+        }
+        History history(path);
+        const auto runs = history.runs(42);
+        REQUIRE(runs.size() >= SUBARUU_HISTORY_WINDOW);
+        REQUIRE(runs.size() <= 2 * SUBARUU_HISTORY_WINDOW);
+        REQUIRE(runs.back().run_ms == 5 * SUBARUU_HISTORY_WINDOW - 1);
+        REQUIRE(history.runs(7).size() == 1);
+        REQUIRE_FALSE(std::filesystem::exists(path + ".tmp"));
+    }
+
+    SECTION("Malformed lines are skipped") {
+        {
+            std::ofstream out(path);
+            out << "# comment\n"
+                << "2a compact 1 0.5 1 10 0 100\n"
+                << "2a turbo 1 0.5 1 10 0 100\n"
+                << "garbage\n";
+        }
+        REQUIRE(History(path).runs(42).size() == 1);
+    }
+
+    SECTION("Each engine is tried, then the faster one kept") {
+        History history(path);
+        auto choice = history.choose(42, true);
+        REQUIRE(choice.compact);
+        REQUIRE(choice.reason == "no history");
+
+        history.record(make_run(42, true, 10));
+        choice = history.choose(42, true);
+        REQUIRE_FALSE(choice.compact);
+        REQUIRE(choice.reason == "trying text engine");
+
+        history.record(make_run(42, false, 5));
+        REQUIRE_FALSE(history.choose(42, true).compact);
+
+        // Only the recent window counts
+        for (std::size_t i = 0; i < SUBARUU_HISTORY_WINDOW; ++i)
+            history.record(make_run(42, false, 20));
+        REQUIRE(history.choose(42, true).compact);
+    }
+
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("SUBARUU Adaptive Engine", "[history]") {
+    const std::string history_path = "temp_history_engine.txt";
+    const std::string program = "temp_history_engine.subaru";
+    std::filesystem::remove(history_path);
+    {
+        std::ofstream out(program);
+        out << "10 LET a = 1\n"
+               "20 LET m[a] = a + 1\n"
+               "30 LET a = a + 1\n"
+               "40 IF a < 5 THEN 20\n";
+    }
+
+    auto history = std::make_shared<History>(history_path);
+    SUBARUU::Options options;
+    options.history = history;
+
+    SUBARUU first(program, options);
+    first.run();
+    const auto stats = first.stats();
+    REQUIRE(stats.compact);
+    REQUIRE(stats.verified);
+    REQUIRE(stats.engine_reason == "no history");
+    REQUIRE(stats.statements == 13);
+    REQUIRE(stats.memory_cells == 4);
+    REQUIRE(stats.run_ms >= 0);
+    history->record({ stats.source_hash, stats.compact, stats.verified,
+                      stats.load_ms, stats.run_ms, stats.statements,
+                      stats.memory_cells, 0 });
+
+    SUBARUU second(program, options);
+    REQUIRE_FALSE(second.stats().compact);
+    REQUIRE(second.stats().source_hash == stats.source_hash);
+
+    // A text engine by default identifies the program without compiling it
+    SUBARUU::Options text;
+    text.compact = false;
+    REQUIRE(SUBARUU(program, text).stats().source_hash == stats.source_hash);
+    second.run();
+    REQUIRE(second.stats().statements == 13);
+
+    std::filesystem::remove(history_path);
+    std::filesystem::remove(program);
+}
+
+TEST_CASE("SUBARUU History Of A Broken Program", "[history]") {
+    const std::string history_path = "temp_history_broken.txt";
+    const std::string program = "temp_history_broken.subaru";
+    std::filesystem::remove(history_path);
+    {
+        std::ofstream out(program);
+        out << "10 LET a = 1\n"
+               "20 GOTO 30\n";
+    }
+    const auto hash = SUBARUU(program, SUBARUU::Options{ false })
+                        .stats()
+                        .source_hash;
+    auto history = std::make_shared<History>(history_path);
+    history->record(make_run(hash, true, 1.0));
+
+    // A record claiming the program verified must not let a missing
+    // target through
+    SUBARUU::Options options;
+    options.history = history;
+    REQUIRE_THROWS_AS(
+      [&] {
+          SUBARUU trusted(program, options);
+          trusted.run();
+      }(),
+      std::runtime_error);
+
+    std::filesystem::remove(history_path);
+    std::filesystem::remove(program);
+}
@@ -0,0 +1,55 @@
+#include "../../include/input.h"
+#include <catch2/catch_test_macros.hpp>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+TEST_CASE("InputReader Numbers", "[input]") {
+    using value_t = InputReader::value_t;
+
+    SECTION("Whitespace separated integers") {
+        std::istringstream in("  12 -7\n+3\t0\n");
+        InputReader reader(in);
+        value_t value;
+        REQUIRE(reader.next(value));
+        REQUIRE(value == 12);
+        REQUIRE(reader.next(value));
+        REQUIRE(value == -7);
+        REQUIRE(reader.next(value));
+        REQUIRE(value == 3);
+        REQUIRE(reader.next(value));
+        REQUIRE(value == 0);
+        REQUIRE_FALSE(reader.next(value));
+    }
+
+    SECTION("Long digit runs become big integers") {
+        const std::string digits = "123456789012345678901234567890123456789";
+        std::istringstream in(digits + " -" + digits);
+        InputReader reader(in);
+        value_t value;
+        REQUIRE(reader.next(value));
+        REQUIRE(value == value_t(digits));
+        REQUIRE(reader.next(value));
+        REQUIRE(value == -value_t(digits));
+    }
+
+    SECTION("Numbers spanning buffer refills") {
+        std::istringstream in("1234567 89 123456789012345678901");
+        InputReader reader(in, 4);
+        value_t value;
+        REQUIRE(reader.next(value));
+        REQUIRE(value == 1234567);
+        REQUIRE(reader.next(value));
+        REQUIRE(value == 89);
+        REQUIRE(reader.next(value));
+        REQUIRE(value == value_t("123456789012345678901"));
+        REQUIRE_FALSE(reader.next(value));
+    }
+
+    SECTION("Malformed input throws") {
+        std::istringstream in("12x");
+        InputReader reader(in);
+        value_t value;
+        REQUIRE_THROWS_AS(reader.next(value), std::runtime_error);
+    }
+}
@@ -0,0 +1,119 @@
+#include "../../include/metrics.h"
+#include "../../include/subaruu.h"
+#include <catch2/catch_test_macros.hpp>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+bool has_line(const std::string& text, const std::string& line) {
+    return text.find("\n" + line + "\n") != std::string::npos;
+}
+
+} // namespace
+
+TEST_CASE("Metrics Export", "[metrics]") {
+    const std::string program = "temp_metrics.subaru";
+    {
+        std::ofstream out(program);
+        out << "10 LET a = 1\n"
+               "20 LET m[a] = a * 4294967296 * 4294967296\n"
+               "30 LET a = a + 1\n"
+               "40 PRINT$ \"ab\"\n"
+               "50 IF a < 4 THEN 20\n";
+    }
+    const auto hour = std::chrono::milliseconds(3600000);
+
+    SECTION("Counters and a final sample in a file") {
+        const std::string target = "temp_metrics.prom";
+        std::string text;
+        {
+            Metrics metrics(target, hour, "test");
+            std::ostringstream out;
+            SUBARUU::Options options;
+            options.output = &out;
+            options.metrics = &metrics;
+            SUBARUU subaruu(program, options);
+            subaruu.run();
+            REQUIRE(out.str() == "ababab");
+            auto& counters = metrics.counters();
+            REQUIRE(counters.statements.load() == 13);
+            REQUIRE(counters.jumps.load() == 2);
+            REQUIRE(counters.memory_cells.load() == 3);
+            REQUIRE(counters.bignums.load() == 3);
+            REQUIRE(counters.output_bytes.load() == 6);
+            REQUIRE(counters.line.load() == 50);
+        }
+        std::ifstream in(target);
+        text.assign(std::istreambuf_iterator<char>(in),
+                    std::istreambuf_iterator<char>());
+        REQUIRE(has_line(text, "# TYPE subaru_statements_total counter"));
+        REQUIRE(has_line(text, "subaru_statements_total{program=\"test\"} 13"));
+        REQUIRE(has_line(text, "subaru_jumps_total{program=\"test\"} 2"));
+        REQUIRE(has_line(text, "subaru_output_bytes_total{program=\"test\"} 6"));
+        REQUIRE(has_line(text, "subaru_current_line{program=\"test\"} 50"));
+        std::filesystem::remove(target);
+    }
+
+    SECTION("Samples are served on a Unix socket") {
+        const std::string path = "temp_metrics.sock";
+        Metrics metrics("unix:" + path, std::chrono::milliseconds(5), "sock");
+        metrics.counters().statements = 42;
+        for (int i = 0; i < 200 &&
+                        metrics.text().find("} 42\n") == std::string::npos;
+             ++i)
+            usleep(5000);
+        const int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        path.copy(address.sun_path, path.size());
+        REQUIRE(::connect(fd, reinterpret_cast<sockaddr*>(&address),
+                          sizeof(address)) == 0);
+        std::string text;
+        char buffer[4096];
+        for (ssize_t n; (n = ::read(fd, buffer, sizeof(buffer))) > 0;)
+            text.append(buffer, static_cast<std::size_t>(n));
+        ::close(fd);
+        REQUIRE(has_line(text, "subaru_statements_total{program=\"sock\"} 42"));
+    }
+
+    SECTION("The program label is escaped") {
+        const std::string target = "temp_metrics.prom";
+        {
+            Metrics metrics(target, hour, "dir\\a \"b\"\nc");
+            metrics.counters().statements = 7;
+        }
+        std::ifstream in(target);
+        const std::string text(std::istreambuf_iterator<char>(in),
+                               std::istreambuf_iterator<char>{});
+        REQUIRE(has_line(
+          text, "subaru_statements_total{program=\"dir\\\\a \\\"b\\\"\\nc\"} 7"));
+        std::filesystem::remove(target);
+    }
+
+    SECTION("Nothing is counted without metrics") {
+        std::ostringstream out;
+        SUBARUU::Options options;
+        options.output = &out;
+        SUBARUU subaruu(program, options);
+        subaruu.run();
+        REQUIRE(out.str() == "ababab");
+    }
+
+    std::filesystem::remove(program);
+}
+
+TEST_CASE("Counting Stream", "[metrics]") {
+    std::ostringstream target;
+    CountingStream counting(target);
+    counting << "abc" << 12 << '\n';
+    counting.flush();
+    REQUIRE(target.str() == "abc12\n");
+    REQUIRE(counting.count() == 6);
+}
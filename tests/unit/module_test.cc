@@ -0,0 +1,94 @@
+#include "../../include/module.h"
+#include "../../include/io.h"
+#include "../../include/tokenizer.h"
+#include <catch2/catch_test_macros.hpp>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+TEST_CASE("Module Cache", "[module]") {
+    SECTION("Loading a module twice returns the cached copy") {
+        auto first = Module::load("tests/test2.subaru");
+        auto second = Module::load("tests/test2.subaru");
+        REQUIRE(first == second);
+        REQUIRE(first->line_numbers().size() == 5);
+    }
+
+    SECTION("Clearing the cache forces a reload") {
+        auto first = Module::load("tests/test2.subaru");
+        Module::clear_cache();
+        auto second = Module::load("tests/test2.subaru");
+        REQUIRE(first != second);
+    }
+
+    SECTION("Missing module throws") {
+        REQUIRE_THROWS_AS(Module::load("tests/nonexistent.subaru"),
+                          std::runtime_error);
+    }
+}
+
+TEST_CASE("Module Linking", "[module]") {
+    const std::string lib = "temp_module_lib.subaru";
+    const std::string main = "temp_module_main.subaru";
+    {
+        std::ofstream out(lib);
+        out << "900 PRINT \"lib\"\n";
+    }
+
+    SECTION("MERGE is replaced by the merged module") {
+        {
+            std::ofstream out(main);
+            out << "10 GOTO 900\n"
+                << "MERGE \"" << lib << "\"\n"
+                << "MERGE \"" << lib << "\"\n"
+                << "990 REM end\n";
+        }
+        const auto text = Module::link(main);
+        REQUIRE(text == "10 GOTO 900\n900 PRINT \"lib\"\n990 REM end\n");
+        Tokenizer linked(std::make_unique<IO>(main, text));
+        REQUIRE(Module::compile(main)->fingerprint() ==
+                Bytecode::compile(linked)->fingerprint());
+    }
+
+    SECTION("Merged modules are compiled once and cached as code") {
+        {
+            std::ofstream out(main);
+            out << "10 GOTO 900\n"
+                << "MERGE \"" << lib << "\"\n";
+        }
+        Module::clear_cache();
+        const auto first = Module::compile(main);
+        const auto library = Module::load(lib);
+        const auto second = Module::compile(main);
+        REQUIRE(Module::load(lib) == library);
+        REQUIRE(first->fingerprint() == second->fingerprint());
+        REQUIRE(library->segments().size() == 1);
+        REQUIRE(library->segments()[0].code != nullptr);
+        REQUIRE(library->segments()[0].text.empty());
+    }
+
+    SECTION("Line number collisions are reported at load") {
+        {
+            std::ofstream out(main);
+            out << "900 GOTO 910\n"
+                << "MERGE \"" << lib << "\"\n"
+                << "910 REM end\n";
+        }
+        REQUIRE_THROWS_AS(Module::link(main), std::runtime_error);
+    }
+
+    SECTION("A numbered MERGE line does not define its number") {
+        {
+            std::ofstream out(main);
+            out << "10 GOTO 900\n"
+                << "900 MERGE \"" << lib << "\"\n";
+        }
+        REQUIRE(Module::link(main) == "10 GOTO 900\n900 PRINT \"lib\"\n");
+        REQUIRE_NOTHROW(Module::compile(main));
+    }
+
+    std::filesystem::remove(main);
+    std::filesystem::remove(lib);
+}
@@ -0,0 +1,114 @@
+#include "../../include/pipeline.h"
+#include "temp_file.h"
+#include <catch2/catch_test_macros.hpp>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+bool fails_with(const std::string& manifest, const std::string& message) {
+    try {
+        Pipeline pipeline("manifest", manifest);
+    } catch (const std::runtime_error& e) {
+        return std::string(e.what()).find(message) != std::string::npos;
+    }
+    return false;
+}
+
+} // namespace
+
+TEST_CASE("Pipeline Runs", "[pipeline]") {
+    const TempFile squares("temp_pipe_squares.subaru",
+                           "10 LET i = 1\n"
+                           "20 LET m[i] = i * i\n"
+                           "30 LET i = i + 1\n"
+                           "40 IF i < 6 THEN 20\n"
+                           "50 PRINT \"squares\"\n");
+    const TempFile tens("temp_pipe_tens.subaru",
+                        "10 LET m[1] = 11\n"
+                        "20 LET m[2] = 22\n"
+                        "30 PRINT \"tens\"\n");
+    const TempFile sum("temp_pipe_sum.subaru",
+                       "10 LET s = 0\n"
+                       "20 LET i = 1\n"
+                       "30 LET s = s + m[i]\n"
+                       "40 LET i = i + 1\n"
+                       "50 IF i < 13 THEN 30\n"
+                       "60 LET m[0] = s\n"
+                       "70 PRINT s\n");
+    const TempFile fail("temp_pipe_fail.subaru", "10 GOTO 99\n");
+
+    SECTION("Ranges are handed downstream in memory") {
+        Pipeline pipeline("manifest",
+                          "# two sources feed a sum\n"
+                          "stage squares temp_pipe_squares.subaru\n"
+                          "output squares 1 5\n"
+                          "stage tens temp_pipe_tens.subaru\n"
+                          "output tens 1 2\n"
+                          "stage sum temp_pipe_sum.subaru\n"
+                          "input sum squares 2 5\n"
+                          "input sum tens 1 2 at 11\n");
+        REQUIRE(pipeline.stages().size() == 3);
+        std::ostringstream out;
+        pipeline.run(out, SUBARUU::Options{});
+        // Output in manifest order whatever the finishing order
+        REQUIRE(out.str() == "squares\ntens\n87\n");
+        REQUIRE(pipeline.peek("sum", 0) == 87);
+        REQUIRE(pipeline.peek("sum", 11) == 11);
+        REQUIRE(pipeline.peek("squares", 5) == 25);
+    }
+
+    SECTION("Wide sparse ranges cost only their written cells") {
+        const TempFile sparse("temp_pipe_sparse.subaru",
+                              "10 LET m[7] = 70\n"
+                              "20 LET m[1000000000000] = 99\n");
+        Pipeline pipeline("manifest",
+                          "stage sparse temp_pipe_sparse.subaru\n"
+                          "output sparse 0 1000000000000\n"
+                          "stage tens temp_pipe_tens.subaru\n"
+                          "input tens sparse 0 1000000000000 at 100\n");
+        std::ostringstream out;
+        pipeline.run(out, SUBARUU::Options{});
+        REQUIRE(pipeline.peek("tens", 107) == 70);
+        REQUIRE(pipeline.peek("tens", 1000000000100) == 99);
+        REQUIRE(pipeline.peek("tens", 1) == 11);
+    }
+
+    SECTION("A failing stage fails its downstream") {
+        Pipeline pipeline("manifest",
+                          "stage tens temp_pipe_tens.subaru\n"
+                          "stage bad temp_pipe_fail.subaru\n"
+                          "output bad 1 1\n"
+                          "stage sum temp_pipe_sum.subaru\n"
+                          "input sum bad 1 1\n");
+        std::ostringstream out;
+        bool failed = false;
+        try {
+            pipeline.run(out, SUBARUU::Options{ false });
+        } catch (const std::runtime_error& e) {
+            failed = std::string(e.what()).find("Stage bad") == 0;
+        }
+        REQUIRE(failed);
+        REQUIRE(out.str() == "tens\n");
+        REQUIRE_THROWS(pipeline.peek("sum", 0));
+    }
+}
+
+TEST_CASE("Pipeline Manifest Errors", "[pipeline]") {
+    REQUIRE(fails_with("stage a a.subaru\nstage a b.subaru\n",
+                       "manifest:2: stage a is already defined"));
+    REQUIRE(fails_with("output a 1 2\n", "unknown stage a"));
+    REQUIRE(fails_with("stage a a.subaru\nstage b b.subaru\n"
+                       "output b 1 2\ninput a b 1 2\n",
+                       "not defined before it"));
+    REQUIRE(fails_with("stage a a.subaru\noutput a 1 4\n"
+                       "stage b b.subaru\ninput b a 3 5\n",
+                       "not an output of a"));
+    REQUIRE(fails_with("stage a a.subaru\noutput a 5 1\n", "memory range"));
+    REQUIRE(fails_with("stage a a.subaru\noutput a 1 4\n"
+                       "stage b b.subaru\ninput b a 1 4 to 7\n",
+                       "expected at DEST"));
+    REQUIRE(fails_with("stage\n", "expected a stage name"));
+    REQUIRE(fails_with("run a b\n", "unknown keyword run"));
+}
@@ -0,0 +1,164 @@
+#include "../../include/radix_trie.h"
+#include <boost/multiprecision/cpp_int.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <string>
+
+using boost::multiprecision::cpp_int;
+
+TEST_CASE("RadixTrie Cells", "[radix_trie]") {
+    RadixTrie<cpp_int> trie;
+
+    SECTION("Unwritten cells read as the default value") {
+        REQUIRE(trie.find(5) == nullptr);
+        REQUIRE(trie.get(5) == 0);
+        REQUIRE(trie.size() == 0);
+    }
+
+    SECTION("Negative, sparse and wide indices are independent") {
+        const cpp_int huge = cpp_int(1) << 100;
+        trie.set(0, 1);
+        trie.set(-1, 2);
+        trie.set(1, 3);
+        trie.set(1000000007, 4);
+        trie.set(-(cpp_int(1) << 62), 5);
+        trie.set(huge, 6);
+        trie.set(-huge, 7);
+        REQUIRE(trie.get(0) == 1);
+        REQUIRE(trie.get(-1) == 2);
+        REQUIRE(trie.get(1) == 3);
+        REQUIRE(trie.get(1000000007) == 4);
+        REQUIRE(trie.get(-(cpp_int(1) << 62)) == 5);
+        REQUIRE(trie.get(huge) == 6);
+        REQUIRE(trie.get(-huge) == 7);
+        REQUIRE(trie.get(2) == 0);
+        REQUIRE(trie.size() == 7);
+    }
+
+    SECTION("Overwriting keeps the size") {
+        for (int i = 0; i < 1000; ++i)
+            trie.set(i, i);
+        for (int i = 0; i < 1000; ++i)
+            trie.set(i, -i);
+        REQUIRE(trie.size() == 1000);
+        for (int i = 0; i < 1000; ++i)
+            REQUIRE(trie.get(i) == -i);
+    }
+}
+
+TEST_CASE("RadixTrie Ranges", "[radix_trie]") {
+    RadixTrie<cpp_int> trie;
+    const cpp_int huge = cpp_int(1) << 100;
+    const cpp_int keys[] = { -1000, -3, 0, 2, 17, cpp_int(1) << 40, huge,
+                             -huge };
+    for (const auto& key : keys)
+        trie.set(key, key + 1);
+    const auto visited = [&trie](const cpp_int& first, const cpp_int& last) {
+        std::map<cpp_int, cpp_int> cells;
+        trie.for_each(first, last, [&cells](const cpp_int& key,
+                                            const cpp_int& value) {
+            cells.emplace(key, value);
+        });
+        return cells;
+    };
+
+    SECTION("Only written cells in the range are visited") {
+        const auto cells = visited(-3, cpp_int(1) << 40);
+        REQUIRE(cells.size() == 5);
+        REQUIRE(cells.count(-3));
+        REQUIRE(cells.count(0));
+        REQUIRE(cells.count(2));
+        REQUIRE(cells.count(17));
+        REQUIRE(cells.at(cpp_int(1) << 40) == (cpp_int(1) << 40) + 1);
+    }
+
+    SECTION("Ranges of one sign and of wide keys") {
+        REQUIRE(visited(1, 16).size() == 1);
+        REQUIRE(visited(-2000, -4).size() == 1);
+        REQUIRE(visited(3, 16).empty());
+        REQUIRE(visited(5, 4).empty());
+        REQUIRE(visited(-huge, huge).size() == 8);
+        REQUIRE(visited(huge, huge * 2).size() == 1);
+    }
+}
+
+TEST_CASE("RadixTrie Copies", "[radix_trie]") {
+    RadixTrie<std::string> original;
+    for (int i = -500; i < 500; ++i)
+        original.set(i, std::to_string(i));
+    original.set(cpp_int(1) << 80, "wide");
+
+    SECTION("Writes to a copy do not reach the original") {
+        RadixTrie<std::string> copy = original;
+        copy.set(7, "changed");
+        copy.set(-7, "changed");
+        copy.set(100000, "new");
+        copy.set(cpp_int(1) << 80, "copy");
+        REQUIRE(original.get(7) == "7");
+        REQUIRE(original.get(-7) == "-7");
+        REQUIRE(original.find(100000) == nullptr);
+        REQUIRE(original.get(cpp_int(1) << 80) == "wide");
+        REQUIRE(copy.get(7) == "changed");
+        REQUIRE(copy.get(cpp_int(1) << 80) == "copy");
+        REQUIRE(copy.get(8) == "8");
+        REQUIRE(copy.size() == original.size() + 1);
+    }
+
+    SECTION("Writes to the original do not reach a copy") {
+        RadixTrie<std::string> copy = original;
+        original.set(3, "changed");
+        REQUIRE(copy.get(3) == "3");
+        REQUIRE(original.get(3) == "changed");
+    }
+}
+
+TEST_CASE("RadixTrie Cursors", "[radix_trie]") {
+    RadixTrie<cpp_int> trie;
+    RadixTrie<cpp_int>::Cursor reader, writer;
+
+    SECTION("A cursor reads and writes the cells of its leaf") {
+        for (std::int64_t i = -40; i < 40; ++i)
+            trie.set(i, cpp_int(i) * 2, writer);
+        REQUIRE(trie.size() == 80);
+        for (std::int64_t i = -40; i < 40; ++i) {
+            REQUIRE(trie.find(i, reader) != nullptr);
+            REQUIRE(*trie.find(i, reader) == i * 2);
+            REQUIRE(trie.get(i) == i * 2);
+        }
+        REQUIRE(trie.find(1000, reader) == nullptr);
+        REQUIRE(trie.find(-41, reader) == nullptr);
+        REQUIRE(trie.find(std::numeric_limits<std::int64_t>::max(), reader) ==
+                nullptr);
+        trie.set(std::numeric_limits<std::int64_t>::max(), 9, writer);
+        REQUIRE(trie.get(std::numeric_limits<std::int64_t>::max()) == 9);
+    }
+
+    SECTION("Growing the trie invalidates cursors") {
+        trie.set(1, 1, writer);
+        REQUIRE(*trie.find(1, reader) == 1);
+        trie.set(cpp_int(1) << 40, 2);
+        trie.set(2, 3, writer);
+        REQUIRE(*trie.find(1, reader) == 1);
+        REQUIRE(*trie.find(2, reader) == 3);
+        REQUIRE(trie.get(2) == 3);
+    }
+
+    SECTION("Cursors do not write through shared leaves") {
+        for (std::int64_t i = 0; i < 16; ++i)
+            trie.set(i, i, writer);
+        REQUIRE(*trie.find(3, reader) == 3);
+        RadixTrie<cpp_int> copy = trie;
+        trie.set(3, 30, writer);
+        REQUIRE(*trie.find(3, reader) == 30);
+        REQUIRE(copy.get(3) == 3);
+        RadixTrie<cpp_int>::Cursor copy_writer;
+        copy.set(4, 40, copy_writer);
+        copy = trie;
+        trie.set(5, 50, writer);
+        REQUIRE(copy.get(5) == 5);
+        REQUIRE(copy.get(3) == 30);
+        REQUIRE(*trie.find(5, reader) == 50);
+    }
+}
@@ -0,0 +1,74 @@
+#include "../../include/random.h"
+#include <catch2/catch_test_macros.hpp>
+#include <cstdint>
+#include <vector>
+
+TEST_CASE("Random Streams", "[random]") {
+    SECTION("Same seed and stream reproduce the same draws") {
+        Random a(42), b(42);
+        for (int i = 0; i < 100; ++i)
+            REQUIRE(a.next() == b.next());
+    }
+
+    SECTION("Substreams of one seed differ") {
+        Random a, b;
+        a.seed(42, 0);
+        b.seed(42, 1);
+        int equal = 0;
+        for (int i = 0; i < 100; ++i)
+            equal += a.next() == b.next();
+        REQUIRE(equal == 0);
+    }
+
+    SECTION("Substream k equals k jumps from the seed") {
+        Random a, b;
+        a.seed(7, 3);
+        b.seed(7);
+        b.jump();
+        b.jump();
+        b.jump();
+        REQUIRE(a.next() == b.next());
+    }
+
+    SECTION("Many jumps are taken as powers of the jump") {
+        Random a, b;
+        a.seed(7, 100);
+        b.seed(7);
+        for (int i = 0; i < 100; ++i)
+            b.jump();
+        REQUIRE(a.next() == b.next());
+
+        a.seed(7, std::uint64_t(1) << 40);
+        b.seed(7, std::uint64_t(1) << 39);
+        b.jump(std::uint64_t(1) << 39);
+        REQUIRE(a.next() == b.next());
+    }
+}
+
+TEST_CASE("Random Bounded Draws", "[random]") {
+    Random rng(1);
+
+    SECTION("Small bounds stay in range and cover it") {
+        std::vector<int> seen(6, 0);
+        for (int i = 0; i < 6000; ++i) {
+            const auto draw = rng.below(std::uint64_t(6));
+            REQUIRE(draw < 6);
+            ++seen[draw];
+        }
+        for (int count : seen)
+            REQUIRE(count > 800);
+    }
+
+    SECTION("Bounds beyond 64 bits") {
+        const Random::value_t bound =
+          Random::value_t(1) << 100; // 2^100
+        bool high = false;
+        for (int i = 0; i < 100; ++i) {
+            const auto draw = rng.below(bound);
+            REQUIRE(draw >= 0);
+            REQUIRE(draw < bound);
+            high = high || draw > Random::value_t(1) << 64;
+        }
+        REQUIRE(high);
+    }
+}
@@ -0,0 +1,90 @@
+#include "../../include/segment.h"
+#include "../../include/subaruu.h"
+#include "temp_file.h"
+#include <catch2/catch_test_macros.hpp>
+#include <filesystem>
+#include <sstream>
+#include <string>
+
+TEST_CASE("Segment Sharing", "[segment]") {
+    const TempFile setup_file("temp_segment_setup.subaru",
+                              "10 LET i = 1\n"
+                              "20 LET m[i] = i * 7\n"
+                              "30 LET i = i + 1\n"
+                              "40 IF i < 9 THEN 20\n"
+                              "50 LET m[-3] = -5\n");
+    const TempFile reader_file("temp_segment_reader.subaru",
+                               "10 PRINT m[1] + m[8]; m[-3]; m[0]; m[99]\n");
+    const TempFile writer_file("temp_segment_writer.subaru",
+                               "10 LET m[2] = 1\n"
+                               "20 PRINT m[2] + m[3]\n");
+    const TempFile segment_file("temp_segment.seg");
+    const std::string& setup = setup_file.path();
+    const std::string& reader = reader_file.path();
+    const std::string& writer = writer_file.path();
+    const std::string& file = segment_file.path();
+
+    SUBARUU prepared(setup);
+    prepared.run();
+    const auto captured = Segment::capture(prepared, -3, 8);
+    REQUIRE(captured->get(8) == 56);
+    REQUIRE(captured->get(-1) == 0);
+    captured->save(file);
+    const auto mapped = Segment::map(file);
+    REQUIRE(mapped->first() == -3);
+    REQUIRE(mapped->last() == 8);
+
+    SECTION("Attached segments are read through m[]") {
+        for (const auto& segment : { captured, mapped }) {
+            std::ostringstream out;
+            SUBARUU::Options options;
+            options.output = &out;
+            SUBARUU first(reader, options), second(reader, options);
+            first.attach(segment, Segment::Access::READ_ONLY);
+            second.attach(segment, Segment::Access::READ_ONLY);
+            first.run();
+            second.run();
+            REQUIRE(out.str() == "63 -5 0 0\n63 -5 0 0\n");
+            REQUIRE(first.stats().memory_cells == 0);
+        }
+    }
+
+    SECTION("Writes are rejected or kept private") {
+        SUBARUU rejected(writer);
+        rejected.attach(mapped, Segment::Access::READ_ONLY);
+        REQUIRE_THROWS(rejected.run());
+        REQUIRE_THROWS(rejected.poke(-3, 1));
+        rejected.poke(9, 1);
+
+        std::ostringstream out;
+        SUBARUU::Options options;
+        options.output = &out;
+        SUBARUU private_copy(writer, options);
+        private_copy.attach(mapped, Segment::Access::COPY_ON_WRITE);
+        private_copy.run();
+        REQUIRE(out.str() == "22\n");
+        REQUIRE(private_copy.peek(2) == 1);
+        REQUIRE(mapped->get(2) == 14);
+    }
+
+    SECTION("Saving replaces the file instead of rewriting it") {
+        prepared.poke(1, 1000);
+        Segment::capture(prepared, -3, 8)->save(file);
+        // The old mapping keeps its pages
+        REQUIRE(mapped->get(1) == 7);
+        REQUIRE(Segment::map(file)->get(1) == 1000);
+
+        // A cell beyond 64 bits is found before the file is touched
+        prepared.poke(8, SUBARUU::value_t(1) << 70);
+        REQUIRE_THROWS(Segment::capture(prepared, -3, 8)->save(file));
+        REQUIRE(Segment::map(file)->get(1) == 1000);
+        REQUIRE_FALSE(std::filesystem::exists(file + ".tmp"));
+    }
+
+    SECTION("Only segment files can be mapped") {
+        REQUIRE_THROWS(Segment::map("temp_segment_missing.seg"));
+        REQUIRE_THROWS(Segment::map(setup));
+        prepared.poke(1, SUBARUU::value_t(1) << 70);
+        REQUIRE_THROWS(Segment::capture(prepared, 1, 1)->save(file));
+    }
+}
@@ -0,0 +1,75 @@
+#include "../../include/config.h"
+#include "../../include/sorter.h"
+#include "../../include/subaruu.h"
+#include "temp_file.h"
+#include <algorithm>
+#include <catch2/catch_test_macros.hpp>
+#include <functional>
+#include <numeric>
+#include <random>
+#include <string>
+#include <vector>
+
+TEST_CASE("Radix Sort", "[sort]") {
+    std::mt19937_64 gen(7);
+    const std::size_t sizes[] = { 0, 1, 2, 1000, 3 * SUBARUU_SORT_PARALLEL + 7 };
+    for (const auto n : sizes) {
+        std::vector<std::int64_t> keys(n);
+        for (auto& key : keys)
+            key = static_cast<std::int64_t>(gen()) >> (gen() % 64);
+        for (const bool descending : { false, true }) {
+            auto sorted = keys;
+            Sorter::Order order(n);
+            std::iota(order.begin(), order.end(), 0u);
+            Sorter::radix(sorted, &order, descending, 4);
+            auto expected = keys;
+            if (descending)
+                std::sort(expected.begin(), expected.end(),
+                          std::greater<>());
+            else
+                std::sort(expected.begin(), expected.end());
+            REQUIRE(sorted == expected);
+            bool follows = true;
+            for (std::size_t i = 0; i < n; ++i)
+                follows = follows && keys[order[i]] == sorted[i];
+            REQUIRE(follows);
+        }
+    }
+
+    SECTION("Equal keys keep their order") {
+        std::vector<std::int64_t> keys = { 3, -1, 3, -1, 3 };
+        Sorter::Order order = { 0, 1, 2, 3, 4 };
+        Sorter::radix(keys, &order, true);
+        REQUIRE(order == Sorter::Order{ 0, 2, 4, 1, 3 });
+    }
+}
+
+TEST_CASE("Comparison Sort", "[sort]") {
+    Sorter::value_t big = 1;
+    big <<= 80;
+    const std::vector<Sorter::value_t> values = { big, -big, 5, 5, 0 };
+    REQUIRE(Sorter::compare(values, false) ==
+            Sorter::Order{ 1, 4, 2, 3, 0 });
+    REQUIRE(Sorter::compare(values, true) == Sorter::Order{ 0, 2, 3, 4, 1 });
+}
+
+TEST_CASE("SORT Statement", "[sort]") {
+    const std::string program =
+      "10 LET i = 1\n"
+      "20 LET m[i] = (i * 7) - (i / 3) * 20\n"
+      "30 LET m[i + 100] = i\n"
+      "40 LET i = i + 1\n"
+      "50 IF i < 9 THEN 20\n"
+      "60 SORT m[1 TO 8], m[101]\n"
+      "70 PRINT m[1]; m[2]; m[3]; m[8]; m[101]; m[102]; m[108]\n"
+      "80 SORT m[1 TO 8] DESC\n"
+      "90 PRINT m[1]; m[8]\n"
+      "100 LET m[3] = 4294967296 * 4294967296 * -2\n"
+      "110 SORT m[1 TO 4] ASC\n"
+      "120 PRINT m[1]; m[2]; m[4]\n";
+    const std::string expected = "1 2 7 16 3 6 8\n"
+                                 "16 1\n"
+                                 "-36893488147419103232 9 16\n";
+    REQUIRE(run_program(program, true) == expected);
+    REQUIRE(run_program(program, false) == expected);
+}
@@ -0,0 +1,87 @@
+#include "../../include/str.h"
+#include <catch2/catch_test_macros.hpp>
+#include <sstream>
+#include <string>
+
+TEST_CASE("Str Small Strings", "[str]") {
+    SECTION("Short strings are stored inline") {
+        Str s("hello");
+        REQUIRE(s.is_inline());
+        REQUIRE(s.size() == 5);
+        REQUIRE(s.str() == "hello");
+        REQUIRE(s.at(1) == 'e');
+    }
+
+    SECTION("Concatenation stays inline while it fits") {
+        Str s = Str::concat(Str("hello, "), Str("world"));
+        REQUIRE(s.is_inline());
+        REQUIRE(s.str() == "hello, world");
+    }
+
+    SECTION("Long strings spill to the heap") {
+        const std::string text(100, 'x');
+        Str s(text);
+        REQUIRE_FALSE(s.is_inline());
+        REQUIRE(s.str() == text);
+    }
+
+    SECTION("Comparison is byte-wise") {
+        REQUIRE(Str("abc").compare(Str("abd")) < 0);
+        REQUIRE(Str("abc").compare(Str("abc")) == 0);
+        REQUIRE(Str("b").compare(Str("abc")) > 0);
+        REQUIRE(Str("").compare(Str("a")) < 0);
+    }
+}
+
+TEST_CASE("Str Ropes", "[str]") {
+    SECTION("Appending one character at a time stays balanced") {
+        Str s;
+        std::string expected;
+        for (int i = 0; i < 100000; ++i) {
+            const char c = static_cast<char>('a' + i % 26);
+            s = Str::concat(s, Str(std::string(1, c)));
+            expected += c;
+        }
+        REQUIRE(s.size() == expected.size());
+        REQUIRE(s.str() == expected);
+        // 100000 bytes in leaves of up to SUBARUU_ROPE_LEAF bytes
+        REQUIRE(s.depth() < 20);
+        REQUIRE(s.at(54321) == expected[54321]);
+    }
+
+    SECTION("Prepending stays balanced too") {
+        Str s;
+        std::string expected;
+        for (int i = 0; i < 2000; ++i) {
+            const std::string piece = std::to_string(i) + std::string(40, '.');
+            s = Str::concat(Str(piece), s);
+            expected = piece + expected;
+        }
+        REQUIRE(s.str() == expected);
+        REQUIRE(s.depth() < 20);
+    }
+
+    SECTION("Substrings of a rope") {
+        Str s;
+        std::string expected;
+        for (int i = 0; i < 1000; ++i) {
+            const std::string piece = "<" + std::to_string(i) + ">";
+            s = Str::concat(s, Str(piece));
+            expected += piece;
+        }
+        REQUIRE(s.substr(10, 5).str() == expected.substr(10, 5));
+        REQUIRE(s.substr(100, 3000).str() == expected.substr(100, 3000));
+        REQUIRE(s.substr(expected.size() - 4, 100).str() ==
+                expected.substr(expected.size() - 4));
+        REQUIRE(s.substr(expected.size(), 1).empty());
+        REQUIRE(s.compare(Str(expected)) == 0);
+    }
+
+    SECTION("Streaming writes every leaf in order") {
+        Str s = Str::concat(Str(std::string(600, 'a')),
+                            Str(std::string(600, 'b')));
+        std::ostringstream out;
+        out << s;
+        REQUIRE(out.str() == std::string(600, 'a') + std::string(600, 'b'));
+    }
+}
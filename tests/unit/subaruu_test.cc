@@ -149,3 +149,667 @@ TEST_CASE("SUBARUU GOTO Statement Tests", "[subaru]") {
     }
 }
 #define CATCH_CONFIG_MAIN
+
+TEST_CASE("SUBARUU MERGE and CHAIN", "[subaru]") {
+    const std::string lib = "temp_merge_lib.subaru";
+    const std::string main_file = "temp_merge_main.subaru";
+    const std::string next = "temp_chain_next.subaru";
+    {
+        std::ofstream out(lib);
+        out << "900 LET b = a * 2\n"
+            << "910 GOTO 30\n";
+    }
+    {
+        std::ofstream out(next);
+        out << "10 PRINT \"chained\", a, b, m[7]\n";
+    }
+
+    SECTION("Merged lines are reachable by GOTO") {
+        std::ofstream temp_file(main_file);
+        temp_file << "10 LET a = 21\n"
+                  << "20 GOTO 900\n"
+                  << "30 PRINT b\n"
+                  << "40 GOTO 990\n"
+                  << "MERGE \"" << lib << "\"\n"
+                  << "990 REM end\n";
+        temp_file.close();
+
+        std::stringstream output;
+        std::streambuf* old_cout = std::cout.rdbuf(output.rdbuf());
+        REQUIRE_NOTHROW([&]() {
+            SUBARUU interpreter(main_file);
+            interpreter.run();
+        }());
+        std::cout.rdbuf(old_cout);
+        REQUIRE(output.str() == "42\n");
+    }
+
+    SECTION("CHAIN keeps variables and memory") {
+        std::ofstream temp_file(main_file);
+        temp_file << "10 LET a = 3\n"
+                  << "20 LET b = 4\n"
+                  << "30 LET m[7] = 5\n"
+                  << "40 CHAIN \"" << next << "\"\n"
+                  << "50 PRINT \"not reached\"\n";
+        temp_file.close();
+
+        std::stringstream output;
+        std::streambuf* old_cout = std::cout.rdbuf(output.rdbuf());
+        REQUIRE_NOTHROW([&]() {
+            SUBARUU interpreter(main_file);
+            interpreter.run();
+        }());
+        std::cout.rdbuf(old_cout);
+        REQUIRE(output.str() == "chained 3 4 5\n");
+    }
+
+    std::filesystem::remove(main_file);
+    std::filesystem::remove(next);
+    std::filesystem::remove(lib);
+}
+
+TEST_CASE("SUBARUU Output Channels", "[subaru]") {
+    const std::string temp_filename = "temp_channel_test.subaru";
+    const std::string evens = "temp_channel_evens.txt";
+    const std::string odds = "temp_channel_odds.txt";
+
+    SECTION("PRINT #n writes to the opened file") {
+        std::ofstream temp_file(temp_filename);
+        temp_file << "10 OPEN \"" << evens << "\" FOR OUTPUT AS #1\n"
+                  << "20 OPEN \"" << odds << "\" FOR OUTPUT AS #2\n"
+                  << "30 LET i = 0\n"
+                  << "40 IF i - (i / 2) * 2 THEN 70\n"
+                  << "50 PRINT #1, i\n"
+                  << "60 GOTO 80\n"
+                  << "70 PRINT$ #2, i, \"\"\n"
+                  << "80 LET i = i + 1\n"
+                  << "90 IF i < 6 THEN 40\n"
+                  << "100 CLOSE #1\n"
+                  << "110 PRINT \"done\"\n";
+        temp_file.close();
+
+        std::stringstream output;
+        std::streambuf* old_cout = std::cout.rdbuf(output.rdbuf());
+        REQUIRE_NOTHROW([&]() {
+            SUBARUU interpreter(temp_filename);
+            interpreter.run();
+        }());
+        std::cout.rdbuf(old_cout);
+
+        REQUIRE(output.str() == "done\n");
+        std::ifstream even_file(evens);
+        std::stringstream even_text;
+        even_text << even_file.rdbuf();
+        REQUIRE(even_text.str() == "0\n2\n4\n");
+        std::ifstream odd_file(odds);
+        std::stringstream odd_text;
+        odd_text << odd_file.rdbuf();
+        REQUIRE(odd_text.str() == "1 3 5 ");
+    }
+
+    SECTION("PRINT to a channel that is not open fails") {
+        std::ofstream temp_file(temp_filename);
+        temp_file << "10 PRINT #3, 1\n";
+        temp_file.close();
+
+        REQUIRE_THROWS_AS(
+          [&]() {
+              SUBARUU interpreter(temp_filename);
+              interpreter.run();
+          }(),
+          std::runtime_error);
+    }
+
+    std::filesystem::remove(temp_filename);
+    std::filesystem::remove(evens);
+    std::filesystem::remove(odds);
+}
+
+TEST_CASE("SUBARUU INPUT Statement", "[subaru]") {
+    const std::string temp_filename = "temp_input_test.subaru";
+
+    SECTION("Scalar, indexed and bulk INPUT") {
+        std::ofstream temp_file(temp_filename);
+        temp_file << "10 INPUT n, m[0]\n"
+                  << "20 INPUT m[1 TO n]\n"
+                  << "30 LET s = 0\n"
+                  << "40 LET i = 1\n"
+                  << "50 LET s = s + m[i]\n"
+                  << "60 LET i = i + 1\n"
+                  << "70 IF i <= n THEN 50\n"
+                  << "80 PRINT m[0], s\n";
+        temp_file.close();
+
+        std::istringstream input("4 99\n1 2 3\n40\n");
+        std::stringstream output;
+        std::streambuf* old_cin = std::cin.rdbuf(input.rdbuf());
+        std::streambuf* old_cout = std::cout.rdbuf(output.rdbuf());
+        REQUIRE_NOTHROW([&]() {
+            SUBARUU interpreter(temp_filename);
+            interpreter.run();
+        }());
+        std::cout.rdbuf(old_cout);
+        std::cin.rdbuf(old_cin);
+        REQUIRE(output.str() == "99 46\n");
+    }
+
+    SECTION("INPUT past end of data fails") {
+        std::ofstream temp_file(temp_filename);
+        temp_file << "10 INPUT a, b\n";
+        temp_file.close();
+
+        std::istringstream input("1");
+        std::streambuf* old_cin = std::cin.rdbuf(input.rdbuf());
+        REQUIRE_THROWS_AS(
+          [&]() {
+              SUBARUU interpreter(temp_filename);
+              interpreter.run();
+          }(),
+          std::runtime_error);
+        std::cin.rdbuf(old_cin);
+    }
+
+    std::filesystem::remove(temp_filename);
+}
+
+TEST_CASE("SUBARUU RND and RANDOMIZE", "[subaru]") {
+    const std::string temp_filename = "temp_rnd_test.subaru";
+    auto run = [&](const std::string& program) {
+        std::ofstream temp_file(temp_filename);
+        temp_file << program;
+        temp_file.close();
+        std::stringstream output;
+        std::streambuf* old_cout = std::cout.rdbuf(output.rdbuf());
+        SUBARUU interpreter(temp_filename);
+        interpreter.run();
+        std::cout.rdbuf(old_cout);
+        return output.str();
+    };
+
+    SECTION("A seed reproduces its stream, streams differ") {
+        const auto first = run("10 RANDOMIZE 7, 1\n"
+                               "20 PRINT RND(1000000), RND(1000000)\n");
+        const auto again = run("10 RANDOMIZE 7, 1\n"
+                               "20 PRINT RND(1000000), RND(1000000)\n");
+        const auto other = run("10 RANDOMIZE 7, 2\n"
+                               "20 PRINT RND(1000000), RND(1000000)\n");
+        REQUIRE(first == again);
+        REQUIRE(first != other);
+    }
+
+    SECTION("Bulk RND fills a range within bounds") {
+        const auto out = run("10 RND m[1 TO 100], 6\n"
+                             "20 LET i = 1\n"
+                             "30 IF m[i] < 0 THEN 90\n"
+                             "40 IF m[i] > 5 THEN 90\n"
+                             "50 LET i = i + 1\n"
+                             "60 IF i <= 100 THEN 30\n"
+                             "70 PRINT \"ok\"\n"
+                             "80 GOTO 100\n"
+                             "90 PRINT \"out of range\"\n"
+                             "100 REM end\n");
+        REQUIRE(out == "ok\n");
+    }
+
+    std::filesystem::remove(temp_filename);
+}
+
+TEST_CASE("SUBARUU String Variables", "[subaru]") {
+    const std::string temp_filename = "temp_string_test.subaru";
+    auto run = [&](const std::string& program) {
+        std::ofstream temp_file(temp_filename);
+        temp_file << program;
+        temp_file.close();
+        std::stringstream output;
+        std::streambuf* old_cout = std::cout.rdbuf(output.rdbuf());
+        SUBARUU interpreter(temp_filename);
+        interpreter.run();
+        std::cout.rdbuf(old_cout);
+        return output.str();
+    };
+
+    SECTION("Assignment, concatenation and string functions") {
+        const auto out = run("10 LET a$ = \"Hello\"\n"
+                             "20 LET b$ = a$ + \", \" + \"World\"\n"
+                             "30 PRINT b$, LEN(b$)\n"
+                             "40 PRINT MID$(b$, 8, 3), LEFT$(b$, 4), "
+                             "RIGHT$(b$, 2)\n"
+                             "50 PRINT ASC(a$), CHR$(66) + STR$(42)\n");
+        REQUIRE(out == "Hello, World 12\nWor Hell ld\n72 B42\n");
+    }
+
+    SECTION("Indexed strings and comparison in IF") {
+        const auto out = run("10 LET s$[1] = \"pear\"\n"
+                             "20 LET s$[2] = \"apple\"\n"
+                             "30 IF s$[1] > s$[2] THEN 60\n"
+                             "40 PRINT \"wrong\"\n"
+                             "50 GOTO 70\n"
+                             "60 PRINT s$[2], s$[1]\n"
+                             "70 IF s$[3] = \"\" THEN 90\n"
+                             "80 PRINT \"unset is not empty\"\n"
+                             "90 REM end\n");
+        REQUIRE(out == "apple pear\n");
+    }
+
+    SECTION("Building a long string in a loop") {
+        const auto out = run("10 LET i = 0\n"
+                             "20 LET a$ = a$ + CHR$(65 + i - i / 26 * 26)\n"
+                             "30 LET i = i + 1\n"
+                             "40 IF i < 20000 THEN 20\n"
+                             "50 PRINT LEN(a$), MID$(a$, 26, 3)\n");
+        REQUIRE(out == "20000 ZAB\n");
+    }
+
+    SECTION("Invalid arguments are runtime errors") {
+        auto fails = [&](const std::string& program) {
+            std::ofstream temp_file(temp_filename);
+            temp_file << program;
+            temp_file.close();
+            SUBARUU interpreter(temp_filename);
+            interpreter.run();
+        };
+        REQUIRE_THROWS_AS(fails("10 PRINT MID$(\"abc\", 0, 1)\n"),
+                          std::runtime_error);
+        REQUIRE_THROWS_AS(fails("10 PRINT CHR$(256)\n"), std::runtime_error);
+        REQUIRE_THROWS_AS(fails("10 PRINT ASC(\"\")\n"), std::runtime_error);
+    }
+
+    std::filesystem::remove(temp_filename);
+}
+
+TEST_CASE("SUBARUU Structured Loops", "[subaru]") {
+    const std::string temp_filename = "temp_loop_test.subaru";
+    auto run = [&](const std::string& program) {
+        std::ofstream temp_file(temp_filename);
+        temp_file << program;
+        temp_file.close();
+        std::stringstream output;
+        std::streambuf* old_cout = std::cout.rdbuf(output.rdbuf());
+        SUBARUU interpreter(temp_filename);
+        interpreter.run();
+        std::cout.rdbuf(old_cout);
+        return output.str();
+    };
+    auto fails = [&](const std::string& program) {
+        std::ofstream temp_file(temp_filename);
+        temp_file << program;
+        temp_file.close();
+        SUBARUU interpreter(temp_filename);
+        interpreter.run();
+    };
+
+    SECTION("Nested WHILE/WEND") {
+        const auto out = run("10 LET i = 1\n"
+                             "20 WHILE i <= 3\n"
+                             "30 LET j = 0\n"
+                             "40 WHILE j < i\n"
+                             "50 PRINT$ i\n"
+                             "60 LET j = j + 1\n"
+                             "70 WEND\n"
+                             "80 LET i = i + 1\n"
+                             "90 WEND\n"
+                             "100 PRINT \"|\"\n");
+        REQUIRE(out == "122333|\n");
+    }
+
+    SECTION("A false WHILE skips its body") {
+        const auto out = run("10 WHILE 0\n"
+                             "20 PRINT \"body\"\n"
+                             "30 WEND\n"
+                             "40 PRINT \"after\"\n");
+        REQUIRE(out == "after\n");
+    }
+
+    SECTION("DO/LOOP UNTIL runs at least once, LOOP WHILE repeats") {
+        const auto out = run("10 DO\n"
+                             "20 LET i = i + 1\n"
+                             "30 LOOP UNTIL 1\n"
+                             "40 DO : LET i = i * 2 : LOOP WHILE i < 100\n"
+                             "50 PRINT i\n");
+        REQUIRE(out == "128\n");
+    }
+
+    SECTION("GOTO out of a loop") {
+        const auto out = run("10 DO\n"
+                             "20 LET i = i + 1\n"
+                             "30 IF i = 5 THEN 50\n"
+                             "40 LOOP\n"
+                             "50 PRINT i\n");
+        REQUIRE(out == "5\n");
+    }
+
+    SECTION("Unmatched loop keywords are load errors") {
+        REQUIRE_THROWS_AS(fails("10 WHILE 1\n20 PRINT 1\n"),
+                          std::runtime_error);
+        REQUIRE_THROWS_AS(fails("10 WEND\n"), std::runtime_error);
+        REQUIRE_THROWS_AS(fails("10 DO\n20 WEND\n"), std::runtime_error);
+    }
+
+    std::filesystem::remove(temp_filename);
+}
+
+TEST_CASE("SUBARUU Logical Conditions", "[subaru]") {
+    const std::string temp_filename = "temp_logic_test.subaru";
+    // Prints "T" or "F" for each condition
+    auto check = [&](const std::string& condition, const std::string& setup) {
+        std::ofstream temp_file(temp_filename);
+        temp_file << "10 " << setup << "\n"
+                  << "20 IF " << condition << " THEN 50\n"
+                  << "30 PRINT \"F\"\n"
+                  << "40 GOTO 60\n"
+                  << "50 PRINT \"T\"\n"
+                  << "60 REM end\n";
+        temp_file.close();
+        std::stringstream output;
+        std::streambuf* old_cout = std::cout.rdbuf(output.rdbuf());
+        SUBARUU interpreter(temp_filename);
+        interpreter.run();
+        std::cout.rdbuf(old_cout);
+        return output.str() == "T\n";
+    };
+
+    SECTION("AND, OR and NOT") {
+        REQUIRE(check("a = 4 AND b = 2", "LET a = 4 : LET b = 2"));
+        REQUIRE_FALSE(check("a = 4 AND b = 3", "LET a = 4 : LET b = 2"));
+        REQUIRE(check("a = 5 OR b = 2", "LET a = 4 : LET b = 2"));
+        REQUIRE_FALSE(check("a = 5 OR b = 3", "LET a = 4 : LET b = 2"));
+        REQUIRE(check("NOT a = 5", "LET a = 4"));
+        REQUIRE(check("NOT NOT a", "LET a = 4"));
+    }
+
+    SECTION("NOT binds tighter than AND, AND tighter than OR") {
+        REQUIRE(check("1 OR 0 AND 0", "REM"));
+        REQUIRE_FALSE(check("(1 OR 0) AND 0", "REM"));
+        REQUIRE_FALSE(check("NOT 1 AND 0", "REM"));
+        REQUIRE(check("NOT (1 AND 0)", "REM"));
+    }
+
+    SECTION("Parenthesized conditions and numeric parentheses") {
+        REQUIRE(check("(a < 3 OR a > 5) AND NOT (a = 1)", "LET a = 7"));
+        REQUIRE_FALSE(check("(a < 3 OR a > 5) AND NOT (a = 1)", "LET a = 4"));
+        REQUIRE(check("(a + 1) * 2 = 16 AND m[(a)] = 0", "LET a = 7"));
+        REQUIRE(check("a$ = \"x\" OR LEN(a$) > 3", "LET a$ = \"long\""));
+    }
+
+    SECTION("Skipped operands are not evaluated") {
+        // ASC("") throws if evaluated
+        REQUIRE(check("1 OR ASC(\"\") AND (ASC(\"\") = 0)", "REM"));
+        REQUIRE_FALSE(check("0 AND ASC(\"\")", "REM"));
+    }
+
+    SECTION("Conditions re-evaluated in a loop") {
+        std::ofstream temp_file(temp_filename);
+        temp_file << "10 WHILE i < 20\n"
+                  << "20 IF (i < 5 OR i > 15) AND NOT i = 2 THEN 40\n"
+                  << "30 GOTO 50\n"
+                  << "40 LET n = n + 1\n"
+                  << "50 LET i = i + 1\n"
+                  << "60 WEND\n"
+                  << "70 PRINT n\n";
+        temp_file.close();
+        std::stringstream output;
+        std::streambuf* old_cout = std::cout.rdbuf(output.rdbuf());
+        SUBARUU interpreter(temp_filename);
+        interpreter.run();
+        std::cout.rdbuf(old_cout);
+        REQUIRE(output.str() == "8\n");
+    }
+
+    std::filesystem::remove(temp_filename);
+}
+
+TEST_CASE("SUBARUU Load-Time Verification", "[subaru]") {
+    const std::string temp_filename = "temp_verify_test.subaru";
+    std::ofstream temp_file(temp_filename);
+    temp_file << "10 PRINT \"started\"\n"
+              << "20 GOTO 35\n"
+              << "30 LET a = (1\n";
+    temp_file.close();
+
+    SECTION("Verification reports every problem before anything runs") {
+        std::stringstream output;
+        std::streambuf* old_cout = std::cout.rdbuf(output.rdbuf());
+        std::string message;
+        try {
+            SUBARUU interpreter(temp_filename);
+            interpreter.run();
+        } catch (const std::runtime_error& e) {
+            message = e.what();
+        }
+        std::cout.rdbuf(old_cout);
+        REQUIRE(output.str().empty());
+        REQUIRE(message.find("line 20: GOTO target 35 not found") !=
+                std::string::npos);
+        REQUIRE(message.find("line 30: Unbalanced") != std::string::npos);
+    }
+
+    SECTION("Unverified programs fail when the bad line runs") {
+        std::stringstream output;
+        std::streambuf* old_cout = std::cout.rdbuf(output.rdbuf());
+        SUBARUU interpreter(temp_filename, SUBARUU::Options{ false });
+        REQUIRE_THROWS_AS(interpreter.run(), std::runtime_error);
+        std::cout.rdbuf(old_cout);
+        REQUIRE(output.str() == "started\n");
+    }
+
+    std::filesystem::remove(temp_filename);
+}
+
+TEST_CASE("SUBARUU Cloning", "[subaru]") {
+    const std::string temp_filename = "temp_clone_test.subaru";
+    std::ofstream temp_file(temp_filename);
+    temp_file << "10 LET m[1] = 5\n"
+              << "20 LET a = 1\n"
+              << "30 LET s$ = \"base\"\n"
+              << "40 LET m[1] = m[1] + a\n"
+              << "50 LET a = a + 1\n"
+              << "60 PRINT m[1], a, s$\n";
+    temp_file.close();
+
+    SECTION("run_until pauses before the line and run resumes") {
+        std::stringstream output;
+        std::streambuf* old_cout = std::cout.rdbuf(output.rdbuf());
+        SUBARUU interpreter(temp_filename);
+        REQUIRE(interpreter.run_until(40));
+        REQUIRE(interpreter.peek(1) == 5);
+        interpreter.run();
+        std::cout.rdbuf(old_cout);
+        REQUIRE(output.str() == "6 2 base\n");
+        REQUIRE(interpreter.finished());
+    }
+
+    SECTION("run_until reports a line that is never reached") {
+        std::stringstream output;
+        std::streambuf* old_cout = std::cout.rdbuf(output.rdbuf());
+        SUBARUU interpreter(temp_filename);
+        const bool reached = interpreter.run_until(70);
+        std::cout.rdbuf(old_cout);
+        REQUIRE_FALSE(reached);
+        REQUIRE(interpreter.finished());
+    }
+
+    SECTION("Clones diverge without affecting each other") {
+        std::stringstream output;
+        std::streambuf* old_cout = std::cout.rdbuf(output.rdbuf());
+        SUBARUU interpreter(temp_filename);
+        REQUIRE(interpreter.run_until(40));
+        auto fork = interpreter.clone();
+        fork->poke(1, 100);
+        fork->run();
+        interpreter.run();
+        std::cout.rdbuf(old_cout);
+        REQUIRE(output.str() == "101 2 base\n6 2 base\n");
+        REQUIRE(interpreter.peek(1) == 6);
+        REQUIRE(fork->peek(1) == 101);
+    }
+
+    std::filesystem::remove(temp_filename);
+}
+
+TEST_CASE("SUBARUU Clone RND Substreams", "[subaru]") {
+    const std::string temp_filename = "temp_clone_rnd_test.subaru";
+    std::ofstream temp_file(temp_filename);
+    temp_file << "10 RANDOMIZE 11\n"
+              << "20 PRINT RND(1000000000)\n";
+    temp_file.close();
+
+    auto draw = [](SUBARUU& interpreter) {
+        std::stringstream output;
+        std::streambuf* old_cout = std::cout.rdbuf(output.rdbuf());
+        interpreter.run();
+        std::cout.rdbuf(old_cout);
+        return output.str();
+    };
+
+    SUBARUU interpreter(temp_filename);
+    REQUIRE(interpreter.run_until(20));
+    auto same = interpreter.clone(0);
+    auto first = interpreter.clone(1);
+    auto second = interpreter.clone(2);
+    const auto base = draw(interpreter);
+    REQUIRE(draw(*same) == base);
+    REQUIRE(draw(*first) != base);
+    REQUIRE(draw(*second) != draw(*interpreter.clone(1)));
+
+    std::filesystem::remove(temp_filename);
+}
+
+TEST_CASE("SUBARUU Expression Evaluation", "[subaru]") {
+    const std::string temp_filename = "temp_expression_test.subaru";
+    auto run = [&](const std::string& program, bool verify = true) {
+        std::ofstream temp_file(temp_filename);
+        temp_file << program;
+        temp_file.close();
+        std::stringstream output;
+        std::streambuf* old_cout = std::cout.rdbuf(output.rdbuf());
+        SUBARUU interpreter(temp_filename, SUBARUU::Options{ verify });
+        interpreter.run();
+        std::cout.rdbuf(old_cout);
+        return output.str();
+    };
+    auto error = [&](const std::string& program) {
+        std::ofstream temp_file(temp_filename);
+        temp_file << program;
+        temp_file.close();
+        try {
+            SUBARUU interpreter(temp_filename, SUBARUU::Options{ false });
+            interpreter.run();
+        } catch (const std::runtime_error& e) {
+            return std::string(e.what());
+        }
+        return std::string();
+    };
+
+    SECTION("Precedence, associativity and unary minus") {
+        REQUIRE(run("10 PRINT 2 + 3 * 4 - 10 / 2 - 1\n") == "8\n");
+        REQUIRE(run("10 PRINT 99 / 3 / 11, 11 - 3 - 2\n") == "3 6\n");
+        REQUIRE(run("10 PRINT -2 * 3, - - 4, 2 * -(3 + 1)\n") ==
+                "-6 4 -8\n");
+        REQUIRE(run("10 LET m[3] = 7\n20 LET a = 1\n"
+                    "30 PRINT -m[a + 2] * 2, m[m[3] - 4] + 1\n") ==
+                "-14 8\n");
+    }
+
+    SECTION("String functions inside expressions") {
+        REQUIRE(run("10 LET s$ = \"hello\"\n"
+                    "20 PRINT LEN(s$ + MID$(s$, 1 + 1, 2)) * 2 + ASC(s$)\n") ==
+                "118\n");
+    }
+
+    SECTION("A repeated expression is reused") {
+        REQUIRE(run("10 LET i = 0\n20 LET t = 0\n"
+                    "30 LET t = t + i * (i - 1) / 2\n"
+                    "40 LET i = i + 1\n50 IF i < 10 THEN 30\n"
+                    "60 PRINT t\n") == "120\n");
+    }
+
+    SECTION("Variable-plus-constant indices match general ones") {
+        const std::string walk =
+          "10 LET i = -3\n"
+          "20 LET m[i + 1] = i * i\n"
+          "30 LET m[100 + i] = m[i + 1] + m[i - 1]\n"
+          "40 LET i = i + 1\n50 IF i < 40 THEN 20\n"
+          "60 LET t = 0\n70 LET i = -3\n"
+          "80 LET t = t + m[i] * 3 + m[100 + i]\n"
+          "90 LET i = i + 1\n100 IF i < 40 THEN 80\n"
+          "110 PRINT t, m[0 + 0], m[5 - 1]\n";
+        // (i) is not of a site's form, so this walk takes the general path
+        std::string general = walk;
+        for (const std::string site : { "[i", "+ i]" }) {
+            for (std::size_t at = 0;
+                 (at = general.find(site, at)) != std::string::npos;
+                 at += site.size() + 2)
+                general.replace(at + site.find('i'), 1, "(i)");
+        }
+        const std::string result = run(walk);
+        REQUIRE(result == run(general));
+        REQUIRE(result.substr(result.find(' ')) == " 1 9\n");
+        // Indices beyond 64 bits and at its edges take the general path
+        REQUIRE(run("10 LET w = 4611686018427387904\n"
+                    "20 LET m[w + 1] = 1\n30 LET m[w - 1] = 2\n"
+                    "40 LET n = -9223372036854775807\n"
+                    "50 LET m[n - 1] = 3\n60 LET m[n + 1] = 4\n"
+                    "70 LET v = w * w\n80 LET m[v - 1] = 5\n"
+                    "90 PRINT m[4611686018427387905], m[w + 1 - 2],"
+                    " m[-9223372036854775808], m[n + 1], m[v + 0 - 1]\n") ==
+                "1 2 3 4 5\n");
+    }
+
+    SECTION("A product of unchanged large variables is reused") {
+        const std::string program =
+          "10 LET s = 2 * 1180591620717411303424 * 1180591620717411303424\n"
+          "20 LET i = 0\n30 LET t = 0\n"
+          "40 LET r = s * s - i * 0\n"
+          "50 LET t = t + r / s / s\n"
+          "60 IF NOT i = 5 THEN 70\n65 LET s = s + 1\n"
+          "70 LET i = i + 1\n80 IF i < 10 THEN 40\n"
+          "90 LET q = 3 * 4\n100 LET i = i + 1\n110 IF i < 15 THEN 90\n"
+          "120 PRINT t, r - s * s, q\n";
+        std::ofstream temp_file(temp_filename);
+        temp_file << program;
+        temp_file.close();
+        std::stringstream output;
+        std::streambuf* old_cout = std::cout.rdbuf(output.rdbuf());
+        SUBARUU interpreter(temp_filename, SUBARUU::Options{ false });
+        interpreter.run();
+        std::cout.rdbuf(old_cout);
+        REQUIRE(output.str() == "10 0 12\n");
+        // Line 40 reads i, which changes every time; line 90 is small
+        REQUIRE(interpreter.stats().memo_hits == 0);
+
+        std::string reused = program;
+        reused.replace(reused.find(" - i * 0"), 8, "");
+        temp_file.open(temp_filename);
+        temp_file << reused;
+        temp_file.close();
+        old_cout = std::cout.rdbuf(output.rdbuf());
+        output.str("");
+        SUBARUU again(temp_filename, SUBARUU::Options{ false });
+        again.run();
+        std::cout.rdbuf(old_cout);
+        REQUIRE(output.str() == "10 0 12\n");
+        // Computed on the first two passes and after s changed
+        REQUIRE(again.stats().memo_lookups == 7);
+        REQUIRE(again.stats().memo_hits == 6);
+    }
+
+    SECTION("Deep nesting does not use native stack per level") {
+        const int depth = 100000;
+        std::string program = "10 PRINT " + std::string(depth, '(') + "1" +
+                              std::string(depth, ')') + " + " +
+                              std::string(depth, '-') + "2\n";
+        REQUIRE(run(program, false) == "3\n");
+    }
+
+    SECTION("Syntax errors keep their messages") {
+        REQUIRE(error("10 PRINT 1 + \n") ==
+                "Syntax Error: Unexpected token in factor: EOL");
+        REQUIRE(error("10 PRINT (1 + 2\n") ==
+                "*subaruu.cpp: unexpected `EOL` expected `RIGHT_PAREN`");
+        REQUIRE(error("10 LET a = m[1 + 2)\n") ==
+                "*subaruu.cpp: unexpected `RIGHT_PAREN` expected "
+                "`RIGHT_BRACKET`");
+    }
+
+    std::filesystem::remove(temp_filename);
+}
@@ -0,0 +1,261 @@
+#include "../../include/sweep.h"
+#include "temp_file.h"
+#include <catch2/catch_test_macros.hpp>
+#include <chrono>
+#include <cstdint>
+#include <future>
+#include <sstream>
+#include <stdexcept>
+#include <netinet/in.h>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+const std::string PROGRAM = "temp_sweep.subaru";
+const std::string MANIFEST = "program temp_sweep.subaru\n"
+                             "vary a 1 TO 5 STEP 2\n"
+                             "vary b 1 2 3\n"
+                             "report r m[5]\n"
+                             "shard 2\n";
+
+const std::string PROGRAM_TEXT = "10 LET r = a * 10 + b\n"
+                                 "20 LET m[5] = r * r\n"
+                                 "30 IF a = 3 AND b = 2 THEN 999\n"
+                                 "40 PRINT r\n";
+
+bool fails_with(const std::string& manifest, const std::string& message) {
+    try {
+        Sweep sweep("manifest", manifest);
+    } catch (const std::runtime_error& e) {
+        return std::string(e.what()).find(message) != std::string::npos;
+    }
+    return false;
+}
+
+std::string table(const Sweep& sweep,
+                  const std::vector<Sweep::Result>& results) {
+    std::ostringstream out;
+    sweep.table(out, results);
+    return out.str();
+}
+
+// Connects to a coordinator ("unix:PATH" or "127.0.0.1:PORT"), takes a
+// shard and hangs up; with `values`, first sends a result for the shard's
+// first run reporting that many values
+void flaky_worker(const std::string& endpoint,
+                  std::uint64_t fingerprint,
+                  std::size_t values = SIZE_MAX) {
+    sockaddr_un local{};
+    sockaddr_in tcp{};
+    sockaddr* address = reinterpret_cast<sockaddr*>(&tcp);
+    socklen_t length = sizeof(tcp);
+    if (endpoint.rfind("unix:", 0) == 0) {
+        local.sun_family = AF_UNIX;
+        endpoint.copy(local.sun_path, endpoint.size() - 5, 5);
+        address = reinterpret_cast<sockaddr*>(&local);
+        length = sizeof(local);
+    } else {
+        tcp.sin_family = AF_INET;
+        tcp.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        tcp.sin_port = htons(static_cast<std::uint16_t>(
+          std::stoi(endpoint.substr(endpoint.rfind(':') + 1))));
+    }
+    const int fd = ::socket(address->sa_family, SOCK_STREAM, 0);
+    if (::connect(fd, address, length) == 0) {
+        const std::string hello = "HELLO " + std::to_string(fingerprint) + "\n";
+        ::send(fd, hello.data(), hello.size(), MSG_NOSIGNAL);
+        std::string shard;
+        char c = 0;
+        while (::recv(fd, &c, 1, 0) == 1 && c != '\n')
+            shard += c;
+        if (values != SIZE_MAX) {
+            std::istringstream fields(shard);
+            std::string keyword, id, first;
+            fields >> keyword >> id >> first;
+            std::string result = "RESULT " + first + " ok";
+            for (std::size_t k = 0; k < values; ++k)
+                result += " 1";
+            result += "\n";
+            ::send(fd, result.data(), result.size(), MSG_NOSIGNAL);
+            // Wait for the coordinator to drop this worker
+            while (::recv(fd, &c, 1, 0) == 1) {
+            }
+        }
+    }
+    ::close(fd);
+}
+
+} // namespace
+
+TEST_CASE("Sweep Manifest", "[sweep]") {
+    const TempFile program(PROGRAM, PROGRAM_TEXT);
+
+    SECTION("The grid is the product of the vary lines") {
+        Sweep sweep("manifest", MANIFEST);
+        REQUIRE(sweep.size() == 9);
+        REQUIRE(sweep.shard_size() == 2);
+        REQUIRE(sweep.axes().size() == 2);
+        REQUIRE(sweep.point(0) == std::vector<Sweep::value_t>{ 1, 1 });
+        REQUIRE(sweep.point(5) == std::vector<Sweep::value_t>{ 3, 3 });
+        REQUIRE(sweep.point(8) == std::vector<Sweep::value_t>{ 5, 3 });
+        REQUIRE(Sweep("manifest", MANIFEST).fingerprint() ==
+                sweep.fingerprint());
+        REQUIRE(Sweep("manifest", MANIFEST + "# more\n").fingerprint() !=
+                sweep.fingerprint());
+    }
+
+    SECTION("Runs in process, recording failed runs") {
+        Sweep sweep("manifest", MANIFEST);
+        const auto results =
+          sweep.run(0, sweep.size(), SUBARUU::Options{ false });
+        REQUIRE(results.size() == 9);
+        REQUIRE(results[4].ok == false);
+        REQUIRE(results[4].error.find("999") != std::string::npos);
+        const auto text = table(sweep, results);
+        REQUIRE(text.rfind("run\ta\tb\tr\tm[5]\tstatus\n"
+                           "0\t1\t1\t11\t121\tok\n"
+                           "1\t1\t2\t12\t144\tok\n",
+                           0) == 0);
+        REQUIRE(text.find("\n4\t3\t2\t\t\terror: ") != std::string::npos);
+        REQUIRE(text.find("\n8\t5\t3\t53\t2809\tok\n") != std::string::npos);
+    }
+
+    SECTION("Malformed manifests are rejected") {
+        REQUIRE(fails_with("vary a 1\n", "no program"));
+        REQUIRE(fails_with(MANIFEST + "vary a 2\n", "a already varies"));
+        REQUIRE(fails_with(MANIFEST + "vary ab 2\n", "expected a variable"));
+        REQUIRE(fails_with(MANIFEST + "vary c 1 TO x\n", "expected a number"));
+        REQUIRE(fails_with(MANIFEST + "vary c 5 TO 1\n", "FIRST <= LAST"));
+        REQUIRE(fails_with(MANIFEST + "report m[q]\n", "expected a number"));
+        REQUIRE(fails_with(MANIFEST + "shard 0\n", "positive number"));
+        REQUIRE(fails_with(MANIFEST + "limit 3\n", "unknown keyword"));
+    }
+
+    SECTION("Results survive the wire") {
+        const Sweep::Result ok{
+            7, true, { -3, Sweep::value_t("123456789012345678901234567890") }, ""
+        };
+        const auto line = Sweep::encode(ok);
+        REQUIRE(line == "RESULT 7 ok -3 123456789012345678901234567890\n");
+        const auto back = Sweep::decode(line.substr(0, line.size() - 1));
+        REQUIRE(back.run == 7);
+        REQUIRE(back.ok);
+        REQUIRE(back.values == ok.values);
+        const auto failed = Sweep::decode("RESULT 2 error Line 9 not found");
+        REQUIRE_FALSE(failed.ok);
+        REQUIRE(failed.error == "Line 9 not found");
+        REQUIRE_THROWS_AS(Sweep::decode("RESULT x ok"), std::runtime_error);
+        REQUIRE_THROWS_AS(Sweep::decode("RESULT 1 ok 1x"), std::runtime_error);
+    }
+}
+
+TEST_CASE("Sweep Coordinator", "[sweep]") {
+    const TempFile program(PROGRAM, PROGRAM_TEXT);
+    const Sweep sweep("manifest", MANIFEST);
+    const auto local =
+      table(sweep, sweep.run(0, sweep.size(), SUBARUU::Options{ false }));
+
+    SECTION("Workers over a Unix socket merge into one table") {
+        Coordinator coordinator(sweep, "unix:temp_sweep.sock");
+        std::vector<std::future<std::size_t>> workers;
+        for (int k = 0; k < 3; ++k) {
+            workers.push_back(std::async(std::launch::async, [&] {
+                return sweep.work("unix:temp_sweep.sock",
+                                  SUBARUU::Options{ false });
+            }));
+        }
+        // Let every worker connect; one alone could finish the sweep
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        const auto results = coordinator.run();
+        std::size_t runs = 0;
+        for (auto& worker : workers)
+            runs += worker.get();
+        REQUIRE(runs == 9);
+        REQUIRE(table(sweep, results) == local);
+        REQUIRE(coordinator.retries() == 0);
+    }
+
+    SECTION("Shards of a worker that hangs up are retried over TCP") {
+        Coordinator coordinator(sweep, "127.0.0.1:0");
+        const auto endpoint = coordinator.endpoint();
+        REQUIRE(endpoint.rfind("127.0.0.1:", 0) == 0);
+        REQUIRE(endpoint != "127.0.0.1:0");
+        auto merged = std::async(std::launch::async,
+                                 [&coordinator] { return coordinator.run(); });
+        flaky_worker(endpoint, sweep.fingerprint());
+        flaky_worker(endpoint, sweep.fingerprint());
+        std::size_t failed = 0;
+        REQUIRE(sweep.work(endpoint, SUBARUU::Options{ false }, &failed) == 9);
+        REQUIRE(failed == 1);
+        REQUIRE(table(sweep, merged.get()) == local);
+        REQUIRE(coordinator.retries() == 2);
+    }
+
+    SECTION("A result with the wrong number of values drops the worker") {
+        Coordinator coordinator(sweep, "unix:temp_sweep.sock");
+        auto merged = std::async(std::launch::async,
+                                 [&coordinator] { return coordinator.run(); });
+        flaky_worker("unix:temp_sweep.sock", sweep.fingerprint(), 1);
+        flaky_worker("unix:temp_sweep.sock", sweep.fingerprint(), 3);
+        REQUIRE(sweep.work("unix:temp_sweep.sock", SUBARUU::Options{ false }) ==
+                9);
+        REQUIRE(table(sweep, merged.get()) == local);
+        REQUIRE(coordinator.retries() == 2);
+    }
+
+    SECTION("A shard that keeps failing fails the sweep") {
+        Coordinator coordinator(sweep, "unix:temp_sweep.sock");
+        auto merged = std::async(std::launch::async,
+                                 [&coordinator] { return coordinator.run(); });
+        for (std::size_t k = 0; k < SUBARUU_SWEEP_ATTEMPTS; ++k)
+            flaky_worker("unix:temp_sweep.sock", sweep.fingerprint());
+        REQUIRE_THROWS_AS(merged.get(), std::runtime_error);
+    }
+
+    SECTION("A program that fails to load fails every run") {
+        Coordinator coordinator(sweep, "unix:temp_sweep.sock");
+        auto merged = std::async(std::launch::async,
+                                 [&coordinator] { return coordinator.run(); });
+        // Verification finds the missing line 999 and the load fails
+        REQUIRE(sweep.work("unix:temp_sweep.sock", SUBARUU::Options{}) == 9);
+        const auto results = merged.get();
+        REQUIRE(results.size() == 9);
+        for (const auto& result : results) {
+            REQUIRE_FALSE(result.ok);
+            REQUIRE(result.error.find("Verification failed") !=
+                    std::string::npos);
+        }
+    }
+
+    SECTION("A sweep with no workers left fails") {
+        Coordinator coordinator(sweep, "unix:temp_sweep.sock");
+        std::size_t checks = 0;
+        const auto supervise = [&checks] {
+            return ++checks < 3 ? std::size_t(1) : std::size_t(0);
+        };
+        REQUIRE_THROWS_AS(coordinator.run(supervise), std::runtime_error);
+        REQUIRE(checks == 3);
+    }
+
+    SECTION("Workers of a different sweep are refused") {
+        Coordinator coordinator(sweep, "unix:temp_sweep.sock");
+        auto merged = std::async(std::launch::async,
+                                 [&coordinator] { return coordinator.run(); });
+        const Sweep other("manifest", MANIFEST + "vary c 1 2\n");
+        REQUIRE_THROWS_AS(
+          other.work("unix:temp_sweep.sock", SUBARUU::Options{ false }),
+          std::runtime_error);
+        REQUIRE(sweep.work("unix:temp_sweep.sock", SUBARUU::Options{ false }) ==
+                9);
+        REQUIRE(table(sweep, merged.get()) == local);
+    }
+
+    REQUIRE_THROWS_AS(
+      sweep.work("unix:temp_sweep.sock", SUBARUU::Options{ false }),
+      std::runtime_error);
+}
@@ -0,0 +1,55 @@
+// temp_file.h
+
+#pragma once
+
+#include "../../include/subaruu.h"
+
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <system_error>
+#include <utility>
+
+// A file removed when it goes out of scope, whether or not the test using
+// it threw: one the test writes itself, or a program written up front
+class TempFile {
+    public:
+        explicit TempFile(std::string path)
+          : path_(std::move(path)) {}
+        TempFile(std::string path, const std::string& text)
+          : path_(std::move(path)) {
+            std::ofstream out(path_);
+            out << text;
+        }
+        ~TempFile() {
+            std::error_code ignored;
+            std::filesystem::remove(path_, ignored);
+        }
+        TempFile(const TempFile&) = delete;
+        TempFile& operator=(const TempFile&) = delete;
+
+        [[nodiscard]] const std::string& path() const noexcept {
+            return path_;
+        }
+
+    private:
+        std::string path_;
+};
+
+// Runs text as a program on the chosen engine and returns what it printed;
+// its stats are copied out when asked for
+inline std::string run_program(const std::string& text,
+                               bool compact,
+                               SUBARUU::Stats* stats = nullptr) {
+    const TempFile program("temp_program.subaru", text);
+    std::ostringstream out;
+    SUBARUU::Options options;
+    options.compact = compact;
+    options.output = &out;
+    SUBARUU subaruu(program.path(), options);
+    subaruu.run();
+    if (stats)
+        *stats = subaruu.stats();
+    return out.str();
+}
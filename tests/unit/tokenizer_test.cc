@@ -67,7 +67,7 @@ TEST_CASE("Tokenizer Complex Expressions", "[tokenizer]") {
         while (!tokenizer.finished()) {
             const auto& data = tokenizer.get_token_data();
             // Just checking if we can iterate through tokens
-            if (std::holds_alternative<int>(data)) {
+            if (std::holds_alternative<boost::multiprecision::cpp_int>(data)) {
                 found_arithmetic = true;
                 break;
             }
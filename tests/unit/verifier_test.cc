@@ -0,0 +1,63 @@
+#include "../../include/io.h"
+#include "../../include/verifier.h"
+#include <catch2/catch_test_macros.hpp>
+#include <string>
+
+TEST_CASE("Verifier Valid Programs", "[verifier]") {
+    SECTION("Statements, conditions, strings and loops") {
+        Verifier verifier("valid",
+                          "10 REM (unbalanced ( text in a comment\n"
+                          "20 LET a = (1 + 2) * -m[a + 1]\n"
+                          "30 LET s$ = MID$(\"abc\", 2) + CHR$(65)\n"
+                          "40 IF (a < 3 OR a > 5) AND NOT s$ = \"x\" THEN 60\n"
+                          "50 PRINT \"a\", a; TAB(3) LEN(s$)\n"
+                          "60 WHILE a < 10 : LET a = a + 1 : WEND\n"
+                          "70 DO\n"
+                          "80 INPUT b, m[1 TO 3]\n"
+                          "90 LOOP UNTIL b = 0\n"
+                          "100 GOTO 10\n");
+        REQUIRE(verifier.ok());
+    }
+
+    SECTION("Sample programs verify") {
+        for (const char* path :
+             { "tests/fib.subaru", "tests/fractal.subaru",
+               "tests/collatz.subaru", "tests/primegen.subaru",
+               "tests/print.subaru" }) {
+            IO io(path);
+            Verifier verifier(path, std::string(io.begin(), io.end()));
+            REQUIRE(verifier.report() == "");
+        }
+    }
+}
+
+TEST_CASE("Verifier Diagnostics", "[verifier]") {
+    SECTION("Every problem is reported with its line number") {
+        Verifier verifier("broken",
+                          "10 GOTO 95\n"
+                          "20 LET a = (1 + 2\n"
+                          "30 IF a THEN\n"
+                          "40 LET = 5\n"
+                          "50 PRINT m[1]]\n"
+                          "60 WEND\n"
+                          "70 FROB\n"
+                          "80 IF a < 1 THEN 40\n");
+        const auto& d = verifier.diagnostics();
+        REQUIRE(d.size() == 7);
+        REQUIRE(d[0].line == 10);
+        REQUIRE(d[0].message == "GOTO target 95 not found");
+        REQUIRE(d[1].line == 20);
+        REQUIRE(d[2].line == 30);
+        REQUIRE(d[3].line == 40);
+        REQUIRE(d[4].line == 50);
+        REQUIRE(d[5].line == 60);
+        REQUIRE(d[6].line == 70);
+    }
+
+    SECTION("Unclosed loops are reported at their opening line") {
+        Verifier verifier("loops", "10 WHILE 1\n20 DO\n30 LOOP\n");
+        REQUIRE(verifier.diagnostics().size() == 1);
+        REQUIRE(verifier.diagnostics()[0].line == 10);
+        REQUIRE(verifier.report() == "  line 10: WHILE is never closed");
+    }
+}
@@ -0,0 +1,135 @@
+#include "../../include/writer.h"
+#include <catch2/catch_test_macros.hpp>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#ifdef SUBARUU_WITH_ZLIB
+#include <zlib.h>
+#endif
+
+static std::string read_back(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    std::stringstream content;
+    content << in.rdbuf();
+    return content.str();
+}
+
+#ifdef SUBARUU_WITH_ZLIB
+// Inflates a gzip file as far as it goes; complete is set if the stream
+// ended with its trailer
+static std::string gunzip(const std::string& path, bool& complete) {
+    std::string packed = read_back(path);
+    z_stream stream{};
+    inflateInit2(&stream, 15 + 16);
+    stream.next_in = reinterpret_cast<Bytef*>(packed.data());
+    stream.avail_in = static_cast<uInt>(packed.size());
+    std::string text;
+    int status = Z_OK;
+    char block[4096];
+    while (status == Z_OK) {
+        stream.next_out = reinterpret_cast<Bytef*>(block);
+        stream.avail_out = sizeof(block);
+        status = inflate(&stream, Z_NO_FLUSH);
+        text.append(block, sizeof(block) - stream.avail_out);
+    }
+    inflateEnd(&stream);
+    complete = status == Z_STREAM_END && stream.avail_in == 0;
+    return text;
+}
+#endif
+
+TEST_CASE("BufferedWriter Output", "[writer]") {
+    const std::string path = "temp_writer_test.txt";
+    std::string expected;
+    for (int i = 0; i < 1000; ++i)
+        expected += "line " + std::to_string(i) + "\n";
+
+    SECTION("Synchronous writes larger than the buffer") {
+        {
+            OutputFile out(path, 64, false);
+            out << expected;
+            out.close();
+        }
+        REQUIRE(read_back(path) == expected);
+    }
+
+    SECTION("Asynchronous writes larger than the buffer") {
+        {
+            OutputFile out(path, 64, true);
+            for (int i = 0; i < 1000; ++i)
+                out << "line " << i << '\n';
+        }
+        REQUIRE(read_back(path) == expected);
+    }
+
+    SECTION("Flush makes buffered output visible") {
+        OutputFile out(path, 1 << 20, true);
+        out << "partial";
+        out.flush();
+        REQUIRE(read_back(path) == "partial");
+    }
+
+    std::filesystem::remove(path);
+}
+
+#ifdef SUBARUU_WITH_ZLIB
+TEST_CASE("BufferedWriter Gzip", "[writer]") {
+    const std::string path = "temp_writer_test.txt.gz";
+    REQUIRE(BufferedWriter::compression_for(path) ==
+            BufferedWriter::Compression::GZIP);
+    REQUIRE(BufferedWriter::compression_for(".gz") ==
+            BufferedWriter::Compression::NONE);
+    REQUIRE(BufferedWriter::compression_for("out.txt") ==
+            BufferedWriter::Compression::NONE);
+    std::string expected;
+    for (int i = 0; i < 20000; ++i)
+        expected += "line " + std::to_string(i) + "\n";
+    bool complete = false;
+
+    SECTION("Asynchronous blocks form one gzip stream") {
+        {
+            OutputFile out(path, 4096, true, BufferedWriter::Compression::GZIP);
+            for (int i = 0; i < 20000; ++i)
+                out << "line " << i << '\n';
+            out.close();
+        }
+        REQUIRE(gunzip(path, complete) == expected);
+        REQUIRE(complete);
+        REQUIRE(read_back(path).size() < expected.size() / 4);
+    }
+
+    SECTION("Synchronous writes with a small buffer") {
+        {
+            OutputFile out(path, 64, false, BufferedWriter::Compression::GZIP);
+            out << expected;
+        }
+        REQUIRE(gunzip(path, complete) == expected);
+        REQUIRE(complete);
+    }
+
+    SECTION("Flush makes compressed output readable so far") {
+        OutputFile out(path, 1 << 20, true, BufferedWriter::Compression::GZIP);
+        out << "partial";
+        out.flush();
+        REQUIRE(gunzip(path, complete) == "partial");
+        REQUIRE_FALSE(complete);
+        out << " and the rest";
+        out.flush();
+        out.flush();
+        REQUIRE(gunzip(path, complete) == "partial and the rest");
+        out.close();
+        REQUIRE(gunzip(path, complete) == "partial and the rest");
+        REQUIRE(complete);
+    }
+
+    std::filesystem::remove(path);
+}
+#endif
+
+TEST_CASE("BufferedWriter Errors", "[writer]") {
+    SECTION("Opening a file in a missing directory throws") {
+        REQUIRE_THROWS_AS(OutputFile("no/such/dir/out.txt", 64, false),
+                          std::runtime_error);
+    }
+}